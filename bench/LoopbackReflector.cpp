@@ -0,0 +1,134 @@
+#include "LoopbackReflector.h"
+#include "P25Protocol.h"
+#include "LduBundler.h"
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <cstring>
+
+LoopbackReflector::LoopbackReflector()
+    : m_socket(-1)
+    , m_port(0)
+    , m_running(false)
+    , m_hasPeer(false)
+    , m_bundling(true)
+    , m_rxPackets(0)
+    , m_rxBytes(0)
+    , m_rxRecords(0)
+    , m_rxBundles(0)
+{
+    memset(&m_peer, 0, sizeof(m_peer));
+}
+
+LoopbackReflector::~LoopbackReflector() {
+    stop();
+}
+
+bool LoopbackReflector::start() {
+    m_socket = socket(AF_INET, SOCK_DGRAM, 0);
+    if (m_socket < 0) {
+        return false;
+    }
+
+    struct timeval tv;
+    tv.tv_sec = 0;
+    tv.tv_usec = 100000;  // 100ms so stop() is noticed
+    setsockopt(m_socket, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    // Large receive buffer so throughput runs are not limited by drops here
+    int rcvbuf = 4 * 1024 * 1024;
+    setsockopt(m_socket, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+
+    if (bind(m_socket, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        ::close(m_socket);
+        m_socket = -1;
+        return false;
+    }
+
+    socklen_t addrLen = sizeof(addr);
+    getsockname(m_socket, (struct sockaddr*)&addr, &addrLen);
+    m_port = ntohs(addr.sin_port);
+
+    m_running = true;
+    m_thread = std::thread(&LoopbackReflector::receiveThread, this);
+    return true;
+}
+
+void LoopbackReflector::stop() {
+    if (!m_running) {
+        return;
+    }
+
+    m_running = false;
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+
+    if (m_socket >= 0) {
+        ::close(m_socket);
+        m_socket = -1;
+    }
+}
+
+void LoopbackReflector::resetCounters() {
+    m_rxPackets = 0;
+    m_rxBytes = 0;
+    m_rxRecords = 0;
+    m_rxBundles = 0;
+}
+
+bool LoopbackReflector::sendToPeer(const uint8_t* data, size_t length) {
+    std::lock_guard<std::mutex> lock(m_peerMutex);
+    if (!m_hasPeer) {
+        return false;
+    }
+
+    return sendto(m_socket, data, length, 0, (struct sockaddr*)&m_peer, sizeof(m_peer)) == static_cast<ssize_t>(length);
+}
+
+void LoopbackReflector::receiveThread() {
+    uint8_t buffer[2048];
+
+    while (m_running) {
+        struct sockaddr_in from;
+        socklen_t fromLen = sizeof(from);
+        ssize_t received = recvfrom(m_socket, buffer, sizeof(buffer), 0, (struct sockaddr*)&from, &fromLen);
+        if (received <= 0) {
+            continue;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_peerMutex);
+            m_peer = from;
+            m_hasPeer = true;
+        }
+
+        if (buffer[0] == FRAME_AUTH_REQUEST) {
+            // A reflector without bundling support sends no capability byte
+            const uint8_t response[3] = {FRAME_AUTH_RESPONSE, 0x01, REFLECTOR_CAP_LDU_BUNDLE};
+            size_t length = m_bundling ? sizeof(response) : 2;
+            sendto(m_socket, response, length, 0, (struct sockaddr*)&from, fromLen);
+            continue;
+        }
+
+        m_rxPackets++;
+        m_rxBytes += received;
+
+        P25FrameView frame(buffer, static_cast<size_t>(received));
+        if (frame.frameType() == FRAME_LDU_BUNDLE) {
+            size_t records = 0;
+            if (LduBundler::unbundle(frame, [&records](const P25FrameView&) { records++; })) {
+                m_rxBundles++;
+                m_rxRecords += records;
+            }
+        } else {
+            m_rxRecords++;
+        }
+    }
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <netinet/in.h>
+
+// Minimal local stand-in for the P25 reflector. Binds a UDP socket on
+// 127.0.0.1, accepts any auth request and counts everything else it receives.
+// LDU bundles are split back into records, and bundling support can be
+// withheld from the auth response to exercise the fallback.
+class LoopbackReflector {
+public:
+    LoopbackReflector();
+    ~LoopbackReflector();
+
+    bool start();
+    void stop();
+
+    uint16_t getPort() const { return m_port; }
+
+    // Advertise LDU bundling in auth responses (default on)
+    void setBundling(bool enabled) { m_bundling = enabled; }
+
+    uint64_t getReceivedPackets() const { return m_rxPackets.load(); }
+    uint64_t getReceivedBytes() const { return m_rxBytes.load(); }
+
+    // P25 records after unbundling, and how many datagrams were bundles
+    uint64_t getReceivedRecords() const { return m_rxRecords.load(); }
+    uint64_t getReceivedBundles() const { return m_rxBundles.load(); }
+    void resetCounters();
+
+    // Send a datagram to the last hotspot that talked to us
+    bool sendToPeer(const uint8_t* data, size_t length);
+
+private:
+    void receiveThread();
+
+    int m_socket;
+    uint16_t m_port;
+    std::atomic<bool> m_running;
+    std::thread m_thread;
+
+    std::mutex m_peerMutex;
+    struct sockaddr_in m_peer;
+    bool m_hasPeer;
+
+    std::atomic<bool> m_bundling;
+
+    std::atomic<uint64_t> m_rxPackets;
+    std::atomic<uint64_t> m_rxBytes;
+    std::atomic<uint64_t> m_rxRecords;
+    std::atomic<uint64_t> m_rxBundles;
+};
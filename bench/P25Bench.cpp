@@ -0,0 +1,517 @@
+// p25-bench - microbenchmarks for the frame parser, protocol helpers, timer
+// wheel, logger and network send path.
+//
+// Usage: p25-bench [--filter <substring>] [--min-time-ms <n>] [--format json|csv]
+//
+// Results go to stdout (JSON by default) stamped with the git revision, so
+// runs from different commits can be diffed directly.
+
+#include "LoopbackReflector.h"
+#include "Config.h"
+#include "HandlerSlot.h"
+#include "IngressGuard.h"
+#include "Logger.h"
+#include "ModemFramer.h"
+#include "ModemSerial.h"
+#include "NetworkClient.h"
+#include "P25Protocol.h"
+#include "TimerWheel.h"
+#include "TrunkingState.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifndef P25_GIT_REVISION
+#define P25_GIT_REVISION "unknown"
+#endif
+
+namespace {
+
+template <typename T>
+inline void doNotOptimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+struct BenchResult {
+    std::string name;
+    uint64_t iterations;
+    double nsPerOp;
+    double opsPerSec;
+    double bytesPerSec;
+    std::vector<std::pair<std::string, double>> extra;
+};
+
+class BenchRunner {
+public:
+    BenchRunner(const std::string& filter, int minTimeMs)
+        : m_filter(filter), m_minTimeNs(static_cast<double>(minTimeMs) * 1e6) {}
+
+    bool enabled(const std::string& name) const {
+        return m_filter.empty() || name.find(m_filter) != std::string::npos;
+    }
+
+    double minTimeNs() const { return m_minTimeNs; }
+
+    // body(n) must perform n operations. Iterations are scaled until a run
+    // lasts at least the minimum time.
+    template <typename Body>
+    void run(const std::string& name, size_t bytesPerOp, Body&& body) {
+        if (!enabled(name)) {
+            return;
+        }
+
+        uint64_t iterations = 1;
+        double elapsedNs = 0;
+
+        while (true) {
+            auto start = std::chrono::steady_clock::now();
+            body(iterations);
+            auto end = std::chrono::steady_clock::now();
+            elapsedNs = std::chrono::duration<double, std::nano>(end - start).count();
+
+            if (elapsedNs >= m_minTimeNs || iterations >= (1ULL << 40)) {
+                break;
+            }
+
+            // Aim straight for the target once the timing is meaningful
+            double scale = elapsedNs > 1e5 ? (m_minTimeNs * 1.2) / elapsedNs : 10.0;
+            if (scale < 2.0) scale = 2.0;
+            iterations = static_cast<uint64_t>(iterations * scale);
+        }
+
+        add(name, iterations, elapsedNs, bytesPerOp, {});
+    }
+
+    void add(const std::string& name, uint64_t iterations, double elapsedNs, size_t bytesPerOp,
+             std::vector<std::pair<std::string, double>> extra) {
+        BenchResult result;
+        result.name = name;
+        result.iterations = iterations;
+        result.nsPerOp = elapsedNs / iterations;
+        result.opsPerSec = iterations / (elapsedNs / 1e9);
+        result.bytesPerSec = result.opsPerSec * bytesPerOp;
+        result.extra = std::move(extra);
+        m_results.push_back(result);
+
+        fprintf(stderr, "%-36s %14.1f ns/op %14.0f ops/s\n", name.c_str(), result.nsPerOp, result.opsPerSec);
+    }
+
+    void printJson() const {
+        printf("{\n");
+        printf("  \"revision\": \"%s\",\n", P25_GIT_REVISION);
+        printf("  \"compiler\": \"%s\",\n", __VERSION__);
+        printf("  \"timestamp\": %lld,\n", static_cast<long long>(
+            std::chrono::duration_cast<std::chrono::seconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count()));
+        printf("  \"results\": [\n");
+        for (size_t i = 0; i < m_results.size(); i++) {
+            const BenchResult& r = m_results[i];
+            printf("    {\"name\": \"%s\", \"iterations\": %llu, \"ns_per_op\": %.3f, \"ops_per_sec\": %.1f, \"bytes_per_sec\": %.1f",
+                   r.name.c_str(), static_cast<unsigned long long>(r.iterations), r.nsPerOp, r.opsPerSec, r.bytesPerSec);
+            for (const auto& kv : r.extra) {
+                printf(", \"%s\": %.3f", kv.first.c_str(), kv.second);
+            }
+            printf("}%s\n", i + 1 < m_results.size() ? "," : "");
+        }
+        printf("  ]\n}\n");
+    }
+
+    void printCsv() const {
+        printf("revision,name,iterations,ns_per_op,ops_per_sec,bytes_per_sec\n");
+        for (const BenchResult& r : m_results) {
+            printf("%s,%s,%llu,%.3f,%.1f,%.1f\n", P25_GIT_REVISION, r.name.c_str(),
+                   static_cast<unsigned long long>(r.iterations), r.nsPerOp, r.opsPerSec, r.bytesPerSec);
+        }
+    }
+
+private:
+    std::string m_filter;
+    double m_minTimeNs;
+    std::vector<BenchResult> m_results;
+};
+
+// One LDU1 sub-frame record with a talkgroup and source filled in
+std::vector<uint8_t> makeLdu1Record(uint8_t frameType, size_t length) {
+    std::vector<uint8_t> record(length, 0x55);
+    record[0] = frameType;
+    record[LC_LCF_OFFSET] = 0x00;
+    record[LC_MFID_OFFSET] = 0x00;
+    record[LC_SVC_OPTIONS_OFFSET] = 0x00;
+    record[LC_TG_OFFSET] = 0x27;
+    record[LC_TG_OFFSET + 1] = 0x10;
+    record[LC_SRC_OFFSET] = 0x01;
+    record[LC_SRC_OFFSET + 1] = 0xE2;
+    record[LC_SRC_OFFSET + 2] = 0x40;
+    return record;
+}
+
+// A full superframe (LDU1 + LDU2) as the modem would put it on the wire
+std::vector<uint8_t> makeModemStream(bool withNoise) {
+    std::vector<uint8_t> stream;
+    for (uint8_t type = FRAME_LDU1_0; type <= FRAME_LDU2_8; type++) {
+        std::vector<uint8_t> record = makeLdu1Record(type, 17);
+        stream.push_back(FRAME_START);
+        stream.push_back(static_cast<uint8_t>(record.size() + 3));
+        stream.push_back(CMD_P25_DATA);
+        stream.insert(stream.end(), record.begin(), record.end());
+        if (withNoise) {
+            stream.push_back(0x00);
+            stream.push_back(0xFF);
+        }
+    }
+    return stream;
+}
+
+void benchFramer(BenchRunner& runner) {
+    for (bool noisy : {false, true}) {
+        std::vector<uint8_t> stream = makeModemStream(noisy);
+        ModemFramer framer;
+        uint64_t frames = 0;
+
+        // Serial reads arrive in small chunks
+        const size_t chunk = 32;
+        runner.run(noisy ? "framer.superframe_noisy" : "framer.superframe", stream.size(), [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) {
+                for (size_t off = 0; off < stream.size(); off += chunk) {
+                    size_t len = std::min(chunk, stream.size() - off);
+                    framer.feed(stream.data() + off, len, [&](uint8_t command, const P25FrameView& frame) {
+                        frames += command + frame.size();
+                    });
+                }
+            }
+            doNotOptimize(frames);
+        });
+    }
+}
+
+void benchProtocol(BenchRunner& runner) {
+    std::vector<uint8_t> ldu1 = makeLdu1Record(FRAME_LDU1_3, 17);
+
+    runner.run("protocol.classify_frame", 1, [&](uint64_t n) {
+        uint32_t acc = 0;
+        for (uint64_t i = 0; i < n; i++) {
+            acc += static_cast<uint32_t>(classifyFrame(static_cast<uint8_t>(i)));
+        }
+        doNotOptimize(acc);
+    });
+
+    runner.run("protocol.view_link_control", ldu1.size(), [&](uint64_t n) {
+        uint32_t acc = 0;
+        for (uint64_t i = 0; i < n; i++) {
+            P25FrameView frame(ldu1.data(), ldu1.size());
+            doNotOptimize(frame);
+            acc += frame.talkgroupId() ^ frame.sourceId() ^ frame.serviceOptions();
+        }
+        doNotOptimize(acc);
+    });
+
+    // Accepting path (unlimited buckets) and the fast reject of junk
+    ReflectorConfig unlimited;
+    unlimited.ingress_voice_rate = 0;
+    unlimited.ingress_tsbk_rate = 0;
+    unlimited.ingress_control_rate = 0;
+    IngressGuard guard(unlimited);
+    runner.run("protocol.ingress_admit", ldu1.size(), [&](uint64_t n) {
+        uint32_t accepted = 0;
+        for (uint64_t i = 0; i < n; i++) {
+            P25FrameView frame(ldu1.data(), ldu1.size());
+            doNotOptimize(frame);
+            accepted += guard.admit(frame, i >> 10) == IngressGuard::Verdict::Accept;
+        }
+        doNotOptimize(accepted);
+    });
+
+    const uint8_t junk[64] = {0x42};
+    runner.run("protocol.ingress_reject", sizeof(junk), [&](uint64_t n) {
+        uint32_t rejected = 0;
+        for (uint64_t i = 0; i < n; i++) {
+            P25FrameView frame(junk, sizeof(junk));
+            doNotOptimize(frame);
+            rejected += guard.admit(frame, i >> 10) != IngressGuard::Verdict::Accept;
+        }
+        doNotOptimize(rejected);
+    });
+
+    runner.run("protocol.extract_ids_compat", ldu1.size(), [&](uint64_t n) {
+        uint32_t acc = 0;
+        for (uint64_t i = 0; i < n; i++) {
+            acc += P25Protocol::extractTalkgroupId(ldu1) ^ P25Protocol::extractSourceId(ldu1);
+        }
+        doNotOptimize(acc);
+    });
+
+    const std::string password = "bench_password";
+    runner.run("protocol.write_auth_request", 6 + password.size(), [&](uint64_t n) {
+        uint8_t buffer[P25_MAX_FRAME_LENGTH];
+        size_t total = 0;
+        for (uint64_t i = 0; i < n; i++) {
+            total += P25Protocol::writeAuthRequest(buffer, sizeof(buffer), static_cast<uint32_t>(i), password);
+            doNotOptimize(buffer);
+        }
+        doNotOptimize(total);
+    });
+
+    runner.run("protocol.build_auth_request_compat", 6 + password.size(), [&](uint64_t n) {
+        size_t total = 0;
+        for (uint64_t i = 0; i < n; i++) {
+            std::vector<uint8_t> packet = P25Protocol::buildAuthRequest(static_cast<uint32_t>(i), password);
+            total += packet.size();
+        }
+        doNotOptimize(total);
+    });
+
+    const uint8_t authResponse[2] = {FRAME_AUTH_RESPONSE, 0x01};
+    runner.run("protocol.parse_auth_response", sizeof(authResponse), [&](uint64_t n) {
+        uint32_t acc = 0;
+        for (uint64_t i = 0; i < n; i++) {
+            bool authenticated = false;
+            acc += P25Protocol::parseAuthResponse(P25FrameView(authResponse, sizeof(authResponse)), authenticated);
+            acc += authenticated;
+        }
+        doNotOptimize(acc);
+    });
+}
+
+struct FrameCounter {
+    uint64_t bytes = 0;
+    void onFrame(const P25FrameView& frame) { bytes += frame.size() + frame.frameType(); }
+};
+
+// Per-frame cost of the ways an I/O loop can reach its handler
+template <typename Dispatch>
+void runDispatch(BenchRunner& runner, const std::string& name, const P25FrameView& frame, Dispatch& dispatch) {
+    runner.run(name, frame.size(), [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) {
+            dispatch(frame);
+            doNotOptimize(frame);
+        }
+    });
+}
+
+void benchHandlers(BenchRunner& runner) {
+    std::vector<uint8_t> ldu1 = makeLdu1Record(FRAME_LDU1_3, 17);
+    P25FrameView frame(ldu1);
+    FrameCounter counter;
+
+    std::function<void(const P25FrameView&)> function = [&counter](const P25FrameView& f) { counter.onFrame(f); };
+    runDispatch(runner, "handler.std_function_compat", frame, function);
+
+    HandlerSlot<const P25FrameView&> slot;
+    slot.bind<FrameCounter, &FrameCounter::onFrame>(&counter);
+    runDispatch(runner, "handler.atomic_slot", frame, slot);
+
+    StaticFrameHandler<FrameCounter, &FrameCounter::onFrame> fixed{&counter};
+    runDispatch(runner, "handler.static_pipeline", frame, fixed);
+
+    if (counter.bytes == 0) {
+        fprintf(stderr, "handlers: nothing dispatched\n");
+    }
+}
+
+void benchTrunking(BenchRunner& runner) {
+    // Heap-allocated once - the tables are large but never grow
+    std::unique_ptr<UnitRegistry> units(new UnitRegistry());
+    std::unique_ptr<GrantTable> grants(new GrantTable());
+
+    runner.run("trunking.unit_affiliate", 0, [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) {
+            uint32_t unit = 1000000 + static_cast<uint32_t>(i % 3000);
+            units->affiliate(unit, 100 + (unit % 50), i);
+        }
+    });
+
+    runner.run("trunking.unit_lookup", 0, [&](uint64_t n) {
+        uint32_t acc = 0;
+        for (uint64_t i = 0; i < n; i++) {
+            const UnitEntry* unit = units->find(1000000 + static_cast<uint32_t>(i % 4000));
+            acc += unit ? unit->talkgroup : 0;
+        }
+        doNotOptimize(acc);
+    });
+
+    runner.run("trunking.grant_cycle", 0, [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) {
+            uint32_t tg = 1 + static_cast<uint32_t>(i % 200);
+            grants->grant(tg, 1234567, 1, CallDirection::RF, i);
+            grants->activate(tg, 1234567, CallDirection::RF, i);
+            grants->hang(tg, i);
+            grants->release(tg);
+        }
+    });
+}
+
+void benchTimers(BenchRunner& runner) {
+    TimerWheel& wheel = TimerWheel::getInstance();
+    std::unique_ptr<TimerWheel::Timer[]> timers(new TimerWheel::Timer[4096]);
+
+    // Far enough out that nothing fires during the run
+    runner.run("timer.schedule_cancel", 0, [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) {
+            TimerWheel::Timer& timer = timers[i & 4095];
+            wheel.schedule(timer, 60000 + static_cast<uint32_t>(i % 5000), []() {});
+            wheel.cancel(timer);
+        }
+    });
+
+    // Re-arming a pending timer, as the ACK/expiry paths do
+    runner.run("timer.reschedule_4096_pending", 0, [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) {
+            wheel.schedule(timers[i & 4095], 60000 + static_cast<uint32_t>(i % 5000), []() {});
+        }
+    });
+
+    for (size_t i = 0; i < 4096; i++) {
+        wheel.cancel(timers[i]);
+    }
+}
+
+void benchLogger(BenchRunner& runner) {
+    const std::string message = "Voice call started - TG: 10000 SRC: 123456";
+
+    runner.run("logger.filtered_debug", 0, [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) {
+            LOG_DEBUG(message);
+        }
+    });
+
+    for (int threads : {1, 2, 4}) {
+        std::string name = "logger.log_" + std::to_string(threads) + "_threads";
+        if (!runner.enabled(name)) {
+            continue;
+        }
+
+        // Fixed per-thread count so the thread counts compare directly
+        const uint64_t perThread = 20000;
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> workers;
+        for (int t = 0; t < threads; t++) {
+            workers.emplace_back([&]() {
+                for (uint64_t i = 0; i < perThread; i++) {
+                    LOG_INFO(message);
+                }
+            });
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        auto end = std::chrono::steady_clock::now();
+
+        double elapsedNs = std::chrono::duration<double, std::nano>(end - start).count();
+        runner.add(name, perThread * threads, elapsedNs, message.size(), {{"threads", threads}});
+    }
+}
+
+void benchNetworkSend(BenchRunner& runner, bool bundling) {
+    const std::string name = bundling ? "network.send_ldu_bundled_loopback" : "network.send_ldu_loopback";
+    if (!runner.enabled(name)) {
+        return;
+    }
+
+    LoopbackReflector reflector;
+    if (!reflector.start()) {
+        fprintf(stderr, "network: failed to start loopback reflector\n");
+        return;
+    }
+
+    ReflectorConfig config;
+    config.address = "127.0.0.1";
+    config.port = reflector.getPort();
+    config.radio_id = 1234567;
+    config.password = "bench";
+    config.callsign = "N0CALL";
+    config.keepalive_interval = 5;
+    config.bundle_ldu = bundling;
+    config.ingress_voice_rate = 0;
+    config.ingress_tsbk_rate = 0;
+    config.ingress_control_rate = 0;
+
+    NetworkClient client(config);
+    if (!client.start()) {
+        fprintf(stderr, "network: failed to authenticate with loopback reflector\n");
+        return;
+    }
+
+    // One superframe's worth of records, sent in LDU order
+    std::vector<std::vector<uint8_t>> superframe;
+    for (uint8_t type = FRAME_LDU1_0; type <= FRAME_LDU2_8; type++) {
+        superframe.push_back(makeLdu1Record(type, 17));
+    }
+    reflector.resetCounters();
+
+    // Fixed count rather than calibrated - the kernel queue, not the loop, is the limit
+    const uint64_t records = 198000;
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < records; i++) {
+        client.sendData(P25FrameView(superframe[i % superframe.size()]));
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    // Let the reflector drain what is still queued
+    for (int i = 0; i < 50 && reflector.getReceivedRecords() < records; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    double elapsedNs = std::chrono::duration<double, std::nano>(end - start).count();
+    double delivered = static_cast<double>(reflector.getReceivedRecords()) / records;
+    double packetsPerRecord = reflector.getReceivedRecords() > 0
+        ? static_cast<double>(reflector.getReceivedPackets()) / reflector.getReceivedRecords() : 0.0;
+    runner.add(name, records, elapsedNs, superframe[0].size(),
+               {{"delivered_ratio", delivered}, {"packets_per_record", packetsPerRecord}});
+
+    client.stop();
+    reflector.stop();
+}
+
+void benchNetwork(BenchRunner& runner) {
+    benchNetworkSend(runner, false);
+    benchNetworkSend(runner, true);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    std::string filter;
+    std::string format = "json";
+    int minTimeMs = 200;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--filter" && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (arg == "--min-time-ms" && i + 1 < argc) {
+            minTimeMs = std::stoi(argv[++i]);
+        } else if (arg == "--format" && i + 1 < argc) {
+            format = argv[++i];
+        } else {
+            fprintf(stderr, "Usage: %s [--filter <substring>] [--min-time-ms <n>] [--format json|csv]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    // Log to /dev/null so the logger benchmarks measure formatting and locking, not the terminal
+    Logger::getInstance().init("/dev/null", LogLevel::INFO, false);
+
+    BenchRunner runner(filter, minTimeMs);
+    benchFramer(runner);
+    benchProtocol(runner);
+    benchTrunking(runner);
+    benchHandlers(runner);
+    benchTimers(runner);
+    benchLogger(runner);
+    benchNetwork(runner);
+
+    if (format == "csv") {
+        runner.printCsv();
+    } else {
+        runner.printJson();
+    }
+
+    return 0;
+}
@@ -0,0 +1,489 @@
+// p25-replay - feed a frame capture back into the relay pipeline
+//
+// Usage: p25-replay --config <yaml> --capture <file> [--speed <n>|max] [--drain-ms <n>]
+//                   [--soak-hours <n>] [--log <file>]
+//
+// The pipeline is the daemon's own: modems, trunking controller and
+// network client built from the config. Each modem runs on an in-process
+// link that answers the command engine like a modem and delivers the
+// captured modem bytes, and the reflector is a LoopbackReflector that
+// delivers the captured reflector datagrams. Frames go in on the captured
+// schedule (--speed 1, the default), N times faster, or back to back
+// (--speed max); the capture's own modem and reflector output is only
+// counted, to compare with what the pipeline sends now.
+//
+// At any speed but 1 and max the pipeline runs on a SimulatedClock going
+// that many times faster, so hang time, grant expiry and keepalives keep
+// pace with the traffic. --soak-hours then runs that much more protocol
+// time with no traffic as fast as the timers can fire - a day of
+// keepalives and status polls takes seconds - and checks that the modems
+// and the reflector link are still up.
+//
+// Results go to stdout as JSON stamped with the git revision, like
+// p25-bench. Config limits still apply - zero the ingress rates to
+// measure raw throughput at max speed.
+//
+// Built with P25_ALLOC_TRACE, the heap allocations made on each site
+// during the replay are reported too, and any on the modem, network or
+// timer threads fail the run (exit status 3).
+
+#include "LoopbackReflector.h"
+#include "AllocTrace.h"
+#include "CallJournal.h"
+#include "Clock.h"
+#include "Config.h"
+#include "FrameCapture.h"
+#include "FrameTrace.h"
+#include "LatencyHistogram.h"
+#include "Logger.h"
+#include "ModemSerial.h"
+#include "ModemTransport.h"
+#include "NetworkClient.h"
+#include "P25Protocol.h"
+#include "TimerWheel.h"
+#include "TrunkingController.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <time.h>
+
+#ifndef P25_GIT_REVISION
+#define P25_GIT_REVISION "unknown"
+#endif
+
+namespace {
+
+// Modem bytes not yet read by the modem thread before the injector waits,
+// as a serial line would hold it back
+const size_t MAX_PENDING_BYTES = 65536;
+
+// Status reply payload: P25 TX buffer space at offset 7 (protocol 1)
+const size_t STATUS_LENGTH = 8;
+const uint8_t STATUS_P25_SPACE = 32;
+
+uint64_t nowNs() {
+    return FrameTrace::nowNs();
+}
+
+// In-process modem link. Commands are answered as firmware would; the
+// captured bytes from the modem are queued for the read thread.
+class ReplayLink : public ModemTransport {
+public:
+    ReplayLink() : ModemTransport(8192), m_p25Frames(0) {
+        // Room for a full backlog plus the chunk and replies on top, so
+        // queueing never allocates on the threads under measurement
+        m_pending.reserve(2 * MAX_PENDING_BYTES);
+    }
+
+    bool open() override { return true; }
+    void close() override {}
+
+    ssize_t read(uint8_t* buffer, size_t size) override {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (!m_readable.wait_for(lock, std::chrono::milliseconds(100), [this]() { return !m_pending.empty(); })) {
+            return 0;
+        }
+
+        size_t count = m_pending.size() < size ? m_pending.size() : size;
+        std::copy(m_pending.begin(), m_pending.begin() + count, buffer);
+        m_pending.erase(m_pending.begin(), m_pending.begin() + count);
+        m_writable.notify_all();
+        return static_cast<ssize_t>(count);
+    }
+
+    std::string describe() const override { return "replay"; }
+
+    // Bytes as the modem sent them
+    void inject(const uint8_t* data, size_t length) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_writable.wait(lock, [this]() { return m_pending.size() < MAX_PENDING_BYTES; });
+        m_pending.insert(m_pending.end(), data, data + length);
+        m_readable.notify_one();
+    }
+
+    // P25 data the pipeline put on the air
+    uint64_t getP25Frames() const { return m_p25Frames; }
+
+protected:
+    bool writeBatch(const uint8_t* data, size_t length) override {
+        while (length >= 3 && data[0] == FRAME_START && data[1] >= 3 && data[1] <= length) {
+            answer(data[2]);
+            length -= data[1];
+            data += data[1];
+        }
+        return true;
+    }
+
+private:
+    void answer(uint8_t command) {
+        uint8_t reply[3 + 16] = {FRAME_START, 0, command};
+        size_t length = 3;
+
+        switch (command) {
+            case CMD_P25_DATA:
+                m_p25Frames++;
+                return;
+            case CMD_GET_VERSION: {
+                static const char description[] = "p25-replay";
+                reply[length++] = 1;
+                memcpy(reply + length, description, sizeof(description) - 1);
+                length += sizeof(description) - 1;
+                break;
+            }
+            case CMD_GET_STATUS:
+                memset(reply + length, 0, STATUS_LENGTH);
+                reply[length + STATUS_LENGTH - 1] = STATUS_P25_SPACE;
+                length += STATUS_LENGTH;
+                break;
+            default:
+                reply[2] = CMD_ACK;
+                reply[length++] = command;
+                break;
+        }
+
+        reply[1] = static_cast<uint8_t>(length);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pending.insert(m_pending.end(), reply, reply + length);
+        m_readable.notify_one();
+    }
+
+    std::mutex m_mutex;
+    std::condition_variable m_readable;
+    std::condition_variable m_writable;
+    std::vector<uint8_t> m_pending;
+    uint64_t m_p25Frames;  // writer threads are serialized by ModemTransport
+};
+
+bool parseSpeed(const std::string& value, double& speed) {
+    if (value == "max") {
+        speed = 0;
+        return true;
+    }
+
+    char* end = nullptr;
+    speed = strtod(value.c_str(), &end);
+    if (*end == 'x') {
+        end++;
+    }
+    return end != value.c_str() && *end == '\0' && speed > 0;
+}
+
+void sleepUntil(uint64_t ns) {
+    struct timespec ts;
+    ts.tv_sec = static_cast<time_t>(ns / 1000000000);
+    ts.tv_nsec = static_cast<long>(ns % 1000000000);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) {
+    }
+}
+
+struct ReplayCounts {
+    uint64_t modemChunks = 0;
+    uint64_t modemBytes = 0;
+    uint64_t networkDatagrams = 0;
+    uint64_t skipped = 0;            // unknown modem, or a handshake datagram
+    uint64_t capturedModemP25 = 0;   // what the capture's own pipeline sent
+    uint64_t capturedNetwork = 0;
+};
+
+// Modem frames of one command within a captured write (always whole frames)
+uint64_t countCommands(const uint8_t* data, size_t length, uint8_t command) {
+    uint64_t count = 0;
+    while (length >= 3 && data[0] == FRAME_START && data[1] >= 3 && data[1] <= length) {
+        count += data[2] == command;
+        length -= data[1];
+        data += data[1];
+    }
+    return count;
+}
+
+void printLatency(const char* name, const LatencyHistogram::Summary& summary, bool last) {
+    printf("    \"%s\": {\"count\": %llu, \"p50_us\": %.1f, \"p99_us\": %.1f, \"p999_us\": %.1f, \"max_us\": %.1f}%s\n",
+           name, static_cast<unsigned long long>(summary.count), summary.p50Ns / 1e3, summary.p99Ns / 1e3,
+           summary.p999Ns / 1e3, summary.maxNs / 1e3, last ? "" : ",");
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    std::string configFile;
+    std::string captureFile;
+    std::string logFile = "/dev/null";
+    double speed = 1.0;
+    int drainMs = 1000;
+    double soakHours = 0;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--config" && i + 1 < argc) {
+            configFile = argv[++i];
+        } else if (arg == "--capture" && i + 1 < argc) {
+            captureFile = argv[++i];
+        } else if (arg == "--speed" && i + 1 < argc) {
+            if (!parseSpeed(argv[++i], speed)) {
+                fprintf(stderr, "Invalid --speed value: %s\n", argv[i]);
+                return 1;
+            }
+        } else if (arg == "--drain-ms" && i + 1 < argc) {
+            drainMs = atoi(argv[++i]);
+        } else if (arg == "--soak-hours" && i + 1 < argc) {
+            soakHours = atof(argv[++i]);
+        } else if (arg == "--log" && i + 1 < argc) {
+            logFile = argv[++i];
+        } else {
+            configFile.clear();
+            break;
+        }
+    }
+
+    if (configFile.empty() || captureFile.empty()) {
+        fprintf(stderr, "Usage: %s --config <yaml> --capture <file> [--speed <n>|max] [--drain-ms <n>] [--soak-hours <n>] [--log <file>]\n",
+                argv[0]);
+        return 1;
+    }
+
+    Logger::getInstance().init(logFile, LogLevel::INFO, false);
+
+    Config config;
+    if (!config.load(configFile)) {
+        fprintf(stderr, "Cannot load config %s\n", configFile.c_str());
+        return 1;
+    }
+    if (config.getModems().empty()) {
+        fprintf(stderr, "Config %s has no enabled modem\n", configFile.c_str());
+        return 1;
+    }
+
+    FrameCapture capture;
+    if (!capture.openReadOnly(captureFile)) {
+        fprintf(stderr, "Cannot open frame capture %s\n", captureFile.c_str());
+        return 1;
+    }
+
+    LoopbackReflector reflector;
+    if (!reflector.start()) {
+        fprintf(stderr, "Cannot start loopback reflector\n");
+        return 1;
+    }
+
+    FrameTrace::getInstance().setEnabled(true);
+
+    // Protocol time - before anything starts the timer wheel. Real time
+    // pace until the replay starts, so start-up timeouts mean what they say.
+    SimulatedClock clock;
+    bool simulated = (speed > 0 && speed != 1.0) || soakHours > 0;
+    if (simulated) {
+        Clock::install(&clock);
+        clock.run(1.0);
+    }
+
+    // The daemon's pipeline, with the reflector and modem links swapped out
+    ReflectorConfig reflectorConfig = config.getReflector();
+    reflectorConfig.address = "127.0.0.1";
+    reflectorConfig.port = reflector.getPort();
+
+    auto network = std::make_shared<NetworkClient>(reflectorConfig);
+    std::vector<std::shared_ptr<ModemSerial>> modems;
+    std::vector<ReplayLink*> links;
+    for (const ModemConfig& modemConfig : config.getModems()) {
+        ReplayLink* link = new ReplayLink();
+        links.push_back(link);
+        modems.push_back(std::make_shared<ModemSerial>(modemConfig, config.getP25().nac,
+                                                       std::unique_ptr<ModemTransport>(link), modems.size()));
+    }
+
+    CallJournal journal;
+    auto controller = std::make_shared<TrunkingController>(config.getP25(), modems, network, journal);
+
+    bool started = true;
+    for (size_t i = 0; i < modems.size() && started; i++) {
+        started = modems[i]->open(controller->getModemSink(i));
+    }
+    started = started && network->start(controller->getNetworkSink());
+    if (!started) {
+        fprintf(stderr, "Pipeline failed to start - see the log\n");
+        for (auto& modem : modems) modem->close();
+        TimerWheel::getInstance().shutdown();
+        clock.stop();
+        Clock::install(nullptr);
+        return 1;
+    }
+    controller->start();
+
+    // Sent so far was the handshake
+    reflector.resetCounters();
+
+    ReplayCounts counts;
+    LatencyHistogram slip;   // how late each frame went in against the schedule
+
+    uint64_t offset = 0;
+    CaptureRecord record;
+    const uint8_t* payload = nullptr;
+    uint64_t firstNs = 0;
+    uint64_t lastNs = 0;
+    if (simulated) {
+        clock.run(speed > 0 ? speed : 1.0);
+    }
+
+    // Steady state from here on - the pipeline threads should not allocate
+    AllocTrace::Counts allocStart[ALLOC_SITE_COUNT];
+    for (size_t i = 0; i < ALLOC_SITE_COUNT; i++) {
+        allocStart[i] = AllocTrace::get(static_cast<AllocSite>(i));
+    }
+    uint64_t startNs = nowNs();
+
+    while (capture.next(offset, record, payload)) {
+        CaptureStream stream = static_cast<CaptureStream>(record.stream);
+
+        if (stream == CaptureStream::ModemTx) {
+            counts.capturedModemP25 += countCommands(payload, record.length, CMD_P25_DATA);
+            continue;
+        }
+        if (stream == CaptureStream::NetworkTx) {
+            counts.capturedNetwork += record.length > 0 && payload[0] != FRAME_AUTH_REQUEST;
+            continue;
+        }
+
+        // Already authenticated - the captured handshake would only confuse the client
+        bool modem = stream == CaptureStream::ModemRx;
+        if ((modem && record.port >= links.size()) ||
+            (!modem && (record.length == 0 || payload[0] == FRAME_AUTH_RESPONSE))) {
+            counts.skipped++;
+            continue;
+        }
+
+        if (firstNs == 0) {
+            firstNs = record.timestampNs;
+        }
+        lastNs = record.timestampNs > lastNs ? record.timestampNs : lastNs;
+
+        if (speed > 0 && record.timestampNs > firstNs) {
+            uint64_t dueNs = startNs + static_cast<uint64_t>(static_cast<double>(record.timestampNs - firstNs) / speed);
+            uint64_t now = nowNs();
+            if (now < dueNs) {
+                sleepUntil(dueNs);
+                now = nowNs();
+            }
+            slip.record(now - dueNs);
+        }
+
+        if (modem) {
+            links[record.port]->inject(payload, record.length);
+            counts.modemChunks++;
+            counts.modemBytes += record.length;
+        } else {
+            reflector.sendToPeer(payload, record.length);
+            counts.networkDatagrams++;
+        }
+    }
+
+    uint64_t replayNs = nowNs() - startNs;
+
+    // Let hang timers, concealment and bundles run out
+    if (simulated) {
+        clock.stop();
+        clock.advance(static_cast<uint64_t>(drainMs) * 1000000);
+    } else {
+        std::this_thread::sleep_for(std::chrono::milliseconds(drainMs));
+    }
+
+    // Idle protocol time, a minute per step, stopping at the first failure
+    uint64_t soakPolls = reflector.getReceivedPackets();
+    uint64_t soakMinutes = 0;
+    bool soakOk = true;
+    uint64_t soakStartNs = nowNs();
+    for (uint64_t minutes = static_cast<uint64_t>(soakHours * 60); soakMinutes < minutes && soakOk; soakMinutes++) {
+        clock.advance(60ULL * 1000000000);
+        soakOk = network->isConnected() && network->isAuthenticated();
+        for (auto& modem : modems) {
+            soakOk = soakOk && modem->isOpen();
+        }
+    }
+    uint64_t soakNs = nowNs() - soakStartNs;
+    soakPolls = reflector.getReceivedPackets() - soakPolls;
+
+    uint64_t allocations[ALLOC_SITE_COUNT];
+    for (size_t i = 0; i < ALLOC_SITE_COUNT; i++) {
+        allocations[i] = AllocTrace::get(static_cast<AllocSite>(i)).allocations - allocStart[i].allocations;
+    }
+    bool allocFree = allocations[static_cast<size_t>(AllocSite::Modem)] == 0 &&
+                     allocations[static_cast<size_t>(AllocSite::Network)] == 0 &&
+                     allocations[static_cast<size_t>(AllocSite::Timer)] == 0;
+
+    // Shutdown waits on command timeouts again
+    if (simulated) {
+        clock.run(1.0);
+    }
+
+    controller->stop();
+    network->stop();
+    for (auto& modem : modems) modem->close();
+
+    uint64_t modemP25 = 0;
+    for (ReplayLink* link : links) {
+        modemP25 += link->getP25Frames();
+    }
+    IngressGuard::Stats ingress = network->getIngressStats();
+    uint64_t rejected = ingress.malformed + ingress.unknown;
+    for (uint64_t limited : ingress.rateLimited) {
+        rejected += limited;
+    }
+
+    double seconds = replayNs / 1e9;
+    uint64_t frames = counts.modemChunks + counts.networkDatagrams;
+
+    printf("{\n");
+    printf("  \"revision\": \"%s\",\n", P25_GIT_REVISION);
+    printf("  \"capture\": \"%s\",\n", captureFile.c_str());
+    printf("  \"speed\": %.3f,\n", speed);
+    printf("  \"capture_span_s\": %.3f,\n", lastNs > firstNs ? (lastNs - firstNs) / 1e9 : 0.0);
+    printf("  \"replay_s\": %.3f,\n", seconds);
+    printf("  \"modem_chunks\": %llu,\n", static_cast<unsigned long long>(counts.modemChunks));
+    printf("  \"modem_bytes\": %llu,\n", static_cast<unsigned long long>(counts.modemBytes));
+    printf("  \"network_datagrams\": %llu,\n", static_cast<unsigned long long>(counts.networkDatagrams));
+    printf("  \"skipped\": %llu,\n", static_cast<unsigned long long>(counts.skipped));
+    printf("  \"frames_per_sec\": %.1f,\n", seconds > 0 ? frames / seconds : 0.0);
+    printf("  \"schedule_slip\": {\"p50_us\": %.1f, \"p99_us\": %.1f, \"max_us\": %.1f},\n",
+           slip.getPercentile(0.50) / 1e3, slip.getPercentile(0.99) / 1e3, slip.getSummary().maxNs / 1e3);
+    printf("  \"modem_p25_sent\": %llu,\n", static_cast<unsigned long long>(modemP25));
+    printf("  \"modem_p25_captured\": %llu,\n", static_cast<unsigned long long>(counts.capturedModemP25));
+    printf("  \"network_sent\": %llu,\n", static_cast<unsigned long long>(reflector.getReceivedPackets()));
+    printf("  \"network_captured\": %llu,\n", static_cast<unsigned long long>(counts.capturedNetwork));
+    printf("  \"ingress_rejected\": %llu,\n", static_cast<unsigned long long>(rejected));
+    if (soakHours > 0) {
+        printf("  \"soak\": {\"protocol_hours\": %.2f, \"real_s\": %.3f, \"reflector_packets\": %llu, \"ok\": %s},\n",
+               soakMinutes / 60.0, soakNs / 1e9, static_cast<unsigned long long>(soakPolls), soakOk ? "true" : "false");
+    }
+    if (AllocTrace::ENABLED) {
+        printf("  \"allocations\": {");
+        for (size_t i = 0; i < ALLOC_SITE_COUNT; i++) {
+            printf("\"%s\": %llu%s", allocSiteName(static_cast<AllocSite>(i)),
+                   static_cast<unsigned long long>(allocations[i]), i + 1 < ALLOC_SITE_COUNT ? ", " : "");
+        }
+        printf("},\n");
+    }
+    printf("  \"latency\": {\n");
+    const char* names[2] = {"rf_to_network", "network_to_rf"};
+    for (size_t direction = 0; direction < 2; direction++) {
+        printLatency(names[direction], FrameTrace::getInstance().getSummary(
+            static_cast<CallDirection>(direction), TraceStage::Total), direction == 1);
+    }
+    printf("  }\n}\n");
+
+    reflector.stop();
+    TimerWheel::getInstance().shutdown();
+    clock.stop();
+    Clock::install(nullptr);
+    if (!soakOk) {
+        return 2;
+    }
+    return allocFree ? 0 : 3;
+}
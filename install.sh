@@ -165,8 +165,9 @@ print_success "Build successful"
 
 # Install binary
 print_info "Installing binary..."
-cp p25-hotspot /usr/local/bin/
-chmod +x /usr/local/bin/p25-hotspot
+cp p25-hotspot p25-cdr /usr/local/bin/
+chmod +x /usr/local/bin/p25-hotspot /usr/local/bin/p25-cdr
+mkdir -p /var/lib/p25-hotspot
 
 # Install systemd service
 print_info "Installing systemd service..."
@@ -0,0 +1,162 @@
+#include "AllocTrace.h"
+#include "Clock.h"
+#include "Logger.h"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+const char* allocSiteName(AllocSite site) {
+    switch (site) {
+        case AllocSite::Other: return "other";
+        case AllocSite::Modem: return "modem";
+        case AllocSite::Network: return "network";
+        case AllocSite::Timer: return "timer";
+        case AllocSite::Logger: return "logger";
+        case AllocSite::Snapshot: return "snapshot";
+    }
+    return "unknown";
+}
+
+#ifdef P25_ALLOC_TRACE
+
+namespace {
+
+struct SiteCounters {
+    std::atomic<uint64_t> allocations;
+    std::atomic<uint64_t> frees;
+    std::atomic<uint64_t> bytes;
+};
+
+// Zero-initialized before any constructor runs, so allocations from static
+// constructors are counted too
+SiteCounters s_counters[ALLOC_SITE_COUNT];
+
+thread_local AllocSite t_site = AllocSite::Other;
+
+void* countedAlloc(size_t size) {
+    SiteCounters& counters = s_counters[static_cast<size_t>(t_site)];
+    counters.allocations.fetch_add(1, std::memory_order_relaxed);
+    counters.bytes.fetch_add(size, std::memory_order_relaxed);
+    return malloc(size ? size : 1);
+}
+
+void* countedAlignedAlloc(size_t size, size_t alignment) {
+    SiteCounters& counters = s_counters[static_cast<size_t>(t_site)];
+    counters.allocations.fetch_add(1, std::memory_order_relaxed);
+    counters.bytes.fetch_add(size, std::memory_order_relaxed);
+
+    void* pointer = nullptr;
+    if (alignment < sizeof(void*)) {
+        alignment = sizeof(void*);
+    }
+    return posix_memalign(&pointer, alignment, size ? size : 1) == 0 ? pointer : nullptr;
+}
+
+void countedFree(void* pointer) {
+    if (!pointer) {
+        return;
+    }
+    s_counters[static_cast<size_t>(t_site)].frees.fetch_add(1, std::memory_order_relaxed);
+    free(pointer);
+}
+
+}  // namespace
+
+void AllocTrace::enterThread(AllocSite site) {
+    t_site = site;
+}
+
+AllocTrace::Counts AllocTrace::get(AllocSite site) {
+    const SiteCounters& counters = s_counters[static_cast<size_t>(site)];
+    return Counts{counters.allocations.load(std::memory_order_relaxed),
+                  counters.frees.load(std::memory_order_relaxed),
+                  counters.bytes.load(std::memory_order_relaxed)};
+}
+
+uint64_t AllocTrace::total() {
+    uint64_t allocations = 0;
+    for (const SiteCounters& counters : s_counters) {
+        allocations += counters.allocations.load(std::memory_order_relaxed);
+    }
+    return allocations;
+}
+
+AllocTrace::Scope::Scope(AllocSite site)
+    : m_previous(t_site)
+{
+    t_site = site;
+}
+
+AllocTrace::Scope::~Scope() {
+    t_site = m_previous;
+}
+
+void AllocTrace::logRates() {
+    static uint64_t lastAllocations[ALLOC_SITE_COUNT];
+    static uint64_t lastMs = 0;
+
+    uint64_t now = Clock::nowMs();
+    uint64_t allocations[ALLOC_SITE_COUNT];
+    for (size_t i = 0; i < ALLOC_SITE_COUNT; i++) {
+        allocations[i] = s_counters[i].allocations.load(std::memory_order_relaxed);
+    }
+
+    if (lastMs != 0 && now > lastMs) {
+        double seconds = static_cast<double>(now - lastMs) / 1000.0;
+        char message[256];
+        size_t length = 0;
+        for (size_t i = 0; i < ALLOC_SITE_COUNT && length < sizeof(message); i++) {
+            length += snprintf(message + length, sizeof(message) - length, " %s %.1f",
+                               allocSiteName(static_cast<AllocSite>(i)),
+                               static_cast<double>(allocations[i] - lastAllocations[i]) / seconds);
+        }
+        LOG_INFOF("Allocations/s:%s", message);
+    }
+
+    for (size_t i = 0; i < ALLOC_SITE_COUNT; i++) {
+        lastAllocations[i] = allocations[i];
+    }
+    lastMs = now;
+}
+
+// Global replacements - the array and nothrow forms of the standard library
+// forward to these
+void* operator new(size_t size) {
+    void* pointer = countedAlloc(size);
+    if (!pointer) {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+    void* pointer = countedAlignedAlloc(size, static_cast<size_t>(alignment));
+    if (!pointer) {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+void operator delete(void* pointer) noexcept {
+    countedFree(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t) noexcept {
+    countedFree(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    countedFree(pointer);
+}
+
+void operator delete(void* pointer, size_t, std::align_val_t) noexcept {
+    countedFree(pointer);
+}
+
+#else
+
+void AllocTrace::logRates() {
+}
+
+#endif
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+// Part of the daemon an allocation is charged to: the thread it happened on,
+// or the logger wherever it is called from
+enum class AllocSite : uint8_t {
+    Other = 0,  // main thread, start-up, tools
+    Modem,      // modem read threads
+    Network,    // reflector receive thread
+    Timer,      // timer wheel callbacks
+    Logger,
+    Snapshot    // state snapshot writer
+};
+
+static const size_t ALLOC_SITE_COUNT = 6;
+
+const char* allocSiteName(AllocSite site);
+
+// Heap allocation counting for the allocation-free steady state
+// (P25_ALLOC_TRACE builds). The build replaces the global operator new and
+// delete with versions that count per site before calling malloc/free.
+// Without it everything here compiles to nothing and the counts stay zero.
+//
+// The RF and network paths allocate nothing once running - buffers are
+// sized at start-up - so any count on the Modem, Network or Timer sites
+// after start-up is a regression. p25-replay and p25-bench report them.
+class AllocTrace {
+public:
+    struct Counts {
+        uint64_t allocations;
+        uint64_t frees;
+        uint64_t bytes;  // allocated
+    };
+
+#ifdef P25_ALLOC_TRACE
+    static constexpr bool ENABLED = true;
+
+    // Site the calling thread's allocations go to from now on
+    static void enterThread(AllocSite site);
+
+    static Counts get(AllocSite site);
+
+    // Allocations on every site
+    static uint64_t total();
+
+    // Charges allocations to site until the scope ends (logger)
+    class Scope {
+    public:
+        explicit Scope(AllocSite site);
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        AllocSite m_previous;
+    };
+#else
+    static constexpr bool ENABLED = false;
+
+    static void enterThread(AllocSite) {}
+    static Counts get(AllocSite) { return Counts{0, 0, 0}; }
+    static uint64_t total() { return 0; }
+
+    class Scope {
+    public:
+        explicit Scope(AllocSite) {}
+    };
+#endif
+
+    // Log allocations per second on each site since the last call
+    // (nothing without P25_ALLOC_TRACE)
+    static void logRates();
+};
@@ -0,0 +1,180 @@
+#include "CallArbiter.h"
+#include "Logger.h"
+
+// Active stream with no frames for this long lost its EOT
+static const uint64_t STREAM_ACTIVITY_TIMEOUT_MS = 1000;
+
+static const char* directionName(CallDirection direction) {
+    return direction == CallDirection::RF ? "RF" : "network";
+}
+
+CallArbiter::CallArbiter(const P25Config& config)
+    : m_config(config)
+    , m_state(ChannelState::Idle)
+    , m_owner()
+    , m_lastFrameMs(0)
+    , m_hangStartMs(0)
+    , m_preemptions(0)
+{
+    m_priorities.fill(0);
+    for (const auto& entry : config.talkgroup_priorities) {
+        if (entry.first < m_priorities.size()) {
+            m_priorities[entry.first] = entry.second;
+        }
+    }
+
+    m_admitting[0] = m_admitting[1] = true;
+    m_dropped[0] = 0;
+    m_dropped[1] = 0;
+}
+
+bool CallArbiter::admit(CallDirection direction, P25FrameClass frameClass, const P25FrameView& frame, uint64_t nowMs) {
+    size_t dir = static_cast<size_t>(direction);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    expire(nowMs);
+
+    if (frameClass == P25FrameClass::VoiceLdu1 && frame.hasLinkControl() && frame.talkgroupId() != 0) {
+        Stream candidate;
+        candidate.direction = direction;
+        candidate.talkgroup = frame.talkgroupId();
+        candidate.source = frame.sourceId();
+        candidate.priority = getPriority(candidate.talkgroup);
+        candidate.emergency = m_config.emergency_preempt && frame.isEmergency();
+
+        m_admitting[dir] = contend(candidate, nowMs);
+    }
+
+    bool admitted = m_admitting[dir];
+
+    if (admitted && m_state == ChannelState::Active && m_owner.direction == direction) {
+        m_lastFrameMs = nowMs;
+
+        if (frameClass == P25FrameClass::Eot) {
+            m_state = ChannelState::Hang;
+            m_hangStartMs = nowMs;
+        }
+    }
+
+    if (!admitted) {
+        m_dropped[dir].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Next call in this direction gets a fresh decision
+    if (frameClass == P25FrameClass::Eot) {
+        m_admitting[dir] = true;
+    }
+
+    return admitted;
+}
+
+CallArbiter::Snapshot CallArbiter::snapshot() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    Snapshot snapshot = {};
+    snapshot.state = static_cast<uint8_t>(m_state);
+    snapshot.direction = static_cast<uint8_t>(m_owner.direction);
+    snapshot.priority = m_owner.priority;
+    snapshot.emergency = m_owner.emergency;
+    snapshot.talkgroup = m_owner.talkgroup;
+    snapshot.source = m_owner.source;
+    snapshot.admitting[0] = m_admitting[0];
+    snapshot.admitting[1] = m_admitting[1];
+    snapshot.lastFrameMs = m_lastFrameMs;
+    snapshot.hangStartMs = m_hangStartMs;
+    return snapshot;
+}
+
+void CallArbiter::restore(const Snapshot& snapshot) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_state = snapshot.state <= static_cast<uint8_t>(ChannelState::Hang) ? static_cast<ChannelState>(snapshot.state)
+                                                                          : ChannelState::Idle;
+    m_owner.direction = snapshot.direction == 0 ? CallDirection::RF : CallDirection::Network;
+    m_owner.priority = snapshot.priority;
+    m_owner.emergency = snapshot.emergency;
+    m_owner.talkgroup = snapshot.talkgroup;
+    m_owner.source = snapshot.source;
+    m_admitting[0] = snapshot.admitting[0];
+    m_admitting[1] = snapshot.admitting[1];
+    m_lastFrameMs = snapshot.lastFrameMs;
+    m_hangStartMs = snapshot.hangStartMs;
+}
+
+bool CallArbiter::tick(uint64_t nowMs, uint64_t* idleAtMs) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    expire(nowMs);
+    if (idleAtMs) {
+        uint64_t hangTimeMs = static_cast<uint64_t>(m_config.hang_time_ms);
+        if (m_state == ChannelState::Active) {
+            *idleAtMs = m_lastFrameMs + STREAM_ACTIVITY_TIMEOUT_MS + hangTimeMs;
+        } else if (m_state == ChannelState::Hang) {
+            *idleAtMs = m_hangStartMs + hangTimeMs;
+        } else {
+            *idleAtMs = nowMs;
+        }
+    }
+    return m_state != ChannelState::Idle;
+}
+
+void CallArbiter::expire(uint64_t nowMs) {
+    if (m_state == ChannelState::Active && nowMs - m_lastFrameMs >= STREAM_ACTIVITY_TIMEOUT_MS) {
+        m_state = ChannelState::Hang;
+        m_hangStartMs = m_lastFrameMs;
+    }
+
+    if (m_state == ChannelState::Hang && nowMs - m_hangStartMs >= static_cast<uint64_t>(m_config.hang_time_ms)) {
+        m_state = ChannelState::Idle;
+    }
+}
+
+bool CallArbiter::contend(const Stream& candidate, uint64_t nowMs) {
+    bool sameStream = candidate.direction == m_owner.direction && candidate.talkgroup == m_owner.talkgroup;
+
+    switch (m_state) {
+        case ChannelState::Idle:
+            break;
+
+        case ChannelState::Active:
+            if (sameStream) {
+                // Same talkgroup from the same side - late entry or a new talker
+                m_owner.source = candidate.source;
+                m_owner.emergency = m_owner.emergency || candidate.emergency;
+                return true;
+            }
+            if (candidate.direction == CallDirection::RF && m_owner.direction == CallDirection::RF) {
+                // The modem only receives one signal - a new RF talkgroup means the last call lost its EOT
+                break;
+            }
+            if (!outranks(candidate, m_owner)) {
+                return false;
+            }
+            m_preemptions.fetch_add(1, std::memory_order_relaxed);
+            LOG_INFOF("Call preempted - TG %u (%s%s) over TG %u (%s)", candidate.talkgroup,
+                      directionName(candidate.direction), candidate.emergency ? ", EMERGENCY" : "",
+                      m_owner.talkgroup, directionName(m_owner.direction));
+
+            // Cut the rest of the losing stream off at ingress
+            m_admitting[static_cast<size_t>(m_owner.direction)] = false;
+            break;
+
+        case ChannelState::Hang:
+            // The hanging talkgroup may resume from either side
+            if (candidate.talkgroup != m_owner.talkgroup && !outranks(candidate, m_owner)) {
+                return false;
+            }
+            break;
+    }
+
+    m_owner = candidate;
+    m_state = ChannelState::Active;
+    m_lastFrameMs = nowMs;
+    return true;
+}
+
+bool CallArbiter::outranks(const Stream& candidate, const Stream& owner) const {
+    if (candidate.emergency != owner.emergency) {
+        return candidate.emergency;
+    }
+    return candidate.priority > owner.priority;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "Config.h"
+#include "P25Protocol.h"
+#include "TrunkingState.h"
+#include <cstdint>
+#include <array>
+#include <atomic>
+#include <mutex>
+
+// Decides which stream owns the channel when RF and network calls overlap.
+// One stream is active at a time; the owner's talkgroup keeps the channel
+// through the hang time, and another stream only takes over by outranking it
+// (higher talkgroup priority, or emergency against non-emergency). Frames of
+// the losing stream are rejected at ingress, before they are written to the
+// modem or sent to the reflector.
+class CallArbiter {
+public:
+    explicit CallArbiter(const P25Config& config);
+
+    // Admission check for every voice/EOT frame. LDU1 link control claims or
+    // contends for the channel; LDU2 and EOT follow the decision last made
+    // for their direction.
+    bool admit(CallDirection direction, P25FrameClass frameClass, const P25FrameView& frame, uint64_t nowMs);
+
+    // Apply activity/hang timeouts when no frames are arriving. Returns true
+    // while the channel is still held (active or in hang time), and through
+    // idleAtMs when it will be released if no more frames arrive.
+    bool tick(uint64_t nowMs, uint64_t* idleAtMs = nullptr);
+
+    uint8_t getPriority(uint32_t talkgroup) const {
+        return talkgroup < m_priorities.size() ? m_priorities[talkgroup] : 0;
+    }
+
+    uint64_t getDropped(CallDirection direction) const {
+        return m_dropped[static_cast<size_t>(direction)].load(std::memory_order_relaxed);
+    }
+    uint64_t getPreemptions() const { return m_preemptions.load(std::memory_order_relaxed); }
+
+    // Who holds the channel and the latched decisions, for a handoff to a
+    // new process. Times are on the protocol clock.
+    struct Snapshot {
+        uint8_t state;
+        uint8_t direction;
+        uint8_t priority;
+        bool emergency;
+        uint32_t talkgroup;
+        uint32_t source;
+        bool admitting[2];
+        uint64_t lastFrameMs;
+        uint64_t hangStartMs;
+    };
+
+    Snapshot snapshot();
+    void restore(const Snapshot& snapshot);
+
+private:
+    enum class ChannelState : uint8_t {
+        Idle = 0,
+        Active,
+        Hang
+    };
+
+    struct Stream {
+        CallDirection direction;
+        uint32_t talkgroup;
+        uint32_t source;
+        uint8_t priority;
+        bool emergency;
+    };
+
+    void expire(uint64_t nowMs);
+    bool contend(const Stream& candidate, uint64_t nowMs);
+    bool outranks(const Stream& candidate, const Stream& owner) const;
+
+    const P25Config& m_config;
+
+    // Per-talkgroup priority, one indexed load per decision
+    std::array<uint8_t, 65536> m_priorities;
+
+    std::mutex m_mutex;
+    ChannelState m_state;
+    Stream m_owner;
+    uint64_t m_lastFrameMs;
+    uint64_t m_hangStartMs;
+
+    // Latched admission decision per direction (indexed by CallDirection)
+    bool m_admitting[2];
+
+    std::atomic<uint64_t> m_dropped[2];
+    std::atomic<uint64_t> m_preemptions;
+};
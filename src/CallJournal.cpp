@@ -0,0 +1,197 @@
+#include "CallJournal.h"
+#include "Logger.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
+static const char JOURNAL_MAGIC[8] = {'P', '2', '5', 'C', 'D', 'R', 0, 1};
+static const uint32_t JOURNAL_VERSION = 2;
+
+// Records start on their own page
+static const size_t HEADER_SIZE = 4096;
+
+struct CallJournal::Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t recordSize;
+    uint64_t capacity;
+    uint64_t writeIndex;  // atomic, next index to reserve
+};
+
+CallJournal::CallJournal()
+    : m_header(nullptr)
+    , m_records(nullptr)
+    , m_capacity(0)
+    , m_mappedLength(0)
+{
+}
+
+CallJournal::~CallJournal() {
+    close();
+}
+
+size_t CallJournal::fileLength(uint64_t capacity) {
+    static_assert(sizeof(Header) <= HEADER_SIZE, "Journal header must fit its page");
+    return HEADER_SIZE + static_cast<size_t>(capacity) * sizeof(CallRecord);
+}
+
+bool CallJournal::open(const std::string& path, uint64_t capacity) {
+    close();
+
+    if (capacity == 0) {
+        capacity = DEFAULT_CAPACITY;
+    }
+
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        LOG_ERROR("Failed to open call journal " + path + ": " + std::string(strerror(errno)));
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        return false;
+    }
+
+    size_t length = fileLength(capacity);
+    bool reinitialize = static_cast<size_t>(st.st_size) != length;
+
+    if (reinitialize) {
+        if (st.st_size != 0) {
+            LOG_WARN("Call journal " + path + " has a different size - starting a new one");
+        }
+        // Reserve the blocks now so appends never fault on a full disk
+        if (ftruncate(fd, 0) != 0 || posix_fallocate(fd, 0, static_cast<off_t>(length)) != 0) {
+            LOG_ERROR("Failed to allocate call journal " + path);
+            ::close(fd);
+            return false;
+        }
+    }
+
+    bool mapped = map(fd, length, true);
+    ::close(fd);
+    if (!mapped) {
+        LOG_ERROR("Failed to map call journal " + path);
+        return false;
+    }
+
+    if (!reinitialize && (memcmp(m_header->magic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) != 0 ||
+                          m_header->version != JOURNAL_VERSION ||
+                          m_header->recordSize != sizeof(CallRecord) ||
+                          m_header->capacity != capacity)) {
+        LOG_WARN("Call journal " + path + " has an unknown layout - starting a new one");
+        memset(static_cast<void*>(m_header), 0, length);
+        reinitialize = true;
+    }
+
+    if (reinitialize) {
+        memcpy(m_header->magic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+        m_header->version = JOURNAL_VERSION;
+        m_header->recordSize = sizeof(CallRecord);
+        m_header->capacity = capacity;
+        m_header->writeIndex = 0;
+    }
+
+    m_capacity = capacity;
+    LOG_INFO("Call journal " + path + ": " + std::to_string(getWriteIndex()) + " records, capacity " +
+             std::to_string(capacity));
+    return true;
+}
+
+bool CallJournal::openReadOnly(const std::string& path) {
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < HEADER_SIZE) {
+        ::close(fd);
+        return false;
+    }
+
+    bool mapped = map(fd, static_cast<size_t>(st.st_size), false);
+    ::close(fd);
+    if (!mapped) {
+        return false;
+    }
+
+    if (memcmp(m_header->magic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) != 0 ||
+        m_header->recordSize != sizeof(CallRecord) ||
+        fileLength(m_header->capacity) > m_mappedLength) {
+        close();
+        return false;
+    }
+
+    m_capacity = m_header->capacity;
+    return true;
+}
+
+bool CallJournal::map(int fd, size_t length, bool writable) {
+    int protection = writable ? (PROT_READ | PROT_WRITE) : PROT_READ;
+    void* base = mmap(nullptr, length, protection, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        return false;
+    }
+
+    m_header = static_cast<Header*>(base);
+    m_records = reinterpret_cast<CallRecord*>(static_cast<uint8_t*>(base) + HEADER_SIZE);
+    m_mappedLength = length;
+    return true;
+}
+
+void CallJournal::close() {
+    if (!m_header) {
+        return;
+    }
+
+    munmap(m_header, m_mappedLength);
+    m_header = nullptr;
+    m_records = nullptr;
+    m_capacity = 0;
+    m_mappedLength = 0;
+}
+
+bool CallJournal::append(const CallRecord& record) {
+    if (!m_header) {
+        return false;
+    }
+
+    uint64_t index = __atomic_fetch_add(&m_header->writeIndex, 1, __ATOMIC_RELAXED);
+    CallRecord* target = &m_records[index % m_capacity];
+
+    // Invalidate, fill, then publish - readers retry or skip on a mismatch
+    __atomic_store_n(&target->sequence, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(reinterpret_cast<uint8_t*>(target) + sizeof(uint64_t),
+           reinterpret_cast<const uint8_t*>(&record) + sizeof(uint64_t),
+           sizeof(CallRecord) - sizeof(uint64_t));
+    __atomic_store_n(&target->sequence, index + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+uint64_t CallJournal::getWriteIndex() const {
+    return m_header ? __atomic_load_n(&m_header->writeIndex, __ATOMIC_ACQUIRE) : 0;
+}
+
+bool CallJournal::read(uint64_t index, CallRecord& record) const {
+    if (!m_header) {
+        return false;
+    }
+
+    const CallRecord* source = &m_records[index % m_capacity];
+    uint64_t sequence = __atomic_load_n(&source->sequence, __ATOMIC_ACQUIRE);
+    if (sequence != index + 1) {
+        return false;
+    }
+
+    memcpy(&record, source, sizeof(CallRecord));
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&source->sequence, __ATOMIC_RELAXED) == sequence;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+// Call detail record as stored in the journal - fixed 64 bytes, host byte order
+struct CallRecord {
+    uint64_t sequence;    // journal index + 1; 0 while the slot is being written
+    uint64_t startUs;     // wall clock, microseconds since the epoch
+    uint64_t endUs;
+    uint32_t talkgroup;
+    uint32_t source;
+    uint32_t frames;      // voice records received
+    uint32_t lostFrames;  // voice records missing from the LDU sequence
+    int16_t rssi;         // average dBm, CDR_RSSI_UNKNOWN if the modem reported none
+    uint8_t direction;    // CallDirection
+    uint8_t flags;        // CDR_FLAG_*
+    uint32_t lateFrames;  // records arriving well behind the 20 ms voice cadence
+    uint32_t jitterUs;    // inter-arrival jitter (RFC 3550 estimator)
+    uint16_t maxGapMs;    // longest gap between two records (saturates)
+    uint16_t concealedFrames;  // network records synthesized to keep the carrier up
+    int16_t rssiMin;
+    int16_t rssiMax;
+    uint16_t superframes;
+    uint16_t badSuperframes;  // superframes with at least one record missing
+};
+
+static_assert(sizeof(CallRecord) == 64, "CallRecord is an on-disk format");
+
+const uint8_t CDR_FLAG_EMERGENCY = 0x01;
+const uint8_t CDR_FLAG_ENCRYPTED = 0x02;
+const uint8_t CDR_FLAG_NO_EOT = 0x04;    // ended by timeout, not an EOT
+
+const int16_t CDR_RSSI_UNKNOWN = INT16_MIN;
+
+// Append-only ring of CallRecords in a pre-allocated, memory-mapped file.
+// Writers reserve a slot with one atomic add on the shared write index and
+// publish it by storing the sequence last, so any thread (or the query tool
+// in another process) can append or read without a lock. Once the ring is
+// full the oldest records are overwritten.
+class CallJournal {
+public:
+    static const uint64_t DEFAULT_CAPACITY = 262144;  // 16 MB
+
+    CallJournal();
+    ~CallJournal();
+
+    CallJournal(const CallJournal&) = delete;
+    CallJournal& operator=(const CallJournal&) = delete;
+
+    // Create or reopen the journal. An existing file with a different layout
+    // or capacity is reinitialized.
+    bool open(const std::string& path, uint64_t capacity);
+
+    // Map an existing journal read-only (query tool)
+    bool openReadOnly(const std::string& path);
+
+    void close();
+
+    bool isOpen() const { return m_header != nullptr; }
+
+    // Lock-free. record.sequence is ignored.
+    bool append(const CallRecord& record);
+
+    // Total records ever appended; the oldest still present is
+    // max(0, getWriteIndex() - getCapacity())
+    uint64_t getWriteIndex() const;
+    uint64_t getCapacity() const { return m_capacity; }
+
+    // Consistent copy of record index, false if it was overwritten or is
+    // still being written
+    bool read(uint64_t index, CallRecord& record) const;
+
+private:
+    struct Header;
+
+    bool map(int fd, size_t length, bool writable);
+    static size_t fileLength(uint64_t capacity);
+
+    Header* m_header;
+    CallRecord* m_records;
+    uint64_t m_capacity;
+    size_t m_mappedLength;
+};
@@ -0,0 +1,211 @@
+#include "CallTracker.h"
+#include "Logger.h"
+#include "Clock.h"
+#include <cstdio>
+
+// Voice record types run 0x62..0x73 (LDU1 then LDU2, nine records each)
+static const uint8_t VOICE_SEQUENCE_FIRST = FRAME_LDU1_0;
+static const uint8_t VOICE_SEQUENCE_LENGTH = FRAME_LDU2_8 - FRAME_LDU1_0 + 1;
+
+// 18 records per 360 ms superframe
+static const int64_t RECORD_INTERVAL_US = 20000;
+
+// A record this far behind its slot in the cadence counts as late
+static const int64_t LATE_THRESHOLD_US = 60000;
+
+CallTracker::CallTracker(CallJournal& journal)
+    : m_journal(journal)
+{
+}
+
+void CallTracker::onVoice(CallDirection direction, const P25FrameView& frame, int16_t rssi) {
+    Transmission& call = m_calls[static_cast<size_t>(direction)];
+    std::lock_guard<std::mutex> lock(call.mutex);
+
+    if (frame.hasLinkControl() && classifyFrame(frame.frameType()) == P25FrameClass::VoiceLdu1) {
+        uint32_t tg = frame.talkgroupId();
+        if (tg != 0) {
+            // New talker without an EOT in between
+            if (call.open && (call.record.talkgroup != tg || call.record.source != frame.sourceId())) {
+                closeLocked(call, CDR_FLAG_NO_EOT);
+            }
+            if (!call.open) {
+                openLocked(call, direction, frame);
+            }
+        }
+    }
+
+    if (!call.open) {
+        return;
+    }
+
+    uint64_t arrivalUs = Clock::nowUs();
+    uint8_t type = frame.frameType();
+    uint32_t missing = 0;
+
+    if (call.lastType != 0) {
+        // Count gaps in the record type sequence as lost records (a repeated
+        // type is a duplicate, not a lost superframe)
+        if (type != call.lastType) {
+            uint8_t expected = call.lastType + 1 > FRAME_LDU2_8 ? VOICE_SEQUENCE_FIRST : call.lastType + 1;
+            missing = (type + VOICE_SEQUENCE_LENGTH - expected) % VOICE_SEQUENCE_LENGTH;
+
+            // Wrapped back to the start of the sequence - a superframe ended
+            if (type < call.lastType) {
+                finishSuperframeLocked(call);
+            }
+        }
+
+        // Transit variation against the cadence, lost records included
+        int64_t gapUs = static_cast<int64_t>(arrivalUs - call.lastArrivalUs);
+        int64_t variationUs = gapUs - RECORD_INTERVAL_US * (missing + 1);
+        int64_t magnitude = variationUs < 0 ? -variationUs : variationUs;
+        call.jitterUs += (magnitude - call.jitterUs) / 16.0;
+
+        if (variationUs > LATE_THRESHOLD_US) {
+            call.record.lateFrames++;
+        }
+        int64_t gapMs = gapUs / 1000;
+        if (gapMs > call.record.maxGapMs) {
+            call.record.maxGapMs = static_cast<uint16_t>(gapMs > UINT16_MAX ? UINT16_MAX : gapMs);
+        }
+    }
+
+    call.record.lostFrames += missing;
+    call.superframeLost += missing;
+    call.record.frames++;
+    call.lastType = type;
+    call.lastArrivalUs = arrivalUs;
+
+    if (rssi != CDR_RSSI_UNKNOWN) {
+        if (call.rssiCount == 0 || rssi < call.record.rssiMin) {
+            call.record.rssiMin = rssi;
+        }
+        if (call.rssiCount == 0 || rssi > call.record.rssiMax) {
+            call.record.rssiMax = rssi;
+        }
+        call.rssiSum += rssi;
+        call.rssiCount++;
+    }
+}
+
+void CallTracker::onConcealed(CallDirection direction, uint32_t count) {
+    Transmission& call = m_calls[static_cast<size_t>(direction)];
+    std::lock_guard<std::mutex> lock(call.mutex);
+    if (call.open) {
+        uint32_t total = call.record.concealedFrames + count;
+        call.record.concealedFrames = static_cast<uint16_t>(total > UINT16_MAX ? UINT16_MAX : total);
+    }
+}
+
+void CallTracker::onEnd(CallDirection direction) {
+    Transmission& call = m_calls[static_cast<size_t>(direction)];
+    std::lock_guard<std::mutex> lock(call.mutex);
+    if (call.open) {
+        closeLocked(call, 0);
+    }
+}
+
+void CallTracker::onTimeout(CallDirection direction, uint32_t talkgroup) {
+    Transmission& call = m_calls[static_cast<size_t>(direction)];
+    std::lock_guard<std::mutex> lock(call.mutex);
+    if (call.open && call.record.talkgroup == talkgroup) {
+        closeLocked(call, CDR_FLAG_NO_EOT);
+    }
+}
+
+void CallTracker::flush() {
+    for (Transmission& call : m_calls) {
+        std::lock_guard<std::mutex> lock(call.mutex);
+        if (call.open) {
+            closeLocked(call, CDR_FLAG_NO_EOT);
+        }
+    }
+}
+
+bool CallTracker::snapshot(CallDirection direction, CallRecord& record) {
+    Transmission& call = m_calls[static_cast<size_t>(direction)];
+    std::lock_guard<std::mutex> lock(call.mutex);
+    if (!call.open) {
+        return false;
+    }
+
+    record = call.record;
+    record.endUs = Clock::wallClockUs();
+    summarizeLocked(call, record);
+    return true;
+}
+
+void CallTracker::openLocked(Transmission& call, CallDirection direction, const P25FrameView& frame) {
+    call.open = true;
+    call.lastType = 0;
+    call.lastArrivalUs = 0;
+    call.jitterUs = 0.0;
+    call.superframeLost = 0;
+    call.rssiSum = 0;
+    call.rssiCount = 0;
+
+    call.record = CallRecord();
+    call.record.startUs = Clock::wallClockUs();
+    call.record.talkgroup = frame.talkgroupId();
+    call.record.source = frame.sourceId();
+    call.record.direction = static_cast<uint8_t>(direction);
+    call.record.rssi = CDR_RSSI_UNKNOWN;
+    call.record.rssiMin = CDR_RSSI_UNKNOWN;
+    call.record.rssiMax = CDR_RSSI_UNKNOWN;
+    if (frame.isEmergency()) {
+        call.record.flags |= CDR_FLAG_EMERGENCY;
+    }
+    if (frame.isEncrypted()) {
+        call.record.flags |= CDR_FLAG_ENCRYPTED;
+    }
+}
+
+void CallTracker::finishSuperframeLocked(Transmission& call) {
+    if (call.record.superframes < UINT16_MAX) {
+        call.record.superframes++;
+        if (call.superframeLost > 0) {
+            call.record.badSuperframes++;
+        }
+    }
+    call.superframeLost = 0;
+}
+
+void CallTracker::summarizeLocked(const Transmission& call, CallRecord& record) {
+    record.jitterUs = static_cast<uint32_t>(call.jitterUs);
+    if (call.rssiCount > 0) {
+        record.rssi = static_cast<int16_t>(call.rssiSum / static_cast<int64_t>(call.rssiCount));
+    }
+}
+
+void CallTracker::closeLocked(Transmission& call, uint8_t flags) {
+    // The last, possibly partial, superframe
+    if (call.lastType != 0) {
+        finishSuperframeLocked(call);
+    }
+
+    call.record.endUs = Clock::wallClockUs();
+    call.record.flags |= flags;
+    summarizeLocked(call, call.record);
+    m_journal.append(call.record);
+    call.open = false;
+    if (m_endCallback) {
+        m_endCallback(call.record);
+    }
+
+    const CallRecord& record = call.record;
+    uint32_t expected = record.frames + record.lostFrames;
+    char quality[160];
+    snprintf(quality, sizeof(quality), "%.1fs, %u/%u records (%.1f%% loss), %u/%u superframes clean, %u late, jitter %.1f ms",
+             (record.endUs - record.startUs) / 1e6, record.frames, expected,
+             expected ? 100.0 * record.lostFrames / expected : 0.0,
+             static_cast<unsigned>(record.superframes - record.badSuperframes), static_cast<unsigned>(record.superframes),
+             record.lateFrames, record.jitterUs / 1000.0);
+
+    char rssi[48] = "";
+    if (record.rssi != CDR_RSSI_UNKNOWN) {
+        snprintf(rssi, sizeof(rssi), ", RSSI %d dBm (%d..%d)", record.rssi, record.rssiMin, record.rssiMax);
+    }
+    LOG_INFOF("%s call TG %u SRC %u: %s%s", record.direction == 0 ? "RF" : "Network", record.talkgroup,
+              record.source, quality, rssi);
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "CallJournal.h"
+#include "P25Protocol.h"
+#include "TrunkingState.h"
+#include <cstdint>
+#include <functional>
+#include <mutex>
+
+// Follows the transmission currently passing in each direction and writes a
+// CallRecord to the journal when it ends. A transmission opens on the first
+// admitted LDU1 carrying link control and closes on its EOT, on a timeout,
+// or when link control for a different talkgroup/source shows up.
+//
+// Quality counters live in the per-direction slot, so tracking allocates
+// nothing: records received vs missing per superframe, late records and
+// inter-arrival jitter against the 20 ms voice cadence, and RSSI when the
+// modem reports it.
+class CallTracker {
+public:
+    using EndCallback = std::function<void(const CallRecord&)>;
+
+    explicit CallTracker(CallJournal& journal);
+
+    // Called with each finished record after it is journaled. Set before
+    // any traffic flows; runs with the direction's slot locked.
+    void setEndCallback(EndCallback callback) { m_endCallback = std::move(callback); }
+
+    // Every admitted voice record (LDU1/LDU2). rssi is in dBm, or
+    // CDR_RSSI_UNKNOWN.
+    void onVoice(CallDirection direction, const P25FrameView& frame, int16_t rssi = CDR_RSSI_UNKNOWN);
+
+    // Records synthesized in place of lost ones on their way out
+    void onConcealed(CallDirection direction, uint32_t count);
+
+    // Admitted EOT
+    void onEnd(CallDirection direction);
+
+    // Activity timeout on talkgroup - closes the open call if it matches
+    void onTimeout(CallDirection direction, uint32_t talkgroup);
+
+    // Close anything still open (shutdown)
+    void flush();
+
+    // Live view of the open call in direction, false if there is none
+    bool snapshot(CallDirection direction, CallRecord& record);
+
+private:
+    struct Transmission {
+        std::mutex mutex;
+        bool open = false;
+        uint8_t lastType = 0;       // last voice record type, 0 = none yet
+        uint64_t lastArrivalUs = 0;
+        double jitterUs = 0.0;
+        uint32_t superframeLost = 0;
+        int64_t rssiSum = 0;
+        uint32_t rssiCount = 0;
+        CallRecord record = {};
+    };
+
+    void openLocked(Transmission& call, CallDirection direction, const P25FrameView& frame);
+    void closeLocked(Transmission& call, uint8_t flags);
+    void finishSuperframeLocked(Transmission& call);
+    static void summarizeLocked(const Transmission& call, CallRecord& record);
+
+
+    CallJournal& m_journal;
+    EndCallback m_endCallback;
+
+    // Indexed by CallDirection. The mutex only meets contention when a
+    // timeout closes a call from the timer thread.
+    Transmission m_calls[2];
+};
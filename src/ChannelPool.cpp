@@ -0,0 +1,119 @@
+#include "ChannelPool.h"
+
+ChannelPool::ChannelPool()
+    : m_slots()
+    , m_count(0)
+    , m_rejected(0)
+{
+}
+
+size_t ChannelPool::add(uint16_t channelId) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_count >= MAX_CHANNELS) {
+        return NONE;
+    }
+
+    m_slots[m_count] = {channelId, 0, 0};
+    return m_count++;
+}
+
+size_t ChannelPool::assign(uint32_t talkgroup) {
+    bool taken = false;
+    return assign(talkgroup, taken);
+}
+
+size_t ChannelPool::assign(uint32_t talkgroup, bool& taken) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    taken = false;
+
+    size_t index = findLocked(talkgroup);
+    if (index != NONE) {
+        return index;
+    }
+
+    // Rotate through the free channels rather than always keying the first
+    size_t best = NONE;
+    for (size_t i = 0; i < m_count; i++) {
+        if (m_slots[i].talkgroup == 0 && (best == NONE || m_slots[i].freedAtMs < m_slots[best].freedAtMs)) {
+            best = i;
+        }
+    }
+
+    if (best == NONE) {
+        m_rejected.fetch_add(1, std::memory_order_relaxed);
+        return NONE;
+    }
+
+    m_slots[best].talkgroup = talkgroup;
+    taken = true;
+    return best;
+}
+
+bool ChannelPool::claim(size_t index, uint32_t talkgroup, uint64_t nowMs) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (index >= m_count) {
+        return false;
+    }
+
+    Slot& slot = m_slots[index];
+    if (slot.talkgroup == talkgroup) {
+        return true;
+    }
+    if (slot.talkgroup != 0) {
+        return false;
+    }
+
+    // The talkgroup moves here - whatever it held elsewhere is free
+    size_t previous = findLocked(talkgroup);
+    if (previous != NONE) {
+        m_slots[previous].talkgroup = 0;
+        m_slots[previous].freedAtMs = nowMs;
+    }
+    slot.talkgroup = talkgroup;
+    return true;
+}
+
+size_t ChannelPool::find(uint32_t talkgroup) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return findLocked(talkgroup);
+}
+
+bool ChannelPool::release(uint32_t talkgroup, uint64_t nowMs) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    size_t index = findLocked(talkgroup);
+    if (index == NONE) {
+        return false;
+    }
+
+    m_slots[index].talkgroup = 0;
+    m_slots[index].freedAtMs = nowMs;
+    return true;
+}
+
+uint32_t ChannelPool::getTalkgroup(size_t index) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return index < m_count ? m_slots[index].talkgroup : 0;
+}
+
+size_t ChannelPool::getBusyCount() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    size_t busy = 0;
+    for (size_t i = 0; i < m_count; i++) {
+        if (m_slots[i].talkgroup != 0) {
+            busy++;
+        }
+    }
+    return busy;
+}
+
+size_t ChannelPool::findLocked(uint32_t talkgroup) const {
+    if (talkgroup == 0) {
+        return NONE;
+    }
+    for (size_t i = 0; i < m_count; i++) {
+        if (m_slots[i].talkgroup == talkgroup) {
+            return i;
+        }
+    }
+    return NONE;
+}
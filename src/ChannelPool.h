@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <mutex>
+
+// Traffic channels of a multi-modem site. Each channel carries one
+// talkgroup at a time; a talkgroup keeps its channel from the first grant or
+// voice until its grant is released, so a reply within the hang time lands
+// on the same frequency.
+class ChannelPool {
+public:
+    static const size_t MAX_CHANNELS = 16;
+    static const size_t NONE = static_cast<size_t>(-1);
+
+    ChannelPool();
+
+    // Register a traffic channel (identifier << 12 | channel number).
+    // Returns its index, NONE if the pool is full.
+    size_t add(uint16_t channelId);
+
+    // Channel already carrying talkgroup, or the free channel idle longest.
+    // NONE (and counted) if every channel is busy.
+    size_t assign(uint32_t talkgroup);
+
+    // As above; taken is set when a free channel was taken for talkgroup by
+    // this call, so the caller can give it back if the call goes nowhere
+    size_t assign(uint32_t talkgroup, bool& taken);
+
+    // Voice turned up on a specific channel (late entry, unit that skipped
+    // the control channel) - take it if it is free
+    bool claim(size_t index, uint32_t talkgroup, uint64_t nowMs);
+
+    size_t find(uint32_t talkgroup);
+
+    // Grant released - the channel is free again
+    bool release(uint32_t talkgroup, uint64_t nowMs);
+
+    uint16_t getChannelId(size_t index) const { return m_slots[index].channelId; }
+
+    // Talkgroup on the channel, 0 if free
+    uint32_t getTalkgroup(size_t index);
+    size_t size() const { return m_count; }
+    size_t getBusyCount();
+    uint64_t getRejected() const { return m_rejected.load(std::memory_order_relaxed); }
+
+private:
+    struct Slot {
+        uint16_t channelId;
+        uint32_t talkgroup;   // 0 = free
+        uint64_t freedAtMs;
+    };
+
+    size_t findLocked(uint32_t talkgroup) const;
+
+    std::mutex m_mutex;
+    Slot m_slots[MAX_CHANNELS];
+    size_t m_count;
+    std::atomic<uint64_t> m_rejected;
+};
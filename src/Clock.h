@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+// Source of protocol time. The timer wheel and everything that times the
+// protocol - keepalives, command and auth timeouts, hang and grant expiry,
+// ingress rates, TSBK pacing, concealment playout, call records - read the
+// installed clock, so a harness can swap in a SimulatedClock and run days
+// of protocol time in seconds.
+//
+// Latency measurement (FrameTrace, capture timestamps, realtime wakeup
+// stats) stays on the system clock: it measures the machine.
+class Clock {
+public:
+    virtual ~Clock() = default;
+
+    // Monotonic and wall clock time, ns
+    virtual uint64_t monotonicNs() const = 0;
+    virtual uint64_t realtimeNs() const = 0;
+
+    virtual bool isSimulated() const { return false; }
+
+    // Clock in use - the system clock unless another was installed
+    static Clock& get() { return *s_current.load(std::memory_order_acquire); }
+
+    // Install before the timer wheel and the I/O threads start. nullptr
+    // restores the system clock.
+    static void install(Clock* clock);
+
+    static uint64_t nowMs() { return get().monotonicNs() / 1000000; }
+    static uint64_t nowUs() { return get().monotonicNs() / 1000; }
+    static uint64_t wallClockUs() { return get().realtimeNs() / 1000; }
+
+private:
+    static std::atomic<Clock*> s_current;
+};
+
+// CLOCK_MONOTONIC and CLOCK_REALTIME
+class SystemClock : public Clock {
+public:
+    static SystemClock& getInstance();
+
+    uint64_t monotonicNs() const override;
+    uint64_t realtimeNs() const override;
+};
+
+// Time that only moves when told to. advance() steps from one timer wheel
+// deadline to the next and waits for the wheel to run each, so every
+// periodic timer fires as often as it would have in real time, only
+// without the wait in between.
+class SimulatedClock : public Clock {
+public:
+    // Starts where the system clock is, so timers already armed keep their meaning
+    SimulatedClock();
+    ~SimulatedClock() override;
+
+    SimulatedClock(const SimulatedClock&) = delete;
+    SimulatedClock& operator=(const SimulatedClock&) = delete;
+
+    uint64_t monotonicNs() const override { return m_nowNs.load(std::memory_order_acquire); }
+    uint64_t realtimeNs() const override { return m_realtimeOffsetNs + monotonicNs(); }
+    bool isSimulated() const override { return true; }
+
+    // Move time forward, firing the timers due on the way. Returns once the
+    // wheel has run them all. Not from a timer callback.
+    void advance(uint64_t ns);
+
+    // Let time run at rate x real time on a thread of its own until stop()
+    void run(double rate);
+    void stop();
+
+private:
+    std::atomic<uint64_t> m_nowNs;
+    const uint64_t m_realtimeOffsetNs;
+
+    std::mutex m_advanceMutex;  // one advance at a time
+    std::atomic<bool> m_running;
+    std::thread m_thread;
+};
@@ -2,13 +2,99 @@
 #include "Logger.h"
 #include <yaml-cpp/yaml.h>
 #include <fstream>
+#include <algorithm>
+#include <stdexcept>
+
+// ID spaces the filter lists are checked against
+static const uint64_t TALKGROUP_LIMIT = 1 << 16;
+static const uint64_t SOURCE_LIMIT = 1 << 24;
+
+// Accepts a list of IDs and "first-last" range strings, all below limit
+static std::vector<IdRange> parseIdRanges(const YAML::Node& node, uint64_t limit, const std::string& key) {
+    std::vector<IdRange> ranges;
+    if (!node.IsSequence()) {
+        return ranges;
+    }
+
+    for (const auto& item : node) {
+        std::string value = item.as<std::string>();
+        size_t dash = value.find('-');
+        uint64_t first = std::stoull(value.substr(0, dash), nullptr, 0);
+        uint64_t last = dash == std::string::npos ? first : std::stoull(value.substr(dash + 1), nullptr, 0);
+        if (first > last) {
+            throw std::runtime_error(key + " range " + value + " ends before it starts");
+        }
+        if (last >= limit) {
+            throw std::runtime_error(key + " entry " + value + " is outside 0-" + std::to_string(limit - 1));
+        }
+        ranges.push_back(IdRange{static_cast<uint32_t>(first), static_cast<uint32_t>(last)});
+    }
+    return ranges;
+}
+
+// Talkgroup list with ranges expanded (bounded by the talkgroup space)
+static std::vector<uint32_t> parseIdList(const YAML::Node& node, const std::string& key) {
+    std::vector<uint32_t> ids;
+    for (const IdRange& range : parseIdRanges(node, TALKGROUP_LIMIT, key)) {
+        for (uint32_t id = range.first; id <= range.last; id++) {
+            ids.push_back(id);
+        }
+    }
+    return ids;
+}
+
+// Keys of one modem; whatever the node leaves out stays as in modem
+static void parseModem(const YAML::Node& node, ModemConfig& modem) {
+    if (node["port"]) modem.port = node["port"].as<std::string>();
+    if (node["baud"]) modem.baud = node["baud"].as<int>();
+    if (node["transport"]) modem.transport = node["transport"].as<std::string>();
+    if (node["address"]) modem.address = node["address"].as<std::string>();
+    if (node["remote_port"]) modem.remote_port = node["remote_port"].as<uint16_t>();
+    if (node["local_port"]) modem.local_port = node["local_port"].as<uint16_t>();
+    if (node["rx_frequency"]) modem.rx_frequency = node["rx_frequency"].as<uint32_t>();
+    if (node["tx_frequency"]) modem.tx_frequency = node["tx_frequency"].as<uint32_t>();
+    if (node["tx_power"]) modem.tx_power = node["tx_power"].as<int>();
+    if (node["rx_offset"]) modem.rx_offset = node["rx_offset"].as<int>();
+    if (node["tx_offset"]) modem.tx_offset = node["tx_offset"].as<int>();
+    if (node["rf_level"]) modem.rf_level = node["rf_level"].as<int>();
+    if (node["rx_dc_offset"]) modem.rx_dc_offset = node["rx_dc_offset"].as<int>();
+    if (node["tx_dc_offset"]) modem.tx_dc_offset = node["tx_dc_offset"].as<int>();
+    if (node["enabled"]) modem.enabled = node["enabled"].as<bool>();
+    if (node["rssi"]) modem.rssi = node["rssi"].as<bool>();
+    if (node["tx_delay"]) modem.tx_delay = node["tx_delay"].as<int>();
+    if (node["rssi_map"]) {
+        modem.rssi_map.clear();
+        for (const auto& entry : node["rssi_map"]) {
+            modem.rssi_map.emplace_back(entry.first.as<uint16_t>(), entry.second.as<int>());
+        }
+        std::sort(modem.rssi_map.begin(), modem.rssi_map.end());
+    }
+    if (node["role"]) modem.role = node["role"].as<std::string>();
+    if (node["channel"]) modem.channel = node["channel"].as<int>();
+    if (node["cpu"]) modem.cpu = node["cpu"].as<int>();
+
+    if (modem.role != "both" && modem.role != "control" && modem.role != "traffic") {
+        throw std::runtime_error("modem role must be both, control or traffic, not " + modem.role);
+    }
+}
 
 Config::Config() {
     // Set defaults
     m_reflector.port = 41000;
     m_reflector.keepalive_interval = 5;
+    m_reflector.dynamic_talkgroups = true;
+    m_reflector.talkgroup_idle_timeout = 900;
+    m_reflector.bundle_ldu = false;
+    m_reflector.ingress_voice_rate = 150;   // Three concurrent streams at 50 records/s
+    m_reflector.ingress_tsbk_rate = 50;
+    m_reflector.ingress_control_rate = 20;
 
+    m_modem.transport = "serial";
     m_modem.baud = 115200;
+    m_modem.remote_port = 0;
+    m_modem.local_port = 0;
+    m_modem.rx_frequency = 0;
+    m_modem.tx_frequency = 0;
     m_modem.tx_power = 50;
     m_modem.rx_offset = 0;
     m_modem.tx_offset = 0;
@@ -16,15 +102,55 @@ Config::Config() {
     m_modem.rx_dc_offset = 0;
     m_modem.tx_dc_offset = 0;
     m_modem.enabled = true;
+    m_modem.rssi = false;
+    m_modem.tx_delay = 100;
+    m_modem.role = "both";
+    m_modem.channel = -1;
+    m_modem.cpu = -1;
 
     m_p25.nac = 0x293;
     m_p25.enabled = true;
     m_p25.trunking = true;
+    m_p25.hang_time_ms = 3000;
+    m_p25.grant_timeout_ms = 5000;
+    m_p25.registration_timeout = 3600;
+    m_p25.emergency_preempt = true;
+    m_p25.conceal_loss = true;
+    m_p25.wacn = 0xBEE00;
+    m_p25.system_id = 0x001;
+    m_p25.rfss_id = 1;
+    m_p25.site_id = 1;
+    m_p25.lra = 0;
+    m_p25.service_class = 0x70;  // Composite control channel, voice, registration
+    m_p25.control_channel = (1 << 12) | 0;
+    m_p25.tsbk_slot_us = 25000;  // Three-block TSDU at 9600 bps: 75 ms per 3 TSBKs
 
     m_logging.level = "INFO";
     m_logging.console = true;
     m_logging.max_size_mb = 10;
     m_logging.max_files = 5;
+    m_logging.cdr_file = "/var/lib/p25-hotspot/calls.cdr";
+    m_logging.cdr_records = 262144;
+    m_logging.status_file = "/dev/shm/p25-hotspot-status";
+    m_logging.latency_trace = true;
+    m_logging.capture_mb = 64;
+
+    m_realtime.enabled = false;
+    m_realtime.lock_memory = true;
+    m_realtime.modem_priority = 80;     // RX timing matters most
+    m_realtime.modem_cpu = -1;
+    m_realtime.network_priority = 70;
+    m_realtime.network_cpu = -1;
+    m_realtime.timer_priority = 75;
+    m_realtime.timer_cpu = -1;
+    m_realtime.overrun_us = 2000;
+
+    m_handoff.socket = "/run/p25-hotspot/handoff.sock";
+    m_handoff.timeout_ms = 2000;
+
+    m_snapshot.file = "/var/lib/p25-hotspot/state.snap";
+    m_snapshot.interval_ms = 5000;
+    m_snapshot.max_age = 600;
 }
 
 bool Config::load(const std::string& filename) {
@@ -40,22 +166,29 @@ bool Config::load(const std::string& filename) {
             if (ref["password"]) m_reflector.password = ref["password"].as<std::string>();
             if (ref["callsign"]) m_reflector.callsign = ref["callsign"].as<std::string>();
             if (ref["keepalive_interval"]) m_reflector.keepalive_interval = ref["keepalive_interval"].as<int>();
+            if (ref["talkgroups"]) m_reflector.talkgroups = parseIdList(ref["talkgroups"], "reflector talkgroups");
+            if (ref["dynamic_talkgroups"]) m_reflector.dynamic_talkgroups = ref["dynamic_talkgroups"].as<bool>();
+            if (ref["talkgroup_idle_timeout"]) m_reflector.talkgroup_idle_timeout = ref["talkgroup_idle_timeout"].as<int>();
+            if (ref["bundle_ldu"]) m_reflector.bundle_ldu = ref["bundle_ldu"].as<bool>();
+            if (ref["ingress_voice_rate"]) m_reflector.ingress_voice_rate = ref["ingress_voice_rate"].as<int>();
+            if (ref["ingress_tsbk_rate"]) m_reflector.ingress_tsbk_rate = ref["ingress_tsbk_rate"].as<int>();
+            if (ref["ingress_control_rate"]) m_reflector.ingress_control_rate = ref["ingress_control_rate"].as<int>();
         }
 
-        // Modem settings
+        // Modem settings. Entries under "modems" start from the "modem" section.
         if (config["modem"]) {
-            auto modem = config["modem"];
-            if (modem["port"]) m_modem.port = modem["port"].as<std::string>();
-            if (modem["baud"]) m_modem.baud = modem["baud"].as<int>();
-            if (modem["rx_frequency"]) m_modem.rx_frequency = modem["rx_frequency"].as<uint32_t>();
-            if (modem["tx_frequency"]) m_modem.tx_frequency = modem["tx_frequency"].as<uint32_t>();
-            if (modem["tx_power"]) m_modem.tx_power = modem["tx_power"].as<int>();
-            if (modem["rx_offset"]) m_modem.rx_offset = modem["rx_offset"].as<int>();
-            if (modem["tx_offset"]) m_modem.tx_offset = modem["tx_offset"].as<int>();
-            if (modem["rf_level"]) m_modem.rf_level = modem["rf_level"].as<int>();
-            if (modem["rx_dc_offset"]) m_modem.rx_dc_offset = modem["rx_dc_offset"].as<int>();
-            if (modem["tx_dc_offset"]) m_modem.tx_dc_offset = modem["tx_dc_offset"].as<int>();
-            if (modem["enabled"]) m_modem.enabled = modem["enabled"].as<bool>();
+            parseModem(config["modem"], m_modem);
+        }
+        if (config["modems"]) {
+            for (const auto& entry : config["modems"]) {
+                ModemConfig modem = m_modem;
+                parseModem(entry, modem);
+                if (modem.enabled) {
+                    m_modems.push_back(modem);
+                }
+            }
+        } else if (m_modem.enabled) {
+            m_modems.push_back(m_modem);
         }
 
         // P25 settings
@@ -64,6 +197,93 @@ bool Config::load(const std::string& filename) {
             if (p25["nac"]) m_p25.nac = p25["nac"].as<uint16_t>();
             if (p25["enabled"]) m_p25.enabled = p25["enabled"].as<bool>();
             if (p25["trunking"]) m_p25.trunking = p25["trunking"].as<bool>();
+            if (p25["hang_time_ms"]) m_p25.hang_time_ms = p25["hang_time_ms"].as<int>();
+            if (p25["grant_timeout_ms"]) m_p25.grant_timeout_ms = p25["grant_timeout_ms"].as<int>();
+            if (p25["registration_timeout"]) m_p25.registration_timeout = p25["registration_timeout"].as<int>();
+            if (p25["talkgroup_allow"]) m_p25.talkgroup_allow = parseIdRanges(p25["talkgroup_allow"], TALKGROUP_LIMIT, "p25 talkgroup_allow");
+            if (p25["talkgroup_deny"]) m_p25.talkgroup_deny = parseIdRanges(p25["talkgroup_deny"], TALKGROUP_LIMIT, "p25 talkgroup_deny");
+            if (p25["source_block"]) m_p25.source_block = parseIdRanges(p25["source_block"], SOURCE_LIMIT, "p25 source_block");
+            if (p25["talkgroup_priorities"]) {
+                for (const auto& entry : p25["talkgroup_priorities"]) {
+                    m_p25.talkgroup_priorities.emplace_back(
+                        entry.first.as<uint32_t>(),
+                        static_cast<uint8_t>(entry.second.as<int>()));
+                }
+            }
+            if (p25["emergency_preempt"]) m_p25.emergency_preempt = p25["emergency_preempt"].as<bool>();
+            if (p25["conceal_loss"]) m_p25.conceal_loss = p25["conceal_loss"].as<bool>();
+            if (p25["wacn"]) m_p25.wacn = p25["wacn"].as<uint32_t>() & 0xFFFFF;
+            if (p25["system_id"]) m_p25.system_id = p25["system_id"].as<uint16_t>() & 0xFFF;
+            if (p25["rfss_id"]) m_p25.rfss_id = static_cast<uint8_t>(p25["rfss_id"].as<int>());
+            if (p25["site_id"]) m_p25.site_id = static_cast<uint8_t>(p25["site_id"].as<int>());
+            if (p25["lra"]) m_p25.lra = static_cast<uint8_t>(p25["lra"].as<int>());
+            if (p25["service_class"]) m_p25.service_class = static_cast<uint8_t>(p25["service_class"].as<int>());
+            if (p25["control_channel"]) m_p25.control_channel = p25["control_channel"].as<uint16_t>();
+            if (p25["tsbk_slot_us"]) m_p25.tsbk_slot_us = p25["tsbk_slot_us"].as<int>();
+            if (p25["identifiers"]) {
+                for (const auto& entry : p25["identifiers"]) {
+                    ChannelIdentifier iden = {};
+                    iden.id = static_cast<uint8_t>(entry["id"].as<int>() & 0x0F);
+                    iden.base_frequency = entry["base_frequency"].as<uint32_t>();
+                    iden.spacing = entry["spacing"] ? entry["spacing"].as<uint32_t>() : 12500;
+                    iden.bandwidth = entry["bandwidth"] ? entry["bandwidth"].as<uint32_t>() : 12500;
+                    iden.tx_offset = entry["tx_offset"] ? entry["tx_offset"].as<int32_t>() : 0;
+                    m_p25.identifiers.push_back(iden);
+                }
+            }
+            if (p25["adjacent_sites"]) {
+                for (const auto& entry : p25["adjacent_sites"]) {
+                    AdjacentSite site = {};
+                    site.system_id = entry["system_id"] ? (entry["system_id"].as<uint16_t>() & 0xFFF) : m_p25.system_id;
+                    site.rfss_id = static_cast<uint8_t>(entry["rfss_id"].as<int>());
+                    site.site_id = static_cast<uint8_t>(entry["site_id"].as<int>());
+                    site.channel = entry["channel"].as<uint16_t>();
+                    m_p25.adjacent_sites.push_back(site);
+                }
+            }
+        }
+
+        // The modem carrying the control channel, first listed unless one is
+        // marked control or both
+        const ModemConfig* control = m_modems.empty() ? &m_modem : &m_modems.front();
+        for (const ModemConfig& modem : m_modems) {
+            if (modem.role != "traffic") {
+                control = &modem;
+                break;
+            }
+        }
+
+        // Simplex hotspot: one identifier whose channel 0 is the control modem TX frequency
+        if (m_p25.identifiers.empty() && control->tx_frequency != 0) {
+            ChannelIdentifier iden = {};
+            iden.id = static_cast<uint8_t>(m_p25.control_channel >> 12);
+            iden.base_frequency = control->tx_frequency;
+            iden.spacing = 12500;
+            iden.bandwidth = 12500;
+            iden.tx_offset = static_cast<int32_t>(control->rx_frequency) - static_cast<int32_t>(control->tx_frequency);
+            m_p25.identifiers.push_back(iden);
+        }
+
+        // Channel numbers the modems announce in grants, unless configured
+        const ChannelIdentifier* iden = nullptr;
+        for (const ChannelIdentifier& entry : m_p25.identifiers) {
+            if (!iden && entry.id == (m_p25.control_channel >> 12)) {
+                iden = &entry;
+            }
+        }
+        for (size_t i = 0; i < m_modems.size(); i++) {
+            ModemConfig& modem = m_modems[i];
+            if (modem.channel >= 0) {
+                continue;
+            }
+            if (modem.role != "traffic") {
+                modem.channel = m_p25.control_channel;
+            } else if (iden && iden->spacing != 0 && modem.tx_frequency >= iden->base_frequency &&
+                       (modem.tx_frequency - iden->base_frequency) % iden->spacing == 0) {
+                modem.channel = (iden->id << 12) | ((modem.tx_frequency - iden->base_frequency) / iden->spacing);
+            } else {
+                throw std::runtime_error("modem " + std::to_string(i) + " tx_frequency is off the channel plan - set its channel");
+            }
         }
 
         // Logging settings
@@ -74,6 +294,59 @@ bool Config::load(const std::string& filename) {
             if (log["console"]) m_logging.console = log["console"].as<bool>();
             if (log["max_size_mb"]) m_logging.max_size_mb = log["max_size_mb"].as<int>();
             if (log["max_files"]) m_logging.max_files = log["max_files"].as<int>();
+            if (log["cdr_file"]) m_logging.cdr_file = log["cdr_file"].as<std::string>();
+            if (log["cdr_records"]) m_logging.cdr_records = log["cdr_records"].as<uint64_t>();
+            if (log["status_file"]) m_logging.status_file = log["status_file"].as<std::string>();
+            if (log["latency_trace"]) m_logging.latency_trace = log["latency_trace"].as<bool>();
+            if (log["capture_file"]) m_logging.capture_file = log["capture_file"].as<std::string>();
+            if (log["capture_mb"]) m_logging.capture_mb = log["capture_mb"].as<int>();
+
+            if (m_logging.capture_mb <= 0) {
+                throw std::runtime_error("logging capture_mb must be positive");
+            }
+        }
+
+        // Realtime scheduling
+        if (config["realtime"]) {
+            auto rt = config["realtime"];
+            if (rt["enabled"]) m_realtime.enabled = rt["enabled"].as<bool>();
+            if (rt["lock_memory"]) m_realtime.lock_memory = rt["lock_memory"].as<bool>();
+            if (rt["modem_priority"]) m_realtime.modem_priority = rt["modem_priority"].as<int>();
+            if (rt["modem_cpu"]) m_realtime.modem_cpu = rt["modem_cpu"].as<int>();
+            if (rt["network_priority"]) m_realtime.network_priority = rt["network_priority"].as<int>();
+            if (rt["network_cpu"]) m_realtime.network_cpu = rt["network_cpu"].as<int>();
+            if (rt["timer_priority"]) m_realtime.timer_priority = rt["timer_priority"].as<int>();
+            if (rt["timer_cpu"]) m_realtime.timer_cpu = rt["timer_cpu"].as<int>();
+            if (rt["overrun_us"]) m_realtime.overrun_us = rt["overrun_us"].as<int>();
+
+            for (int priority : {m_realtime.modem_priority, m_realtime.network_priority, m_realtime.timer_priority}) {
+                if (priority < 0 || priority > 99) {
+                    throw std::runtime_error("realtime priorities must be 0-99");
+                }
+            }
+        }
+
+        // Zero-downtime upgrade
+        if (config["handoff"]) {
+            auto handoff = config["handoff"];
+            if (handoff["socket"]) m_handoff.socket = handoff["socket"].as<std::string>();
+            if (handoff["timeout_ms"]) m_handoff.timeout_ms = handoff["timeout_ms"].as<int>();
+
+            if (m_handoff.timeout_ms <= 0) {
+                throw std::runtime_error("handoff timeout_ms must be positive");
+            }
+        }
+
+        // Warm restart
+        if (config["snapshot"]) {
+            auto snapshot = config["snapshot"];
+            if (snapshot["file"]) m_snapshot.file = snapshot["file"].as<std::string>();
+            if (snapshot["interval_ms"]) m_snapshot.interval_ms = snapshot["interval_ms"].as<int>();
+            if (snapshot["max_age"]) m_snapshot.max_age = snapshot["max_age"].as<int>();
+
+            if (m_snapshot.interval_ms <= 0 || m_snapshot.max_age < 0) {
+                throw std::runtime_error("snapshot interval_ms must be positive and max_age not negative");
+            }
         }
 
         LOG_INFO("Configuration loaded from " + filename);
@@ -82,5 +355,8 @@ bool Config::load(const std::string& filename) {
     } catch (const YAML::Exception& e) {
         LOG_ERROR("Failed to load config: " + std::string(e.what()));
         return false;
+    } catch (const std::exception& e) {
+        LOG_ERROR("Invalid value in config: " + std::string(e.what()));
+        return false;
     }
 }
@@ -2,6 +2,8 @@
 
 #include <string>
 #include <cstdint>
+#include <vector>
+#include <utility>
 
 struct ReflectorConfig {
     std::string address;
@@ -10,11 +12,22 @@ struct ReflectorConfig {
     std::string password;
     std::string callsign;
     int keepalive_interval;
+    std::vector<uint32_t> talkgroups;   // Always subscribed
+    bool dynamic_talkgroups;            // Subscribe to talkgroups affiliated/used on RF
+    int talkgroup_idle_timeout;         // Seconds before an unused dynamic talkgroup is released
+    bool bundle_ldu;                    // Send each LDU as one datagram if the reflector supports it
+    int ingress_voice_rate;             // Max records/s accepted per class, 0 = unlimited
+    int ingress_tsbk_rate;
+    int ingress_control_rate;
 };
 
 struct ModemConfig {
-    std::string port;
-    int baud;
+    std::string transport;  // serial, tcp or udp
+    std::string port;       // serial device
+    int baud;               // any rate the serial driver supports
+    std::string address;    // tcp/udp: serial-to-IP bridge
+    uint16_t remote_port;
+    uint16_t local_port;    // udp: port the bridge sends to, 0 = any
     uint32_t rx_frequency;
     uint32_t tx_frequency;
     int tx_power;
@@ -24,12 +37,61 @@ struct ModemConfig {
     int rx_dc_offset;
     int tx_dc_offset;
     bool enabled;
+    bool rssi;  // Modem appends a 2-byte raw RSSI to P25 data
+    int tx_delay;  // ms the modem keys up before the first record of a transmission
+    std::vector<std::pair<uint16_t, int>> rssi_map;  // raw → dBm, interpolated; empty = raw is -dBm
+    std::string role;  // control, traffic or both (multi-modem sites)
+    int channel;       // identifier (4 bits) + channel number (12 bits) in grants, -1 = from tx_frequency
+    int cpu;           // core the modem read thread is pinned to, -1 = any
+};
+
+// Inclusive span of talkgroup or radio IDs from a filter list
+struct IdRange {
+    uint32_t first;
+    uint32_t last;
+};
+
+// Channel identifier table entry (IDEN_UP), channel numbers are relative to it
+struct ChannelIdentifier {
+    uint8_t id;               // 0-15
+    uint32_t base_frequency;  // Hz
+    uint32_t spacing;         // Hz
+    uint32_t bandwidth;       // Hz
+    int32_t tx_offset;        // Hz, input minus output
+};
+
+struct AdjacentSite {
+    uint16_t system_id;
+    uint8_t rfss_id;
+    uint8_t site_id;
+    uint16_t channel;  // identifier (4 bits) + channel number (12 bits)
 };
 
 struct P25Config {
     uint16_t nac;
     bool enabled;
     bool trunking;
+    int hang_time_ms;       // Call hang time after EOT before the grant is released
+    int grant_timeout_ms;   // Release a grant that never saw voice after this long
+    int registration_timeout;  // Seconds without hearing a unit before it leaves the registry, 0 = never
+    std::vector<IdRange> talkgroup_allow;  // Empty = all talkgroups allowed
+    std::vector<IdRange> talkgroup_deny;
+    std::vector<IdRange> source_block;
+    std::vector<std::pair<uint32_t, uint8_t>> talkgroup_priorities;  // TG → priority (0 = lowest)
+    bool emergency_preempt;  // Emergency calls take over the channel
+    bool conceal_loss;       // Fill lost network voice records so the carrier stays up
+
+    // Control channel broadcasts (trunking only)
+    uint32_t wacn;             // 20-bit
+    uint16_t system_id;        // 12-bit
+    uint8_t rfss_id;
+    uint8_t site_id;
+    uint8_t lra;               // Location registration area
+    uint8_t service_class;
+    uint16_t control_channel;  // identifier (4 bits) + channel number (12 bits)
+    int tsbk_slot_us;          // Time per TSBK on air - sets the control channel rate
+    std::vector<ChannelIdentifier> identifiers;  // Defaults to one built from the modem frequencies
+    std::vector<AdjacentSite> adjacent_sites;
 };
 
 struct LoggingConfig {
@@ -38,6 +100,41 @@ struct LoggingConfig {
     bool console;
     int max_size_mb;
     int max_files;
+    std::string cdr_file;     // Call detail record journal, empty = disabled
+    uint64_t cdr_records;     // Journal capacity (64 bytes each)
+    std::string status_file;  // Shared-memory live status for the web dashboard, empty = disabled
+    bool latency_trace;       // Per-stage relay latency histograms
+    std::string capture_file; // Frame capture for p25-replay, empty = disabled
+    int capture_mb;           // Capture size, allocated up front
+};
+
+// Opt-in realtime scheduling of the I/O threads. Priorities are SCHED_FIFO
+// 1-99 (0 = normal scheduling), CPUs -1 = any.
+struct RealtimeConfig {
+    bool enabled;
+    bool lock_memory;     // mlockall and pre-faulted thread stacks
+    int modem_priority;
+    int modem_cpu;        // a modem's own cpu setting wins
+    int network_priority;
+    int network_cpu;
+    int timer_priority;   // timer wheel: grant expiry, TSBK pacing, voice concealment
+    int timer_cpu;
+    int overrun_us;       // wakeups later than this are reported, 0 = never
+};
+
+// Zero-downtime upgrade: a new process started with --takeover gets the
+// open modem and reflector links from the running one over this socket
+struct HandoffConfig {
+    std::string socket;   // Unix socket the running process listens on, empty = disabled
+    int timeout_ms;       // how long the running process waits for the new one to take over
+};
+
+// Warm restart: grants, units and subscriptions are snapshotted to this
+// file and restored on startup if recent enough
+struct SnapshotConfig {
+    std::string file;     // empty = disabled
+    int interval_ms;      // how often the state is written
+    int max_age;          // seconds - an older snapshot is ignored
 };
 
 class Config {
@@ -49,12 +146,20 @@ public:
 
     const ReflectorConfig& getReflector() const { return m_reflector; }
     const ModemConfig& getModem() const { return m_modem; }
+    const std::vector<ModemConfig>& getModems() const { return m_modems; }  // enabled modems
     const P25Config& getP25() const { return m_p25; }
     const LoggingConfig& getLogging() const { return m_logging; }
+    const RealtimeConfig& getRealtime() const { return m_realtime; }
+    const HandoffConfig& getHandoff() const { return m_handoff; }
+    const SnapshotConfig& getSnapshot() const { return m_snapshot; }
 
 private:
     ReflectorConfig m_reflector;
     ModemConfig m_modem;
+    std::vector<ModemConfig> m_modems;
     P25Config m_p25;
     LoggingConfig m_logging;
+    RealtimeConfig m_realtime;
+    HandoffConfig m_handoff;
+    SnapshotConfig m_snapshot;
 };
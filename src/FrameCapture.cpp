@@ -0,0 +1,247 @@
+#include "FrameCapture.h"
+#include "Logger.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+static const char CAPTURE_MAGIC[8] = {'P', '2', '5', 'C', 'A', 'P', 0, 1};
+static const uint32_t CAPTURE_VERSION = 1;
+
+// Records start on their own page
+static const size_t HEADER_SIZE = 4096;
+
+static const size_t RECORD_ALIGN = 8;
+
+struct FrameCapture::Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t recordHeaderSize;
+    uint64_t capacity;          // bytes for records after the header page
+    uint64_t writeOffset;       // atomic, next byte to reserve (may pass capacity once full)
+    uint64_t dropped;           // atomic, frames that did not fit
+    uint64_t startMonotonicNs;
+    uint64_t startRealtimeNs;
+};
+
+static uint64_t clockNs(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000 + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+FrameCapture::FrameCapture()
+    : m_header(nullptr)
+    , m_records(nullptr)
+    , m_capacity(0)
+    , m_mappedLength(0)
+    , m_fd(-1)
+{
+}
+
+FrameCapture::~FrameCapture() {
+    close();
+}
+
+FrameCapture& FrameCapture::getInstance() {
+    static FrameCapture instance;
+    return instance;
+}
+
+bool FrameCapture::open(const std::string& path, uint64_t capacity) {
+    close();
+
+    static_assert(sizeof(Header) <= HEADER_SIZE, "Capture header must fit its page");
+
+    if (capacity == 0) {
+        capacity = DEFAULT_CAPACITY;
+    }
+    capacity -= capacity % RECORD_ALIGN;
+
+    // Keep the last capture - the bad call may be in it
+    std::string previous = path + ".1";
+    if (rename(path.c_str(), previous.c_str()) == 0) {
+        LOG_INFO("Previous frame capture kept as " + previous);
+    }
+
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        LOG_ERROR("Failed to open frame capture " + path + ": " + std::string(strerror(errno)));
+        return false;
+    }
+
+    // Reserve the blocks now so appends never fault on a full disk
+    size_t length = HEADER_SIZE + static_cast<size_t>(capacity);
+    if (posix_fallocate(fd, 0, static_cast<off_t>(length)) != 0) {
+        LOG_ERROR("Failed to allocate frame capture " + path);
+        ::close(fd);
+        return false;
+    }
+
+    if (!map(fd, length, true)) {
+        LOG_ERROR("Failed to map frame capture " + path);
+        ::close(fd);
+        return false;
+    }
+
+    memcpy(m_header->magic, CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC));
+    m_header->version = CAPTURE_VERSION;
+    m_header->recordHeaderSize = sizeof(CaptureRecord);
+    m_header->capacity = capacity;
+    m_header->writeOffset = 0;
+    m_header->dropped = 0;
+    m_header->startMonotonicNs = clockNs(CLOCK_MONOTONIC);
+    m_header->startRealtimeNs = clockNs(CLOCK_REALTIME);
+
+    m_capacity = capacity;
+    m_fd = fd;
+    LOG_INFO("Capturing frames to " + path + " (" + std::to_string(capacity >> 20) + " MB)");
+    return true;
+}
+
+bool FrameCapture::openReadOnly(const std::string& path) {
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < HEADER_SIZE) {
+        ::close(fd);
+        return false;
+    }
+
+    bool mapped = map(fd, static_cast<size_t>(st.st_size), false);
+    ::close(fd);
+    if (!mapped) {
+        return false;
+    }
+
+    if (memcmp(m_header->magic, CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC)) != 0 ||
+        m_header->version != CAPTURE_VERSION ||
+        m_header->recordHeaderSize != sizeof(CaptureRecord)) {
+        close();
+        return false;
+    }
+
+    // A finished capture is trimmed to what was written, a crashed one is not
+    m_capacity = m_mappedLength - HEADER_SIZE;
+    if (m_header->capacity < m_capacity) {
+        m_capacity = m_header->capacity;
+    }
+    return true;
+}
+
+bool FrameCapture::map(int fd, size_t length, bool writable) {
+    int protection = writable ? (PROT_READ | PROT_WRITE) : PROT_READ;
+    void* base = mmap(nullptr, length, protection, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        return false;
+    }
+
+    m_header = static_cast<Header*>(base);
+    m_records = static_cast<uint8_t*>(base) + HEADER_SIZE;
+    m_mappedLength = length;
+    return true;
+}
+
+void FrameCapture::close() {
+    if (!m_header) {
+        return;
+    }
+
+    uint64_t used = getUsedBytes();
+    uint64_t dropped = getDropped();
+    munmap(m_header, m_mappedLength);
+    m_header = nullptr;
+    m_records = nullptr;
+    m_capacity = 0;
+    m_mappedLength = 0;
+
+    if (m_fd < 0) {
+        return;
+    }
+
+    // Give back the unused allocation
+    if (ftruncate(m_fd, static_cast<off_t>(HEADER_SIZE + used)) != 0) {
+        LOG_WARN("Failed to trim frame capture: " + std::string(strerror(errno)));
+    }
+    ::close(m_fd);
+    m_fd = -1;
+
+    LOG_INFO("Frame capture closed: " + std::to_string(used) + " bytes" +
+             (dropped > 0 ? ", " + std::to_string(dropped) + " frames dropped once full" : ""));
+}
+
+bool FrameCapture::append(CaptureStream stream, uint8_t port, const uint8_t* data, size_t length) {
+    if (!m_header || length > UINT16_MAX) {
+        return false;
+    }
+
+    uint64_t timestampNs = clockNs(CLOCK_MONOTONIC);
+    uint32_t size = static_cast<uint32_t>((sizeof(CaptureRecord) + length + RECORD_ALIGN - 1) & ~(RECORD_ALIGN - 1));
+
+    uint64_t offset = __atomic_fetch_add(&m_header->writeOffset, size, __ATOMIC_RELAXED);
+    if (offset + size > m_capacity) {
+        __atomic_fetch_add(&m_header->dropped, 1, __ATOMIC_RELAXED);
+        return false;
+    }
+
+    // Fill, then publish - a reader stops at a size of 0
+    CaptureRecord* target = reinterpret_cast<CaptureRecord*>(m_records + offset);
+    target->stream = static_cast<uint8_t>(stream);
+    target->port = port;
+    target->length = static_cast<uint16_t>(length);
+    target->timestampNs = timestampNs;
+    memcpy(target + 1, data, length);
+    __atomic_store_n(&target->size, size, __ATOMIC_RELEASE);
+    return true;
+}
+
+bool FrameCapture::next(uint64_t& offset, CaptureRecord& record, const uint8_t*& payload) const {
+    if (!m_header || offset + sizeof(CaptureRecord) > getUsedBytes()) {
+        return false;
+    }
+
+    const CaptureRecord* source = reinterpret_cast<const CaptureRecord*>(m_records + offset);
+    uint32_t size = __atomic_load_n(&source->size, __ATOMIC_ACQUIRE);
+    if (size < sizeof(CaptureRecord) || size % RECORD_ALIGN != 0 || offset + size > getUsedBytes()) {
+        return false;
+    }
+
+    memcpy(&record, source, sizeof(CaptureRecord));
+    if (sizeof(CaptureRecord) + record.length > size) {
+        return false;
+    }
+
+    payload = reinterpret_cast<const uint8_t*>(source + 1);
+    offset += size;
+    return true;
+}
+
+uint64_t FrameCapture::getStartMonotonicNs() const {
+    return m_header ? m_header->startMonotonicNs : 0;
+}
+
+uint64_t FrameCapture::getStartRealtimeNs() const {
+    return m_header ? m_header->startRealtimeNs : 0;
+}
+
+uint64_t FrameCapture::getUsedBytes() const {
+    if (!m_header) {
+        return 0;
+    }
+
+    uint64_t used = __atomic_load_n(&m_header->writeOffset, __ATOMIC_ACQUIRE);
+    return used < m_capacity ? used : m_capacity;
+}
+
+uint64_t FrameCapture::getDropped() const {
+    return m_header ? __atomic_load_n(&m_header->dropped, __ATOMIC_RELAXED) : 0;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+// Link and direction a captured frame was seen on
+enum class CaptureStream : uint8_t {
+    ModemRx = 0,   // bytes as read from the modem link
+    ModemTx,       // one modem frame as written
+    NetworkRx,     // one datagram from the reflector, before any checks
+    NetworkTx      // one datagram to the reflector
+};
+
+// Captured frame header, followed by length payload bytes and padding to
+// 8 bytes. Host byte order.
+struct CaptureRecord {
+    uint32_t size;         // header + payload + padding; 0 while being written
+    uint8_t stream;        // CaptureStream
+    uint8_t port;          // modem index (modem streams), 0 for the network
+    uint16_t length;       // payload bytes
+    uint64_t timestampNs;  // CLOCK_MONOTONIC
+};
+
+static_assert(sizeof(CaptureRecord) == 16, "CaptureRecord is an on-disk format");
+
+// Append-only capture of every modem and network frame, for reproducing a
+// bad call offline with p25-replay. The file is allocated up front and
+// memory-mapped; writers reserve space with one atomic add on the shared
+// write offset and publish a record by storing its size last, so any I/O
+// thread appends without a lock or a syscall. Once full, further frames
+// are counted and dropped. close() trims the file to what was written.
+class FrameCapture {
+public:
+    static const uint64_t DEFAULT_CAPACITY = 64ULL << 20;
+
+    FrameCapture();
+    ~FrameCapture();
+
+    FrameCapture(const FrameCapture&) = delete;
+    FrameCapture& operator=(const FrameCapture&) = delete;
+
+    // Capture the daemon's frames go to (open() it to start capturing)
+    static FrameCapture& getInstance();
+
+    // Start a new capture of up to capacity bytes. An existing file is kept
+    // as path.1.
+    bool open(const std::string& path, uint64_t capacity);
+
+    // Map a finished (or crashed) capture read-only (replay tool)
+    bool openReadOnly(const std::string& path);
+
+    void close();
+
+    bool isOpen() const { return m_header != nullptr; }
+
+    // Lock-free; false if not open or full
+    bool append(CaptureStream stream, uint8_t port, const uint8_t* data, size_t length);
+
+    // Hook for the I/O paths - a branch when capture is off
+    static void record(CaptureStream stream, uint8_t port, const uint8_t* data, size_t length) {
+        FrameCapture& capture = getInstance();
+        if (capture.isOpen()) {
+            capture.append(stream, port, data, length);
+        }
+    }
+
+    // Walk the records: start with offset 0, false at the end of the
+    // capture. payload points into the mapping.
+    bool next(uint64_t& offset, CaptureRecord& record, const uint8_t*& payload) const;
+
+    // CLOCK_MONOTONIC and wall clock (ns since the epoch) when the capture started
+    uint64_t getStartMonotonicNs() const;
+    uint64_t getStartRealtimeNs() const;
+
+    uint64_t getUsedBytes() const;
+    uint64_t getCapacity() const { return m_capacity; }
+    uint64_t getDropped() const;
+
+private:
+    struct Header;
+
+    bool map(int fd, size_t length, bool writable);
+
+    Header* m_header;
+    uint8_t* m_records;
+    uint64_t m_capacity;
+    size_t m_mappedLength;
+    int m_fd;   // kept by a writer to trim the file on close
+};
@@ -0,0 +1,116 @@
+#include "FrameTrace.h"
+#include "Logger.h"
+#include <ctime>
+
+// Frame being traced on this thread
+struct TraceContext {
+    bool active = false;
+    CallDirection direction = CallDirection::RF;
+    uint64_t originNs = 0;
+    uint64_t lastNs = 0;
+};
+
+static thread_local TraceContext t_trace;
+
+static const char* const STAGE_NAMES[TRACE_STAGE_COUNT] = {"receive", "controller", "queue", "send", "total"};
+
+static std::string formatUs(uint64_t ns) {
+    return std::to_string(ns / 1000) + "." + std::to_string((ns % 1000) / 100);
+}
+
+FrameTrace& FrameTrace::getInstance() {
+    static FrameTrace instance;
+    return instance;
+}
+
+FrameTrace::FrameTrace()
+    : m_enabled(false)
+{
+}
+
+uint64_t FrameTrace::nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000 + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+void FrameTrace::begin(CallDirection direction, uint64_t originNs) {
+    if (originNs == 0) {
+        t_trace.active = false;
+        return;
+    }
+
+    t_trace.active = true;
+    t_trace.direction = direction;
+    t_trace.originNs = originNs;
+    t_trace.lastNs = originNs;
+}
+
+void FrameTrace::mark(TraceStage stage) {
+    if (!t_trace.active) {
+        return;
+    }
+
+    uint64_t now = nowNs();
+    getInstance().histogram(t_trace.direction, stage).record(now - t_trace.lastNs);
+    t_trace.lastNs = now;
+}
+
+bool FrameTrace::take(Stamp& stamp) {
+    if (!t_trace.active) {
+        stamp = {0, 0};
+        return false;
+    }
+
+    stamp.originNs = t_trace.originNs;
+    stamp.lastNs = t_trace.lastNs;
+    t_trace.active = false;
+    return true;
+}
+
+void FrameTrace::resume(CallDirection direction, const Stamp& stamp) {
+    t_trace.active = stamp.originNs != 0;
+    t_trace.direction = direction;
+    t_trace.originNs = stamp.originNs;
+    t_trace.lastNs = stamp.lastNs;
+}
+
+void FrameTrace::complete(CallDirection direction, const Stamp& stamp, uint64_t sendStartNs, uint64_t sendEndNs) {
+    if (stamp.originNs == 0) {
+        return;
+    }
+
+    FrameTrace& trace = getInstance();
+    trace.histogram(direction, TraceStage::Queue).record(sendStartNs - stamp.lastNs);
+    trace.histogram(direction, TraceStage::Send).record(sendEndNs - sendStartNs);
+    trace.histogram(direction, TraceStage::Total).record(sendEndNs - stamp.originNs);
+}
+
+void FrameTrace::abandon() {
+    t_trace.active = false;
+}
+
+LatencyHistogram::Summary FrameTrace::getSummary(CallDirection direction, TraceStage stage) const {
+    return m_histograms[static_cast<size_t>(direction)][static_cast<size_t>(stage)].getSummary();
+}
+
+void FrameTrace::logSummary() const {
+    if (!isEnabled()) {
+        return;
+    }
+
+    for (CallDirection direction : {CallDirection::RF, CallDirection::Network}) {
+        if (getSummary(direction, TraceStage::Total).count == 0) {
+            continue;
+        }
+
+        LOG_INFO(std::string(direction == CallDirection::RF ? "RF → network" : "Network → RF") +
+                 " latency, us (p50/p99/p99.9/max):");
+        for (size_t i = 0; i < TRACE_STAGE_COUNT; i++) {
+            LatencyHistogram::Summary summary = getSummary(direction, static_cast<TraceStage>(i));
+            LOG_INFO(std::string("  ") + STAGE_NAMES[i] + ": " + formatUs(summary.p50Ns) + " / " +
+                     formatUs(summary.p99Ns) + " / " + formatUs(summary.p999Ns) + " / " + formatUs(summary.maxNs) +
+                     " over " + std::to_string(summary.count) + " frames");
+        }
+    }
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "LatencyHistogram.h"
+#include "TrunkingState.h"
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+
+// Pipeline stages a relayed frame passes through, in order. For frames from
+// RF (CallDirection::RF):
+//   Receive     serial read returned → the framer has the whole frame
+//   Controller  framer → the controller hands it to the network client
+//   Queue       → send() starts (send lock, LDU bundling hold)
+//   Send        send() itself
+// and from the network:
+//   Receive     recv returned → length/rate checks done, dispatched
+//   Controller  dispatch → the modem write (filter, arbiter, concealer)
+//   Queue       → its batch starts on the link (behind another writer)
+//   Send        the link write itself
+// Total is first to last.
+enum class TraceStage : uint8_t {
+    Receive = 0,
+    Controller,
+    Queue,
+    Send,
+    Total
+};
+
+static const size_t TRACE_STAGE_COUNT = 5;
+
+// Per-frame latency tracing. A frame is stamped on the thread that received
+// it: begin() when its bytes arrived, mark() at each stage boundary. Where a
+// frame is handed to a queue, take() moves its stamps off the thread so they
+// travel with it, and complete() closes Queue, Send and Total once it is on
+// the wire. Each stage goes into a lock-free histogram per direction.
+//
+// The trace context is thread-local and inactive unless begin() ran on that
+// thread, so frames the daemon originates (TSBKs, concealment, polls) are
+// not traced.
+class FrameTrace {
+public:
+    // Stamps of a frame in flight
+    struct Stamp {
+        uint64_t originNs;   // arrival, 0 = not traced
+        uint64_t lastNs;     // end of the last stage recorded
+    };
+
+    static FrameTrace& getInstance();
+
+    void setEnabled(bool enabled) { m_enabled.store(enabled, std::memory_order_relaxed); }
+    bool isEnabled() const { return m_enabled.load(std::memory_order_relaxed); }
+
+    static uint64_t nowNs();
+
+    // Arrival time to pass to begin(), 0 while tracing is off
+    static uint64_t arrivalNs() { return getInstance().isEnabled() ? nowNs() : 0; }
+
+    // Start tracing a frame from direction on this thread (arrivalNs() of
+    // the read that delivered it)
+    static void begin(CallDirection direction, uint64_t originNs);
+
+    // Close stage for the frame traced on this thread
+    static void mark(TraceStage stage);
+
+    // Move the frame's stamps off this thread. False (and stamp cleared) if
+    // none is being traced.
+    static bool take(Stamp& stamp);
+
+    // Trace a taken frame on this thread again
+    static void resume(CallDirection direction, const Stamp& stamp);
+
+    // The frame left: Queue ran to sendStartNs, Send to sendEndNs
+    static void complete(CallDirection direction, const Stamp& stamp, uint64_t sendStartNs, uint64_t sendEndNs);
+
+    // Frame handled without reaching the far side (dropped, not forwarded)
+    static void abandon();
+
+    LatencyHistogram::Summary getSummary(CallDirection direction, TraceStage stage) const;
+    void logSummary() const;
+
+private:
+    FrameTrace();
+    FrameTrace(const FrameTrace&) = delete;
+    FrameTrace& operator=(const FrameTrace&) = delete;
+
+    LatencyHistogram& histogram(CallDirection direction, TraceStage stage) {
+        return m_histograms[static_cast<size_t>(direction)][static_cast<size_t>(stage)];
+    }
+
+    std::atomic<bool> m_enabled;
+    LatencyHistogram m_histograms[2][TRACE_STAGE_COUNT];
+};
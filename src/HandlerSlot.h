@@ -0,0 +1,89 @@
+#pragma once
+
+#include "P25Frame.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Handler that can be (re)published while an I/O thread is calling it.
+//
+// A handler is an immutable block holding a plain function pointer and its
+// context, published through one atomic pointer - invoking it is an acquire
+// load and a direct call, with no lock and no std::function. Blocks are never
+// freed while the slot lives (a reader may still be inside one) and are
+// reused when the same handler is published again, so start/stop cycles do
+// not grow the list.
+template <typename... Args>
+class HandlerSlot {
+public:
+    using Function = void (*)(void* context, Args...);
+
+    HandlerSlot() : m_current(nullptr) {}
+
+    HandlerSlot(const HandlerSlot&) = delete;
+    HandlerSlot& operator=(const HandlerSlot&) = delete;
+
+    void publish(Function function, void* context) {
+        std::lock_guard<std::mutex> lock(m_publishMutex);
+
+        const Block* block = nullptr;
+        for (const auto& existing : m_blocks) {
+            if (existing->function == function && existing->context == context) {
+                block = existing.get();
+                break;
+            }
+        }
+        if (!block) {
+            m_blocks.emplace_back(new Block{function, context});
+            block = m_blocks.back().get();
+        }
+
+        m_current.store(block, std::memory_order_release);
+    }
+
+    // Publish object->Method. The trampoline is generated per method, so the
+    // method body can be inlined into it.
+    template <typename T, void (T::*Method)(Args...)>
+    void bind(T* object) {
+        publish(&trampoline<T, Method>, object);
+    }
+
+    // Calls already in progress finish against the old handler
+    void clear() { m_current.store(nullptr, std::memory_order_release); }
+
+    bool isSet() const { return m_current.load(std::memory_order_relaxed) != nullptr; }
+
+    // False if no handler is published
+    bool operator()(Args... args) const {
+        const Block* block = m_current.load(std::memory_order_acquire);
+        if (!block) {
+            return false;
+        }
+        block->function(block->context, args...);
+        return true;
+    }
+
+private:
+    struct Block {
+        Function function;
+        void* context;
+    };
+
+    template <typename T, void (T::*Method)(Args...)>
+    static void trampoline(void* context, Args... args) {
+        (static_cast<T*>(context)->*Method)(args...);
+    }
+
+    std::atomic<const Block*> m_current;
+    std::mutex m_publishMutex;
+    std::vector<std::unique_ptr<Block>> m_blocks;
+};
+
+// Compile-time binding of object->Method for the templated I/O loops - the
+// call is direct, so the whole handler can be inlined into the loop
+template <typename T, void (T::*Method)(const P25FrameView&)>
+struct StaticFrameHandler {
+    T* object;
+    void operator()(const P25FrameView& frame) const { (object->*Method)(frame); }
+};
@@ -0,0 +1,483 @@
+#include "Handoff.h"
+#include "StateImage.h"
+#include "Logger.h"
+#include "Clock.h"
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
+static const char HANDOFF_MAGIC[8] = {'P', '2', '5', 'H', 'O', 'F', 'F', 1};
+
+// Bumped whenever the state image changes shape
+static const uint32_t HANDOFF_VERSION = 1;
+
+// Message types, in the order they are exchanged
+static const uint8_t MSG_REQUEST = 1;   // new → running: hand me the site
+static const uint8_t MSG_STATE = 2;     // running → new: descriptors and state image
+static const uint8_t MSG_READY = 3;     // new → running: adopted, waiting to start
+static const uint8_t MSG_REFUSED = 4;   // new → running: can't use it, carry on
+static const uint8_t MSG_GO = 5;        // running → new: let go, start reading
+
+// The reflector socket plus one link per modem
+static const size_t MAX_DESCRIPTORS = 32;
+
+// Voice comes in 180 ms LDUs - forwarding should pick up within one
+static const uint64_t LDU_PERIOD_MS = 180;
+
+// Accept wakes this often to notice close()
+static const int ACCEPT_TIMEOUT_MS = 100;
+
+struct HandoffHeader {
+    char magic[8];
+    uint32_t version;
+    uint8_t type;
+    uint8_t descriptors;    // passed along with this message
+    uint16_t reserved;
+    uint32_t imageLength;   // state image bytes that follow
+    uint64_t suspendedNs;   // CLOCK_MONOTONIC when the running process stopped its I/O
+};
+
+static void setTimeout(int socket, int option, int ms) {
+    struct timeval tv;
+    tv.tv_sec = ms / 1000;
+    tv.tv_usec = (ms % 1000) * 1000;
+    setsockopt(socket, SOL_SOCKET, option, &tv, sizeof(tv));
+}
+
+static bool socketAddress(const std::string& path, struct sockaddr_un& addr) {
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        LOG_ERROR("Handoff socket path too long: " + path);
+        return false;
+    }
+    memcpy(addr.sun_path, path.c_str(), path.size());
+    return true;
+}
+
+static bool sendAll(int fd, const uint8_t* data, size_t length) {
+    while (length > 0) {
+        ssize_t sent = send(fd, data, length, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += sent;
+        length -= static_cast<size_t>(sent);
+    }
+    return true;
+}
+
+static bool receiveAll(int fd, uint8_t* data, size_t length) {
+    while (length > 0) {
+        ssize_t received = recv(fd, data, length, 0);
+        if (received <= 0) {
+            if (received < 0 && errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += received;
+        length -= static_cast<size_t>(received);
+    }
+    return true;
+}
+
+// Header with the descriptors attached, then the image
+static bool sendMessage(int fd, uint8_t type, const StateImage* image = nullptr,
+                        const std::vector<int>& descriptors = std::vector<int>(), uint64_t suspendedNs = 0) {
+    HandoffHeader header = {};
+    memcpy(header.magic, HANDOFF_MAGIC, sizeof(HANDOFF_MAGIC));
+    header.version = HANDOFF_VERSION;
+    header.type = type;
+    header.descriptors = static_cast<uint8_t>(descriptors.size());
+    header.imageLength = image ? static_cast<uint32_t>(image->size()) : 0;
+    header.suspendedNs = suspendedNs;
+
+    struct iovec iov = {&header, sizeof(header)};
+    alignas(struct cmsghdr) uint8_t control[CMSG_SPACE(sizeof(int) * MAX_DESCRIPTORS)];
+    struct msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+
+    if (!descriptors.empty()) {
+        size_t length = sizeof(int) * descriptors.size();
+        msg.msg_control = control;
+        msg.msg_controllen = CMSG_SPACE(length);
+        struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(length);
+        memcpy(CMSG_DATA(cmsg), descriptors.data(), length);
+    }
+
+    if (sendmsg(fd, &msg, MSG_NOSIGNAL) != static_cast<ssize_t>(sizeof(header))) {
+        return false;
+    }
+    return !image || sendAll(fd, image->data(), image->size());
+}
+
+// Descriptors that arrive are returned even if the message turns out bad,
+// so the caller can close them
+static bool receiveMessage(int fd, HandoffHeader& header, StateImage* image, std::vector<int>& descriptors) {
+    struct iovec iov = {&header, sizeof(header)};
+    alignas(struct cmsghdr) uint8_t control[CMSG_SPACE(sizeof(int) * MAX_DESCRIPTORS)];
+    struct msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    ssize_t received = recvmsg(fd, &msg, MSG_WAITALL | MSG_CMSG_CLOEXEC);
+
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); received > 0 && cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+            size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            for (size_t i = 0; i < count; i++) {
+                int descriptor;
+                memcpy(&descriptor, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+                descriptors.push_back(descriptor);
+            }
+        }
+    }
+
+    if (received != static_cast<ssize_t>(sizeof(header)) || (msg.msg_flags & MSG_CTRUNC) ||
+        memcmp(header.magic, HANDOFF_MAGIC, sizeof(HANDOFF_MAGIC)) != 0 || header.version != HANDOFF_VERSION ||
+        header.descriptors != descriptors.size()) {
+        return false;
+    }
+
+    if (header.imageLength == 0) {
+        return true;
+    }
+    if (!image) {
+        return false;
+    }
+
+    std::vector<uint8_t> bytes(header.imageLength);
+    if (!receiveAll(fd, bytes.data(), bytes.size())) {
+        return false;
+    }
+    image->assign(bytes.data(), bytes.size());
+    return true;
+}
+
+static bool receiveType(int fd, uint8_t type) {
+    HandoffHeader header;
+    std::vector<int> descriptors;
+    bool ok = receiveMessage(fd, header, nullptr, descriptors) && header.type == type;
+    for (int descriptor : descriptors) {
+        ::close(descriptor);
+    }
+    return ok;
+}
+
+Handoff::Handoff(const HandoffConfig& config, const Modems& modems, std::shared_ptr<NetworkClient> network,
+                 std::shared_ptr<TrunkingController> controller)
+    : m_config(config)
+    , m_modems(modems)
+    , m_network(network)
+    , m_controller(controller)
+    , m_listenSocket(-1)
+    , m_peer(-1)
+    , m_socketInode(0)
+    , m_running(false)
+    , m_requested(false)
+{
+}
+
+Handoff::~Handoff() {
+    close();
+}
+
+bool Handoff::listen(std::function<void()> onRequest) {
+    struct sockaddr_un addr;
+    if (m_config.socket.empty() || !socketAddress(m_config.socket, addr)) {
+        return false;
+    }
+
+    m_listenSocket = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (m_listenSocket < 0) {
+        LOG_ERROR("Failed to create handoff socket");
+        return false;
+    }
+
+    // A socket left there belongs to a crashed run, or to the process this
+    // one just took over from - either way it is ours now
+    unlink(m_config.socket.c_str());
+
+    // Whoever connects gets the modem and the reflector link - owner only
+    mode_t mask = umask(0077);
+    int bound = bind(m_listenSocket, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr));
+    umask(mask);
+
+    struct stat st;
+    if (bound < 0 || ::listen(m_listenSocket, 1) < 0 || stat(m_config.socket.c_str(), &st) != 0) {
+        LOG_ERROR("Failed to listen on handoff socket " + m_config.socket + ": " + std::string(strerror(errno)));
+        ::close(m_listenSocket);
+        m_listenSocket = -1;
+        return false;
+    }
+    m_socketInode = static_cast<uint64_t>(st.st_ino);
+
+    setTimeout(m_listenSocket, SO_RCVTIMEO, ACCEPT_TIMEOUT_MS);
+
+    m_running = true;
+    m_acceptThread = std::thread([this, onRequest]() {
+        acceptLoop(onRequest);
+    });
+
+    LOG_INFO("Accepting takeover requests on " + m_config.socket);
+    return true;
+}
+
+void Handoff::close() {
+    m_running = false;
+    if (m_acceptThread.joinable()) {
+        m_acceptThread.join();
+    }
+
+    if (m_listenSocket >= 0) {
+        ::close(m_listenSocket);
+        m_listenSocket = -1;
+
+        // Leave a newer process's socket alone
+        struct stat st;
+        if (stat(m_config.socket.c_str(), &st) == 0 && static_cast<uint64_t>(st.st_ino) == m_socketInode) {
+            unlink(m_config.socket.c_str());
+        }
+    }
+
+    if (m_peer >= 0) {
+        ::close(m_peer);
+        m_peer = -1;
+    }
+    m_requested = false;
+}
+
+void Handoff::acceptLoop(std::function<void()> onRequest) {
+    while (m_running) {
+        int peer = accept4(m_listenSocket, nullptr, nullptr, SOCK_CLOEXEC);
+        if (peer < 0) {
+            continue;
+        }
+
+        // One takeover at a time, and only by our own user (or root)
+        struct ucred credentials;
+        socklen_t length = sizeof(credentials);
+        bool trusted = getsockopt(peer, SOL_SOCKET, SO_PEERCRED, &credentials, &length) == 0 &&
+                       (credentials.uid == getuid() || credentials.uid == 0);
+
+        setTimeout(peer, SO_RCVTIMEO, m_config.timeout_ms);
+        setTimeout(peer, SO_SNDTIMEO, m_config.timeout_ms);
+
+        if (!trusted || m_requested || !receiveType(peer, MSG_REQUEST)) {
+            LOG_WARN("Ignored takeover request" + std::string(trusted ? "" : " from another user"));
+            ::close(peer);
+            continue;
+        }
+
+        LOG_INFO("Takeover requested by process " + std::to_string(credentials.pid));
+        m_peer = peer;
+        m_requested = true;
+        onRequest();
+    }
+}
+
+void Handoff::suspendSite() {
+    // Let every reader wind down at once, then wait for them
+    m_network->stopReading();
+    for (auto& modem : m_modems) {
+        modem->stopReading();
+    }
+    m_network->suspend();
+    for (auto& modem : m_modems) {
+        modem->suspend();
+    }
+
+    // Nothing arrives any more - stop the timers that act on the links
+    if (m_controller) {
+        m_controller->suspend();
+    }
+}
+
+bool Handoff::startSite() {
+    // The controller takes frames from the first one read
+    if (m_controller) {
+        m_controller->start();
+    }
+
+    bool started = true;
+    for (size_t i = 0; i < m_modems.size(); i++) {
+        started = (m_controller ? m_modems[i]->resume(m_controller->getModemSink(i)) : m_modems[i]->resume()) && started;
+    }
+    started = (m_controller ? m_network->resume(m_controller->getNetworkSink()) : m_network->resume()) && started;
+    return started;
+}
+
+void Handoff::detachSite() {
+    m_network->detach();
+    for (auto& modem : m_modems) {
+        modem->detach();
+    }
+}
+
+bool Handoff::handOver() {
+    if (!m_requested || m_peer < 0) {
+        return false;
+    }
+
+    LOG_INFO("Handing the site over...");
+    uint64_t suspendedNs = Clock::get().monotonicNs();
+    suspendSite();
+
+    StateImage image;
+    image.put(static_cast<uint32_t>(m_modems.size()));
+    image.put(m_controller != nullptr);
+    m_network->saveState(image);
+    for (auto& modem : m_modems) {
+        modem->saveState(image);
+    }
+    if (m_controller) {
+        m_controller->saveState(image);
+    }
+
+    std::vector<int> descriptors;
+    descriptors.push_back(m_network->getDescriptor());
+    for (auto& modem : m_modems) {
+        descriptors.push_back(modem->getDescriptor());
+    }
+
+    bool passable = descriptors.size() <= MAX_DESCRIPTORS;
+    for (int descriptor : descriptors) {
+        passable = passable && descriptor >= 0;
+    }
+    if (!passable) {
+        LOG_ERROR("A link of this site can't be handed over");
+    }
+
+    // The new process only starts reading on MSG_GO, and we only send it
+    // once it has everything - so both never read the same link
+    bool handedOver = passable &&
+        sendMessage(m_peer, MSG_STATE, &image, descriptors, suspendedNs) &&
+        receiveType(m_peer, MSG_READY) &&
+        sendMessage(m_peer, MSG_GO);
+
+    ::close(m_peer);
+    m_peer = -1;
+    m_requested = false;
+
+    if (!handedOver) {
+        LOG_WARN("New process did not take over - resuming");
+        if (!startSite()) {
+            LOG_ERROR("Failed to resume the site");
+        }
+        return false;
+    }
+
+    detachSite();
+    LOG_INFO("✓ Site handed over (" + std::to_string(image.size()) + " bytes of state)");
+    return true;
+}
+
+bool Handoff::takeOver() {
+    struct sockaddr_un addr;
+    if (m_config.socket.empty()) {
+        LOG_ERROR("No handoff socket configured");
+        return false;
+    }
+    if (!socketAddress(m_config.socket, addr)) {
+        return false;
+    }
+
+    int peer = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (peer < 0 || connect(peer, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0) {
+        LOG_ERROR("No running process to take over at " + m_config.socket + ": " + std::string(strerror(errno)));
+        if (peer >= 0) {
+            ::close(peer);
+        }
+        return false;
+    }
+
+    // The running process stops its readers first - up to one read timeout each
+    setTimeout(peer, SO_RCVTIMEO, m_config.timeout_ms);
+    setTimeout(peer, SO_SNDTIMEO, m_config.timeout_ms);
+
+    LOG_INFO("Requesting the site from the running process...");
+    HandoffHeader header;
+    StateImage image;
+    std::vector<int> descriptors;
+    bool ok = sendMessage(peer, MSG_REQUEST) && receiveMessage(peer, header, &image, descriptors) &&
+              header.type == MSG_STATE;
+    if (!ok) {
+        LOG_ERROR("Running process did not hand the site over");
+    }
+
+    uint32_t modemCount = 0;
+    bool hasController = false;
+    if (ok && (!image.get(modemCount) || !image.get(hasController) || modemCount != m_modems.size() ||
+               hasController != (m_controller != nullptr) || descriptors.size() != modemCount + 1)) {
+        LOG_ERROR("Running process has " + std::to_string(modemCount) + " modems, this config " +
+                  std::to_string(m_modems.size()));
+        ok = false;
+    }
+
+    // State first - a mismatch leaves the links untouched
+    ok = ok && m_network->restoreState(image);
+    for (auto& modem : m_modems) {
+        ok = ok && modem->restoreState(image);
+    }
+    if (m_controller) {
+        ok = ok && m_controller->restoreState(image);
+    }
+    if (ok && !image.ok()) {
+        LOG_ERROR("Handoff state is from an incompatible build");
+        ok = false;
+    }
+
+    ok = ok && m_network->adopt(descriptors[0]);
+    for (size_t i = 0; i < m_modems.size(); i++) {
+        ok = ok && m_modems[i]->adopt(descriptors[i + 1]);
+    }
+
+    if (ok) {
+        ok = sendMessage(peer, MSG_READY) && receiveType(peer, MSG_GO);
+        if (!ok) {
+            LOG_ERROR("Running process kept the site");
+        }
+    } else {
+        sendMessage(peer, MSG_REFUSED);
+    }
+    ::close(peer);
+
+    if (!ok) {
+        // Our copies only - the running process still has the links
+        for (size_t i = 0; i < descriptors.size(); i++) {
+            if (i == 0 && m_network->getDescriptor() == descriptors[0]) {
+                m_network->detach();
+            } else if (i > 0 && i <= m_modems.size() && m_modems[i - 1]->getDescriptor() == descriptors[i]) {
+                m_modems[i - 1]->detach();
+            } else {
+                ::close(descriptors[i]);
+            }
+        }
+        return false;
+    }
+
+    if (!startSite()) {
+        LOG_ERROR("Failed to start the taken-over site");
+        return false;
+    }
+
+    uint64_t idleMs = (Clock::get().monotonicNs() - header.suspendedNs) / 1000000;
+    if (idleMs > LDU_PERIOD_MS) {
+        LOG_WARN("Links were idle for " + std::to_string(idleMs) + " ms during the takeover");
+    }
+    LOG_INFO("✓ Took over the site - links idle for " + std::to_string(idleMs) + " ms");
+    return true;
+}
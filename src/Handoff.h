@@ -0,0 +1,78 @@
+#pragma once
+
+#include "Config.h"
+#include "ModemSerial.h"
+#include "NetworkClient.h"
+#include "TrunkingController.h"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Zero-downtime upgrade. The running process listens on a Unix socket; a
+// new process started with --takeover connects, and the running one stops
+// its I/O threads, passes the open modem links and reflector socket over
+// with SCM_RIGHTS along with the link, call and trunking state, and exits
+// once the new process has them. Nothing is closed, reconfigured or
+// re-authenticated: the modem stays in its mode, the reflector sees the
+// same socket, and whatever arrives in between waits in the kernel.
+//
+// The new process confirms it adopted everything before the running one
+// lets go, and only starts reading once told to, so exactly one process
+// drives the links at any time. If the new process refuses (a different
+// modem line-up or reflector in its config) or does not answer in time,
+// the running one resumes where it stopped.
+class Handoff {
+public:
+    using Modems = std::vector<std::shared_ptr<ModemSerial>>;
+
+    // controller is null in network-only mode
+    Handoff(const HandoffConfig& config, const Modems& modems, std::shared_ptr<NetworkClient> network,
+            std::shared_ptr<TrunkingController> controller);
+    ~Handoff();
+
+    Handoff(const Handoff&) = delete;
+    Handoff& operator=(const Handoff&) = delete;
+
+    // Running process: accept takeover requests. onRequest runs on the
+    // accept thread - wake the main thread and call handOver() from there.
+    bool listen(std::function<void()> onRequest);
+
+    // Stop listening. The socket file is removed unless a newer process
+    // has bound its own there.
+    void close();
+
+    bool isRequested() const { return m_requested.load(); }
+
+    // Give the site to the process that asked. True once it took over -
+    // the links are detached and this process should exit. False with
+    // everything running again otherwise.
+    bool handOver();
+
+    // New process: take the site over from the running one, instead of
+    // opening the modems and starting the network. Starts the controller.
+    bool takeOver();
+
+private:
+    void acceptLoop(std::function<void()> onRequest);
+
+    // Stop reading and acting on the links, start again (here or in the
+    // new process), or let go of them
+    void suspendSite();
+    bool startSite();
+    void detachSite();
+
+    const HandoffConfig& m_config;
+    Modems m_modems;
+    std::shared_ptr<NetworkClient> m_network;
+    std::shared_ptr<TrunkingController> m_controller;
+
+    int m_listenSocket;
+    int m_peer;               // connection of the process taking over
+    uint64_t m_socketInode;   // of the socket file we bound
+    std::atomic<bool> m_running;
+    std::atomic<bool> m_requested;
+    std::thread m_acceptThread;
+};
@@ -0,0 +1,131 @@
+#include "IngressGuard.h"
+#include "LduBundler.h"
+#include "Logger.h"
+
+// Voice records: type byte plus at least the IMBE frame. The largest the
+// reflector sends is 22 bytes; leave room without accepting junk.
+static const uint8_t VOICE_MIN_LENGTH = 1 + IMBE_FRAME_LENGTH;
+static const uint16_t VOICE_MAX_LENGTH = 32;
+
+// Short control records (poll, unlink, EOT) may carry a callsign or padding
+static const uint16_t SHORT_MAX_LENGTH = 32;
+
+// Grant/release/auth: a few bytes of fields
+static const uint16_t CONTROL_MAX_LENGTH = 8;
+
+// While a class is being limited, warn at most this often
+static const uint64_t WARN_INTERVAL_MS = 10000;
+
+IngressGuard::IngressGuard(const ReflectorConfig& config)
+    : m_lengths()
+    , m_buckets()
+    , m_unknown(0)
+    , m_malformed(0)
+    , m_rateLimited()
+{
+    for (uint8_t t = FRAME_LDU1_0; t <= FRAME_LDU2_8; t++) {
+        m_lengths[t] = {VOICE_MIN_LENGTH, VOICE_MAX_LENGTH, Bucket::Voice};
+    }
+    m_lengths[FRAME_EOT] = {1, SHORT_MAX_LENGTH, Bucket::Voice};
+    m_lengths[FRAME_LDU_BUNDLE] = {LduBundler::HEADER_SIZE + 1 + VOICE_MIN_LENGTH, LduBundler::CAPACITY, Bucket::Voice};
+    m_lengths[FRAME_TSBK] = {TSBK_LENGTH, TSBK_LENGTH, Bucket::Tsbk};
+    m_lengths[FRAME_POLL] = {1, SHORT_MAX_LENGTH, Bucket::Control};
+    m_lengths[FRAME_UNLINK] = {1, SHORT_MAX_LENGTH, Bucket::Control};
+    m_lengths[FRAME_AUTH_RESPONSE] = {2, CONTROL_MAX_LENGTH, Bucket::Control};
+    m_lengths[FRAME_TG_GRANT] = {3, CONTROL_MAX_LENGTH, Bucket::Control};
+    m_lengths[FRAME_TG_RELEASE] = {3, CONTROL_MAX_LENGTH, Bucket::Control};
+
+    // One second of burst at the configured rate
+    const int rates[BUCKET_COUNT] = {config.ingress_voice_rate, config.ingress_tsbk_rate, config.ingress_control_rate};
+    for (size_t i = 0; i < BUCKET_COUNT; i++) {
+        uint64_t rate = rates[i] > 0 ? static_cast<uint64_t>(rates[i]) : 0;
+        m_buckets[i].perMs = rate;
+        m_buckets[i].capacity = rate * 1000;
+        m_buckets[i].tokens = m_buckets[i].capacity;
+        m_rateLimited[i] = 0;
+    }
+}
+
+IngressGuard::Verdict IngressGuard::admit(const P25FrameView& frame, uint64_t nowMs) {
+    const LengthRange& range = m_lengths[frame.frameType()];
+    if (range.minLength == 0) {
+        m_unknown.fetch_add(1, std::memory_order_relaxed);
+        return Verdict::Unknown;
+    }
+
+    if (frame.size() < range.minLength || frame.size() > range.maxLength) {
+        countMalformed();
+        return Verdict::Malformed;
+    }
+
+    // A bundle is paid for record by record as it is unbundled
+    if (frame.frameType() == FRAME_LDU_BUNDLE) {
+        return Verdict::Accept;
+    }
+
+    return take(range.bucket, nowMs) ? Verdict::Accept : Verdict::RateLimited;
+}
+
+IngressGuard::Verdict IngressGuard::admitBundled(const P25FrameView& record, uint64_t nowMs) {
+    if (!P25Protocol::isVoiceFrame(record.frameType())) {
+        countMalformed();
+        return Verdict::Malformed;
+    }
+    return admit(record, nowMs);
+}
+
+bool IngressGuard::take(Bucket bucket, uint64_t nowMs) {
+    TokenBucket& tb = m_buckets[static_cast<size_t>(bucket)];
+    if (tb.capacity == 0) {
+        return true;
+    }
+
+    if (nowMs > tb.lastMs) {
+        uint64_t refill = (nowMs - tb.lastMs) * tb.perMs;
+        tb.tokens = (tb.capacity - tb.tokens) > refill ? tb.tokens + refill : tb.capacity;
+        tb.lastMs = nowMs;
+    }
+
+    if (tb.tokens >= 1000) {
+        tb.tokens -= 1000;
+        tb.limiting = false;
+        return true;
+    }
+
+    m_rateLimited[static_cast<size_t>(bucket)].fetch_add(1, std::memory_order_relaxed);
+    if (!tb.limiting && nowMs - tb.lastWarnMs >= WARN_INTERVAL_MS) {
+        tb.lastWarnMs = nowMs;
+        LOG_WARNF("Reflector %s traffic over %llu frames/s - dropping", bucketName(bucket),
+                  static_cast<unsigned long long>(tb.perMs));
+    }
+    tb.limiting = true;
+    return false;
+}
+
+IngressGuard::Stats IngressGuard::getStats() const {
+    Stats stats;
+    stats.unknown = m_unknown.load(std::memory_order_relaxed);
+    stats.malformed = m_malformed.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < BUCKET_COUNT; i++) {
+        stats.rateLimited[i] = m_rateLimited[i].load(std::memory_order_relaxed);
+    }
+    return stats;
+}
+
+uint64_t IngressGuard::getTotalDropped() const {
+    Stats stats = getStats();
+    uint64_t total = stats.unknown + stats.malformed;
+    for (size_t i = 0; i < BUCKET_COUNT; i++) {
+        total += stats.rateLimited[i];
+    }
+    return total;
+}
+
+const char* IngressGuard::bucketName(Bucket bucket) {
+    switch (bucket) {
+        case Bucket::Voice: return "voice";
+        case Bucket::Tsbk: return "TSBK";
+        case Bucket::Control: return "control";
+        default: return "unknown";
+    }
+}
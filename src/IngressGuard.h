@@ -0,0 +1,82 @@
+#pragma once
+
+#include "Config.h"
+#include "P25Protocol.h"
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+// First stop for every datagram from the reflector, ahead of dispatch. A
+// record whose length is impossible for its type byte is rejected with one
+// table lookup, and each traffic class (voice, TSBK, control) draws from its
+// own token bucket so a flooding reflector cannot starve the RF path of CPU.
+// Receive thread only, apart from the counters.
+class IngressGuard {
+public:
+    enum class Verdict : uint8_t {
+        Accept = 0,
+        Unknown,     // type byte we have no handler for
+        Malformed,   // length out of range for the type
+        RateLimited
+    };
+
+    // Rate-limited traffic classes
+    enum class Bucket : uint8_t {
+        Voice = 0,   // LDU1/LDU2/EOT records, bundled or not
+        Tsbk,
+        Control,     // poll, auth, grant/release, unlink
+        Count
+    };
+
+    static const size_t BUCKET_COUNT = static_cast<size_t>(Bucket::Count);
+
+    struct Stats {
+        uint64_t unknown;
+        uint64_t malformed;
+        uint64_t rateLimited[BUCKET_COUNT];
+    };
+
+    explicit IngressGuard(const ReflectorConfig& config);
+
+    // Check one record (or a bundle as a whole - its records are checked
+    // again as they are unbundled)
+    Verdict admit(const P25FrameView& frame, uint64_t nowMs);
+
+    // A record out of an admitted bundle - only LDU records belong there
+    Verdict admitBundled(const P25FrameView& record, uint64_t nowMs);
+
+    // A bundle that failed to unbundle
+    void countMalformed() { m_malformed.fetch_add(1, std::memory_order_relaxed); }
+
+    Stats getStats() const;
+    uint64_t getTotalDropped() const;
+
+    static const char* bucketName(Bucket bucket);
+
+private:
+    struct LengthRange {
+        uint8_t minLength;   // 0 = type not accepted
+        uint16_t maxLength;
+        Bucket bucket;
+    };
+
+    // Tokens are kept in thousandths so whole-millisecond refills stay exact
+    struct TokenBucket {
+        uint64_t capacity;   // milli-tokens, 0 = unlimited
+        uint64_t perMs;      // milli-tokens added per ms (= frames per second)
+        uint64_t tokens;
+        uint64_t lastMs;
+        bool limiting;       // dropping since the last warning
+        uint64_t lastWarnMs;
+    };
+
+    bool take(Bucket bucket, uint64_t nowMs);
+
+    std::array<LengthRange, 256> m_lengths;
+    TokenBucket m_buckets[BUCKET_COUNT];
+
+    std::atomic<uint64_t> m_unknown;
+    std::atomic<uint64_t> m_malformed;
+    std::atomic<uint64_t> m_rateLimited[BUCKET_COUNT];
+};
@@ -0,0 +1,109 @@
+#include "LatencyHistogram.h"
+
+LatencyHistogram::LatencyHistogram()
+    : m_count(0)
+    , m_max(0)
+{
+    for (auto& count : m_counts) {
+        count.store(0, std::memory_order_relaxed);
+    }
+}
+
+size_t LatencyHistogram::indexOf(uint64_t ns) {
+    if (ns < SUB_COUNT) {
+        return static_cast<size_t>(ns);
+    }
+
+    // Top bit of ns at position msb: keep SUB_BITS bits of it, the shift
+    // picks the power of two
+    unsigned msb = 63 - static_cast<unsigned>(__builtin_clzll(ns));
+    if (msb >= MAX_BITS) {
+        return BUCKETS - 1;
+    }
+    unsigned shift = msb - (SUB_BITS - 1);
+    return static_cast<size_t>(shift) * HALF_COUNT + static_cast<size_t>(ns >> shift);
+}
+
+uint64_t LatencyHistogram::highestValueOf(size_t index) {
+    if (index < SUB_COUNT) {
+        return index;
+    }
+
+    unsigned shift = static_cast<unsigned>(index / HALF_COUNT) - 1;
+    uint64_t sub = index - static_cast<uint64_t>(shift) * HALF_COUNT;
+    return ((sub + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(uint64_t ns) {
+    m_counts[indexOf(ns)].fetch_add(1, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t max = m_max.load(std::memory_order_relaxed);
+    while (ns > max && !m_max.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {
+    }
+}
+
+uint64_t LatencyHistogram::getPercentile(double quantile) const {
+    uint64_t total = getCount();
+    if (total == 0) {
+        return 0;
+    }
+
+    uint64_t rank = static_cast<uint64_t>(quantile * static_cast<double>(total) + 0.5);
+    if (rank == 0) {
+        rank = 1;
+    }
+
+    uint64_t seen = 0;
+    size_t i = 0;
+    for (; i < BUCKETS - 1; i++) {
+        seen += m_counts[i].load(std::memory_order_relaxed);
+        if (seen >= rank) {
+            break;
+        }
+    }
+
+    // Bucket bounds can overshoot the largest value actually seen
+    uint64_t max = m_max.load(std::memory_order_relaxed);
+    uint64_t value = highestValueOf(i);
+    return value < max ? value : max;
+}
+
+LatencyHistogram::Summary LatencyHistogram::getSummary() const {
+    Summary summary = {};
+
+    // Sum the counters rather than trusting m_count, so a record racing
+    // this pass can't push a rank past the end
+    uint64_t counts[BUCKETS];
+    for (size_t i = 0; i < BUCKETS; i++) {
+        counts[i] = m_counts[i].load(std::memory_order_relaxed);
+        summary.count += counts[i];
+    }
+    summary.maxNs = m_max.load(std::memory_order_relaxed);
+    if (summary.count == 0) {
+        return summary;
+    }
+
+    const double quantiles[3] = {0.50, 0.99, 0.999};
+    uint64_t* results[3] = {&summary.p50Ns, &summary.p99Ns, &summary.p999Ns};
+    size_t next = 0;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKETS && next < 3; i++) {
+        seen += counts[i];
+        while (next < 3) {
+            uint64_t rank = static_cast<uint64_t>(quantiles[next] * static_cast<double>(summary.count) + 0.5);
+            if (seen < (rank == 0 ? 1 : rank)) {
+                break;
+            }
+            *results[next++] = highestValueOf(i);
+        }
+    }
+
+    // Bucket bounds can overshoot the largest value actually seen
+    for (uint64_t* result : results) {
+        if (*result > summary.maxNs) {
+            *result = summary.maxNs;
+        }
+    }
+    return summary;
+}
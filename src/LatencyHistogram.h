@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+
+// Nanosecond latencies in the HdrHistogram layout: values below 2^SUB_BITS
+// are counted exactly, above that every power of two is split into
+// 2^(SUB_BITS-1) linear sub-buckets, so any value is resolved to within
+// 1/16 (about 3 %) up to 2^MAX_BITS ns (~68 s). Larger values land in the
+// top bucket.
+//
+// record() is two relaxed atomic operations and takes no lock, so any
+// thread may record while another reads; a reader sees each counter
+// exactly, if not all of them from the same instant.
+class LatencyHistogram {
+public:
+    static const unsigned SUB_BITS = 5;
+    static const unsigned MAX_BITS = 36;
+
+    struct Summary {
+        uint64_t count;
+        uint64_t p50Ns;
+        uint64_t p99Ns;
+        uint64_t p999Ns;
+        uint64_t maxNs;
+    };
+
+    LatencyHistogram();
+
+    void record(uint64_t ns);
+
+    // Highest value equivalent to the given quantile (0-1), 0 if empty
+    uint64_t getPercentile(double quantile) const;
+
+    // p50/p99/p99.9 from one pass over the counters
+    Summary getSummary() const;
+
+    uint64_t getCount() const { return m_count.load(std::memory_order_relaxed); }
+
+private:
+    static const unsigned SUB_COUNT = 1u << SUB_BITS;
+    static const unsigned HALF_COUNT = SUB_COUNT / 2;
+    static const size_t BUCKETS = (MAX_BITS - SUB_BITS) * HALF_COUNT + SUB_COUNT;
+
+    static size_t indexOf(uint64_t ns);
+    static uint64_t highestValueOf(size_t index);
+
+    std::atomic<uint64_t> m_counts[BUCKETS];
+    std::atomic<uint64_t> m_count;
+    std::atomic<uint64_t> m_max;
+};
@@ -0,0 +1,33 @@
+#include "LduBundler.h"
+#include <cstring>
+
+bool LduBundler::add(const P25FrameView& record) {
+    P25FrameClass frameClass = classifyFrame(record.frameType());
+    if (frameClass != P25FrameClass::VoiceLdu1 && frameClass != P25FrameClass::VoiceLdu2) {
+        return false;
+    }
+
+    // Length has to fit the one-byte prefix, and the bundle has to fit the buffer
+    if (record.size() > UINT8_MAX || m_length + 1 + record.size() > CAPACITY) {
+        return false;
+    }
+
+    if (m_count > 0 && record.frameType() != m_nextType) {
+        return false;
+    }
+
+    m_buffer[m_length] = static_cast<uint8_t>(record.size());
+    memcpy(&m_buffer[m_length + 1], record.data(), record.size());
+    m_length += 1 + record.size();
+    m_count++;
+
+    uint8_t type = record.frameType();
+    m_nextType = (type == FRAME_LDU1_8 || type == FRAME_LDU2_8) ? 0 : type + 1;
+    return true;
+}
+
+P25FrameView LduBundler::view() {
+    m_buffer[0] = FRAME_LDU_BUNDLE;
+    m_buffer[1] = static_cast<uint8_t>(m_count);
+    return P25FrameView(m_buffer, m_length);
+}
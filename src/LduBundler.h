@@ -0,0 +1,80 @@
+#pragma once
+
+#include "P25Frame.h"
+#include "P25Protocol.h"
+#include <cstdint>
+#include <cstddef>
+
+// Packs the nine records of one LDU1 or LDU2 into a single datagram:
+//
+//   0xF6 + record count + (record length + record) per record
+//
+// Each record keeps its own type byte, so the receiver needs nothing else to
+// split the bundle. Records in a bundle are always consecutive in the LDU
+// sequence; a gap, a new LDU or a full buffer means the pending bundle has to
+// go out first.
+class LduBundler {
+public:
+    static const size_t MAX_RECORDS = 9;
+    static const size_t HEADER_SIZE = 2;
+
+    // Well under any path MTU, and far more than nine LDU records need
+    static const size_t CAPACITY = 1200;
+
+    LduBundler() : m_length(HEADER_SIZE), m_count(0), m_nextType(0) {}
+
+    // Append an LDU record. False if it cannot extend the pending bundle -
+    // send that first, reset, then add again.
+    bool add(const P25FrameView& record);
+
+    bool empty() const { return m_count == 0; }
+
+    // The last record of the LDU is in
+    bool isComplete() const { return m_count > 0 && m_nextType == 0; }
+
+    size_t getRecordCount() const { return m_count; }
+
+    // Wire form of the pending bundle
+    P25FrameView view();
+
+    void reset() { m_length = HEADER_SIZE; m_count = 0; m_nextType = 0; }
+
+    // Call sink(record) for each record of a received bundle. Returns false
+    // (having delivered nothing) if the bundle is malformed.
+    template <typename Sink>
+    static bool unbundle(const P25FrameView& bundle, Sink&& sink);
+
+private:
+    uint8_t m_buffer[CAPACITY];
+    size_t m_length;
+    size_t m_count;
+    uint8_t m_nextType;  // type the next record must have, 0 once the LDU is complete
+};
+
+template <typename Sink>
+bool LduBundler::unbundle(const P25FrameView& bundle, Sink&& sink) {
+    if (bundle.size() < HEADER_SIZE || bundle[0] != FRAME_LDU_BUNDLE) {
+        return false;
+    }
+
+    // Validate the whole thing before delivering any of it
+    size_t count = bundle[1];
+    size_t offset = HEADER_SIZE;
+    for (size_t i = 0; i < count; i++) {
+        if (offset >= bundle.size() || bundle[offset] == 0 || offset + 1 + bundle[offset] > bundle.size()) {
+            return false;
+        }
+        offset += 1 + bundle[offset];
+    }
+    if (count == 0 || count > MAX_RECORDS || offset != bundle.size()) {
+        return false;
+    }
+
+    offset = HEADER_SIZE;
+    for (size_t i = 0; i < count; i++) {
+        size_t length = bundle[offset];
+        sink(P25FrameView(bundle.data() + offset + 1, length));
+        offset += 1 + length;
+    }
+    return true;
+}
@@ -1,8 +1,10 @@
 #include "Logger.h"
+#include "AllocTrace.h"
 #include <iostream>
-#include <iomanip>
-#include <sstream>
 #include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
 #include <ctime>
 
 Logger& Logger::getInstance() {
@@ -32,23 +34,49 @@ void Logger::init(const std::string& logFile, LogLevel level, bool console) {
 }
 
 void Logger::log(LogLevel level, const std::string& message) {
-    if (level < m_level) {
+    if (!isEnabled(level)) {
         return;
     }
+    write(level, message.data(), message.size());
+}
 
-    std::lock_guard<std::mutex> lock(m_mutex);
+void Logger::logf(LogLevel level, const char* format, ...) {
+    if (!isEnabled(level)) {
+        return;
+    }
 
-    std::string timestamp = getTimestamp();
-    std::string levelStr = levelToString(level);
-    std::string fullMessage = "[" + timestamp + "] [" + levelStr + "] " + message;
+    char message[MAX_FORMATTED];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+    if (length < 0) {
+        return;
+    }
+
+    write(level, message, static_cast<size_t>(length) < sizeof(message) ? static_cast<size_t>(length) : sizeof(message) - 1);
+}
+
+void Logger::write(LogLevel level, const char* message, size_t length) {
+    AllocTrace::Scope scope(AllocSite::Logger);
+
+    // "[2024-01-01 12:00:00.000] [INFO ] "
+    char prefix[48];
+    char timestamp[32];
+    formatTimestamp(timestamp, sizeof(timestamp));
+    int prefixLength = snprintf(prefix, sizeof(prefix), "[%s] [%s] ", timestamp, levelToString(level));
+    if (prefixLength < 0) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
 
     if (m_console) {
-        std::cout << fullMessage << std::endl;
+        std::cout.write(prefix, prefixLength).write(message, static_cast<std::streamsize>(length)) << std::endl;
     }
 
     if (m_fileStream.is_open()) {
-        m_fileStream << fullMessage << std::endl;
-        m_fileStream.flush();
+        m_fileStream.write(prefix, prefixLength).write(message, static_cast<std::streamsize>(length)) << std::endl;
     }
 }
 
@@ -72,7 +100,7 @@ void Logger::setLevel(LogLevel level) {
     m_level = level;
 }
 
-std::string Logger::levelToString(LogLevel level) {
+const char* Logger::levelToString(LogLevel level) {
     switch (level) {
         case LogLevel::DEBUG: return "DEBUG";
         case LogLevel::INFO:  return "INFO ";
@@ -82,7 +110,7 @@ std::string Logger::levelToString(LogLevel level) {
     }
 }
 
-std::string Logger::getTimestamp() {
+size_t Logger::formatTimestamp(char* buffer, size_t capacity) {
     auto now = std::chrono::system_clock::now();
     auto time_t = std::chrono::system_clock::to_time_t(now);
     auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
@@ -91,9 +119,7 @@ std::string Logger::getTimestamp() {
     std::tm tm;
     localtime_r(&time_t, &tm);
 
-    std::ostringstream oss;
-    oss << std::put_time(&tm, "%Y-%m-%d %H:%M:%S");
-    oss << '.' << std::setfill('0') << std::setw(3) << ms.count();
-
-    return oss.str();
+    size_t length = strftime(buffer, capacity, "%Y-%m-%d %H:%M:%S", &tm);
+    int written = snprintf(buffer + length, capacity - length, ".%03d", static_cast<int>(ms.count()));
+    return written > 0 ? length + static_cast<size_t>(written) : length;
 }
@@ -4,6 +4,8 @@
 #include <fstream>
 #include <mutex>
 #include <memory>
+#include <atomic>
+#include <cstddef>
 
 enum class LogLevel {
     DEBUG = 0,
@@ -23,26 +25,48 @@ public:
     void warn(const std::string& message);
     void error(const std::string& message);
 
+    // printf-style, formatted on the stack (truncated past MAX_FORMATTED).
+    // The modem, network and timer threads log with this - building a
+    // std::string message would put them back on the heap.
+    void logf(LogLevel level, const char* format, ...) __attribute__((format(printf, 3, 4)));
+
+    // The LOG_* macros check this before building the message
+    bool isEnabled(LogLevel level) const { return level >= m_level.load(std::memory_order_relaxed); }
+
     void setLevel(LogLevel level);
 
+    static const size_t MAX_FORMATTED = 512;
+
 private:
     Logger() = default;
     ~Logger();
     Logger(const Logger&) = delete;
     Logger& operator=(const Logger&) = delete;
 
-    std::string levelToString(LogLevel level);
-    std::string getTimestamp();
+    // Writing a line allocates nothing once the streams are open
+    void write(LogLevel level, const char* message, size_t length);
+    static const char* levelToString(LogLevel level);
+    static size_t formatTimestamp(char* buffer, size_t capacity);
 
-    LogLevel m_level = LogLevel::INFO;
+    std::atomic<LogLevel> m_level{LogLevel::INFO};
     std::string m_logFile;
     std::ofstream m_fileStream;
     bool m_console = true;
     std::mutex m_mutex;
 };
 
-// Convenience macros
-#define LOG_DEBUG(msg) Logger::getInstance().debug(msg)
-#define LOG_INFO(msg) Logger::getInstance().info(msg)
-#define LOG_WARN(msg) Logger::getInstance().warn(msg)
-#define LOG_ERROR(msg) Logger::getInstance().error(msg)
+// Convenience macros - the message is only built if the level is enabled
+#define LOG_AT(level, msg) \
+    do { \
+        if (Logger::getInstance().isEnabled(level)) Logger::getInstance().log(level, msg); \
+    } while (0)
+#define LOG_DEBUG(msg) LOG_AT(LogLevel::DEBUG, msg)
+#define LOG_INFO(msg) LOG_AT(LogLevel::INFO, msg)
+#define LOG_WARN(msg) LOG_AT(LogLevel::WARN, msg)
+#define LOG_ERROR(msg) LOG_AT(LogLevel::ERROR, msg)
+
+// Allocation-free forms for the RF and network paths
+#define LOG_DEBUGF(...) Logger::getInstance().logf(LogLevel::DEBUG, __VA_ARGS__)
+#define LOG_INFOF(...) Logger::getInstance().logf(LogLevel::INFO, __VA_ARGS__)
+#define LOG_WARNF(...) Logger::getInstance().logf(LogLevel::WARN, __VA_ARGS__)
+#define LOG_ERRORF(...) Logger::getInstance().logf(LogLevel::ERROR, __VA_ARGS__)
@@ -0,0 +1,23 @@
+#include "ModemFramer.h"
+
+void ModemFramer::append(const uint8_t* data, size_t length) {
+    if (m_head == m_tail) {
+        m_head = m_tail = 0;
+    }
+
+    // Compact the unread tail to the front once the free space runs out
+    if (m_tail + length > BUFFER_SIZE) {
+        size_t pending = m_tail - m_head;
+        if (pending + length > BUFFER_SIZE) {
+            // Nothing in here can still be a valid frame (max 250 bytes)
+            discard(pending);
+            pending = 0;
+        }
+        memmove(m_buffer, m_buffer + m_head, pending);
+        m_head = 0;
+        m_tail = pending;
+    }
+
+    memcpy(m_buffer + m_tail, data, length);
+    m_tail += length;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "P25Frame.h"
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+// MMDVM frame start marker
+const uint8_t FRAME_START = 0xE0;
+
+// Reassembles MMDVM frames (START + LENGTH + COMMAND + DATA) from a serial
+// byte stream. Frames are handed to the sink as a view into the framer's own
+// buffer, so the sink must copy anything it wants to keep.
+class ModemFramer {
+public:
+    static const size_t BUFFER_SIZE = 4096;
+
+    ModemFramer() : m_head(0), m_tail(0), m_discarded(0) {}
+
+    // Append raw bytes and call sink(command, payload) for each complete frame
+    template <typename Sink>
+    void feed(const uint8_t* data, size_t length, Sink&& sink);
+
+    void reset() { m_head = m_tail = 0; }
+
+    size_t buffered() const { return m_tail - m_head; }
+
+    // The start of a frame still waiting for the rest of its bytes, so
+    // another process reading the same link can carry on with it (handoff)
+    const uint8_t* pending() const { return m_buffer + m_head; }
+    void preload(const uint8_t* data, size_t length) { reset(); append(data, length); }
+    uint64_t getDiscardedBytes() const { return m_discarded; }
+
+private:
+    void append(const uint8_t* data, size_t length);
+    void discard(size_t count) { m_head += count; m_discarded += count; }
+
+    uint8_t m_buffer[BUFFER_SIZE];
+    size_t m_head;
+    size_t m_tail;
+    uint64_t m_discarded;
+};
+
+template <typename Sink>
+void ModemFramer::feed(const uint8_t* data, size_t length, Sink&& sink) {
+    while (length > 0) {
+        size_t chunk = length < BUFFER_SIZE ? length : BUFFER_SIZE;
+        append(data, chunk);
+        data += chunk;
+        length -= chunk;
+
+        // Process complete frames
+        while (m_tail - m_head >= 3) {
+            const uint8_t* frame = m_buffer + m_head;
+
+            // Look for frame start
+            if (frame[0] != FRAME_START) {
+                const void* next = memchr(frame, FRAME_START, m_tail - m_head);
+                discard(next ? static_cast<const uint8_t*>(next) - frame : m_tail - m_head);
+                continue;
+            }
+
+            uint8_t frameLength = frame[1];
+
+            // Validate length to prevent crashes
+            if (frameLength < 3 || frameLength > 250) {
+                discard(1);
+                continue;
+            }
+
+            if (m_tail - m_head < frameLength) {
+                break;  // Wait for more data
+            }
+
+            sink(frame[2], P25FrameView(frame + 3, frameLength - 3));
+            m_head += frameLength;
+        }
+    }
+}
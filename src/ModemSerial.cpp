@@ -1,18 +1,39 @@
 #include "ModemSerial.h"
+#include "P25Protocol.h"
 #include "Logger.h"
-#include <fcntl.h>
-#include <termios.h>
-#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
 #include <cstring>
-#include <chrono>
+#include <utility>
 
-ModemSerial::ModemSerial(const ModemConfig& config, uint16_t nac)
+// Status replies keep the P25 TX buffer space current
+static const uint32_t STATUS_POLL_INTERVAL_MS = 1000;
+
+// Offsets into CMD_GET_STATUS / CMD_GET_VERSION payloads (protocol 1)
+static const size_t STATUS_P25_SPACE = 7;
+static const size_t VERSION_PROTOCOL = 0;
+static const size_t VERSION_DESCRIPTION_V1 = 1;
+static const size_t VERSION_DESCRIPTION_V2 = 20;
+
+ModemSerial::ModemSerial(const ModemConfig& config, uint16_t nac, size_t index)
+    : ModemSerial(config, nac, ModemTransport::create(config), index)
+{
+}
+
+ModemSerial::ModemSerial(const ModemConfig& config, uint16_t nac, std::unique_ptr<ModemTransport> transport, size_t index)
     : m_config(config)
     , m_nac(nac)
-    , m_fd(-1)
+    , m_index(static_cast<uint8_t>(index))
+    , m_transport(std::move(transport))
     , m_isOpen(false)
     , m_running(false)
-    , m_ackReceived(false)
+    , m_response(Response::None)
+    , m_expectedReply(CMD_ACK)
+    , m_responseLength(0)
+    , m_p25Space(0)
+    , m_frameHasRssi(false)
+    , m_frameRssi(0)
+    , m_protocolVersion(1)
 {
 }
 
@@ -21,64 +42,32 @@ ModemSerial::~ModemSerial() {
 }
 
 bool ModemSerial::open() {
-    LOG_INFO("Opening modem on " + m_config.port);
-
-    // Open serial port
-    m_fd = ::open(m_config.port.c_str(), O_RDWR | O_NOCTTY | O_SYNC);
-    if (m_fd < 0) {
-        LOG_ERROR("Failed to open serial port: " + std::string(strerror(errno)));
-        return false;
-    }
+    return open([this](const P25FrameView& frame) {
+        m_p25Handler(frame);
+    });
+}
 
-    // Configure serial port
-    struct termios tty;
-    memset(&tty, 0, sizeof(tty));
+std::string ModemSerial::describeTransport() const {
+    return m_transport ? m_transport->describe() : m_config.transport;
+}
 
-    if (tcgetattr(m_fd, &tty) != 0) {
-        LOG_ERROR("Failed to get serial attributes");
-        ::close(m_fd);
+bool ModemSerial::openPort() {
+    if (!m_transport) {
         return false;
     }
 
-    // Set baud rate
-    speed_t baudRate = B115200;
-    if (m_config.baud == 9600) baudRate = B9600;
-    else if (m_config.baud == 19200) baudRate = B19200;
-    else if (m_config.baud == 38400) baudRate = B38400;
-    else if (m_config.baud == 57600) baudRate = B57600;
-    else if (m_config.baud == 115200) baudRate = B115200;
-
-    cfsetospeed(&tty, baudRate);
-    cfsetispeed(&tty, baudRate);
-
-    // 8N1 mode
-    tty.c_cflag = (tty.c_cflag & ~CSIZE) | CS8;
-    tty.c_cflag |= (CLOCAL | CREAD);
-    tty.c_cflag &= ~(PARENB | PARODD);
-    tty.c_cflag &= ~CSTOPB;
-    tty.c_cflag &= ~CRTSCTS;
-
-    // Raw mode
-    tty.c_lflag = 0;
-    tty.c_oflag = 0;
-    tty.c_iflag &= ~(IXON | IXOFF | IXANY);
-    tty.c_iflag &= ~(IGNBRK | BRKINT | PARMRK | ISTRIP | INLCR | IGNCR | ICRNL);
-
-    tty.c_cc[VMIN] = 0;
-    tty.c_cc[VTIME] = 1;
-
-    if (tcsetattr(m_fd, TCSANOW, &tty) != 0) {
-        LOG_ERROR("Failed to set serial attributes");
-        ::close(m_fd);
+    LOG_INFO("Opening modem on " + m_transport->describe());
+    if (!m_transport->open()) {
         return false;
     }
 
     m_isOpen = true;
-    LOG_INFO("Serial port opened successfully");
+    LOG_INFO("Modem link open");
+    return true;
+}
 
-    // Start read thread
-    m_running = true;
-    m_readThread = std::thread(&ModemSerial::readThread, this);
+bool ModemSerial::initialize() {
+    LOG_INFO("Modem read thread started");
 
     // Get modem version
     std::string version;
@@ -111,10 +100,18 @@ bool ModemSerial::open() {
     // }
     LOG_WARN("P25 mode bypassed - modem will stay in idle mode");
 
+    startStatusPoll();
+
     LOG_INFO("Modem initialized successfully");
     return true;
 }
 
+void ModemSerial::startStatusPoll() {
+    TimerWheel::getInstance().schedulePeriodic(m_statusTimer, STATUS_POLL_INTERVAL_MS, [this]() {
+        getStatus();
+    });
+}
+
 void ModemSerial::close() {
     if (!m_isOpen) {
         return;
@@ -122,8 +119,12 @@ void ModemSerial::close() {
 
     LOG_INFO("Closing modem...");
 
-    // Set to idle mode
-    setMode(MODE_IDLE);
+    TimerWheel::getInstance().cancel(m_statusTimer);
+
+    // Set to idle mode - the reply needs the read thread
+    if (m_running) {
+        setMode(MODE_IDLE);
+    }
 
     m_running = false;
 
@@ -131,32 +132,106 @@ void ModemSerial::close() {
         m_readThread.join();
     }
 
-    if (m_fd >= 0) {
-        ::close(m_fd);
-        m_fd = -1;
+    m_isOpen = false;
+    m_transport->close();
+
+    ModemTransport::Stats stats = m_transport->getStats();
+    if (stats.frames > stats.batches) {
+        LOG_INFO("Wrote " + std::to_string(stats.frames) + " frames to the modem in " + std::to_string(stats.batches) +
+                 " batches");
+    }
+    if (stats.dropped > 0) {
+        LOG_WARN("Modem write queue overflowed, dropped " + std::to_string(stats.dropped) + " frames");
     }
+    LOG_INFO("Modem closed");
+}
+
+bool ModemSerial::resume() {
+    return resume([this](const P25FrameView& frame) {
+        m_p25Handler(frame);
+    });
+}
+
+void ModemSerial::suspend() {
+    TimerWheel::getInstance().cancel(m_statusTimer);
 
+    m_running = false;
+    if (m_readThread.joinable()) {
+        m_readThread.join();
+    }
+}
+
+bool ModemSerial::adopt(int fd) {
+    if (!m_transport || m_isOpen || !m_transport->adopt(fd)) {
+        return false;
+    }
+
+    m_isOpen = true;
+    LOG_INFO("Took over modem link " + m_transport->describe());
+    return true;
+}
+
+void ModemSerial::detach() {
+    if (!m_isOpen) {
+        return;
+    }
+
+    suspend();
     m_isOpen = false;
-    LOG_INFO("Modem closed");
+    m_transport->close();
+    LOG_INFO("Let go of modem link " + m_transport->describe());
+}
+
+// Saved with the link so a handoff to a differently configured modem fails
+struct SavedModem {
+    char transport[64];
+    uint8_t protocolVersion;
+    uint8_t p25Space;
+};
+
+void ModemSerial::saveState(StateImage& image) {
+    SavedModem saved = {};
+    strncpy(saved.transport, describeTransport().c_str(), sizeof(saved.transport) - 1);
+    saved.protocolVersion = m_protocolVersion.load();
+    saved.p25Space = m_p25Space.load();
+    image.put(saved);
+    image.putBytes(m_framer.pending(), m_framer.buffered());
+}
+
+bool ModemSerial::restoreState(StateImage& image) {
+    SavedModem saved;
+    uint8_t pending[ModemFramer::BUFFER_SIZE];
+    size_t length = 0;
+    if (!image.get(saved) || !image.getBytes(pending, sizeof(pending), length)) {
+        return false;
+    }
+
+    saved.transport[sizeof(saved.transport) - 1] = '\0';
+    if (describeTransport().compare(0, sizeof(saved.transport) - 1, saved.transport) != 0) {
+        LOG_ERROR("Handed-off modem is on " + std::string(saved.transport) + ", this config has " + describeTransport());
+        return false;
+    }
+
+    m_protocolVersion = saved.protocolVersion;
+    m_p25Space = saved.p25Space;
+    m_framer.preload(pending, length);
+    return true;
 }
 
-bool ModemSerial::writeP25Data(const std::vector<uint8_t>& data) {
+bool ModemSerial::writeP25Data(const P25FrameView& frame) {
     if (!m_isOpen) {
         return false;
     }
 
-    return sendCommand(CMD_P25_DATA, data);
+    FrameTrace::mark(TraceStage::Controller);
+
+    return sendCommand(CMD_P25_DATA, frame.data(), frame.size());
 }
 
 bool ModemSerial::setMode(uint8_t mode) {
     LOG_INFO("Setting modem mode: " + std::to_string(mode));
 
-    std::vector<uint8_t> data = {mode};
-    if (!sendCommand(CMD_SET_MODE, data)) {
-        return false;
-    }
-
-    if (!waitForAck()) {
+    if (!sendCommandAndWait(CMD_SET_MODE, &mode, 1)) {
         LOG_ERROR("Failed to set mode - no ACK");
         return false;
     }
@@ -166,65 +241,98 @@ bool ModemSerial::setMode(uint8_t mode) {
 }
 
 bool ModemSerial::getVersion(std::string& version) {
-    if (!sendCommand(CMD_GET_VERSION, {})) {
+    // The modem answers with the same command byte instead of an ACK
+    if (!sendCommandAndWait(CMD_GET_VERSION, nullptr, 0, CMD_GET_VERSION)) {
         return false;
     }
 
-    // Wait for response
-    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    std::lock_guard<std::mutex> lock(m_responseMutex);
+    if (m_responseLength <= VERSION_PROTOCOL) {
+        return false;
+    }
 
-    // Version response will be in m_rxBuffer (simplified - real implementation needs proper parsing)
-    version = "MMDVM";  // Placeholder
+    uint8_t protocol = m_responseData[VERSION_PROTOCOL];
+    m_protocolVersion = protocol;
+    size_t offset = (protocol >= 2) ? VERSION_DESCRIPTION_V2 : VERSION_DESCRIPTION_V1;
+    if (offset < m_responseLength) {
+        version.assign(m_responseData + offset, m_responseData + m_responseLength);
+    } else {
+        version = "MMDVM";
+    }
+    version += " (protocol " + std::to_string(protocol) + ")";
     return true;
 }
 
 bool ModemSerial::getStatus() {
-    return sendCommand(CMD_GET_STATUS, {});
+    return sendCommand(CMD_GET_STATUS, nullptr, 0);
 }
 
-bool ModemSerial::sendCommand(uint8_t command, const std::vector<uint8_t>& data) {
-    if (!m_isOpen || m_fd < 0) {
+bool ModemSerial::sendCommand(uint8_t command, const uint8_t* data, size_t length) {
+    if (!m_isOpen) {
         return false;
     }
 
-    std::lock_guard<std::mutex> lock(m_writeMutex);
+    // Length byte covers the 3 header bytes as well
+    if (length + 3 > P25_MAX_FRAME_LENGTH) {
+        LOG_ERROR("Modem command too long: " + std::to_string(length) + " bytes");
+        return false;
+    }
 
     // Build packet: START + LENGTH + COMMAND + DATA
-    std::vector<uint8_t> packet;
-    packet.push_back(FRAME_START);
-    packet.push_back(static_cast<uint8_t>(data.size() + 3));  // Length includes command byte
-    packet.push_back(command);
-    packet.insert(packet.end(), data.begin(), data.end());
-
-    // Write to serial
-    ssize_t written = write(m_fd, packet.data(), packet.size());
-    if (written != static_cast<ssize_t>(packet.size())) {
-        LOG_ERROR("Failed to write to modem");
-        return false;
+    uint8_t packet[P25_MAX_FRAME_LENGTH];
+    packet[0] = FRAME_START;
+    packet[1] = static_cast<uint8_t>(length + 3);  // Length includes command byte
+    packet[2] = command;
+    if (length > 0) {
+        memcpy(packet + 3, data, length);
     }
+    size_t packetLength = length + 3;
 
-    return true;
-}
+    FrameCapture::record(CaptureStream::ModemTx, m_index, packet, packetLength);
 
-bool ModemSerial::waitForAck(int timeoutMs) {
-    m_ackReceived = false;
+    // The transport serializes writers and logs its own errors
+    return m_transport->write(packet, packetLength);
+}
 
-    auto startTime = std::chrono::steady_clock::now();
+bool ModemSerial::sendCommandAndWait(uint8_t command, const uint8_t* data, size_t length, uint8_t reply, uint32_t timeoutMs) {
+    std::lock_guard<std::mutex> commandLock(m_commandMutex);
 
-    while (true) {
-        if (m_ackReceived) {
-            return true;
-        }
+    // Arm before sending so a fast reply can't slip past
+    {
+        std::lock_guard<std::mutex> lock(m_responseMutex);
+        m_response = Response::Waiting;
+        m_expectedReply = reply;
+        m_responseLength = 0;
+    }
 
-        auto now = std::chrono::steady_clock::now();
-        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - startTime).count();
+    if (!sendCommand(command, data, length)) {
+        std::lock_guard<std::mutex> lock(m_responseMutex);
+        m_response = Response::None;
+        return false;
+    }
 
-        if (elapsed > timeoutMs) {
-            return false;
+    TimerWheel::getInstance().schedule(m_responseTimer, timeoutMs, [this]() {
+        std::lock_guard<std::mutex> lock(m_responseMutex);
+        if (m_response == Response::Waiting) {
+            m_response = Response::TimedOut;
+            m_responseCv.notify_all();
         }
+    });
+
+    Response result;
+    {
+        std::unique_lock<std::mutex> lock(m_responseMutex);
+        m_responseCv.wait(lock, [this]() { return m_response != Response::Waiting; });
+        result = m_response;
+        m_response = Response::None;
+    }
+
+    TimerWheel::getInstance().cancel(m_responseTimer);
 
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    if (result == Response::Rejected) {
+        LOG_WARN("Modem rejected command " + std::to_string(command));
     }
+    return result == Response::Received;
 }
 
 bool ModemSerial::configure() {
@@ -250,15 +358,11 @@ bool ModemSerial::configure() {
     config.push_back(static_cast<uint8_t>(m_config.tx_power));
     config.push_back(static_cast<uint8_t>(m_config.rf_level));
 
-    // Delays (set to 0 for now)
+    // Delays - TX delay in 10 ms units
+    config.push_back(static_cast<uint8_t>(std::min(std::max(m_config.tx_delay / 10, 0), 255)));
     config.push_back(0x00);
-    config.push_back(0x00);
-
-    if (!sendCommand(CMD_SET_CONFIG, config)) {
-        return false;
-    }
 
-    if (!waitForAck()) {
+    if (!sendCommandAndWait(CMD_SET_CONFIG, config)) {
         LOG_ERROR("Failed to configure modem - no ACK");
         return false;
     }
@@ -278,7 +382,7 @@ bool ModemSerial::setFrequencies() {
     rxFreq.push_back((rx >> 8) & 0xFF);
     rxFreq.push_back(rx & 0xFF);
 
-    if (!sendCommand(CMD_SET_RXFREQ, rxFreq) || !waitForAck()) {
+    if (!sendCommandAndWait(CMD_SET_RXFREQ, rxFreq)) {
         LOG_ERROR("Failed to set RX frequency");
         return false;
     }
@@ -291,7 +395,7 @@ bool ModemSerial::setFrequencies() {
     txFreq.push_back((tx >> 8) & 0xFF);
     txFreq.push_back(tx & 0xFF);
 
-    if (!sendCommand(CMD_SET_TXFREQ, txFreq) || !waitForAck()) {
+    if (!sendCommandAndWait(CMD_SET_TXFREQ, txFreq)) {
         LOG_ERROR("Failed to set TX frequency");
         return false;
     }
@@ -300,67 +404,100 @@ bool ModemSerial::setFrequencies() {
     return true;
 }
 
-void ModemSerial::readThread() {
-    LOG_INFO("Modem read thread started");
+ssize_t ModemSerial::readDevice(uint8_t* buffer, size_t size) {
+    while (m_running) {
+        ssize_t n = m_transport->read(buffer, size);
+        if (n >= 0) {
+            return n;
+        }
+        break;
+    }
 
-    uint8_t buffer[2048];
+    LOG_INFO("Modem read thread stopped");
+    return -1;
+}
 
-    while (m_running) {
-        ssize_t n = read(m_fd, buffer, sizeof(buffer));
-
-        if (n > 0) {
-            // Add to RX buffer
-            m_rxBuffer.insert(m_rxBuffer.end(), buffer, buffer + n);
-
-            // Process complete frames
-            while (m_rxBuffer.size() >= 3) {
-                // Look for frame start
-                if (m_rxBuffer[0] != FRAME_START) {
-                    m_rxBuffer.erase(m_rxBuffer.begin());
-                    continue;
-                }
-
-                uint8_t length = m_rxBuffer[1];
-
-                // Validate length to prevent crashes
-                if (length < 3 || length > 250) {
-                    LOG_WARN("Invalid frame length: " + std::to_string(length) + ", discarding");
-                    m_rxBuffer.erase(m_rxBuffer.begin());
-                    continue;
-                }
-
-                if (m_rxBuffer.size() < length) {
-                    break;  // Wait for more data
-                }
-
-                uint8_t command = m_rxBuffer[2];
-
-                // Extract frame data
-                std::vector<uint8_t> frameData(m_rxBuffer.begin() + 3, m_rxBuffer.begin() + length);
-
-                // Remove processed frame from buffer
-                m_rxBuffer.erase(m_rxBuffer.begin(), m_rxBuffer.begin() + length);
-
-                // Handle frame based on command
-                if (command == CMD_ACK) {
-                    m_ackReceived = true;
-                    LOG_DEBUG("Received ACK");
-                } else if (command == CMD_NAK) {
-                    LOG_WARN("Received NAK");
-                } else if (command == CMD_P25_DATA) {
-                    // P25 data from modem (RF → Network)
-                    if (m_p25Callback) {
-                        m_p25Callback(frameData);
-                    }
-                }
-            }
-        } else if (n < 0 && errno != EAGAIN) {
-            LOG_ERROR("Modem read error: " + std::string(strerror(errno)));
-            break;
+void ModemSerial::reportDiscarded(uint64_t before) {
+    LOG_WARNF("Discarded %llu bytes of invalid modem data",
+              static_cast<unsigned long long>(m_framer.getDiscardedBytes() - before));
+}
+
+P25FrameView ModemSerial::takeRssi(const P25FrameView& frame) {
+    // The modem only appends RSSI to received voice (LDU1/LDU2)
+    P25FrameClass frameClass = classifyFrame(frame.frameType());
+    m_frameHasRssi = m_config.rssi && frame.size() > 2 &&
+                     (frameClass == P25FrameClass::VoiceLdu1 || frameClass == P25FrameClass::VoiceLdu2);
+    if (!m_frameHasRssi) {
+        return frame;
+    }
+
+    size_t length = frame.size() - 2;
+    m_frameRssi = mapRssi(static_cast<uint16_t>((frame[length] << 8) | frame[length + 1]));
+    return P25FrameView(frame.data(), length);
+}
+
+void ModemSerial::handleFrame(uint8_t command, const P25FrameView& frame) {
+    if (command == CMD_GET_STATUS) {
+        handleStatus(frame);
+    }
+
+    // Complete a pending sendCommandAndWait()
+    std::lock_guard<std::mutex> lock(m_responseMutex);
+    if (m_response != Response::Waiting) {
+        if (command == CMD_NAK) {
+            LOG_WARN("Received unexpected NAK");
         }
+        return;
+    }
 
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    if (command == m_expectedReply) {
+        LOG_DEBUGF("Received reply %u", static_cast<unsigned>(command));
+        m_responseLength = frame.size() < sizeof(m_responseData) ? frame.size() : sizeof(m_responseData);
+        memcpy(m_responseData, frame.data(), m_responseLength);
+        m_response = Response::Received;
+        m_responseCv.notify_all();
+    } else if (command == CMD_NAK) {
+        LOG_WARN("Received NAK");
+        m_response = Response::Rejected;
+        m_responseCv.notify_all();
     }
+}
 
-    LOG_INFO("Modem read thread stopped");
+void ModemSerial::handleStatus(const P25FrameView& payload) {
+    // Protocol 2 moved the buffer fields - only the protocol 1 layout is known
+    if (m_protocolVersion != 1 || payload.size() <= STATUS_P25_SPACE) {
+        return;
+    }
+
+    m_p25Space.store(payload[STATUS_P25_SPACE], std::memory_order_relaxed);
+}
+
+bool ModemSerial::getFrameRssi(int16_t& dbm) const {
+    if (!m_frameHasRssi) {
+        return false;
+    }
+    dbm = m_frameRssi;
+    return true;
+}
+
+int16_t ModemSerial::mapRssi(uint16_t raw) const {
+    const auto& map = m_config.rssi_map;
+    if (map.empty()) {
+        return static_cast<int16_t>(-static_cast<int>(raw));
+    }
+
+    // Piecewise linear between calibration points, clamped at the ends
+    if (raw <= map.front().first) {
+        return static_cast<int16_t>(map.front().second);
+    }
+    for (size_t i = 1; i < map.size(); i++) {
+        if (raw <= map[i].first) {
+            const auto& lo = map[i - 1];
+            const auto& hi = map[i];
+            int span = hi.first - lo.first;
+            int value = lo.second + (hi.second - lo.second) * static_cast<int>(raw - lo.first) / (span ? span : 1);
+            return static_cast<int16_t>(value);
+        }
+    }
+    return static_cast<int16_t>(map.back().second);
 }
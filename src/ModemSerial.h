@@ -1,13 +1,26 @@
 #pragma once
 
 #include "Config.h"
+#include "P25Frame.h"
+#include "ModemFramer.h"
+#include "TimerWheel.h"
+#include "HandlerSlot.h"
+#include "ModemTransport.h"
+#include "Realtime.h"
+#include "AllocTrace.h"
+#include "FrameTrace.h"
+#include "FrameCapture.h"
+#include "StateImage.h"
 #include <string>
 #include <vector>
 #include <cstdint>
 #include <functional>
+#include <memory>
 #include <atomic>
 #include <thread>
 #include <mutex>
+#include <condition_variable>
+#include <sys/types.h>
 
 // MMDVM protocol commands (based on G4KLX protocol)
 const uint8_t CMD_GET_VERSION = 0x00;
@@ -27,54 +40,207 @@ const uint8_t CMD_NAK = 0x7F;
 const uint8_t MODE_IDLE = 0;
 const uint8_t MODE_P25 = 4;
 
-// Frame start/end markers
-const uint8_t FRAME_START = 0xE0;
-
 class ModemSerial {
 public:
-    using P25DataCallback = std::function<void(const std::vector<uint8_t>&)>;
+    // index is the modem's place among the site's modems (tags captured frames)
+    ModemSerial(const ModemConfig& config, uint16_t nac, size_t index = 0);
 
-    ModemSerial(const ModemConfig& config, uint16_t nac);
+    // On a link other than the one config.transport names (replay)
+    ModemSerial(const ModemConfig& config, uint16_t nac, std::unique_ptr<ModemTransport> transport, size_t index = 0);
     ~ModemSerial();
 
+    // P25 data from RF goes to the handler published with setP25Handler()
     bool open();
+
+    // Fixed wiring: P25 data from RF goes straight to sink(frame), which is
+    // compiled into the read loop. The published handler is never consulted.
+    template <typename Sink>
+    bool open(Sink sink);
+
     void close();
 
     bool isOpen() const { return m_isOpen.load(); }
 
+    // Handoff to a new process. suspend() stops the read thread and the
+    // status poll, leaving the modem configured and the link open;
+    // stopReading() only asks the thread to stop, so several links can wind
+    // down at once. resume() carries on without configuring anything - on
+    // this link, or on one taken over with adopt(). detach() lets go of the
+    // link without setting the modem idle.
+    void stopReading() { m_running = false; }
+    void suspend();
+    bool adopt(int fd);
+    bool resume();
+    template <typename Sink>
+    bool resume(Sink sink);
+    void detach();
+
+    int getDescriptor() const { return m_transport ? m_transport->getDescriptor() : -1; }
+
+    // What the new process needs to pick up the link: the protocol version,
+    // buffer space and a partly read frame
+    void saveState(StateImage& image);
+    bool restoreState(StateImage& image);
+
+    const ModemConfig& getConfig() const { return m_config; }
+
+    // Link the modem is on, e.g. "/dev/ttyACM0 @ 460800"
+    std::string describeTransport() const;
+
     // Send P25 data to modem (to be transmitted over RF)
-    bool writeP25Data(const std::vector<uint8_t>& data);
+    bool writeP25Data(const P25FrameView& frame);
 
-    // Set callback for P25 data received from modem (from RF)
-    void setP25DataCallback(P25DataCallback callback) { m_p25Callback = callback; }
+    // Handler for P25 data received from the modem (from RF). Safe to
+    // publish or clear while the read thread is running.
+    template <typename T, void (T::*Method)(const P25FrameView&)>
+    void setP25Handler(T* object) { m_p25Handler.template bind<T, Method>(object); }
+    void clearP25Handler() { m_p25Handler.clear(); }
 
     // Modem control
     bool setMode(uint8_t mode);
     bool getVersion(std::string& version);
     bool getStatus();
 
-private:
-    void readThread();
+    // RSSI trailer of the P25 frame being delivered to the handler, in dBm.
+    // Only meaningful from inside the P25 data handler.
+    bool getFrameRssi(int16_t& dbm) const;
+
+    // Free P25 slots in the modem TX buffer from the last status reply
+    uint8_t getP25BufferSpace() const { return m_p25Space.load(std::memory_order_relaxed); }
 
-    bool sendCommand(uint8_t command, const std::vector<uint8_t>& data);
-    bool waitForAck(int timeoutMs = 1000);
+private:
+    bool openPort();
+    bool initialize();
+    void startStatusPoll();
+
+    template <typename Sink>
+    void readLoop(Sink& sink);
+
+    // Bytes read, 0 on timeout, -1 once stopped or on a read error
+    ssize_t readDevice(uint8_t* buffer, size_t size);
+    void reportDiscarded(uint64_t before);
+
+    // Strip the RSSI trailer of an LDU and remember it for getFrameRssi().
+    // Other frames pass through untouched.
+    P25FrameView takeRssi(const P25FrameView& frame);
+    void handleFrame(uint8_t command, const P25FrameView& frame);
+
+    bool sendCommand(uint8_t command, const uint8_t* data, size_t length);
+    bool sendCommand(uint8_t command, const std::vector<uint8_t>& data) {
+        return sendCommand(command, data.data(), data.size());
+    }
+
+    // Send a command and block until the modem answers with reply (ACK by
+    // default) or NAK, or the timeout on the timer wheel fires
+    bool sendCommandAndWait(uint8_t command, const uint8_t* data, size_t length,
+                            uint8_t reply = CMD_ACK, uint32_t timeoutMs = 1000);
+    bool sendCommandAndWait(uint8_t command, const std::vector<uint8_t>& data) {
+        return sendCommandAndWait(command, data.data(), data.size());
+    }
+    void handleStatus(const P25FrameView& payload);
+    int16_t mapRssi(uint16_t raw) const;
 
     bool configure();
     bool setFrequencies();
 
     const ModemConfig& m_config;
     uint16_t m_nac;
+    uint8_t m_index;
 
-    int m_fd;
+    // Lives as long as the modem so a writer racing close() never sees it go
+    std::unique_ptr<ModemTransport> m_transport;
     std::atomic<bool> m_isOpen;
     std::atomic<bool> m_running;
 
     std::thread m_readThread;
-    std::mutex m_writeMutex;
 
-    P25DataCallback m_p25Callback;
+    HandlerSlot<const P25FrameView&> m_p25Handler;
+
+    // Response handling - one outstanding command at a time
+    ModemFramer m_framer;
+    std::mutex m_commandMutex;
+    std::mutex m_responseMutex;
+    std::condition_variable m_responseCv;
+    enum class Response { None, Waiting, Received, Rejected, TimedOut };
+    Response m_response;
+    uint8_t m_expectedReply;
+    uint8_t m_responseData[P25_MAX_FRAME_LENGTH];  // reply payload, copied on the read thread
+    size_t m_responseLength;
 
-    // Response handling
-    std::vector<uint8_t> m_rxBuffer;
-    std::atomic<bool> m_ackReceived;
+    std::atomic<uint8_t> m_p25Space;
+
+    // Read thread only
+    bool m_frameHasRssi;
+    int16_t m_frameRssi;
+    std::atomic<uint8_t> m_protocolVersion;
+
+    TimerWheel::Timer m_responseTimer;
+    TimerWheel::Timer m_statusTimer;
 };
+
+template <typename Sink>
+bool ModemSerial::open(Sink sink) {
+    if (!openPort()) {
+        return false;
+    }
+
+    // Running before configuration - replies arrive on the read thread
+    m_running = true;
+    m_readThread = std::thread([this, sink]() mutable {
+        Realtime::getInstance().enterThread(RealtimeThread::Modem, m_config.cpu);
+        AllocTrace::enterThread(AllocSite::Modem);
+        readLoop(sink);
+    });
+
+    return initialize();
+}
+
+template <typename Sink>
+bool ModemSerial::resume(Sink sink) {
+    if (!m_isOpen || m_running) {
+        return false;
+    }
+
+    m_running = true;
+    m_readThread = std::thread([this, sink]() mutable {
+        Realtime::getInstance().enterThread(RealtimeThread::Modem, m_config.cpu);
+        AllocTrace::enterThread(AllocSite::Modem);
+        readLoop(sink);
+    });
+
+    startStatusPoll();
+    return true;
+}
+
+template <typename Sink>
+void ModemSerial::readLoop(Sink& sink) {
+    uint8_t buffer[2048];
+
+    ssize_t n;
+    while ((n = readDevice(buffer, sizeof(buffer))) >= 0) {
+        if (n == 0) {
+            continue;
+        }
+
+        FrameCapture::record(CaptureStream::ModemRx, m_index, buffer, static_cast<size_t>(n));
+
+        uint64_t discarded = m_framer.getDiscardedBytes();
+        uint64_t arrivedNs = FrameTrace::arrivalNs();
+
+        m_framer.feed(buffer, static_cast<size_t>(n), [this, &sink, arrivedNs](uint8_t command, const P25FrameView& frame) {
+            if (command == CMD_P25_DATA) {
+                // P25 data from modem (RF → Network)
+                FrameTrace::begin(CallDirection::RF, arrivedNs);
+                FrameTrace::mark(TraceStage::Receive);
+                sink(takeRssi(frame));
+                FrameTrace::abandon();
+            } else {
+                handleFrame(command, frame);
+            }
+        });
+
+        if (m_framer.getDiscardedBytes() != discarded) {
+            reportDiscarded(discarded);
+        }
+    }
+}
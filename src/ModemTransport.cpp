@@ -0,0 +1,470 @@
+#include "ModemTransport.h"
+#include "Logger.h"
+#include <asm/termbits.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
+// Queued bytes per transport - a few hundred modem frames
+static const size_t QUEUE_CAPACITY = 8192;
+
+// Modem frames carrying P25 data are at least this long (header + TSBK) -
+// sizes the queue of trace stamps
+static const size_t MIN_TRACED_FRAME = 16;
+
+// Receive timeout, same as the VTIME the serial port uses
+static const int READ_TIMEOUT_MS = 100;
+
+// Give up on a bridge that does not accept the connection
+static const int CONNECT_TIMEOUT_S = 5;
+
+static void setTimeout(int socket, int option, int ms) {
+    struct timeval tv;
+    tv.tv_sec = ms / 1000;
+    tv.tv_usec = (ms % 1000) * 1000;
+    setsockopt(socket, SOL_SOCKET, option, &tv, sizeof(tv));
+}
+
+static bool isSocketType(int fd, int type) {
+    int actual = 0;
+    socklen_t length = sizeof(actual);
+    return getsockopt(fd, SOL_SOCKET, SO_TYPE, &actual, &length) == 0 && actual == type;
+}
+
+static bool parseAddress(const std::string& address, uint16_t port, struct sockaddr_in& out) {
+    memset(&out, 0, sizeof(out));
+    out.sin_family = AF_INET;
+    out.sin_port = htons(port);
+    return inet_pton(AF_INET, address.c_str(), &out.sin_addr) > 0;
+}
+
+std::unique_ptr<ModemTransport> ModemTransport::create(const ModemConfig& config) {
+    if (config.transport == "serial") {
+        return std::unique_ptr<ModemTransport>(new SerialTransport(config.port, config.baud));
+    }
+    if (config.transport == "tcp") {
+        return std::unique_ptr<ModemTransport>(new TcpTransport(config.address, config.remote_port));
+    }
+    if (config.transport == "udp") {
+        return std::unique_ptr<ModemTransport>(new UdpTransport(config.address, config.remote_port, config.local_port));
+    }
+
+    LOG_ERROR("Unknown modem transport: " + config.transport);
+    return nullptr;
+}
+
+ModemTransport::ModemTransport(size_t queueCapacity)
+    : m_queueCapacity(queueCapacity)
+    , m_flushing(false)
+    , m_stats()
+{
+    m_queued.reserve(queueCapacity);
+    m_sending.reserve(queueCapacity);
+    m_queuedStamps.reserve(queueCapacity / MIN_TRACED_FRAME);
+    m_sendingStamps.reserve(queueCapacity / MIN_TRACED_FRAME);
+}
+
+bool ModemTransport::write(const uint8_t* frame, size_t length) {
+    // Network voice on its way out carries its trace stamps
+    FrameTrace::Stamp stamp;
+    bool traced = FrameTrace::take(stamp);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    // Someone is on the wire - ride along with their next batch
+    if (m_flushing) {
+        if (m_queued.size() + length > m_queueCapacity) {
+            m_stats.dropped++;
+            return false;
+        }
+        m_queued.insert(m_queued.end(), frame, frame + length);
+        if (traced && m_queuedStamps.size() < m_queuedStamps.capacity()) {
+            m_queuedStamps.push_back(stamp);
+        }
+        m_stats.frames++;
+        return true;
+    }
+
+    m_flushing = true;
+    m_stats.frames++;
+    m_stats.batches++;
+    lock.unlock();
+
+    uint64_t startNs = traced ? FrameTrace::nowNs() : 0;
+    bool sent = writeBatch(frame, length);
+    if (traced) {
+        FrameTrace::complete(CallDirection::Network, stamp, startNs, FrameTrace::nowNs());
+    }
+
+    lock.lock();
+    while (!m_queued.empty()) {
+        m_sending.swap(m_queued);
+        m_sendingStamps.swap(m_queuedStamps);
+        m_stats.batches++;
+        lock.unlock();
+
+        startNs = m_sendingStamps.empty() ? 0 : FrameTrace::nowNs();
+        if (!writeBatch(m_sending.data(), m_sending.size())) {
+            LOG_ERROR("Failed to write " + std::to_string(m_sending.size()) + " queued bytes to modem");
+        }
+        if (startNs != 0) {
+            uint64_t endNs = FrameTrace::nowNs();
+            for (const FrameTrace::Stamp& queued : m_sendingStamps) {
+                FrameTrace::complete(CallDirection::Network, queued, startNs, endNs);
+            }
+        }
+        m_sending.clear();
+        m_sendingStamps.clear();
+
+        lock.lock();
+    }
+    m_flushing = false;
+
+    return sent;
+}
+
+ModemTransport::Stats ModemTransport::getStats() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+// Serial
+
+SerialTransport::SerialTransport(const std::string& port, int baud)
+    : ModemTransport(QUEUE_CAPACITY)
+    , m_port(port)
+    , m_baud(baud)
+    , m_fd(-1)
+{
+}
+
+SerialTransport::~SerialTransport() {
+    close();
+}
+
+bool SerialTransport::open() {
+    m_fd = ::open(m_port.c_str(), O_RDWR | O_NOCTTY | O_SYNC);
+    if (m_fd < 0) {
+        LOG_ERROR("Failed to open serial port: " + std::string(strerror(errno)));
+        return false;
+    }
+
+    struct termios2 tty;
+    if (ioctl(m_fd, TCGETS2, &tty) != 0) {
+        LOG_ERROR("Failed to get serial attributes");
+        close();
+        return false;
+    }
+
+    // Arbitrary speed in both directions
+    tty.c_cflag &= ~(CBAUD | (CBAUD << IBSHIFT));
+    tty.c_cflag |= BOTHER | (BOTHER << IBSHIFT);
+    tty.c_ispeed = static_cast<speed_t>(m_baud);
+    tty.c_ospeed = static_cast<speed_t>(m_baud);
+
+    // 8N1 mode
+    tty.c_cflag = (tty.c_cflag & ~CSIZE) | CS8;
+    tty.c_cflag |= (CLOCAL | CREAD);
+    tty.c_cflag &= ~(PARENB | PARODD);
+    tty.c_cflag &= ~CSTOPB;
+    tty.c_cflag &= ~CRTSCTS;
+
+    // Raw mode
+    tty.c_lflag = 0;
+    tty.c_oflag = 0;
+    tty.c_iflag &= ~(IXON | IXOFF | IXANY);
+    tty.c_iflag &= ~(IGNBRK | BRKINT | PARMRK | ISTRIP | INLCR | IGNCR | ICRNL);
+
+    tty.c_cc[VMIN] = 0;
+    tty.c_cc[VTIME] = READ_TIMEOUT_MS / 100;
+
+    if (ioctl(m_fd, TCSETS2, &tty) != 0) {
+        LOG_ERROR("Failed to set serial attributes: " + std::string(strerror(errno)));
+        close();
+        return false;
+    }
+
+    // The driver rounds to what the UART can divide down to
+    if (ioctl(m_fd, TCGETS2, &tty) == 0 && tty.c_ospeed != static_cast<speed_t>(m_baud)) {
+        LOG_WARN("Serial port running at " + std::to_string(tty.c_ospeed) + " baud, asked for " +
+                 std::to_string(m_baud));
+    }
+
+    return true;
+}
+
+void SerialTransport::close() {
+    if (m_fd >= 0) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+}
+
+ssize_t SerialTransport::read(uint8_t* buffer, size_t size) {
+    ssize_t n = ::read(m_fd, buffer, size);
+    if (n >= 0 || errno == EAGAIN || errno == EINTR) {
+        return n > 0 ? n : 0;
+    }
+
+    LOG_ERROR("Modem read error: " + std::string(strerror(errno)));
+    return -1;
+}
+
+bool SerialTransport::writeBatch(const uint8_t* data, size_t length) {
+    while (length > 0) {
+        ssize_t written = ::write(m_fd, data, length);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            LOG_ERROR("Modem write error: " + std::string(strerror(errno)));
+            return false;
+        }
+        data += written;
+        length -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+std::string SerialTransport::describe() const {
+    return m_port + " @ " + std::to_string(m_baud);
+}
+
+int SerialTransport::getDescriptor() const {
+    return m_fd;
+}
+
+bool SerialTransport::adopt(int fd) {
+    // Speed and raw mode belong to the tty, so they came along
+    if (!isatty(fd)) {
+        LOG_ERROR("Handed-off modem descriptor is not a serial port");
+        return false;
+    }
+
+    close();
+    m_fd = fd;
+    return true;
+}
+
+// TCP
+
+TcpTransport::TcpTransport(const std::string& address, uint16_t port)
+    : ModemTransport(QUEUE_CAPACITY)
+    , m_address(address)
+    , m_port(port)
+    , m_socket(-1)
+{
+}
+
+TcpTransport::~TcpTransport() {
+    close();
+}
+
+bool TcpTransport::open() {
+    struct sockaddr_in addr;
+    if (!parseAddress(m_address, m_port, addr)) {
+        LOG_ERROR("Invalid modem address: " + m_address);
+        return false;
+    }
+
+    m_socket = socket(AF_INET, SOCK_STREAM, 0);
+    if (m_socket < 0) {
+        LOG_ERROR("Failed to create modem socket");
+        return false;
+    }
+
+    // connect() honours the send timeout, and a stalled bridge fails sends
+    // instead of blocking the writer forever
+    setTimeout(m_socket, SO_SNDTIMEO, CONNECT_TIMEOUT_S * 1000);
+    if (connect(m_socket, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0) {
+        LOG_ERROR("Failed to connect to modem at " + describe() + ": " + std::string(strerror(errno)));
+        close();
+        return false;
+    }
+
+    int one = 1;
+    setsockopt(m_socket, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    setTimeout(m_socket, SO_RCVTIMEO, READ_TIMEOUT_MS);
+    return true;
+}
+
+void TcpTransport::close() {
+    if (m_socket >= 0) {
+        ::close(m_socket);
+        m_socket = -1;
+    }
+}
+
+ssize_t TcpTransport::read(uint8_t* buffer, size_t size) {
+    ssize_t n = recv(m_socket, buffer, size, 0);
+    if (n > 0) {
+        return n;
+    }
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+        return 0;
+    }
+
+    LOG_ERROR(n == 0 ? "Modem bridge closed the connection" : "Modem read error: " + std::string(strerror(errno)));
+    return -1;
+}
+
+bool TcpTransport::writeBatch(const uint8_t* data, size_t length) {
+    while (length > 0) {
+        ssize_t sent = send(m_socket, data, length, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            LOG_ERROR("Modem write error: " + std::string(strerror(errno)));
+            return false;
+        }
+        data += sent;
+        length -= static_cast<size_t>(sent);
+    }
+    return true;
+}
+
+std::string TcpTransport::describe() const {
+    return "tcp://" + m_address + ":" + std::to_string(m_port);
+}
+
+int TcpTransport::getDescriptor() const {
+    return m_socket;
+}
+
+bool TcpTransport::adopt(int fd) {
+    // Timeouts and TCP_NODELAY are socket options, so they came along
+    if (!isSocketType(fd, SOCK_STREAM)) {
+        LOG_ERROR("Handed-off modem descriptor is not a TCP socket");
+        return false;
+    }
+
+    close();
+    m_socket = fd;
+    return true;
+}
+
+// UDP
+
+UdpTransport::UdpTransport(const std::string& address, uint16_t port, uint16_t localPort)
+    : ModemTransport(QUEUE_CAPACITY)
+    , m_address(address)
+    , m_port(port)
+    , m_localPort(localPort)
+    , m_socket(-1)
+{
+}
+
+UdpTransport::~UdpTransport() {
+    close();
+}
+
+bool UdpTransport::open() {
+    struct sockaddr_in remote;
+    if (!parseAddress(m_address, m_port, remote)) {
+        LOG_ERROR("Invalid modem address: " + m_address);
+        return false;
+    }
+
+    m_socket = socket(AF_INET, SOCK_DGRAM, 0);
+    if (m_socket < 0) {
+        LOG_ERROR("Failed to create modem socket");
+        return false;
+    }
+
+    // Bridges usually send to a fixed port
+    if (m_localPort != 0) {
+        struct sockaddr_in local;
+        memset(&local, 0, sizeof(local));
+        local.sin_family = AF_INET;
+        local.sin_port = htons(m_localPort);
+        local.sin_addr.s_addr = htonl(INADDR_ANY);
+        if (bind(m_socket, reinterpret_cast<struct sockaddr*>(&local), sizeof(local)) < 0) {
+            LOG_ERROR("Failed to bind modem port " + std::to_string(m_localPort) + ": " + std::string(strerror(errno)));
+            close();
+            return false;
+        }
+    }
+
+    // Only the bridge's datagrams get through
+    if (connect(m_socket, reinterpret_cast<struct sockaddr*>(&remote), sizeof(remote)) < 0) {
+        LOG_ERROR("Failed to connect modem socket: " + std::string(strerror(errno)));
+        close();
+        return false;
+    }
+
+    setTimeout(m_socket, SO_RCVTIMEO, READ_TIMEOUT_MS);
+    return true;
+}
+
+void UdpTransport::close() {
+    if (m_socket >= 0) {
+        ::close(m_socket);
+        m_socket = -1;
+    }
+}
+
+ssize_t UdpTransport::read(uint8_t* buffer, size_t size) {
+    ssize_t n = recv(m_socket, buffer, size, 0);
+    if (n >= 0) {
+        return n;
+    }
+
+    // ECONNREFUSED is an ICMP unreachable from a bridge that is restarting -
+    // keep listening until it is back
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR || errno == ECONNREFUSED) {
+        return 0;
+    }
+
+    LOG_ERROR("Modem read error: " + std::string(strerror(errno)));
+    return -1;
+}
+
+bool UdpTransport::writeBatch(const uint8_t* data, size_t length) {
+    bool ok = true;
+    size_t start = 0;
+    while (start < length) {
+        // Extend the datagram frame by frame (the length byte follows the start byte)
+        size_t end = start;
+        while (end + 1 < length && end - start + data[end + 1] <= MAX_DATAGRAM && data[end + 1] > 0) {
+            end += data[end + 1];
+        }
+        if (end == start || end > length) {
+            end = length;  // not frame-aligned - send the rest as is
+        }
+
+        if (send(m_socket, data + start, end - start, 0) != static_cast<ssize_t>(end - start)) {
+            if (errno != ECONNREFUSED) {
+                LOG_ERROR("Modem write error: " + std::string(strerror(errno)));
+            }
+            ok = false;
+        }
+        start = end;
+    }
+    return ok;
+}
+
+std::string UdpTransport::describe() const {
+    return "udp://" + m_address + ":" + std::to_string(m_port);
+}
+
+int UdpTransport::getDescriptor() const {
+    return m_socket;
+}
+
+bool UdpTransport::adopt(int fd) {
+    if (!isSocketType(fd, SOCK_DGRAM)) {
+        LOG_ERROR("Handed-off modem descriptor is not a UDP socket");
+        return false;
+    }
+
+    close();
+    m_socket = fd;
+    return true;
+}
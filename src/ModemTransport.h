@@ -0,0 +1,151 @@
+#pragma once
+
+#include "Config.h"
+#include "FrameTrace.h"
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+// Byte link to an MMDVM modem. ModemSerial does the framing and the command
+// engine on top; a transport only moves bytes.
+//
+// Writes are batched the same way on every link: a frame written while
+// another thread is putting a batch on the wire is queued, and that thread
+// sends everything queued in one more batch before it returns. An idle link
+// costs one write per frame, a busy one amortizes its syscalls. How a batch
+// goes on the wire is up to the transport.
+class ModemTransport {
+public:
+    struct Stats {
+        uint64_t frames;    // frames accepted by write()
+        uint64_t batches;   // writeBatch() calls
+        uint64_t dropped;   // frames that did not fit the queue
+    };
+
+    virtual ~ModemTransport() = default;
+
+    ModemTransport(const ModemTransport&) = delete;
+    ModemTransport& operator=(const ModemTransport&) = delete;
+
+    // Transport for config.transport ("serial", "tcp" or "udp"), nullptr if unknown
+    static std::unique_ptr<ModemTransport> create(const ModemConfig& config);
+
+    virtual bool open() = 0;
+    virtual void close() = 0;
+
+    // Bytes read, 0 if nothing arrived within about 100 ms, -1 on an error
+    // the link does not recover from
+    virtual ssize_t read(uint8_t* buffer, size_t size) = 0;
+
+    // One complete modem frame. Thread-safe. A frame queued behind another
+    // thread's batch reports success once queued - a failure of that batch
+    // is logged by the thread that sent it.
+    bool write(const uint8_t* frame, size_t length);
+
+    // For logs, e.g. "/dev/ttyACM0 @ 460800"
+    virtual std::string describe() const = 0;
+
+    // Descriptor of the open link, -1 if closed or not handed over (handoff)
+    virtual int getDescriptor() const { return -1; }
+
+    // Take over a link another process opened and set up, instead of open()
+    virtual bool adopt(int fd) { (void)fd; return false; }
+
+    Stats getStats();
+
+protected:
+    explicit ModemTransport(size_t queueCapacity);
+
+    // Put whole frames on the link, in order
+    virtual bool writeBatch(const uint8_t* data, size_t length) = 0;
+
+private:
+    const size_t m_queueCapacity;
+
+    std::mutex m_mutex;
+    std::vector<uint8_t> m_queued;   // frames waiting for the current batch to finish
+    std::vector<uint8_t> m_sending;  // batch on the wire (owned by the flushing thread)
+    std::vector<FrameTrace::Stamp> m_queuedStamps;   // traced frames among them
+    std::vector<FrameTrace::Stamp> m_sendingStamps;
+    bool m_flushing;
+    Stats m_stats;
+};
+
+// Local UART or USB CDC port. The speed is set with termios2 (BOTHER), so
+// any rate the driver supports works, not only the Bxxx constants.
+class SerialTransport : public ModemTransport {
+public:
+    SerialTransport(const std::string& port, int baud);
+    ~SerialTransport() override;
+
+    bool open() override;
+    void close() override;
+    ssize_t read(uint8_t* buffer, size_t size) override;
+    std::string describe() const override;
+    int getDescriptor() const override;
+    bool adopt(int fd) override;
+
+protected:
+    // The tty layer buffers, so a batch is one write() looped over short writes
+    bool writeBatch(const uint8_t* data, size_t length) override;
+
+private:
+    const std::string m_port;
+    const int m_baud;
+    int m_fd;
+};
+
+// Serial-to-IP bridge in TCP server mode
+class TcpTransport : public ModemTransport {
+public:
+    TcpTransport(const std::string& address, uint16_t port);
+    ~TcpTransport() override;
+
+    bool open() override;
+    void close() override;
+    ssize_t read(uint8_t* buffer, size_t size) override;
+    std::string describe() const override;
+    int getDescriptor() const override;
+    bool adopt(int fd) override;
+
+protected:
+    // Nagle is off so lone frames leave at once; a batch is one send()
+    bool writeBatch(const uint8_t* data, size_t length) override;
+
+private:
+    const std::string m_address;
+    const uint16_t m_port;
+    int m_socket;
+};
+
+// Serial-to-IP bridge in UDP mode. The bridge forwards each datagram to the
+// UART as a byte stream, and whatever it reads back arrives in datagrams.
+class UdpTransport : public ModemTransport {
+public:
+    // Keeps every datagram clear of IP fragmentation on the usual paths
+    static const size_t MAX_DATAGRAM = 1400;
+
+    UdpTransport(const std::string& address, uint16_t port, uint16_t localPort);
+    ~UdpTransport() override;
+
+    bool open() override;
+    void close() override;
+    ssize_t read(uint8_t* buffer, size_t size) override;
+    std::string describe() const override;
+    int getDescriptor() const override;
+    bool adopt(int fd) override;
+
+protected:
+    // As many whole frames per datagram as fit in MAX_DATAGRAM
+    bool writeBatch(const uint8_t* data, size_t length) override;
+
+private:
+    const std::string m_address;
+    const uint16_t m_port;
+    const uint16_t m_localPort;
+    int m_socket;
+};
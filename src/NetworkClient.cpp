@@ -5,15 +5,29 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <unistd.h>
+#include <cerrno>
 #include <cstring>
-#include <chrono>
+#include <ctime>
+
+static const uint32_t AUTH_TIMEOUT_MS = 5000;
+
+// A partial bundle goes out once records stop arriving for this long
+// (one record is due every 20 ms)
+static const uint32_t BUNDLE_IDLE_FLUSH_MS = 60;
 
 NetworkClient::NetworkClient(const ReflectorConfig& config)
     : m_config(config)
     , m_socket(-1)
+    , m_timestamping(false)
     , m_running(false)
     , m_connected(false)
     , m_authenticated(false)
+    , m_authState(AuthState::Pending)
+    , m_ingress(config)
+    , m_bundling(false)
+    , m_bundlesSent(0)
+    , m_recordsBundled(0)
+    , m_bundleStamps()
 {
 }
 
@@ -22,6 +36,12 @@ NetworkClient::~NetworkClient() {
 }
 
 bool NetworkClient::start() {
+    return start([this](const P25FrameView& frame) {
+        m_dataHandler(frame);
+    });
+}
+
+bool NetworkClient::connectSocket() {
     LOG_INFO("Starting network client...");
 
     // Create UDP socket
@@ -37,6 +57,8 @@ bool NetworkClient::start() {
     tv.tv_usec = 100000;  // 100ms timeout
     setsockopt(m_socket, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
 
+    enableTimestamps();
+
     // Connect to reflector
     struct sockaddr_in serverAddr;
     memset(&serverAddr, 0, sizeof(serverAddr));
@@ -59,22 +81,142 @@ bool NetworkClient::start() {
     m_connected = true;
     LOG_INFO("Connected to reflector at " + m_config.address + ":" + std::to_string(m_config.port));
 
-    // Authenticate
+    return true;
+}
+
+void NetworkClient::enableTimestamps() {
+    // Kernel arrival stamps show how long datagrams waited for the receive thread
+    int on = 1;
+    m_timestamping = Realtime::getInstance().isEnabled() &&
+        setsockopt(m_socket, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on)) == 0;
+}
+
+bool NetworkClient::handshake() {
+    LOG_INFO("Receive thread started");
+
     if (!authenticate()) {
         LOG_ERROR("Authentication failed");
         stop();
         return false;
     }
 
-    // Start threads
-    m_running = true;
-    m_receiveThread = std::thread(&NetworkClient::receiveThread, this);
-    m_keepaliveThread = std::thread(&NetworkClient::keepaliveThread, this);
+    startKeepalive();
 
     LOG_INFO("Network client started successfully");
     return true;
 }
 
+void NetworkClient::startKeepalive() {
+    if (m_config.keepalive_interval <= 0) {
+        return;
+    }
+
+    TimerWheel::getInstance().schedulePeriodic(m_keepaliveTimer, m_config.keepalive_interval * 1000, [this]() {
+        if (m_authenticated) {
+            sendKeepalive();
+
+            m_keepaliveHandler();
+        }
+    });
+}
+
+bool NetworkClient::resume() {
+    return resume([this](const P25FrameView& frame) {
+        m_dataHandler(frame);
+    });
+}
+
+void NetworkClient::suspend() {
+    TimerWheel::getInstance().cancel(m_keepaliveTimer);
+    TimerWheel::getInstance().cancel(m_bundleTimer);
+
+    // Nothing half-bundled stays behind
+    {
+        std::lock_guard<std::mutex> lock(m_sendMutex);
+        flushBundleLocked();
+    }
+
+    m_running = false;
+    if (m_receiveThread.joinable()) {
+        m_receiveThread.join();
+    }
+}
+
+bool NetworkClient::adopt(int fd) {
+    int type = 0;
+    socklen_t length = sizeof(type);
+    if (m_socket >= 0 || getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &length) != 0 || type != SOCK_DGRAM) {
+        LOG_ERROR("Handed-off reflector descriptor is not a UDP socket");
+        return false;
+    }
+
+    // The receive timeout and the reflector address came with the socket
+    m_socket = fd;
+    enableTimestamps();
+    m_connected = true;
+    LOG_INFO("Took over reflector link to " + m_config.address + ":" + std::to_string(m_config.port));
+    return true;
+}
+
+void NetworkClient::detach() {
+    if (m_socket < 0) {
+        return;
+    }
+
+    suspend();
+    close(m_socket);
+    m_socket = -1;
+    m_connected = false;
+    m_authenticated = false;
+    m_bundling = false;
+    LOG_INFO("Let go of reflector link");
+}
+
+// Saved with the socket so a handoff to another reflector fails
+struct SavedLink {
+    char address[64];
+    uint16_t port;
+    uint32_t radioId;
+    bool authenticated;
+    bool bundling;
+};
+
+void NetworkClient::saveState(StateImage& image) {
+    SavedLink saved = {};
+    strncpy(saved.address, m_config.address.c_str(), sizeof(saved.address) - 1);
+    saved.port = m_config.port;
+    saved.radioId = m_config.radio_id;
+    saved.authenticated = m_authenticated.load();
+    saved.bundling = m_bundling.load();
+    image.put(saved);
+}
+
+bool NetworkClient::restoreState(StateImage& image) {
+    SavedLink saved;
+    if (!image.get(saved)) {
+        return false;
+    }
+
+    saved.address[sizeof(saved.address) - 1] = '\0';
+    if (m_config.address != saved.address || m_config.port != saved.port || m_config.radio_id != saved.radioId) {
+        LOG_ERROR("Handed-off link is to " + std::string(saved.address) + ":" + std::to_string(saved.port) +
+                  " as " + std::to_string(saved.radioId) + " - not what this config has");
+        return false;
+    }
+    if (!saved.authenticated) {
+        LOG_ERROR("Handed-off reflector link was not authenticated");
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_authMutex);
+        m_authState = AuthState::Accepted;
+    }
+    m_bundling = saved.bundling && m_config.bundle_ldu;
+    m_authenticated = true;
+    return true;
+}
+
 void NetworkClient::stop() {
     if (!m_running) {
         return;
@@ -83,19 +225,27 @@ void NetworkClient::stop() {
     LOG_INFO("Stopping network client...");
     m_running = false;
 
+    TimerWheel::getInstance().cancel(m_keepaliveTimer);
+    TimerWheel::getInstance().cancel(m_bundleTimer);
+
+    if (m_bundling) {
+        std::lock_guard<std::mutex> lock(m_sendMutex);
+        flushBundleLocked();
+        m_bundling = false;
+        LOG_INFO("Sent " + std::to_string(m_recordsBundled) + " LDU records in " + std::to_string(m_bundlesSent) +
+                 " bundles");
+    }
+
     // Send unlink packet
     if (m_authenticated) {
-        auto unlinkPacket = P25Protocol::buildUnlinkPacket();
-        sendData(unlinkPacket);
+        uint8_t unlinkPacket[1];
+        sendData(unlinkPacket, P25Protocol::writeUnlinkPacket(unlinkPacket, sizeof(unlinkPacket)));
     }
 
     // Wait for threads
     if (m_receiveThread.joinable()) {
         m_receiveThread.join();
     }
-    if (m_keepaliveThread.joinable()) {
-        m_keepaliveThread.join();
-    }
 
     // Close socket
     if (m_socket >= 0) {
@@ -106,17 +256,70 @@ void NetworkClient::stop() {
     m_connected = false;
     m_authenticated = false;
 
+    IngressGuard::Stats ingress = m_ingress.getStats();
+    if (m_ingress.getTotalDropped() > 0) {
+        LOG_INFO("Rejected from reflector: " + std::to_string(ingress.malformed) + " malformed, " +
+                 std::to_string(ingress.unknown) + " unknown type, rate-limited " +
+                 std::to_string(ingress.rateLimited[0]) + " voice/" + std::to_string(ingress.rateLimited[1]) +
+                 " TSBK/" + std::to_string(ingress.rateLimited[2]) + " control");
+    }
+
     LOG_INFO("Network client stopped");
 }
 
-bool NetworkClient::sendData(const std::vector<uint8_t>& data) {
-    if (!m_connected || m_socket < 0) {
+bool NetworkClient::sendData(const uint8_t* data, size_t length) {
+    if (!m_connected || m_socket < 0 || length == 0) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_sendMutex);
+    return sendLocked(data, length);
+}
+
+bool NetworkClient::sendData(const P25FrameView& frame) {
+    // The frame's trace stamps ride along until it is on the wire
+    FrameTrace::Stamp stamp;
+    FrameTrace::take(stamp);
+
+    if (!m_connected || m_socket < 0 || frame.empty()) {
         return false;
     }
 
     std::lock_guard<std::mutex> lock(m_sendMutex);
 
-    ssize_t sent = send(m_socket, data.data(), data.size(), 0);
+    if (!m_bundling.load(std::memory_order_relaxed)) {
+        return sendTracedLocked(frame.data(), frame.size(), stamp);
+    }
+
+    if (P25Protocol::isVoiceFrame(frame.frameType())) {
+        if (!m_bundler.add(frame)) {
+            flushBundleLocked();
+            if (!m_bundler.add(frame)) {
+                return sendTracedLocked(frame.data(), frame.size(), stamp);
+            }
+        }
+        m_bundleStamps[m_bundler.getRecordCount() - 1] = stamp;
+
+        if (m_bundler.isComplete()) {
+            return flushBundleLocked();
+        }
+
+        // Don't sit on a partial LDU if the rest never comes
+        TimerWheel::getInstance().schedule(m_bundleTimer, BUNDLE_IDLE_FLUSH_MS, [this]() {
+            std::lock_guard<std::mutex> lock(m_sendMutex);
+            flushBundleLocked();
+        });
+        return true;
+    }
+
+    flushBundleLocked();
+    return sendTracedLocked(frame.data(), frame.size(), stamp);
+}
+
+bool NetworkClient::sendLocked(const uint8_t* data, size_t length) {
+    FrameCapture::record(CaptureStream::NetworkTx, 0, data, length);
+
+    ssize_t sent = send(m_socket, data, length, 0);
     if (sent < 0) {
         LOG_ERROR("Failed to send data to reflector");
         return false;
@@ -125,107 +328,161 @@ bool NetworkClient::sendData(const std::vector<uint8_t>& data) {
     return true;
 }
 
+bool NetworkClient::sendTracedLocked(const uint8_t* data, size_t length, const FrameTrace::Stamp& stamp) {
+    if (stamp.originNs == 0) {
+        return sendLocked(data, length);
+    }
+
+    uint64_t startNs = FrameTrace::nowNs();
+    bool sent = sendLocked(data, length);
+    FrameTrace::complete(CallDirection::RF, stamp, startNs, FrameTrace::nowNs());
+    return sent;
+}
+
+bool NetworkClient::flushBundleLocked() {
+    if (m_bundler.empty()) {
+        return true;
+    }
+
+    P25FrameView bundle = m_bundler.view();
+    size_t records = m_bundler.getRecordCount();
+    m_bundlesSent++;
+    m_recordsBundled += records;
+
+    // Every record of the bundle waited for the last one
+    uint64_t startNs = FrameTrace::getInstance().isEnabled() ? FrameTrace::nowNs() : 0;
+    bool sent = m_socket >= 0 && sendLocked(bundle.data(), bundle.size());
+    if (startNs != 0) {
+        uint64_t endNs = FrameTrace::nowNs();
+        for (size_t i = 0; i < records; i++) {
+            FrameTrace::complete(CallDirection::RF, m_bundleStamps[i], startNs, endNs);
+        }
+    }
+    m_bundler.reset();
+    return sent;
+}
+
 bool NetworkClient::authenticate() {
     LOG_INFO("Authenticating with reflector...");
     LOG_INFO("Radio ID: " + std::to_string(m_config.radio_id) + " (" + m_config.callsign + ")");
 
+    {
+        std::lock_guard<std::mutex> lock(m_authMutex);
+        m_authState = AuthState::Pending;
+    }
+
     // Build and send auth request
-    auto authPacket = P25Protocol::buildAuthRequest(m_config.radio_id, m_config.password);
-    if (!sendData(authPacket)) {
+    uint8_t authPacket[P25_MAX_FRAME_LENGTH];
+    size_t authLength = P25Protocol::writeAuthRequest(authPacket, sizeof(authPacket), m_config.radio_id, m_config.password);
+    if (authLength == 0) {
+        LOG_ERROR("Password too long for auth request");
+        return false;
+    }
+    if (!sendData(authPacket, authLength)) {
         LOG_ERROR("Failed to send auth request");
         return false;
     }
 
-    // Wait for response (max 5 seconds)
-    auto startTime = std::chrono::steady_clock::now();
-    const int timeoutMs = 5000;
+    TimerWheel::getInstance().schedule(m_authTimer, AUTH_TIMEOUT_MS, [this]() {
+        std::lock_guard<std::mutex> lock(m_authMutex);
+        if (m_authState == AuthState::Pending) {
+            m_authState = AuthState::TimedOut;
+            m_authCv.notify_all();
+        }
+    });
 
-    std::vector<uint8_t> buffer(1024);
+    AuthState result;
+    {
+        std::unique_lock<std::mutex> lock(m_authMutex);
+        m_authCv.wait(lock, [this]() { return m_authState != AuthState::Pending; });
+        result = m_authState;
+    }
 
-    while (true) {
-        auto now = std::chrono::steady_clock::now();
-        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - startTime).count();
+    TimerWheel::getInstance().cancel(m_authTimer);
 
-        if (elapsed > timeoutMs) {
+    switch (result) {
+        case AuthState::Accepted:
+            LOG_INFO("✓ Authentication successful!");
+            if (m_config.bundle_ldu) {
+                LOG_INFO(m_bundling ? "LDU bundling enabled - one datagram per LDU"
+                                    : "Reflector does not support LDU bundling - sending records individually");
+            }
+            return true;
+        case AuthState::Rejected:
+            LOG_ERROR("✗ Authentication rejected by server");
+            return false;
+        default:
             LOG_ERROR("Authentication timeout");
             return false;
-        }
+    }
+}
 
-        ssize_t received = recv(m_socket, buffer.data(), buffer.size(), 0);
-        if (received > 0) {
-            buffer.resize(received);
-
-            // Check if this is an auth response
-            if (buffer[0] == FRAME_AUTH_RESPONSE) {
-                bool authenticated = false;
-                if (P25Protocol::parseAuthResponse(buffer, authenticated)) {
-                    if (authenticated) {
-                        m_authenticated = true;
-                        LOG_INFO("✓ Authentication successful!");
-                        return true;
-                    } else {
-                        LOG_ERROR("✗ Authentication rejected by server");
-                        return false;
-                    }
-                }
-            }
-        }
+void NetworkClient::handleAuthResponse(const P25FrameView& frame) {
+    bool authenticated = false;
+    uint8_t capabilities = 0;
+    if (!P25Protocol::parseAuthResponse(frame, authenticated, capabilities)) {
+        return;
+    }
 
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    std::lock_guard<std::mutex> lock(m_authMutex);
+    if (m_authState != AuthState::Pending) {
+        return;
     }
 
-    return false;
+    // In effect before anything can be sent as authenticated
+    m_bundling = authenticated && m_config.bundle_ldu && (capabilities & REFLECTOR_CAP_LDU_BUNDLE) != 0;
+    m_authenticated = authenticated;
+    m_authState = authenticated ? AuthState::Accepted : AuthState::Rejected;
+    m_authCv.notify_all();
 }
 
-void NetworkClient::receiveThread() {
-    LOG_INFO("Receive thread started");
-
-    std::vector<uint8_t> buffer(2048);
-
+ssize_t NetworkClient::receiveDatagram(uint8_t* buffer, size_t size) {
     while (m_running) {
-        ssize_t received = recv(m_socket, buffer.data(), buffer.size(), 0);
-
-        if (received > 0) {
-            buffer.resize(received);
-
-            // Call data callback if set
-            if (m_dataCallback) {
-                m_dataCallback(buffer);
-            }
-
-            buffer.resize(2048);  // Reset buffer size
-        } else if (received < 0) {
-            // Check if it's just a timeout (expected with SO_RCVTIMEO)
-            if (errno != EAGAIN && errno != EWOULDBLOCK) {
-                LOG_ERROR("Receive error: " + std::string(strerror(errno)));
-                break;
-            }
+        ssize_t received = m_timestamping ? receiveStamped(buffer, size) : recv(m_socket, buffer, size, 0);
+        // A timeout is expected with SO_RCVTIMEO
+        if (received >= 0 || errno == EAGAIN || errno == EWOULDBLOCK) {
+            return received > 0 ? received : 0;
         }
+
+        LOG_ERROR("Receive error: " + std::string(strerror(errno)));
+        break;
     }
 
     LOG_INFO("Receive thread stopped");
+    return -1;
 }
 
-void NetworkClient::keepaliveThread() {
-    LOG_INFO("Keepalive thread started");
-
-    while (m_running) {
-        if (m_authenticated) {
-            sendKeepalive();
-        }
+ssize_t NetworkClient::receiveStamped(uint8_t* buffer, size_t size) {
+    struct iovec iov = {buffer, size};
+    alignas(struct cmsghdr) uint8_t control[CMSG_SPACE(sizeof(struct timespec))];
+    struct msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    ssize_t received = recvmsg(m_socket, &msg, 0);
+    if (received <= 0) {
+        return received;
+    }
 
-        // Sleep for keepalive interval
-        for (int i = 0; i < m_config.keepalive_interval && m_running; i++) {
-            std::this_thread::sleep_for(std::chrono::seconds(1));
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+            struct timespec arrived;
+            struct timespec now;
+            memcpy(&arrived, CMSG_DATA(cmsg), sizeof(arrived));
+            clock_gettime(CLOCK_REALTIME, &now);
+            int64_t lateNs = (static_cast<int64_t>(now.tv_sec) - arrived.tv_sec) * 1000000000 +
+                             (now.tv_nsec - arrived.tv_nsec);
+            Realtime::getInstance().noteLatency(RealtimeThread::Network, lateNs);
         }
     }
-
-    LOG_INFO("Keepalive thread stopped");
+    return received;
 }
 
 void NetworkClient::sendKeepalive() {
-    auto pollPacket = P25Protocol::buildPollPacket();
-    if (!sendData(pollPacket)) {
+    uint8_t pollPacket[1];
+    if (!sendData(pollPacket, P25Protocol::writePollPacket(pollPacket, sizeof(pollPacket)))) {
         LOG_WARN("Failed to send keepalive");
     } else {
         LOG_DEBUG("Sent keepalive");
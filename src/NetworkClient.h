@@ -1,6 +1,18 @@
 #pragma once
 
 #include "Config.h"
+#include "P25Frame.h"
+#include "P25Protocol.h"
+#include "TimerWheel.h"
+#include "HandlerSlot.h"
+#include "LduBundler.h"
+#include "IngressGuard.h"
+#include "Realtime.h"
+#include "AllocTrace.h"
+#include "FrameTrace.h"
+#include "FrameCapture.h"
+#include "Clock.h"
+#include "StateImage.h"
 #include <string>
 #include <vector>
 #include <cstdint>
@@ -8,39 +20,208 @@
 #include <atomic>
 #include <thread>
 #include <mutex>
+#include <condition_variable>
+#include <sys/types.h>
 
 class NetworkClient {
 public:
-    using DataCallback = std::function<void(const std::vector<uint8_t>&)>;
-
     NetworkClient(const ReflectorConfig& config);
     ~NetworkClient();
 
+    // Frames from the reflector go to the handler published with setDataHandler()
     bool start();
+
+    // Fixed wiring: frames go straight to sink(frame), which is compiled
+    // into the receive loop. The published handler is never consulted.
+    template <typename Sink>
+    bool start(Sink sink);
+
     void stop();
 
-    bool sendData(const std::vector<uint8_t>& data);
+    // Handoff to a new process. suspend() stops the receive thread and the
+    // keepalive, leaving the socket open and the reflector linked;
+    // stopReading() only asks the thread to stop. resume() carries on
+    // without authenticating again - on this socket, or on one taken over
+    // with adopt(). detach() lets go of the socket without unlinking.
+    void stopReading() { m_running = false; }
+    void suspend();
+    bool adopt(int fd);
+    bool resume();
+    template <typename Sink>
+    bool resume(Sink sink);
+    void detach();
+
+    int getDescriptor() const { return m_socket; }
+
+    // Link state the new process needs: authenticated, bundling negotiated
+    void saveState(StateImage& image);
+    bool restoreState(StateImage& image);
+
+    bool sendData(const uint8_t* data, size_t length);
+
+    // Send a P25 record. With bundling negotiated, LDU records are held
+    // until their LDU is complete and go out as one datagram; anything else
+    // flushes the pending bundle first so ordering is kept.
+    bool sendData(const P25FrameView& frame);
+
+    bool isBundling() const { return m_bundling.load(std::memory_order_relaxed); }
     bool isConnected() const { return m_connected.load(); }
     bool isAuthenticated() const { return m_authenticated.load(); }
 
-    void setDataCallback(DataCallback callback) { m_dataCallback = callback; }
+    const ReflectorConfig& getConfig() const { return m_config; }
+
+    // Datagrams rejected before dispatch (length, unknown type, rate)
+    IngressGuard::Stats getIngressStats() const { return m_ingress.getStats(); }
+
+    // Safe to publish or clear while the receive thread is running
+    template <typename T, void (T::*Method)(const P25FrameView&)>
+    void setDataHandler(T* object) { m_dataHandler.template bind<T, Method>(object); }
+    void clearDataHandler() { m_dataHandler.clear(); }
+
+    // Runs on the timer wheel thread after every poll
+    template <typename T, void (T::*Method)()>
+    void setKeepaliveHandler(T* object) { m_keepaliveHandler.template bind<T, Method>(object); }
+    void clearKeepaliveHandler() { m_keepaliveHandler.clear(); }
 
 private:
-    void receiveThread();
-    void keepaliveThread();
+    bool connectSocket();
+    bool handshake();
+    void enableTimestamps();
+    void startKeepalive();
+
+    template <typename Sink>
+    void receiveLoop(Sink& sink);
+
+    // Bytes received, 0 on timeout, -1 once stopped or on a socket error
+    ssize_t receiveDatagram(uint8_t* buffer, size_t size);
+
+    // recv() that reports how long the datagram sat in the socket
+    ssize_t receiveStamped(uint8_t* buffer, size_t size);
+
+    bool sendLocked(const uint8_t* data, size_t length);
+    bool sendTracedLocked(const uint8_t* data, size_t length, const FrameTrace::Stamp& stamp);
+    bool flushBundleLocked();
 
     bool authenticate();
+    void handleAuthResponse(const P25FrameView& frame);
     void sendKeepalive();
 
     const ReflectorConfig& m_config;
     int m_socket;
+    bool m_timestamping;   // SO_TIMESTAMPNS on (realtime mode)
     std::atomic<bool> m_running;
     std::atomic<bool> m_connected;
     std::atomic<bool> m_authenticated;
 
     std::thread m_receiveThread;
-    std::thread m_keepaliveThread;
 
-    DataCallback m_dataCallback;
+    // Auth handshake - completed by the receive thread or the timeout timer
+    enum class AuthState { Pending, Accepted, Rejected, TimedOut };
+    std::mutex m_authMutex;
+    std::condition_variable m_authCv;
+    AuthState m_authState;
+
+    // Receive thread only
+    IngressGuard m_ingress;
+
+    HandlerSlot<const P25FrameView&> m_dataHandler;
+    HandlerSlot<> m_keepaliveHandler;
     std::mutex m_sendMutex;
+
+    // LDU bundling, if configured and the reflector advertised it (guarded by m_sendMutex)
+    std::atomic<bool> m_bundling;
+    LduBundler m_bundler;
+    uint64_t m_bundlesSent;
+    uint64_t m_recordsBundled;
+    FrameTrace::Stamp m_bundleStamps[LduBundler::MAX_RECORDS];  // trace of each pending record
+    TimerWheel::Timer m_bundleTimer;
+
+    TimerWheel::Timer m_authTimer;
+    TimerWheel::Timer m_keepaliveTimer;
 };
+
+template <typename Sink>
+bool NetworkClient::start(Sink sink) {
+    if (!connectSocket()) {
+        return false;
+    }
+
+    // The receive thread picks up the auth response
+    m_running = true;
+    m_receiveThread = std::thread([this, sink]() mutable {
+        Realtime::getInstance().enterThread(RealtimeThread::Network);
+        AllocTrace::enterThread(AllocSite::Network);
+        receiveLoop(sink);
+    });
+
+    return handshake();
+}
+
+template <typename Sink>
+bool NetworkClient::resume(Sink sink) {
+    if (!m_connected || !m_authenticated || m_running) {
+        return false;
+    }
+
+    m_running = true;
+    m_receiveThread = std::thread([this, sink]() mutable {
+        Realtime::getInstance().enterThread(RealtimeThread::Network);
+        AllocTrace::enterThread(AllocSite::Network);
+        receiveLoop(sink);
+    });
+
+    startKeepalive();
+    return true;
+}
+
+template <typename Sink>
+void NetworkClient::receiveLoop(Sink& sink) {
+    uint8_t buffer[2048];
+
+    ssize_t received;
+    while ((received = receiveDatagram(buffer, sizeof(buffer))) >= 0) {
+        if (received == 0) {
+            continue;
+        }
+
+        FrameCapture::record(CaptureStream::NetworkRx, 0, buffer, static_cast<size_t>(received));
+
+        // The view points straight into the receive buffer
+        P25FrameView frame(buffer, static_cast<size_t>(received));
+        uint64_t arrivedNs = FrameTrace::arrivalNs();
+        uint64_t nowMs = Clock::nowMs();
+
+        // Length and rate checks before anything looks inside
+        if (m_ingress.admit(frame, nowMs) != IngressGuard::Verdict::Accept) {
+            continue;
+        }
+
+        if (!m_authenticated) {
+            // Nothing but the auth response matters until we're in
+            if (frame.frameType() == FRAME_AUTH_RESPONSE) {
+                handleAuthResponse(frame);
+            }
+            continue;
+        }
+
+        if (frame.frameType() == FRAME_LDU_BUNDLE) {
+            bool valid = LduBundler::unbundle(frame, [&](const P25FrameView& record) {
+                if (m_ingress.admitBundled(record, nowMs) == IngressGuard::Verdict::Accept) {
+                    FrameTrace::begin(CallDirection::Network, arrivedNs);
+                    FrameTrace::mark(TraceStage::Receive);
+                    sink(record);
+                    FrameTrace::abandon();
+                }
+            });
+            if (!valid) {
+                m_ingress.countMalformed();
+            }
+            continue;
+        }
+
+        FrameTrace::begin(CallDirection::Network, arrivedNs);
+        FrameTrace::mark(TraceStage::Receive);
+        sink(frame);
+        FrameTrace::abandon();
+    }
+}
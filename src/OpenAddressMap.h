@@ -0,0 +1,144 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <array>
+
+// Fixed-capacity hash map keyed by a non-zero 32-bit ID (unit, talkgroup).
+// Linear probing with backward-shift deletion, so there are no tombstones and
+// lookups stay O(1) without ever touching the heap. Key 0 marks an empty slot,
+// which is fine because 0 is not a valid P25 unit or talkgroup address.
+template <typename Value, size_t Capacity>
+class OpenAddressMap {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    OpenAddressMap() : m_size(0) { clear(); }
+
+    size_t size() const { return m_size; }
+    size_t capacity() const { return Capacity; }
+    bool full() const { return m_size >= MAX_LOAD; }
+
+    void clear() {
+        for (auto& slot : m_slots) {
+            slot.key = 0;
+        }
+        m_size = 0;
+    }
+
+    Value* find(uint32_t key) {
+        if (key == 0) {
+            return nullptr;
+        }
+        for (size_t i = home(key);; i = next(i)) {
+            if (m_slots[i].key == key) {
+                return &m_slots[i].value;
+            }
+            if (m_slots[i].key == 0) {
+                return nullptr;
+            }
+        }
+    }
+
+    const Value* find(uint32_t key) const {
+        return const_cast<OpenAddressMap*>(this)->find(key);
+    }
+
+    // Returns the existing entry or a value-initialized new one; nullptr when
+    // the key is invalid or the table is at its load limit.
+    Value* insert(uint32_t key, bool* created = nullptr) {
+        if (key == 0) {
+            return nullptr;
+        }
+        for (size_t i = home(key);; i = next(i)) {
+            if (m_slots[i].key == key) {
+                if (created) *created = false;
+                return &m_slots[i].value;
+            }
+            if (m_slots[i].key == 0) {
+                if (full()) {
+                    return nullptr;
+                }
+                m_slots[i].key = key;
+                m_slots[i].value = Value();
+                m_size++;
+                if (created) *created = true;
+                return &m_slots[i].value;
+            }
+        }
+    }
+
+    bool erase(uint32_t key) {
+        if (key == 0) {
+            return false;
+        }
+
+        size_t i = home(key);
+        while (m_slots[i].key != key) {
+            if (m_slots[i].key == 0) {
+                return false;
+            }
+            i = next(i);
+        }
+
+        // Shift later members of the probe run back into the hole
+        size_t hole = i;
+        for (size_t j = next(hole); m_slots[j].key != 0; j = next(j)) {
+            size_t want = home(m_slots[j].key);
+            bool movable = (hole <= j) ? (want <= hole || want > j) : (want <= hole && want > j);
+            if (movable) {
+                m_slots[hole] = m_slots[j];
+                hole = j;
+            }
+        }
+        m_slots[hole].key = 0;
+        m_size--;
+        return true;
+    }
+
+    // fn(key, value) for every entry. The map must not be modified from fn.
+    template <typename Fn>
+    void forEach(Fn&& fn) {
+        for (auto& slot : m_slots) {
+            if (slot.key != 0) {
+                fn(slot.key, slot.value);
+            }
+        }
+    }
+
+    template <typename Fn>
+    void forEach(Fn&& fn) const {
+        for (const auto& slot : m_slots) {
+            if (slot.key != 0) {
+                fn(slot.key, slot.value);
+            }
+        }
+    }
+
+private:
+    // Keep probe runs short - refuse inserts past 7/8 full
+    static const size_t MAX_LOAD = Capacity - Capacity / 8;
+
+    struct Slot {
+        uint32_t key;
+        Value value;
+    };
+
+    static constexpr unsigned hashShift() {
+        unsigned bits = 0;
+        for (size_t c = Capacity; c > 1; c >>= 1) {
+            bits++;
+        }
+        return 32 - bits;
+    }
+
+    static size_t home(uint32_t key) {
+        // Fibonacci hashing - take the top bits so sequential IDs spread out
+        return static_cast<size_t>(static_cast<uint32_t>(key * 2654435769u) >> hashShift());
+    }
+
+    static size_t next(size_t index) { return (index + 1) & (Capacity - 1); }
+
+    std::array<Slot, Capacity> m_slots;
+    size_t m_size;
+};
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+// Largest record we ever build or accept on either link (modem length byte is 8 bits)
+const size_t P25_MAX_FRAME_LENGTH = 255;
+
+// Link control layout inside voice records (simplified - matches reflector)
+//   [0] frame type  [1] LCF  [2] MFID  [3] service options  [5..6] TG  [7..9] source
+const size_t LC_LCF_OFFSET = 1;
+const size_t LC_MFID_OFFSET = 2;
+const size_t LC_SVC_OPTIONS_OFFSET = 3;
+const size_t LC_TG_OFFSET = 5;
+const size_t LC_SRC_OFFSET = 7;
+const size_t LC_MIN_LENGTH = 10;
+
+// Voice records carry one IMBE frame in their last 11 bytes (simplified - matches reflector)
+const size_t IMBE_FRAME_LENGTH = 11;
+
+// Service option bits
+const uint8_t SVC_OPT_EMERGENCY = 0x80;
+const uint8_t SVC_OPT_ENCRYPTED = 0x40;
+
+// TSBK layout: [0] 0x61  [1] LB|P|opcode  [2] MFID  [3..10] arguments  [11..12] CRC
+const size_t TSBK_OPCODE_OFFSET = 1;
+const size_t TSBK_MFID_OFFSET = 2;
+const size_t TSBK_ARGS_OFFSET = 3;
+const size_t TSBK_ARGS_LENGTH = 8;
+const size_t TSBK_LENGTH = 13;
+
+// Non-owning view over a single P25 record. Nothing is copied, so the view is
+// only valid while the buffer it points into is. Accessors return 0 when the
+// record is too short for the field, same as the old vector-based helpers.
+class P25FrameView {
+public:
+    P25FrameView() : m_data(nullptr), m_size(0) {}
+    P25FrameView(const uint8_t* data, size_t size) : m_data(data), m_size(size) {}
+
+    // Implicit so existing std::vector call sites keep compiling
+    P25FrameView(const std::vector<uint8_t>& data) : m_data(data.data()), m_size(data.size()) {}
+
+    const uint8_t* data() const { return m_data; }
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    uint8_t operator[](size_t index) const { return m_data[index]; }
+
+    std::vector<uint8_t> toVector() const { return std::vector<uint8_t>(m_data, m_data + m_size); }
+
+    uint8_t frameType() const { return m_size > 0 ? m_data[0] : 0; }
+
+    // Link control
+    bool hasLinkControl() const { return m_size >= LC_MIN_LENGTH; }
+    uint8_t lcf() const { return byteAt(LC_LCF_OFFSET); }
+    uint8_t mfid() const { return byteAt(LC_MFID_OFFSET); }
+    uint8_t serviceOptions() const { return byteAt(LC_SVC_OPTIONS_OFFSET); }
+    bool isEmergency() const { return (serviceOptions() & SVC_OPT_EMERGENCY) != 0; }
+    bool isEncrypted() const { return (serviceOptions() & SVC_OPT_ENCRYPTED) != 0; }
+
+    uint32_t talkgroupId() const {
+        if (m_size < LC_TG_OFFSET + 2) {
+            return 0;
+        }
+        return (m_data[LC_TG_OFFSET] << 8) | m_data[LC_TG_OFFSET + 1];
+    }
+
+    uint32_t sourceId() const {
+        if (m_size < LC_SRC_OFFSET + 3) {
+            return 0;
+        }
+        return (m_data[LC_SRC_OFFSET] << 16) | (m_data[LC_SRC_OFFSET + 1] << 8) | m_data[LC_SRC_OFFSET + 2];
+    }
+
+    // TSBK
+    bool hasTsbk() const { return m_size >= TSBK_LENGTH; }
+    uint8_t tsbkOpcode() const { return byteAt(TSBK_OPCODE_OFFSET) & 0x3F; }
+    bool tsbkLastBlock() const { return (byteAt(TSBK_OPCODE_OFFSET) & 0x80) != 0; }
+    bool tsbkProtected() const { return (byteAt(TSBK_OPCODE_OFFSET) & 0x40) != 0; }
+    uint8_t tsbkMfid() const { return byteAt(TSBK_MFID_OFFSET); }
+
+    // Big-endian field of 'count' bytes starting at argument byte 'offset' (0-7)
+    uint32_t tsbkField(size_t offset, size_t count) const {
+        uint32_t value = 0;
+        for (size_t i = 0; i < count; i++) {
+            value = (value << 8) | byteAt(TSBK_ARGS_OFFSET + offset + i);
+        }
+        return value;
+    }
+
+private:
+    uint8_t byteAt(size_t offset) const { return offset < m_size ? m_data[offset] : 0; }
+
+    const uint8_t* m_data;
+    size_t m_size;
+};
+
+// Serializes a record into a caller-provided buffer. Writes past the end are
+// dropped and mark the writer as overflowed; size() then reports 0.
+class P25FrameWriter {
+public:
+    P25FrameWriter(uint8_t* buffer, size_t capacity)
+        : m_buffer(buffer), m_capacity(capacity), m_length(0), m_overflow(false) {}
+
+    void put8(uint8_t value) {
+        if (m_length >= m_capacity) {
+            m_overflow = true;
+            return;
+        }
+        m_buffer[m_length++] = value;
+    }
+
+    void put16(uint16_t value) {
+        put8((value >> 8) & 0xFF);
+        put8(value & 0xFF);
+    }
+
+    void put24(uint32_t value) {
+        put8((value >> 16) & 0xFF);
+        put8((value >> 8) & 0xFF);
+        put8(value & 0xFF);
+    }
+
+    void put32(uint32_t value) {
+        put8((value >> 24) & 0xFF);
+        put8((value >> 16) & 0xFF);
+        put8((value >> 8) & 0xFF);
+        put8(value & 0xFF);
+    }
+
+    void putBytes(const void* data, size_t length) {
+        if (m_length + length > m_capacity) {
+            m_overflow = true;
+            return;
+        }
+        memcpy(m_buffer + m_length, data, length);
+        m_length += length;
+    }
+
+    bool ok() const { return !m_overflow; }
+    size_t size() const { return m_overflow ? 0 : m_length; }
+    P25FrameView view() const { return P25FrameView(m_buffer, size()); }
+
+private:
+    uint8_t* m_buffer;
+    size_t m_capacity;
+    size_t m_length;
+    bool m_overflow;
+};
@@ -2,83 +2,188 @@
 #include "Logger.h"
 #include <cstring>
 
-std::vector<uint8_t> P25Protocol::buildAuthRequest(uint32_t radioId, const std::string& password) {
+size_t P25Protocol::writeAuthRequest(uint8_t* buffer, size_t capacity, uint32_t radioId, const std::string& password) {
     // Format: 0xF2 + 4 bytes radio_id (big-endian) + password (null-terminated)
-    std::vector<uint8_t> packet;
-    packet.push_back(FRAME_AUTH_REQUEST);
-
-    // Add radio ID (big-endian)
-    packet.push_back((radioId >> 24) & 0xFF);
-    packet.push_back((radioId >> 16) & 0xFF);
-    packet.push_back((radioId >> 8) & 0xFF);
-    packet.push_back(radioId & 0xFF);
-
-    // Add password (null-terminated)
-    for (char c : password) {
-        packet.push_back(static_cast<uint8_t>(c));
-    }
-    packet.push_back(0x00);  // Null terminator
+    P25FrameWriter writer(buffer, capacity);
+    writer.put8(FRAME_AUTH_REQUEST);
+    writer.put32(radioId);
+    writer.putBytes(password.data(), password.size());
+    writer.put8(0x00);  // Null terminator
+    return writer.size();
+}
 
-    return packet;
+size_t P25Protocol::writePollPacket(uint8_t* buffer, size_t capacity) {
+    P25FrameWriter writer(buffer, capacity);
+    writer.put8(FRAME_POLL);
+    return writer.size();
 }
 
-bool P25Protocol::parseAuthResponse(const std::vector<uint8_t>& data, bool& authenticated) {
-    if (data.size() < 2) {
-        return false;
+size_t P25Protocol::writeUnlinkPacket(uint8_t* buffer, size_t capacity) {
+    P25FrameWriter writer(buffer, capacity);
+    writer.put8(FRAME_UNLINK);
+    return writer.size();
+}
+
+size_t P25Protocol::writeTalkgroupSubscribe(uint8_t* buffer, size_t capacity, uint32_t talkgroup) {
+    P25FrameWriter writer(buffer, capacity);
+    writer.put8(FRAME_TG_GRANT);
+    writer.put16(static_cast<uint16_t>(talkgroup));
+    return writer.size();
+}
+
+size_t P25Protocol::writeTalkgroupRelease(uint8_t* buffer, size_t capacity, uint32_t talkgroup) {
+    P25FrameWriter writer(buffer, capacity);
+    writer.put8(FRAME_TG_RELEASE);
+    writer.put16(static_cast<uint16_t>(talkgroup));
+    return writer.size();
+}
+
+size_t P25Protocol::writeTsbk(uint8_t* buffer, size_t capacity, uint8_t opcode, uint8_t mfid, uint64_t args) {
+    P25FrameWriter writer(buffer, capacity);
+    writer.put8(FRAME_TSBK);
+    writer.put8(TSBK_LAST_BLOCK | (opcode & 0x3F));
+    writer.put8(mfid);
+    writer.put32(static_cast<uint32_t>(args >> 32));
+    writer.put32(static_cast<uint32_t>(args));
+    if (!writer.ok()) {
+        return 0;
     }
 
-    if (data[0] != FRAME_AUTH_RESPONSE) {
-        return false;
+    // CRC covers opcode through the last argument byte
+    writer.put16(crcCcitt(buffer + TSBK_OPCODE_OFFSET, TSBK_LENGTH - TSBK_OPCODE_OFFSET - 2));
+    return writer.size();
+}
+
+size_t P25Protocol::writeGroupVoiceGrant(uint8_t* buffer, size_t capacity, uint8_t serviceOptions,
+                                         uint16_t channel, uint32_t talkgroup, uint32_t source) {
+    uint64_t args = serviceOptions;
+    args = (args << 16) | channel;
+    args = (args << 16) | (talkgroup & 0xFFFF);
+    args = (args << 24) | (source & 0xFFFFFF);
+    return writeTsbk(buffer, capacity, TSBK_GRP_V_CH_GRANT, 0x00, args);
+}
+
+size_t P25Protocol::writeRfssStatus(uint8_t* buffer, size_t capacity, const P25Config& site) {
+    // LRA, flags (4), system ID (12), RFSS, site, channel, service class
+    uint64_t args = site.lra;
+    args = (args << 16) | (site.system_id & 0xFFF);
+    args = (args << 8) | site.rfss_id;
+    args = (args << 8) | site.site_id;
+    args = (args << 16) | site.control_channel;
+    args = (args << 8) | site.service_class;
+    return writeTsbk(buffer, capacity, TSBK_RFSS_STS_BCST, 0x00, args);
+}
+
+size_t P25Protocol::writeNetworkStatus(uint8_t* buffer, size_t capacity, const P25Config& site) {
+    // LRA, WACN (20), system ID (12), channel, service class
+    uint64_t args = site.lra;
+    args = (args << 20) | (site.wacn & 0xFFFFF);
+    args = (args << 12) | (site.system_id & 0xFFF);
+    args = (args << 16) | site.control_channel;
+    args = (args << 8) | site.service_class;
+    return writeTsbk(buffer, capacity, TSBK_NET_STS_BCST, 0x00, args);
+}
+
+size_t P25Protocol::writeAdjacentStatus(uint8_t* buffer, size_t capacity, const P25Config& site, const AdjacentSite& adjacent) {
+    // LRA, C/F/V/A flags (4), system ID (12), RFSS, site, channel, service class
+    const uint64_t flagsValidNetworked = 0x3;
+    uint64_t args = site.lra;
+    args = (args << 4) | flagsValidNetworked;
+    args = (args << 12) | (adjacent.system_id & 0xFFF);
+    args = (args << 8) | adjacent.rfss_id;
+    args = (args << 8) | adjacent.site_id;
+    args = (args << 16) | adjacent.channel;
+    args = (args << 8) | site.service_class;
+    return writeTsbk(buffer, capacity, TSBK_ADJ_STS_BCST, 0x00, args);
+}
+
+size_t P25Protocol::writeIdentifierUpdate(uint8_t* buffer, size_t capacity, const ChannelIdentifier& identifier) {
+    uint32_t spacing = (identifier.spacing / 125) & 0x3FF;    // 125 Hz units
+    uint32_t base = identifier.base_frequency / 5;            // 5 Hz units
+    bool negative = identifier.tx_offset < 0;
+    uint32_t offset = static_cast<uint32_t>(negative ? -static_cast<int64_t>(identifier.tx_offset) : identifier.tx_offset);
+
+    uint64_t args = identifier.id & 0x0F;
+
+    if (identifier.base_frequency < 700000000) {
+        // VHF/UHF: bandwidth code, offset in channel spacings
+        uint64_t bandwidth = (identifier.bandwidth <= 6250) ? 0x4 : 0x5;
+        uint32_t steps = identifier.spacing ? (offset / identifier.spacing) & 0x1FFF : 0;
+        args = (args << 4) | bandwidth;
+        args = (args << 1) | (negative ? 0 : 1);
+        args = (args << 13) | steps;
+        args = (args << 10) | spacing;
+        args = (args << 32) | base;
+        return writeTsbk(buffer, capacity, TSBK_IDEN_UP_VU, 0x00, args);
     }
 
-    // 0x01 = success, 0x00 = failure
-    authenticated = (data[1] == 0x01);
-    return true;
+    // 700/800/900 MHz: bandwidth in 125 Hz units, offset in 250 kHz units
+    args = (args << 9) | ((identifier.bandwidth / 125) & 0x1FF);
+    args = (args << 1) | (negative ? 0 : 1);
+    args = (args << 8) | ((offset / 250000) & 0xFF);
+    args = (args << 10) | spacing;
+    args = (args << 32) | base;
+    return writeTsbk(buffer, capacity, TSBK_IDEN_UP, 0x00, args);
 }
 
-std::vector<uint8_t> P25Protocol::buildPollPacket() {
-    std::vector<uint8_t> packet;
-    packet.push_back(FRAME_POLL);
-    return packet;
+uint16_t P25Protocol::crcCcitt(const uint8_t* data, size_t length) {
+    uint16_t crc = 0x0000;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= static_cast<uint16_t>(data[i]) << 8;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? static_cast<uint16_t>((crc << 1) ^ 0x1021) : static_cast<uint16_t>(crc << 1);
+        }
+    }
+    return static_cast<uint16_t>(~crc);
 }
 
-std::vector<uint8_t> P25Protocol::buildUnlinkPacket() {
-    std::vector<uint8_t> packet;
-    packet.push_back(FRAME_UNLINK);
+std::vector<uint8_t> P25Protocol::buildAuthRequest(uint32_t radioId, const std::string& password) {
+    std::vector<uint8_t> packet(5 + password.size() + 1);
+    packet.resize(writeAuthRequest(packet.data(), packet.size(), radioId, password));
     return packet;
 }
 
-bool P25Protocol::isVoiceFrame(uint8_t frameType) {
-    return frameType >= VOICE_FRAME_MIN && frameType <= VOICE_FRAME_MAX;
+bool P25Protocol::parseAuthResponse(const P25FrameView& frame, bool& authenticated) {
+    uint8_t capabilities;
+    return parseAuthResponse(frame, authenticated, capabilities);
 }
 
-uint32_t P25Protocol::extractTalkgroupId(const std::vector<uint8_t>& data) {
-    // Talkgroup ID is typically in bytes 5-6 (16-bit) for P25
-    // This is simplified - real P25 has more complex frame structure
-    if (data.size() < 7) {
-        return 0;
+bool P25Protocol::parseAuthResponse(const P25FrameView& frame, bool& authenticated, uint8_t& capabilities) {
+    if (frame.size() < 2) {
+        return false;
+    }
+
+    if (frame[0] != FRAME_AUTH_RESPONSE) {
+        return false;
     }
 
-    uint32_t tg = 0;
-    tg = (data[5] << 8) | data[6];
-    return tg;
+    // 0x01 = success, 0x00 = failure
+    authenticated = (frame[1] == 0x01);
+    capabilities = frame.size() >= 3 ? frame[2] : 0;
+    return true;
 }
 
-uint32_t P25Protocol::extractSourceId(const std::vector<uint8_t>& data) {
-    // Source ID is typically in bytes 7-9 (24-bit) for P25
-    // This is simplified - real P25 has more complex frame structure
-    if (data.size() < 10) {
-        return 0;
+bool P25Protocol::parseTalkgroupGrant(const P25FrameView& frame, uint32_t& talkgroup, uint32_t& source) {
+    if (frame.size() < 3 || frame[0] != FRAME_TG_GRANT) {
+        return false;
     }
 
-    uint32_t src = 0;
-    src = (data[7] << 16) | (data[8] << 8) | data[9];
-    return src;
+    talkgroup = (frame[1] << 8) | frame[2];
+    source = 0;
+    if (frame.size() >= 6) {
+        source = (frame[3] << 16) | (frame[4] << 8) | frame[5];
+    }
+    return talkgroup != 0;
 }
 
-uint8_t P25Protocol::getFrameType(const std::vector<uint8_t>& data) {
-    if (data.empty()) {
-        return 0;
-    }
-    return data[0];
+std::vector<uint8_t> P25Protocol::buildPollPacket() {
+    std::vector<uint8_t> packet(1);
+    writePollPacket(packet.data(), packet.size());
+    return packet;
+}
+
+std::vector<uint8_t> P25Protocol::buildUnlinkPacket() {
+    std::vector<uint8_t> packet(1);
+    writeUnlinkPacket(packet.data(), packet.size());
+    return packet;
 }
@@ -1,5 +1,8 @@
 #pragma once
 
+#include "P25Frame.h"
+#include "Config.h"
+#include <array>
 #include <cstdint>
 #include <vector>
 #include <string>
@@ -11,6 +14,10 @@ const uint8_t FRAME_AUTH_REQUEST = 0xF2;
 const uint8_t FRAME_AUTH_RESPONSE = 0xF3;
 const uint8_t FRAME_TG_GRANT = 0xF4;
 const uint8_t FRAME_TG_RELEASE = 0xF5;
+const uint8_t FRAME_LDU_BUNDLE = 0xF6;  // Consecutive LDU records in one datagram (see LduBundler)
+
+// Capability bits a reflector may append to a successful auth response
+const uint8_t REFLECTOR_CAP_LDU_BUNDLE = 0x01;
 
 // Voice/Data frames (LDU1)
 const uint8_t FRAME_LDU1_0 = 0x62;
@@ -40,17 +47,126 @@ const uint8_t FRAME_TSBK = 0x61;
 // End of transmission
 const uint8_t FRAME_EOT = 0x80;
 
+// TSBK opcodes (TIA-102.AABC). Most inbound (ISP) requests and their outbound
+// (OSP) responses share an opcode and the link they arrive on tells them
+// apart; deregistration uses a different one each way.
+const uint8_t TSBK_GRP_V_CH_GRANT = 0x00;
+const uint8_t TSBK_GRP_V_CH_GRANT_UPDT = 0x02;
+const uint8_t TSBK_GRP_AFF = 0x28;      // GRP_AFF_REQ / GRP_AFF_RSP
+const uint8_t TSBK_U_REG = 0x2C;        // U_REG_REQ / U_REG_RSP
+const uint8_t TSBK_U_DE_REG_REQ = 0x2B; // ISP only (the OSP 0x2B is LOC_REG_RSP)
+const uint8_t TSBK_U_DE_REG_ACK = 0x2F; // OSP only
+const uint8_t TSBK_IDEN_UP_VU = 0x34;   // Channel identifier, VHF/UHF
+const uint8_t TSBK_RFSS_STS_BCST = 0x3A;
+const uint8_t TSBK_NET_STS_BCST = 0x3B;
+const uint8_t TSBK_ADJ_STS_BCST = 0x3C;
+const uint8_t TSBK_IDEN_UP = 0x3D;      // Channel identifier, 700/800/900 MHz
+
+const uint8_t TSBK_LAST_BLOCK = 0x80;
+
+// TSBK argument offsets (within the 8 argument bytes, simplified - matches reflector)
+//   grant:        [0] service options  [1..2] channel  [3..4] group  [5..7] source
+//   grant update: [0..1] channel A  [2..3] group A  [4..5] channel B  [6..7] group B
+//   affiliation:  [3..4] group  [5..7] unit
+//   registration: [5..7] unit
+const size_t TSBK_ARG_SVC_OPTIONS = 0;
+const size_t TSBK_ARG_CHANNEL = 1;
+const size_t TSBK_ARG_GROUP = 3;
+const size_t TSBK_ARG_UNIT = 5;
+
 // Voice frame range
 const uint8_t VOICE_FRAME_MIN = 0x62;
 const uint8_t VOICE_FRAME_MAX = 0x80;
 
+// Routing class of a frame type byte. Handlers are dispatched by indexing
+// with this, so keep Count last.
+enum class P25FrameClass : uint8_t {
+    Invalid = 0,
+    VoiceLdu1,
+    VoiceLdu2,
+    Eot,
+    Tsbk,
+    Poll,
+    Auth,
+    Grant,
+    Release,
+    Unlink,
+    Count
+};
+
+const size_t P25_FRAME_CLASS_COUNT = static_cast<size_t>(P25FrameClass::Count);
+
+constexpr std::array<P25FrameClass, 256> makeFrameClassTable() {
+    std::array<P25FrameClass, 256> table{};
+    for (size_t i = 0; i < table.size(); i++) {
+        table[i] = P25FrameClass::Invalid;
+    }
+    for (uint8_t t = FRAME_LDU1_0; t <= FRAME_LDU1_8; t++) {
+        table[t] = P25FrameClass::VoiceLdu1;
+    }
+    for (uint8_t t = FRAME_LDU2_0; t <= FRAME_LDU2_8; t++) {
+        table[t] = P25FrameClass::VoiceLdu2;
+    }
+    table[FRAME_EOT] = P25FrameClass::Eot;
+    table[FRAME_TSBK] = P25FrameClass::Tsbk;
+    table[FRAME_POLL] = P25FrameClass::Poll;
+    table[FRAME_AUTH_REQUEST] = P25FrameClass::Auth;
+    table[FRAME_AUTH_RESPONSE] = P25FrameClass::Auth;
+    table[FRAME_TG_GRANT] = P25FrameClass::Grant;
+    table[FRAME_TG_RELEASE] = P25FrameClass::Release;
+    table[FRAME_UNLINK] = P25FrameClass::Unlink;
+    return table;
+}
+
+inline constexpr std::array<P25FrameClass, 256> P25_FRAME_CLASS_TABLE = makeFrameClassTable();
+
+// One indexed load - no compare chain
+constexpr P25FrameClass classifyFrame(uint8_t frameType) {
+    return P25_FRAME_CLASS_TABLE[frameType];
+}
+
+constexpr size_t frameClassIndex(P25FrameClass frameClass) {
+    return static_cast<size_t>(frameClass);
+}
+
+static_assert(classifyFrame(FRAME_LDU1_0) == P25FrameClass::VoiceLdu1, "LDU1 classification");
+static_assert(classifyFrame(FRAME_LDU2_8) == P25FrameClass::VoiceLdu2, "LDU2 classification");
+static_assert(classifyFrame(0x74) == P25FrameClass::Invalid, "gap between LDU2 and EOT is not voice");
+
 class P25Protocol {
 public:
+    // Serialize into a caller-provided buffer. Return the record length,
+    // or 0 if it does not fit in capacity.
+    static size_t writeAuthRequest(uint8_t* buffer, size_t capacity, uint32_t radioId, const std::string& password);
+    static size_t writePollPacket(uint8_t* buffer, size_t capacity);
+    static size_t writeUnlinkPacket(uint8_t* buffer, size_t capacity);
+
+    // Talkgroup subscription requests to the reflector: 0xF4/0xF5 + TG (16-bit)
+    static size_t writeTalkgroupSubscribe(uint8_t* buffer, size_t capacity, uint32_t talkgroup);
+    static size_t writeTalkgroupRelease(uint8_t* buffer, size_t capacity, uint32_t talkgroup);
+
+    // Outbound TSBK record: 0x61 + LB|opcode + MFID + 8 argument bytes + CRC.
+    // args holds the argument bytes big-endian, as the fields pack in the spec.
+    static size_t writeTsbk(uint8_t* buffer, size_t capacity, uint8_t opcode, uint8_t mfid, uint64_t args);
+
+    // Control channel messages (channel = identifier << 12 | channel number)
+    static size_t writeGroupVoiceGrant(uint8_t* buffer, size_t capacity, uint8_t serviceOptions,
+                                       uint16_t channel, uint32_t talkgroup, uint32_t source);
+    static size_t writeRfssStatus(uint8_t* buffer, size_t capacity, const P25Config& site);
+    static size_t writeNetworkStatus(uint8_t* buffer, size_t capacity, const P25Config& site);
+    static size_t writeAdjacentStatus(uint8_t* buffer, size_t capacity, const P25Config& site, const AdjacentSite& adjacent);
+    static size_t writeIdentifierUpdate(uint8_t* buffer, size_t capacity, const ChannelIdentifier& identifier);
+
+    // CRC-CCITT as used on TSBKs (inverted remainder)
+    static uint16_t crcCcitt(const uint8_t* data, size_t length);
+
     // Build authentication request packet
     static std::vector<uint8_t> buildAuthRequest(uint32_t radioId, const std::string& password);
 
-    // Parse authentication response
-    static bool parseAuthResponse(const std::vector<uint8_t>& data, bool& authenticated);
+    // Parse authentication response: 0xF3 + status [+ capabilities]. A
+    // reflector that sends no capability byte supports none.
+    static bool parseAuthResponse(const P25FrameView& frame, bool& authenticated);
+    static bool parseAuthResponse(const P25FrameView& frame, bool& authenticated, uint8_t& capabilities);
 
     // Build poll/keepalive packet
     static std::vector<uint8_t> buildPollPacket();
@@ -58,15 +174,21 @@ public:
     // Build unlink packet
     static std::vector<uint8_t> buildUnlinkPacket();
 
-    // Check if frame is voice data
-    static bool isVoiceFrame(uint8_t frameType);
+    // Parse a reflector talkgroup grant notification: 0xF4 + TG (16-bit) [+ source (24-bit)]
+    static bool parseTalkgroupGrant(const P25FrameView& frame, uint32_t& talkgroup, uint32_t& source);
+
+    // Check if frame is voice data (LDU1/LDU2 sub-frames only, not EOT)
+    static bool isVoiceFrame(uint8_t frameType) {
+        P25FrameClass frameClass = classifyFrame(frameType);
+        return frameClass == P25FrameClass::VoiceLdu1 || frameClass == P25FrameClass::VoiceLdu2;
+    }
 
     // Extract talkgroup ID from voice frame
-    static uint32_t extractTalkgroupId(const std::vector<uint8_t>& data);
+    static uint32_t extractTalkgroupId(const P25FrameView& frame) { return frame.talkgroupId(); }
 
     // Extract source ID from voice frame
-    static uint32_t extractSourceId(const std::vector<uint8_t>& data);
+    static uint32_t extractSourceId(const P25FrameView& frame) { return frame.sourceId(); }
 
     // Get frame type from packet
-    static uint8_t getFrameType(const std::vector<uint8_t>& data);
+    static uint8_t getFrameType(const P25FrameView& frame) { return frame.frameType(); }
 };
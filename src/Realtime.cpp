@@ -0,0 +1,195 @@
+#include "Realtime.h"
+#include "Logger.h"
+#include "Clock.h"
+#include <cerrno>
+#include <cstring>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+
+// Stack each I/O thread touches up front; the deepest path (modem framer
+// into the controller and the network send) stays well inside it
+static const size_t PREFAULT_STACK_BYTES = 128 * 1024;
+
+// Overrun warnings per thread at most this often
+static const uint64_t OVERRUN_WARN_INTERVAL_MS = 10000;
+
+static const char* threadName(RealtimeThread thread) {
+    switch (thread) {
+        case RealtimeThread::Modem: return "modem";
+        case RealtimeThread::Network: return "network";
+        case RealtimeThread::Timer: return "timer";
+    }
+    return "unknown";
+}
+
+// Kept out of line so the compiler can't drop the touched array
+static void __attribute__((noinline)) prefaultStack() {
+    volatile uint8_t stack[PREFAULT_STACK_BYTES];
+    for (size_t i = 0; i < sizeof(stack); i += 4096) {
+        stack[i] = 0;
+    }
+}
+
+Realtime& Realtime::getInstance() {
+    static Realtime instance;
+    return instance;
+}
+
+Realtime::Realtime()
+    : m_config()
+    , m_enabled(false)
+    , m_overrunNs(0)
+{
+    for (Counters& counters : m_counters) {
+        counters.samples = 0;
+        counters.overruns = 0;
+        counters.maxLateNs = 0;
+        counters.lastWarnMs = 0;
+    }
+}
+
+bool Realtime::configure(const RealtimeConfig& config) {
+    if (!config.enabled) {
+        return true;
+    }
+
+    m_config = config;
+    m_overrunNs = static_cast<int64_t>(config.overrun_us) * 1000;
+    m_enabled = true;
+
+    bool ok = !config.lock_memory || lockMemory();
+
+    // The wheel thread is already running - it picks up its policy from
+    // its own first callback
+    TimerWheel::getInstance().schedule(m_timerThreadSetup, 0, [this]() {
+        enterThread(RealtimeThread::Timer);
+    });
+
+    LOG_INFO("Realtime scheduling: modem " + std::to_string(config.modem_priority) + ", network " +
+             std::to_string(config.network_priority) + ", timer " + std::to_string(config.timer_priority) +
+             (config.lock_memory ? ", memory locked" : ""));
+    return ok;
+}
+
+bool Realtime::lockMemory() {
+    // Lock pages as they are touched rather than every thread's whole stack
+    // mapping; the stacks that matter are pre-faulted by their threads
+#ifdef MCL_ONFAULT
+    if (mlockall(MCL_CURRENT | MCL_FUTURE | MCL_ONFAULT) == 0) {
+        return true;
+    }
+    if (errno != EINVAL) {
+        LOG_WARN("mlockall failed: " + std::string(strerror(errno)) + " (needs CAP_IPC_LOCK or a higher memlock limit)");
+        return false;
+    }
+#endif
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+        LOG_WARN("mlockall failed: " + std::string(strerror(errno)) + " (needs CAP_IPC_LOCK or a higher memlock limit)");
+        return false;
+    }
+    return true;
+}
+
+void Realtime::enterThread(RealtimeThread thread, int cpu) {
+    bool enabled = isEnabled();
+    int priority = 0;
+    if (enabled) {
+        switch (thread) {
+            case RealtimeThread::Modem:
+                priority = m_config.modem_priority;
+                cpu = cpu >= 0 ? cpu : m_config.modem_cpu;
+                break;
+            case RealtimeThread::Network:
+                priority = m_config.network_priority;
+                cpu = cpu >= 0 ? cpu : m_config.network_cpu;
+                break;
+            case RealtimeThread::Timer:
+                priority = m_config.timer_priority;
+                cpu = cpu >= 0 ? cpu : m_config.timer_cpu;
+                break;
+        }
+    }
+
+    std::string name = threadName(thread);
+
+    if (cpu >= 0) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(cpu, &cpus);
+        int err = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+        if (err != 0) {
+            LOG_WARN("Failed to pin " + name + " thread to CPU " + std::to_string(cpu) + ": " + strerror(err));
+        } else {
+            LOG_INFO("Pinned " + name + " thread to CPU " + std::to_string(cpu));
+        }
+    }
+
+    if (!enabled) {
+        return;
+    }
+
+    if (priority > 0) {
+        struct sched_param param = {};
+        param.sched_priority = priority;
+        int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (err != 0) {
+            LOG_WARN("Failed to set SCHED_FIFO " + std::to_string(priority) + " on " + name + " thread: " +
+                     strerror(err) + " (needs CAP_SYS_NICE or an rtprio limit)");
+        } else {
+            LOG_INFO("Running " + name + " thread at SCHED_FIFO " + std::to_string(priority));
+        }
+    }
+
+    if (m_config.lock_memory) {
+        prefaultStack();
+    }
+}
+
+void Realtime::noteLatency(RealtimeThread thread, int64_t lateNs) {
+    Counters& counters = m_counters[static_cast<size_t>(thread)];
+    counters.samples.fetch_add(1, std::memory_order_relaxed);
+
+    int64_t max = counters.maxLateNs.load(std::memory_order_relaxed);
+    while (lateNs > max && !counters.maxLateNs.compare_exchange_weak(max, lateNs, std::memory_order_relaxed)) {
+    }
+
+    int64_t limit = m_overrunNs.load(std::memory_order_relaxed);
+    if (limit <= 0 || lateNs <= limit) {
+        return;
+    }
+
+    uint64_t overruns = counters.overruns.fetch_add(1, std::memory_order_relaxed) + 1;
+    uint64_t now = Clock::nowMs();
+    uint64_t last = counters.lastWarnMs.load(std::memory_order_relaxed);
+    if (now - last >= OVERRUN_WARN_INTERVAL_MS &&
+        counters.lastWarnMs.compare_exchange_strong(last, now, std::memory_order_relaxed)) {
+        LOG_WARNF("Scheduling overrun: %s thread woke %lld us late (%llu so far)", threadName(thread),
+                  static_cast<long long>(lateNs / 1000), static_cast<unsigned long long>(overruns));
+    }
+}
+
+Realtime::Stats Realtime::getStats(RealtimeThread thread) const {
+    const Counters& counters = m_counters[static_cast<size_t>(thread)];
+    Stats stats;
+    stats.samples = counters.samples.load(std::memory_order_relaxed);
+    stats.overruns = counters.overruns.load(std::memory_order_relaxed);
+    stats.maxLateNs = counters.maxLateNs.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void Realtime::logStats() const {
+    if (!isEnabled()) {
+        return;
+    }
+
+    for (size_t i = 0; i < REALTIME_THREAD_COUNT; i++) {
+        RealtimeThread thread = static_cast<RealtimeThread>(i);
+        Stats stats = getStats(thread);
+        if (stats.samples == 0) {
+            continue;
+        }
+        LOG_INFO("Wakeup latency of " + std::string(threadName(thread)) + " thread: max " + std::to_string(stats.maxLateNs / 1000) +
+                 " us over " + std::to_string(stats.samples) + " wakeups, " + std::to_string(stats.overruns) + " overruns");
+    }
+}
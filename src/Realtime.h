@@ -0,0 +1,71 @@
+#pragma once
+
+#include "Config.h"
+#include "TimerWheel.h"
+#include <cstdint>
+#include <atomic>
+
+// Threads with their own scheduling policy
+enum class RealtimeThread : uint8_t {
+    Modem,      // modem read threads
+    Network,    // reflector receive thread
+    Timer       // timer wheel: controller expiry, TSBK pacing, voice concealment
+};
+
+static const size_t REALTIME_THREAD_COUNT = 3;
+
+// Opt-in realtime scheduling for the I/O threads (realtime section).
+//
+// Each thread applies its policy to itself when it starts - CPU affinity,
+// SCHED_FIFO priority and a pre-faulted stack - so nothing it touches on
+// the hot path page-faults later. Memory is locked once for the process.
+// Threads that can tell how late they woke up report it here; wakeups
+// later than overrun_us are counted and logged.
+class Realtime {
+public:
+    struct Stats {
+        uint64_t samples;
+        uint64_t overruns;
+        int64_t maxLateNs;
+    };
+
+    static Realtime& getInstance();
+
+    // Call before the modems and network start. Locks memory and moves the
+    // timer wheel thread onto its policy. False if anything could not be
+    // applied (the hotspot still runs, with normal scheduling).
+    bool configure(const RealtimeConfig& config);
+
+    // Apply the policy of thread to the calling thread. cpu >= 0 pins it
+    // there even with realtime off (per-modem cpu setting).
+    void enterThread(RealtimeThread thread, int cpu = -1);
+
+    bool isEnabled() const { return m_enabled.load(std::memory_order_relaxed); }
+
+    // A wakeup lateNs after it was due. Cheap unless it is an overrun.
+    void noteLatency(RealtimeThread thread, int64_t lateNs);
+
+    Stats getStats(RealtimeThread thread) const;
+    void logStats() const;
+
+private:
+    Realtime();
+    Realtime(const Realtime&) = delete;
+    Realtime& operator=(const Realtime&) = delete;
+
+    struct Counters {
+        std::atomic<uint64_t> samples;
+        std::atomic<uint64_t> overruns;
+        std::atomic<int64_t> maxLateNs;
+        std::atomic<uint64_t> lastWarnMs;
+    };
+
+    bool lockMemory();
+
+    RealtimeConfig m_config;
+    std::atomic<bool> m_enabled;
+    std::atomic<int64_t> m_overrunNs;
+    Counters m_counters[REALTIME_THREAD_COUNT];
+
+    TimerWheel::Timer m_timerThreadSetup;
+};
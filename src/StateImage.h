@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+// Flat byte image of runtime state, for handing it to another process of
+// the same daemon. Values are trivially copyable structs copied in host
+// byte order, each tagged with its size so an image from a build with a
+// different layout fails to read instead of being misread. A failed read
+// sticks: check ok() once after reading everything.
+class StateImage {
+public:
+    StateImage() : m_readOffset(0), m_failed(false) {}
+
+    template <typename T>
+    void put(const T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "State image values are copied bytewise");
+        uint32_t size = sizeof(T);
+        append(&size, sizeof(size));
+        append(&value, sizeof(T));
+    }
+
+    template <typename T>
+    bool get(T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "State image values are copied bytewise");
+        uint32_t size = 0;
+        if (!take(&size, sizeof(size)) || size != sizeof(T) || !take(&value, sizeof(T))) {
+            m_failed = true;
+            return false;
+        }
+        return true;
+    }
+
+    // Raw bytes, length first
+    void putBytes(const uint8_t* data, size_t length) {
+        uint32_t size = static_cast<uint32_t>(length);
+        append(&size, sizeof(size));
+        append(data, length);
+    }
+
+    // Up to capacity bytes; length is set to what was stored
+    bool getBytes(uint8_t* data, size_t capacity, size_t& length) {
+        uint32_t size = 0;
+        if (!take(&size, sizeof(size)) || size > capacity || !take(data, size)) {
+            m_failed = true;
+            return false;
+        }
+        length = size;
+        return true;
+    }
+
+    bool ok() const { return !m_failed; }
+
+    const uint8_t* data() const { return m_data.data(); }
+    size_t size() const { return m_data.size(); }
+
+    // Replace the image with length bytes and read from the start
+    void assign(const uint8_t* data, size_t length) {
+        m_data.assign(data, data + length);
+        m_readOffset = 0;
+        m_failed = false;
+    }
+
+    void clear() { assign(nullptr, 0); }
+
+private:
+    void append(const void* data, size_t length) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        m_data.insert(m_data.end(), bytes, bytes + length);
+    }
+
+    bool take(void* data, size_t length) {
+        if (m_failed || m_data.size() - m_readOffset < length) {
+            return false;
+        }
+        if (length > 0) {
+            memcpy(data, m_data.data() + m_readOffset, length);
+        }
+        m_readOffset += length;
+        return true;
+    }
+
+    std::vector<uint8_t> m_data;
+    size_t m_readOffset;
+    bool m_failed;
+};
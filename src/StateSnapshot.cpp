@@ -0,0 +1,282 @@
+#include "StateSnapshot.h"
+#include "AllocTrace.h"
+#include "Clock.h"
+#include "Logger.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+
+static const char SNAPSHOT_MAGIC[8] = {'P', '2', '5', 'S', 'N', 'A', 'P', 1};
+static const uint32_t SNAPSHOT_VERSION = 1;
+
+// Slots start on their own pages
+static const size_t HEADER_SIZE = 4096;
+static const size_t SLOT_COUNT = 2;
+
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t slotSize;
+};
+
+struct SnapshotSlot {
+    uint64_t sequence;    // higher is newer, 0 = never written
+    uint64_t savedAtUs;   // wall clock
+    uint32_t length;
+    uint32_t checksum;    // CRC-32 of the fields above and the image
+    uint8_t reserved[40];
+    uint8_t image[StateSnapshot::SLOT_CAPACITY];
+};
+
+static_assert(sizeof(SnapshotSlot) % 4096 == 0, "Snapshot slots are whole pages");
+
+static size_t fileLength() {
+    return HEADER_SIZE + SLOT_COUNT * sizeof(SnapshotSlot);
+}
+
+static std::array<uint32_t, 256> makeCrcTable() {
+    std::array<uint32_t, 256> table;
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t value = i;
+        for (int bit = 0; bit < 8; bit++) {
+            value = (value & 1) ? (value >> 1) ^ 0xEDB88320 : value >> 1;
+        }
+        table[i] = value;
+    }
+    return table;
+}
+
+// CRC-32 (IEEE 802.3, reflected)
+static uint32_t crc32(uint32_t crc, const uint8_t* data, size_t length) {
+    static const std::array<uint32_t, 256> table = makeCrcTable();
+
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++) {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+static uint32_t slotChecksum(const SnapshotSlot* slot) {
+    uint32_t crc = crc32(0, reinterpret_cast<const uint8_t*>(&slot->sequence), sizeof(slot->sequence));
+    crc = crc32(crc, reinterpret_cast<const uint8_t*>(&slot->savedAtUs), sizeof(slot->savedAtUs));
+    crc = crc32(crc, reinterpret_cast<const uint8_t*>(&slot->length), sizeof(slot->length));
+    return crc32(crc, slot->image, slot->length);
+}
+
+StateSnapshot::StateSnapshot()
+    : m_base(nullptr)
+    , m_mappedLength(0)
+    , m_running(false)
+    , m_failing(false)
+{
+}
+
+StateSnapshot::~StateSnapshot() {
+    stop();
+    close();
+}
+
+bool StateSnapshot::open(const std::string& path) {
+    close();
+
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        LOG_ERROR("Failed to open state snapshot " + path + ": " + std::string(strerror(errno)));
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        return false;
+    }
+
+    size_t length = fileLength();
+    bool reinitialize = static_cast<size_t>(st.st_size) != length;
+
+    if (reinitialize) {
+        if (st.st_size != 0) {
+            LOG_WARN("State snapshot " + path + " has a different size - starting a new one");
+        }
+        // Reserve the blocks now so a snapshot never faults on a full disk
+        if (ftruncate(fd, 0) != 0 || posix_fallocate(fd, 0, static_cast<off_t>(length)) != 0) {
+            LOG_ERROR("Failed to allocate state snapshot " + path);
+            ::close(fd);
+            return false;
+        }
+    }
+
+    void* base = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED) {
+        LOG_ERROR("Failed to map state snapshot " + path);
+        return false;
+    }
+
+    m_base = static_cast<uint8_t*>(base);
+    m_mappedLength = length;
+    m_path = path;
+
+    FileHeader* header = reinterpret_cast<FileHeader*>(m_base);
+    if (!reinitialize && (memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0 ||
+                          header->version != SNAPSHOT_VERSION ||
+                          header->slotSize != sizeof(SnapshotSlot))) {
+        LOG_WARN("State snapshot " + path + " has an unknown layout - starting a new one");
+        memset(m_base, 0, length);
+        reinitialize = true;
+    }
+
+    if (reinitialize) {
+        memcpy(header->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+        header->version = SNAPSHOT_VERSION;
+        header->slotSize = sizeof(SnapshotSlot);
+        msync(m_base, HEADER_SIZE, MS_SYNC);
+    }
+
+    return true;
+}
+
+void StateSnapshot::close() {
+    if (!m_base) {
+        return;
+    }
+
+    munmap(m_base, m_mappedLength);
+    m_base = nullptr;
+    m_mappedLength = 0;
+}
+
+static SnapshotSlot* slotAt(uint8_t* base, size_t index) {
+    return reinterpret_cast<SnapshotSlot*>(base + HEADER_SIZE + index * sizeof(SnapshotSlot));
+}
+
+static bool isIntact(const SnapshotSlot* slot) {
+    return slot->sequence != 0 && slot->length <= StateSnapshot::SLOT_CAPACITY && slot->checksum == slotChecksum(slot);
+}
+
+bool StateSnapshot::load(StateImage& image, uint64_t maxAgeMs, uint64_t& ageMs) {
+    if (!m_base) {
+        return false;
+    }
+
+    const SnapshotSlot* newest = nullptr;
+    for (size_t i = 0; i < SLOT_COUNT; i++) {
+        const SnapshotSlot* candidate = slotAt(m_base, i);
+        if (isIntact(candidate) && (!newest || candidate->sequence > newest->sequence)) {
+            newest = candidate;
+        }
+    }
+
+    if (!newest) {
+        LOG_INFO("No state snapshot in " + m_path + " - cold start");
+        return false;
+    }
+
+    // A clock that went backwards counts as fresh
+    uint64_t nowUs = Clock::wallClockUs();
+    ageMs = nowUs > newest->savedAtUs ? (nowUs - newest->savedAtUs) / 1000 : 0;
+    if (ageMs > maxAgeMs) {
+        LOG_INFO("State snapshot is " + std::to_string(ageMs / 1000) + " s old - cold start");
+        return false;
+    }
+
+    image.assign(newest->image, newest->length);
+    return true;
+}
+
+bool StateSnapshot::write(const StateImage& image) {
+    if (!m_base) {
+        return false;
+    }
+
+    if (image.size() > SLOT_CAPACITY) {
+        return false;
+    }
+
+    // Overwrite the older (or broken) slot - the newest stays intact until
+    // this one is complete. Read from the file each time: a process that
+    // took over from us writes to the same one.
+    SnapshotSlot* slots[SLOT_COUNT] = {slotAt(m_base, 0), slotAt(m_base, 1)};
+    uint64_t sequence[SLOT_COUNT];
+    for (size_t i = 0; i < SLOT_COUNT; i++) {
+        sequence[i] = isIntact(slots[i]) ? slots[i]->sequence : 0;
+    }
+    size_t target = sequence[0] <= sequence[1] ? 0 : 1;
+    SnapshotSlot* out = slots[target];
+
+    out->sequence = 0;
+    out->savedAtUs = Clock::wallClockUs();
+    out->length = static_cast<uint32_t>(image.size());
+    if (image.size() > 0) {
+        memcpy(out->image, image.data(), image.size());
+    }
+    out->sequence = (sequence[0] > sequence[1] ? sequence[0] : sequence[1]) + 1;
+    out->checksum = slotChecksum(out);
+
+    size_t length = offsetof(SnapshotSlot, image) + image.size();
+    return msync(out, length, MS_SYNC) == 0;
+}
+
+void StateSnapshot::start(int intervalMs, SaveFn save) {
+    stop();
+    if (!m_base) {
+        return;
+    }
+
+    m_save = save;
+    m_running = true;
+    m_thread = std::thread(&StateSnapshot::run, this, intervalMs);
+}
+
+void StateSnapshot::stop() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running = false;
+    }
+    m_wakeCv.notify_all();
+
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+bool StateSnapshot::save() {
+    if (!m_base || !m_save) {
+        return false;
+    }
+
+    m_image.clear();
+    m_save(m_image);
+    bool written = write(m_image);
+    if (!written && !m_failing) {
+        LOG_WARN("State snapshot of " + std::to_string(m_image.size()) + " bytes not written to " + m_path +
+                 (m_image.size() > SLOT_CAPACITY ? " (too large)" : ": " + std::string(strerror(errno))));
+    } else if (written && m_failing) {
+        LOG_INFO("State snapshots written again");
+    }
+    m_failing = !written;
+    return written;
+}
+
+void StateSnapshot::run(int intervalMs) {
+    AllocTrace::enterThread(AllocSite::Snapshot);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (m_running) {
+        m_wakeCv.wait_for(lock, std::chrono::milliseconds(intervalMs), [this]() { return !m_running; });
+        if (!m_running) {
+            break;
+        }
+
+        lock.unlock();
+        save();
+        lock.lock();
+    }
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "StateImage.h"
+#include <condition_variable>
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Crash-safe copy of a StateImage in a memory-mapped file, for a warm
+// restart. The file holds two slots; each write goes to the one not holding
+// the newest image and is checksummed and synced, so a crash or power loss
+// mid-write leaves the previous image intact. Writing runs on a thread of
+// its own, away from the I/O threads and the timer wheel.
+class StateSnapshot {
+public:
+    // Fills the image to write; runs on the snapshot thread
+    using SaveFn = std::function<void(StateImage&)>;
+
+    // Largest image a slot holds
+    static const size_t SLOT_CAPACITY = 256 * 1024 - 64;
+
+    StateSnapshot();
+    ~StateSnapshot();
+
+    StateSnapshot(const StateSnapshot&) = delete;
+    StateSnapshot& operator=(const StateSnapshot&) = delete;
+
+    // Create or reopen the file. One with a different layout is started over.
+    bool open(const std::string& path);
+    void close();
+
+    bool isOpen() const { return m_base != nullptr; }
+
+    // Newest intact image, if it is no older than maxAgeMs (wall clock).
+    // ageMs is set to how old it is.
+    bool load(StateImage& image, uint64_t maxAgeMs, uint64_t& ageMs);
+
+    // Write image over the older slot and sync it
+    bool write(const StateImage& image);
+
+    // Save every intervalMs until stop()
+    void start(int intervalMs, SaveFn save);
+    void stop();
+
+    // One save right now (shutdown), after stop()
+    bool save();
+
+private:
+    void run(int intervalMs);
+
+    uint8_t* m_base;
+    size_t m_mappedLength;
+    std::string m_path;
+
+    SaveFn m_save;
+    StateImage m_image;   // reused by save()
+
+    std::mutex m_mutex;
+    std::condition_variable m_wakeCv;
+    bool m_running;
+    std::thread m_thread;
+    bool m_failing;       // last write failed - logged once per run of failures
+};
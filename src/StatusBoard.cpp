@@ -0,0 +1,140 @@
+#include "StatusBoard.h"
+#include "Logger.h"
+#include "Clock.h"
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
+static const char STATUS_MAGIC[8] = {'P', '2', '5', 'S', 'T', 'A', 'T', 0};
+static const uint32_t STATUS_VERSION = 3;
+
+StatusBoard::StatusBoard()
+    : m_block(nullptr)
+    , m_local()
+{
+}
+
+StatusBoard::~StatusBoard() {
+    close();
+}
+
+bool StatusBoard::open(const std::string& path) {
+    close();
+
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        LOG_ERROR("Failed to open status file " + path + ": " + std::string(strerror(errno)));
+        return false;
+    }
+
+    if (ftruncate(fd, sizeof(StatusBlock)) != 0) {
+        LOG_ERROR("Failed to size status file " + path);
+        ::close(fd);
+        return false;
+    }
+
+    void* base = mmap(nullptr, sizeof(StatusBlock), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED) {
+        LOG_ERROR("Failed to map status file " + path);
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_block = static_cast<StatusBlock*>(base);
+
+    // Carry on from whatever sequence a previous run left, so a reader that
+    // straddles the restart still sees it change
+    uint64_t sequence = __atomic_load_n(&m_block->sequence, __ATOMIC_RELAXED);
+
+    m_local = StatusBlock();
+    memcpy(m_local.magic, STATUS_MAGIC, sizeof(STATUS_MAGIC));
+    m_local.version = STATUS_VERSION;
+    m_local.size = sizeof(StatusBlock);
+    m_local.sequence = sequence & ~1ULL;
+    m_local.startedUs = Clock::wallClockUs();
+    m_local.pid = static_cast<uint32_t>(getpid());
+    m_local.running = 1;
+    publishLocked();
+
+    LOG_INFO("Publishing live status to " + path);
+    return true;
+}
+
+void StatusBoard::close() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_block) {
+        return;
+    }
+
+    m_local.running = 0;
+    m_local.calls[0].sequence = 0;
+    m_local.calls[1].sequence = 0;
+    publishLocked();
+
+    munmap(m_block, sizeof(StatusBlock));
+    m_block = nullptr;
+}
+
+void StatusBoard::detach() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_block) {
+        return;
+    }
+
+    munmap(m_block, sizeof(StatusBlock));
+    m_block = nullptr;
+}
+
+void StatusBoard::update(const std::function<void(StatusBlock&)>& fill) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_block) {
+        return;
+    }
+
+    fill(m_local);
+    publishLocked();
+}
+
+void StatusBoard::addHeard(const CallRecord& record) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_block) {
+        return;
+    }
+
+    memmove(&m_local.heard[1], &m_local.heard[0], (LAST_HEARD - 1) * sizeof(CallRecord));
+    m_local.heard[0] = record;
+    m_local.heard[0].sequence = ++m_local.callsHeard;
+    if (m_local.heardCount < LAST_HEARD) {
+        m_local.heardCount++;
+    }
+
+    // The call is over - don't leave it showing as live until the next update
+    if (record.direction < 2) {
+        m_local.calls[record.direction].sequence = 0;
+    }
+    publishLocked();
+}
+
+void StatusBoard::publishLocked() {
+    // The local copy is the source of truth; only the sequence and the
+    // header fields below are forced here
+    memcpy(m_local.magic, STATUS_MAGIC, sizeof(STATUS_MAGIC));
+    m_local.version = STATUS_VERSION;
+    m_local.size = sizeof(StatusBlock);
+    m_local.updatedUs = Clock::wallClockUs();
+
+    uint64_t sequence = m_local.sequence;
+    __atomic_store_n(&m_block->sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    memcpy(m_block->magic, m_local.magic, offsetof(StatusBlock, sequence));
+    size_t body = offsetof(StatusBlock, updatedUs);
+    memcpy(reinterpret_cast<uint8_t*>(m_block) + body, reinterpret_cast<const uint8_t*>(&m_local) + body,
+           sizeof(StatusBlock) - body);
+
+    m_local.sequence = sequence + 2;
+    __atomic_store_n(&m_block->sequence, m_local.sequence, __ATOMIC_RELEASE);
+}
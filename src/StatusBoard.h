@@ -0,0 +1,106 @@
+#pragma once
+
+#include "CallJournal.h"
+#include "FrameTrace.h"
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <string>
+
+// Relay latency of one pipeline stage, microseconds
+struct LatencyStatus {
+    uint64_t count;
+    uint32_t p50Us;
+    uint32_t p99Us;
+    uint32_t p999Us;
+    uint32_t maxUs;
+};
+
+// Live status as laid out in the shared-memory file - fixed layout, host byte
+// order, read by the web dashboard (web/app.py mirrors it with struct)
+struct StatusBlock {
+    char magic[8];
+    uint32_t version;
+    uint32_t size;
+    uint64_t sequence;          // seqlock: odd while the daemon is writing
+    uint64_t updatedUs;         // wall clock of the last publish
+    uint64_t startedUs;
+    uint32_t pid;
+    uint8_t running;            // cleared on clean shutdown
+    uint8_t modemOpen;
+    uint8_t networkConnected;
+    uint8_t networkAuthenticated;
+    uint8_t trunking;
+    uint8_t p25Space;           // modem P25 buffer space, 0 if unknown
+    uint16_t heardCount;        // valid entries in heard[]
+    uint32_t grants;
+    uint32_t units;
+    uint32_t subscriptions;
+
+    // Counters since start
+    uint64_t rfDropped;         // arbiter
+    uint64_t networkDropped;
+    uint64_t preemptions;
+    uint64_t filterDropped;     // talkgroup filter
+    uint64_t unknownFrames;
+    uint64_t tsbkSent;
+    uint64_t tsbkBroadcasts;
+    uint64_t tsbkMissed;
+    uint64_t callsHeard;
+
+    // Open call per CallDirection, sequence != 0 while one is passing
+    CallRecord calls[2];
+
+    // Last heard, newest first
+    CallRecord heard[20];
+
+    // Relay latency by CallDirection and TraceStage (logging.latency_trace)
+    LatencyStatus latency[2][TRACE_STAGE_COUNT];
+};
+
+static_assert(offsetof(StatusBlock, sequence) == 16, "StatusBlock layout is shared with web/app.py");
+static_assert(offsetof(StatusBlock, rfDropped) == 64, "StatusBlock layout is shared with web/app.py");
+static_assert(offsetof(StatusBlock, calls) == 136, "StatusBlock layout is shared with web/app.py");
+static_assert(offsetof(StatusBlock, latency) == 1544, "StatusBlock layout is shared with web/app.py");
+static_assert(sizeof(StatusBlock) == 1784, "StatusBlock layout is shared with web/app.py");
+
+// Publishes a StatusBlock in a memory-mapped file (normally under /dev/shm).
+// The daemon composes the block in private memory and copies it out under a
+// seqlock, so readers never block the writer and need no syscalls once the
+// file is mapped - they retry on an odd or changed sequence.
+class StatusBoard {
+public:
+    static const size_t LAST_HEARD = sizeof(StatusBlock::heard) / sizeof(CallRecord);
+
+    StatusBoard();
+    ~StatusBoard();
+
+    StatusBoard(const StatusBoard&) = delete;
+    StatusBoard& operator=(const StatusBoard&) = delete;
+
+    // Create or reuse the file. It is left in place on close, so readers
+    // keep a valid mapping across daemon restarts.
+    bool open(const std::string& path);
+    void close();
+
+    // Stop publishing without marking the hotspot stopped - a new process
+    // took the board over (handoff)
+    void detach();
+
+    bool isOpen() const { return m_block != nullptr; }
+
+    // Let fill update the status fields, then publish. heard[] and the
+    // header are managed here and are overwritten.
+    void update(const std::function<void(StatusBlock&)>& fill);
+
+    // Finished call - pushed onto the last heard list and published now
+    void addHeard(const CallRecord& record);
+
+private:
+    void publishLocked();
+
+    StatusBlock* m_block;
+    std::mutex m_mutex;
+    StatusBlock m_local;
+};
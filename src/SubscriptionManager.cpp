@@ -0,0 +1,166 @@
+#include "SubscriptionManager.h"
+#include "NetworkClient.h"
+#include "P25Protocol.h"
+#include "Logger.h"
+
+SubscriptionManager::SubscriptionManager(const ReflectorConfig& config, NetworkClient& network)
+    : m_config(config)
+    , m_network(network)
+    , m_enabled(config.dynamic_talkgroups || !config.talkgroups.empty())
+    , m_lastResyncMs(0)
+{
+}
+
+void SubscriptionManager::start(uint64_t nowMs) {
+    if (!m_enabled) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    // Restored talkgroups stay only while there is interest, unless the
+    // config still lists them
+    size_t restored = m_subscriptions.size();
+    m_subscriptions.forEach([](uint32_t, Subscription& sub) {
+        sub.isStatic = false;
+    });
+
+    size_t staticCount = 0;
+    for (uint32_t tg : m_config.talkgroups) {
+        Subscription* sub = m_subscriptions.find(tg);
+        if (sub) {
+            restored--;
+        } else if (!(sub = m_subscriptions.insert(tg))) {
+            continue;
+        }
+        sub->isStatic = true;
+        sub->lastInterestMs = nowMs;
+        staticCount++;
+    }
+
+    // Static talkgroups and any restored dynamic ones
+    m_subscriptions.forEach([this](uint32_t tg, Subscription&) {
+        send(FRAME_TG_GRANT, tg);
+    });
+    m_lastResyncMs = nowMs;
+
+    LOG_INFO("Talkgroup subscriptions: " + std::to_string(staticCount) + " static" +
+             (restored > 0 ? ", " + std::to_string(restored) + " restored" : "") +
+             (m_config.dynamic_talkgroups ? ", dynamic enabled" : ""));
+}
+
+void SubscriptionManager::stop() {
+    if (!m_enabled) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_subscriptions.forEach([this](uint32_t tg, Subscription&) {
+        send(FRAME_TG_RELEASE, tg);
+    });
+    m_subscriptions.clear();
+}
+
+void SubscriptionManager::noteInterest(uint32_t talkgroup, uint64_t atMs) {
+    if (!m_enabled || !m_config.dynamic_talkgroups || talkgroup == 0) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    Subscription* sub = m_subscriptions.find(talkgroup);
+    if (sub) {
+        if (atMs > sub->lastInterestMs) {
+            sub->lastInterestMs = atMs;
+        }
+        return;
+    }
+
+    if (m_subscriptions.size() >= MAX_SUBSCRIPTIONS || !(sub = m_subscriptions.insert(talkgroup))) {
+        LOG_WARNF("Subscription table full - TG %u not subscribed", talkgroup);
+        return;
+    }
+
+    sub->isStatic = false;
+    sub->lastInterestMs = atMs;
+    send(FRAME_TG_GRANT, talkgroup);
+    LOG_INFOF("Subscribed to TG %u", talkgroup);
+}
+
+void SubscriptionManager::refresh(uint64_t nowMs) {
+    if (!m_enabled) {
+        return;
+    }
+
+    uint64_t idleMs = static_cast<uint64_t>(m_config.talkgroup_idle_timeout) * 1000;
+    uint32_t idle[MAX_SUBSCRIPTIONS];
+    size_t idleCount = 0;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    bool resync = nowMs - m_lastResyncMs >= RESYNC_INTERVAL_MS;
+    if (resync) {
+        m_lastResyncMs = nowMs;
+    }
+
+    m_subscriptions.forEach([&](uint32_t tg, Subscription& sub) {
+        if (!sub.isStatic && sub.lastInterestMs + idleMs <= nowMs) {
+            if (idleCount < MAX_SUBSCRIPTIONS) {
+                idle[idleCount++] = tg;
+            }
+            return;
+        }
+        if (resync) {
+            send(FRAME_TG_GRANT, tg);
+        }
+    });
+
+    for (size_t i = 0; i < idleCount; i++) {
+        m_subscriptions.erase(idle[i]);
+        send(FRAME_TG_RELEASE, idle[i]);
+        LOG_INFOF("Released idle TG %u", idle[i]);
+    }
+}
+
+void SubscriptionManager::saveState(StateImage& image) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    image.put(static_cast<uint32_t>(m_subscriptions.size()));
+    m_subscriptions.forEach([&image](uint32_t tg, const Subscription& sub) {
+        SavedSubscription saved = {tg, sub};
+        image.put(saved);
+    });
+}
+
+bool SubscriptionManager::restoreState(StateImage& image, int64_t shiftMs) {
+    uint32_t count = 0;
+    if (!image.get(count)) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (uint32_t i = 0; i < count; i++) {
+        SavedSubscription saved;
+        if (!image.get(saved)) {
+            return false;
+        }
+        Subscription* sub = m_subscriptions.size() < MAX_SUBSCRIPTIONS ? m_subscriptions.insert(saved.talkgroup) : nullptr;
+        if (sub) {
+            *sub = saved.subscription;
+            int64_t interestMs = static_cast<int64_t>(sub->lastInterestMs) + shiftMs;
+            sub->lastInterestMs = interestMs > 0 ? static_cast<uint64_t>(interestMs) : 0;
+        }
+    }
+    return true;
+}
+
+size_t SubscriptionManager::getSubscriptionCount() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_subscriptions.size();
+}
+
+bool SubscriptionManager::send(uint8_t frameType, uint32_t talkgroup) {
+    uint8_t packet[3];
+    size_t length = (frameType == FRAME_TG_GRANT)
+        ? P25Protocol::writeTalkgroupSubscribe(packet, sizeof(packet), talkgroup)
+        : P25Protocol::writeTalkgroupRelease(packet, sizeof(packet), talkgroup);
+    return m_network.sendData(packet, length);
+}
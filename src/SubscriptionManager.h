@@ -0,0 +1,66 @@
+#pragma once
+
+#include "Config.h"
+#include "OpenAddressMap.h"
+#include "StateImage.h"
+#include <cstdint>
+#include <mutex>
+
+class NetworkClient;
+
+// Tells the reflector which talkgroups this site wants (FRAME_TG_GRANT) and
+// releases the ones nobody has shown interest in for a while
+// (FRAME_TG_RELEASE). Interest comes from static config, RF affiliations and
+// local RF calls.
+class SubscriptionManager {
+public:
+    SubscriptionManager(const ReflectorConfig& config, NetworkClient& network);
+
+    bool isEnabled() const { return m_enabled; }
+
+    // Subscribe to the static talkgroups
+    void start(uint64_t nowMs);
+
+    // Release everything we hold
+    void stop();
+
+    // Record interest in a talkgroup as of atMs (never moves it back); a new
+    // subscription is sent right away
+    void noteInterest(uint32_t talkgroup, uint64_t atMs);
+
+    // Release idle subscriptions - run with the keepalive. Live ones are only
+    // sent again every RESYNC_INTERVAL_MS, in case a datagram was lost.
+    void refresh(uint64_t nowMs);
+
+    size_t getSubscriptionCount();
+
+    // Live subscriptions, for a handoff to a new process or a warm restart.
+    // shiftMs moves the interest times onto this process's clock. Restoring
+    // sends nothing; start() subscribes to them again.
+    void saveState(StateImage& image);
+    bool restoreState(StateImage& image, int64_t shiftMs);
+
+private:
+    struct Subscription {
+        bool isStatic;
+        uint64_t lastInterestMs;
+    };
+
+    struct SavedSubscription {
+        uint32_t talkgroup;
+        Subscription subscription;
+    };
+
+    static const size_t MAX_SUBSCRIPTIONS = 512;
+    static const uint64_t RESYNC_INTERVAL_MS = 300000;
+
+    bool send(uint8_t frameType, uint32_t talkgroup);
+
+    const ReflectorConfig& m_config;
+    NetworkClient& m_network;
+    bool m_enabled;
+
+    std::mutex m_mutex;
+    OpenAddressMap<Subscription, 1024> m_subscriptions;
+    uint64_t m_lastResyncMs;
+};
@@ -0,0 +1,97 @@
+#include "TalkgroupFilter.h"
+#include "Logger.h"
+#include <algorithm>
+
+TalkgroupFilter::TalkgroupFilter()
+    : m_active(false)
+    , m_totalDropped(0)
+{
+    m_talkgroups.fill(~0ULL);
+}
+
+void TalkgroupFilter::setBits(uint64_t* bits, uint32_t first, uint32_t last, bool value) {
+    size_t firstWord = first >> 6;
+    size_t lastWord = last >> 6;
+    for (size_t word = firstWord; word <= lastWord; word++) {
+        uint64_t mask = ~0ULL;
+        if (word == firstWord) {
+            mask &= ~0ULL << (first & 63);
+        }
+        if (word == lastWord) {
+            mask &= ~0ULL >> (63 - (last & 63));
+        }
+        bits[word] = value ? (bits[word] | mask) : (bits[word] & ~mask);
+    }
+}
+
+uint64_t TalkgroupFilter::applyRanges(uint64_t* bits, const std::vector<IdRange>& ranges, size_t limit, bool value,
+                                      const char* list) {
+    uint64_t covered = 0;
+    for (const IdRange& range : ranges) {
+        if (range.first > range.last || range.last >= limit) {
+            LOG_WARNF("Talkgroup filter: %s entry %u-%u is outside 0-%zu - ignored", list, range.first, range.last,
+                      limit - 1);
+            continue;
+        }
+        setBits(bits, range.first, range.last, value);
+        covered += range.last - range.first + 1;
+    }
+    return covered;
+}
+
+void TalkgroupFilter::compile(const P25Config& config) {
+    m_active = !config.talkgroup_allow.empty() || !config.talkgroup_deny.empty() || !config.source_block.empty();
+
+    // An allow list means "only these"; otherwise everything not denied passes
+    m_talkgroups.fill(config.talkgroup_allow.empty() ? ~0ULL : 0ULL);
+    uint64_t allowed = applyRanges(m_talkgroups.data(), config.talkgroup_allow, TALKGROUP_COUNT, true, "allow");
+    uint64_t denied = applyRanges(m_talkgroups.data(), config.talkgroup_deny, TALKGROUP_COUNT, false, "deny");
+
+    m_blockedSources.clear();
+    uint64_t blocked = 0;
+    if (!config.source_block.empty()) {
+        m_blockedSources.assign(SOURCE_COUNT / 64, 0);
+        blocked = applyRanges(m_blockedSources.data(), config.source_block, SOURCE_COUNT, true, "source block");
+    }
+
+    if (m_active && !m_dropCounts) {
+        m_dropCounts.reset(new std::atomic<uint32_t>[TALKGROUP_COUNT]);
+        for (size_t i = 0; i < TALKGROUP_COUNT; i++) {
+            m_dropCounts[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    if (m_active) {
+        LOG_INFO("Talkgroup filter: " + std::to_string(allowed) + " allowed, " + std::to_string(denied) +
+                 " denied, " + std::to_string(blocked) + " blocked sources");
+    }
+
+    if (!config.talkgroup_allow.empty() && allowed == 0) {
+        LOG_ERROR("Talkgroup filter: no valid entry in the allow list - every network call will be dropped");
+    }
+}
+
+std::vector<std::pair<uint32_t, uint32_t>> TalkgroupFilter::getTopDropped(size_t count) const {
+    std::vector<std::pair<uint32_t, uint32_t>> top;
+    if (!m_dropCounts || count == 0) {
+        return top;
+    }
+
+    for (uint32_t tg = 0; tg < TALKGROUP_COUNT; tg++) {
+        uint32_t dropped = m_dropCounts[tg].load(std::memory_order_relaxed);
+        if (dropped > 0) {
+            top.emplace_back(tg, dropped);
+        }
+    }
+
+    auto byFrames = [](const std::pair<uint32_t, uint32_t>& a, const std::pair<uint32_t, uint32_t>& b) {
+        return a.second > b.second || (a.second == b.second && a.first < b.first);
+    };
+    if (top.size() > count) {
+        std::partial_sort(top.begin(), top.begin() + count, top.end(), byFrames);
+        top.resize(count);
+    } else {
+        std::sort(top.begin(), top.end(), byFrames);
+    }
+    return top;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "Config.h"
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+// Talkgroup allow/deny and source block lists compiled into flat bitmaps, so
+// the ingress path decides a call with a single bit test.
+class TalkgroupFilter {
+public:
+    static const size_t TALKGROUP_COUNT = 65536;
+    static const size_t SOURCE_COUNT = 1 << 24;
+
+    TalkgroupFilter();
+
+    // Rebuild the bitmaps from config. Not safe against concurrent lookups.
+    // Config::load rejects IDs outside the ID space; any that get here are
+    // logged and ignored.
+    void compile(const P25Config& config);
+
+    // False when nothing is configured - callers can skip the filter entirely
+    bool isActive() const { return m_active; }
+
+    bool allowTalkgroup(uint32_t tg) const {
+        return tg < TALKGROUP_COUNT && ((m_talkgroups[tg >> 6] >> (tg & 63)) & 1) != 0;
+    }
+
+    bool isSourceBlocked(uint32_t src) const {
+        return !m_blockedSources.empty() && src < SOURCE_COUNT &&
+               ((m_blockedSources[src >> 6] >> (src & 63)) & 1) != 0;
+    }
+
+    // Drop accounting, indexed by talkgroup
+    void countDrop(uint32_t tg) {
+        m_totalDropped.fetch_add(1, std::memory_order_relaxed);
+        if (m_dropCounts && tg < TALKGROUP_COUNT) {
+            m_dropCounts[tg].fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    uint64_t getTotalDropped() const { return m_totalDropped.load(std::memory_order_relaxed); }
+
+    // Up to count talkgroups with the most dropped frames, as (tg, frames)
+    // pairs, most first
+    std::vector<std::pair<uint32_t, uint32_t>> getTopDropped(size_t count) const;
+
+private:
+    // Bits first..last inclusive
+    static void setBits(uint64_t* bits, uint32_t first, uint32_t last, bool value);
+
+    // Applies the ranges below limit to bits; returns how many IDs that covered
+    static uint64_t applyRanges(uint64_t* bits, const std::vector<IdRange>& ranges, size_t limit, bool value,
+                                const char* list);
+
+    bool m_active;
+
+    // Bit set = talkgroup allowed
+    std::array<uint64_t, TALKGROUP_COUNT / 64> m_talkgroups;
+
+    // Bit set = source blocked. Only allocated (2 MB) when a block list exists.
+    std::vector<uint64_t> m_blockedSources;
+
+    std::unique_ptr<std::atomic<uint32_t>[]> m_dropCounts;
+    std::atomic<uint64_t> m_totalDropped;
+};
@@ -0,0 +1,417 @@
+#include "TimerWheel.h"
+#include "Realtime.h"
+#include "AllocTrace.h"
+#include "Clock.h"
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <unistd.h>
+#include <ctime>
+#include <cerrno>
+
+static const int64_t TICK_NS = static_cast<int64_t>(TimerWheel::TICK_MS) * 1000000;
+static const uint64_t NO_EVENT = UINT64_MAX;
+
+// Marks a timer that has expired and is waiting for its callback to run
+static const int8_t LEVEL_FIRING = 127;
+
+static int64_t monotonicNs() {
+    return static_cast<int64_t>(Clock::get().monotonicNs());
+}
+
+static uint64_t rotateRight(uint64_t value, unsigned shift) {
+    shift &= 63;
+    return shift == 0 ? value : (value >> shift) | (value << (64 - shift));
+}
+
+static uint64_t msToTicks(uint32_t ms) {
+    uint64_t ticks = (static_cast<uint64_t>(ms) + TimerWheel::TICK_MS - 1) / TimerWheel::TICK_MS;
+    return ticks == 0 ? 1 : ticks;
+}
+
+TimerWheel::Timer::~Timer() {
+    if (isPending()) {
+        TimerWheel::getInstance().cancel(*this);
+    }
+}
+
+TimerWheel& TimerWheel::getInstance() {
+    static TimerWheel instance;
+    return instance;
+}
+
+TimerWheel::TimerWheel()
+    : m_currentTick(0)
+    , m_armedTick(NO_EVENT)
+    , m_caughtUpTick(0)
+    , m_pending(0)
+    , m_runningTimer(nullptr)
+    , m_epochNs(monotonicNs())
+    , m_timerFd(timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC))
+    , m_wakeFd(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK))
+    , m_running(true)
+{
+    for (unsigned level = 0; level < LEVELS; level++) {
+        m_occupied[level] = 0;
+        for (unsigned slot = 0; slot < SLOTS; slot++) {
+            m_slots[level][slot] = nullptr;
+        }
+    }
+    m_firing = nullptr;
+    m_runningCancelled = false;
+
+    m_thread = std::thread(&TimerWheel::run, this);
+    m_threadId = m_thread.get_id();
+}
+
+TimerWheel::~TimerWheel() {
+    shutdown();
+
+    if (m_timerFd >= 0) {
+        ::close(m_timerFd);
+    }
+    if (m_wakeFd >= 0) {
+        ::close(m_wakeFd);
+    }
+}
+
+void TimerWheel::shutdown() {
+    if (!m_running.exchange(false)) {
+        return;
+    }
+
+    wake();
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_caughtUp.notify_all();
+}
+
+void TimerWheel::schedule(Timer& timer, uint32_t delayMs, Callback callback) {
+    arm(timer, msToTicks(delayMs), 0, std::move(callback));
+}
+
+void TimerWheel::schedulePeriodic(Timer& timer, uint32_t intervalMs, Callback callback) {
+    uint64_t interval = msToTicks(intervalMs);
+    arm(timer, interval, interval, std::move(callback));
+}
+
+bool TimerWheel::cancel(Timer& timer) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    bool wasPending = timer.isPending();
+    if (wasPending) {
+        unlink(timer);
+    }
+
+    if (m_runningTimer == &timer) {
+        // Stop a periodic timer from re-arming after its callback
+        m_runningCancelled = true;
+
+        // Like del_timer_sync - don't return while the callback still runs,
+        // unless we are that callback
+        if (std::this_thread::get_id() != m_threadId) {
+            m_callbackDone.wait(lock, [&]() { return m_runningTimer != &timer; });
+
+            // The callback may have rescheduled it while we waited
+            if (timer.isPending()) {
+                unlink(timer);
+                wasPending = true;
+            }
+        }
+    }
+
+    return wasPending;
+}
+
+size_t TimerWheel::getPendingCount() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_pending;
+}
+
+uint64_t TimerWheel::getNextDeadlineNs() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    uint64_t next = nextEventTick();
+    return next == NO_EVENT ? UINT64_MAX : static_cast<uint64_t>(m_epochNs + static_cast<int64_t>(next) * TICK_NS);
+}
+
+void TimerWheel::catchUp() {
+    // A callback waiting for its own thread would never return
+    if (std::this_thread::get_id() == m_threadId) {
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    uint64_t target = nowTick();
+    wake();
+    m_caughtUp.wait(lock, [&]() { return m_caughtUpTick >= target || !m_running; });
+}
+
+void TimerWheel::arm(Timer& timer, uint64_t delayTicks, uint64_t intervalTicks, Callback callback) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (timer.isPending()) {
+        unlink(timer);
+    }
+    if (m_runningTimer == &timer) {
+        // Rescheduled from its own callback - the new schedule wins
+        m_runningCancelled = true;
+    }
+
+    // +1 because the current tick is already partly over - never fire early
+    uint64_t now = nowTick() + 1;
+    timer.m_expires = (now > m_currentTick ? now : m_currentTick) + delayTicks;
+    timer.m_interval = intervalTicks;
+    timer.m_callback = std::move(callback);
+    insert(timer);
+
+    if (timer.m_expires < m_armedTick) {
+        rearmTimerfd();
+    }
+}
+
+void TimerWheel::insert(Timer& timer) {
+    if (timer.m_expires < m_currentTick) {
+        timer.m_expires = m_currentTick;
+    }
+
+    uint64_t delta = timer.m_expires - m_currentTick;
+    unsigned level = 0;
+    while (level < LEVELS - 1 && delta >= (1ULL << (SLOT_BITS * (level + 1)))) {
+        level++;
+    }
+
+    // Clamp anything past the top level's range to its last slot
+    uint64_t maxDelta = (1ULL << (SLOT_BITS * LEVELS)) - 1;
+    if (delta > maxDelta) {
+        timer.m_expires = m_currentTick + maxDelta;
+    }
+
+    unsigned slot = static_cast<unsigned>((timer.m_expires >> (SLOT_BITS * level)) & (SLOTS - 1));
+
+    timer.m_level = static_cast<int8_t>(level);
+    timer.m_slot = static_cast<uint8_t>(slot);
+    timer.m_prev = nullptr;
+    timer.m_next = m_slots[level][slot];
+    if (timer.m_next) {
+        timer.m_next->m_prev = &timer;
+    }
+    m_slots[level][slot] = &timer;
+    m_occupied[level] |= (1ULL << slot);
+    m_pending++;
+}
+
+void TimerWheel::unlink(Timer& timer) {
+    Timer** head = (timer.m_level == LEVEL_FIRING) ? &m_firing : &m_slots[timer.m_level][timer.m_slot];
+
+    if (timer.m_prev) {
+        timer.m_prev->m_next = timer.m_next;
+    } else {
+        *head = timer.m_next;
+    }
+    if (timer.m_next) {
+        timer.m_next->m_prev = timer.m_prev;
+    }
+
+    if (timer.m_level != LEVEL_FIRING && *head == nullptr) {
+        m_occupied[timer.m_level] &= ~(1ULL << timer.m_slot);
+    }
+
+    timer.m_next = timer.m_prev = nullptr;
+    timer.m_level = -1;
+    m_pending--;
+}
+
+void TimerWheel::cascade(unsigned level) {
+    unsigned slot = static_cast<unsigned>((m_currentTick >> (SLOT_BITS * level)) & (SLOTS - 1));
+
+    Timer* timer = m_slots[level][slot];
+    m_slots[level][slot] = nullptr;
+    m_occupied[level] &= ~(1ULL << slot);
+
+    while (timer) {
+        Timer* next = timer->m_next;
+        m_pending--;
+        insert(*timer);
+        timer = next;
+    }
+}
+
+void TimerWheel::expireTick(uint64_t tick, Timer*& fired) {
+    m_currentTick = tick;
+
+    // Pull the next stretch of each higher level down when a lower level wraps
+    for (unsigned level = 1; level < LEVELS; level++) {
+        if ((tick & ((1ULL << (SLOT_BITS * level)) - 1)) != 0) {
+            break;
+        }
+        cascade(level);
+    }
+
+    unsigned slot = static_cast<unsigned>(tick & (SLOTS - 1));
+    Timer* timer = m_slots[0][slot];
+    m_slots[0][slot] = nullptr;
+    m_occupied[0] &= ~(1ULL << slot);
+
+    // Move to the firing list so cancel() still works until the callback runs
+    while (timer) {
+        Timer* next = timer->m_next;
+        timer->m_level = LEVEL_FIRING;
+        timer->m_prev = nullptr;
+        timer->m_next = fired;
+        if (fired) {
+            fired->m_prev = timer;
+        }
+        fired = timer;
+        timer = next;
+    }
+
+    m_currentTick = tick + 1;
+}
+
+uint64_t TimerWheel::nextEventTick() const {
+    uint64_t next = NO_EVENT;
+
+    if (m_occupied[0]) {
+        unsigned index = static_cast<unsigned>(m_currentTick & (SLOTS - 1));
+        next = m_currentTick + __builtin_ctzll(rotateRight(m_occupied[0], index));
+    }
+
+    // A higher-level slot needs attention at the tick where it cascades
+    for (unsigned level = 1; level < LEVELS; level++) {
+        if (!m_occupied[level]) {
+            continue;
+        }
+        unsigned shift = SLOT_BITS * level;
+        uint64_t boundary = (m_currentTick + (1ULL << shift) - 1) >> shift;
+        uint64_t distance = __builtin_ctzll(rotateRight(m_occupied[level], static_cast<unsigned>(boundary & (SLOTS - 1))));
+        uint64_t tick = (boundary + distance) << shift;
+        if (tick < next) {
+            next = tick;
+        }
+    }
+
+    return next;
+}
+
+uint64_t TimerWheel::nowTick() const {
+    return static_cast<uint64_t>((monotonicNs() - m_epochNs) / TICK_NS);
+}
+
+void TimerWheel::rearmTimerfd() {
+    uint64_t next = nextEventTick();
+    if (next == m_armedTick) {
+        return;
+    }
+    m_armedTick = next;
+
+    // A simulated clock has no real deadline - it wakes the wheel itself
+    struct itimerspec spec = {};
+    if (next != NO_EVENT && !Clock::get().isSimulated()) {
+        int64_t deadline = m_epochNs + static_cast<int64_t>(next) * TICK_NS;
+        spec.it_value.tv_sec = deadline / 1000000000;
+        spec.it_value.tv_nsec = deadline % 1000000000;
+        if (spec.it_value.tv_sec == 0 && spec.it_value.tv_nsec == 0) {
+            spec.it_value.tv_nsec = 1;  // zero would disarm
+        }
+    }
+    timerfd_settime(m_timerFd, TFD_TIMER_ABSTIME, &spec, nullptr);
+}
+
+void TimerWheel::wake() {
+    uint64_t one = 1;
+    ssize_t ignored = write(m_wakeFd, &one, sizeof(one));
+    (void)ignored;
+}
+
+void TimerWheel::run() {
+    AllocTrace::enterThread(AllocSite::Timer);
+
+    struct pollfd fds[2];
+    fds[0].fd = m_timerFd;
+    fds[0].events = POLLIN;
+    fds[1].fd = m_wakeFd;
+    fds[1].events = POLLIN;
+
+    while (m_running) {
+        int ready = poll(fds, 2, -1);
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+
+        uint64_t value;
+        bool expired = false;
+        if (fds[0].revents & POLLIN) {
+            ssize_t ignored = read(m_timerFd, &value, sizeof(value));
+            (void)ignored;
+            expired = true;
+        }
+        if (fds[1].revents & POLLIN) {
+            ssize_t ignored = read(m_wakeFd, &value, sizeof(value));
+            (void)ignored;
+        }
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        // How late the timerfd woke us against the slot it was armed for
+        if (expired && m_armedTick != NO_EVENT && Realtime::getInstance().isEnabled() && !Clock::get().isSimulated()) {
+            int64_t lateNs = monotonicNs() - (m_epochNs + static_cast<int64_t>(m_armedTick) * TICK_NS);
+            Realtime::getInstance().noteLatency(RealtimeThread::Timer, lateNs);
+        }
+        m_armedTick = NO_EVENT;
+
+        uint64_t now = nowTick();
+        while (m_running) {
+            uint64_t next = nextEventTick();
+            if (next > now) {
+                // Nothing due - skip the idle ticks in one step
+                if (now + 1 > m_currentTick) {
+                    m_currentTick = now + 1;
+                }
+                break;
+            }
+
+            expireTick(next, m_firing);
+
+            while (m_firing && m_running) {
+                Timer* timer = m_firing;
+                unlink(*timer);
+
+                m_runningTimer = timer;
+                m_runningCancelled = false;
+                Callback callback = timer->m_callback;
+                uint64_t expires = timer->m_expires;
+
+                lock.unlock();
+                callback();
+                lock.lock();
+
+                // Periodic timers re-arm from their previous expiry so they don't
+                // drift; periods missed entirely (long callback) are skipped
+                if (timer->m_interval > 0 && !m_runningCancelled && !timer->isPending()) {
+                    uint64_t current = nowTick();
+                    timer->m_expires = expires + timer->m_interval;
+                    if (timer->m_expires <= current) {
+                        timer->m_expires = current + 1;
+                    }
+                    insert(*timer);
+                }
+
+                m_runningTimer = nullptr;
+                m_callbackDone.notify_all();
+            }
+
+            now = nowTick();
+        }
+
+        m_caughtUpTick = now;
+        m_caughtUp.notify_all();
+
+        rearmTimerfd();
+    }
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// Hierarchical timer wheel (4 levels x 64 slots, 10 ms ticks, ~46 h range)
+// driven by a single timerfd. Insert and cancel are O(1) list operations on
+// caller-owned Timer objects, and the timerfd is only armed for the next slot
+// that actually holds a timer, so idle timers cost no wakeups.
+//
+// Callbacks run on the wheel thread without the wheel lock held, so they may
+// schedule or cancel timers. cancel() from another thread waits for a
+// callback of that timer that is already running.
+//
+// Time comes from the installed Clock. Under a SimulatedClock the timerfd
+// stays disarmed and the clock drives the wheel through catchUp().
+class TimerWheel {
+public:
+    using Callback = std::function<void()>;
+
+    static const uint32_t TICK_MS = 10;
+
+    class Timer {
+    public:
+        Timer() = default;
+        ~Timer();
+
+        Timer(const Timer&) = delete;
+        Timer& operator=(const Timer&) = delete;
+
+        bool isPending() const { return m_level >= 0; }
+
+    private:
+        friend class TimerWheel;
+
+        Timer* m_next = nullptr;
+        Timer* m_prev = nullptr;
+        uint64_t m_expires = 0;
+        uint64_t m_interval = 0;  // ticks, 0 = one-shot
+        int8_t m_level = -1;      // -1 = not queued
+        uint8_t m_slot = 0;
+        Callback m_callback;
+    };
+
+    static TimerWheel& getInstance();
+
+    // One-shot timer firing after delayMs (rounded up to the tick)
+    void schedule(Timer& timer, uint32_t delayMs, Callback callback);
+
+    // Repeating timer, first firing after intervalMs
+    void schedulePeriodic(Timer& timer, uint32_t intervalMs, Callback callback);
+
+    // Returns true if the timer was pending
+    bool cancel(Timer& timer);
+
+    // Stop the wheel thread. Pending timers never fire afterwards.
+    void shutdown();
+
+    size_t getPendingCount();
+
+    // Clock time (ns) of the next tick that needs the wheel, UINT64_MAX if idle
+    uint64_t getNextDeadlineNs();
+
+    // Run everything due at the clock's current time and wait until the
+    // wheel is done with it (simulated clock)
+    void catchUp();
+
+private:
+    static const unsigned LEVELS = 4;
+    static const unsigned SLOT_BITS = 6;
+    static const unsigned SLOTS = 1 << SLOT_BITS;
+
+    TimerWheel();
+    ~TimerWheel();
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    void run();
+
+    void arm(Timer& timer, uint64_t delayTicks, uint64_t intervalTicks, Callback callback);
+    void insert(Timer& timer);
+    void unlink(Timer& timer);
+    void cascade(unsigned level);
+    void expireTick(uint64_t tick, Timer*& fired);
+    uint64_t nextEventTick() const;
+    uint64_t nowTick() const;
+    void rearmTimerfd();
+    void wake();
+
+    std::mutex m_mutex;
+    std::condition_variable m_callbackDone;
+    std::condition_variable m_caughtUp;
+
+    Timer* m_slots[LEVELS][SLOTS];
+    Timer* m_firing;
+    uint64_t m_occupied[LEVELS];
+    uint64_t m_currentTick;
+    uint64_t m_armedTick;
+    uint64_t m_caughtUpTick;   // every timer up to this tick has fired
+    size_t m_pending;
+
+    // Timer whose callback is executing right now (for cancel-while-running)
+    Timer* m_runningTimer;
+    bool m_runningCancelled;
+    std::thread::id m_threadId;
+
+    int64_t m_epochNs;
+    int m_timerFd;
+    int m_wakeFd;
+
+    std::atomic<bool> m_running;
+    std::thread m_thread;
+};
@@ -1,18 +1,127 @@
 #include "TrunkingController.h"
 #include "P25Protocol.h"
 #include "Logger.h"
+#include "FrameTrace.h"
+#include "Clock.h"
+
+// Active call with no frames for this long lost its EOT
+static const uint64_t CALL_ACTIVITY_TIMEOUT_MS = 1000;
+
+// How often units past the registration timeout are swept out
+static const uint32_t REGISTRY_SWEEP_INTERVAL_MS = 60000;
+
+// Order must follow P25FrameClass
+static_assert(P25_FRAME_CLASS_COUNT == 10, "Update the handler tables when adding a frame class");
+
+const TrunkingController::ModemHandler TrunkingController::s_modemHandlers[P25_FRAME_CLASS_COUNT] = {
+    &TrunkingController::onModemUnknown,    // Invalid
+    &TrunkingController::onModemLdu1,       // VoiceLdu1
+    &TrunkingController::onModemLdu2,       // VoiceLdu2
+    &TrunkingController::onModemEot,        // Eot
+    &TrunkingController::onModemTsbk,       // Tsbk
+    &TrunkingController::onModemIgnored,    // Poll
+    &TrunkingController::onModemIgnored,    // Auth
+    &TrunkingController::onModemIgnored,    // Grant
+    &TrunkingController::onModemIgnored,    // Release
+    &TrunkingController::onModemIgnored,    // Unlink
+};
+
+const TrunkingController::FrameHandler TrunkingController::s_networkHandlers[P25_FRAME_CLASS_COUNT] = {
+    &TrunkingController::onUnknownFrame,    // Invalid
+    &TrunkingController::onNetworkVoice,    // VoiceLdu1
+    &TrunkingController::onNetworkVoice,    // VoiceLdu2
+    &TrunkingController::onNetworkEot,      // Eot
+    &TrunkingController::onNetworkTsbk,     // Tsbk
+    &TrunkingController::onIgnoredFrame,    // Poll
+    &TrunkingController::onIgnoredFrame,    // Auth
+    &TrunkingController::onNetworkGrant,    // Grant
+    &TrunkingController::onIgnoredFrame,    // Release
+    &TrunkingController::onIgnoredFrame,    // Unlink
+};
+
+TrunkingController::Channel::Channel(TrunkingController& owner, size_t index, std::shared_ptr<ModemSerial> modem,
+                                     const P25Config& config, CallJournal& journal)
+    : owner(owner)
+    , index(index)
+    , modem(modem)
+    , channelId(static_cast<uint16_t>(modem->getConfig().channel >= 0 ? modem->getConfig().channel : config.control_channel))
+    , control(modem->getConfig().role != "traffic")
+    , traffic(modem->getConfig().role != "control")
+    , poolIndex(ChannelPool::NONE)
+    , txDelayMs(static_cast<uint32_t>(modem->getConfig().tx_delay))
+    , arbiter(config)
+    , calls(journal)
+    , rfTalkgroup(0)
+{
+}
 
 TrunkingController::TrunkingController(
     const P25Config& config,
-    std::shared_ptr<ModemSerial> modem,
-    std::shared_ptr<NetworkClient> network)
+    std::vector<std::shared_ptr<ModemSerial>> modems,
+    std::shared_ptr<NetworkClient> network,
+    CallJournal& journal)
     : m_config(config)
-    , m_modem(modem)
     , m_network(network)
+    , m_control(nullptr)
     , m_running(false)
-    , m_currentTalkgroup(0)
-    , m_inCall(false)
+    , m_networkTalkgroup(0)
+    , m_networkChannel(nullptr)
+    , m_unroutedTalkgroup(0)
+    , m_dropNetworkCall(false)
+    , m_droppedTalkgroup(0)
+    , m_subscriptions(network->getConfig(), *network)
+    , m_controlChannel(config, [this](const P25FrameView& tsbk) {
+        return m_control->modem->isOpen() && m_control->modem->writeP25Data(tsbk);
+    })
+    , m_concealer([this](const P25FrameView& record) {
+        Channel* channel = m_networkChannel.load();
+        return channel && channel->modem->isOpen() && channel->modem->writeP25Data(record);
+    }, [this]() {
+        Channel* channel = m_networkChannel.load();
+        if (channel) {
+            channel->calls.onConcealed(CallDirection::Network, 1);
+        }
+    })
+    , m_unknownFrames(0)
+    , m_freeGrantTimerCount(0)
+    , m_controlVoiceWatched(false)
 {
+    m_grants.setTimeouts(config.grant_timeout_ms, CALL_ACTIVITY_TIMEOUT_MS, config.hang_time_ms);
+    resetGrantTimers();
+
+    for (size_t i = 0; i < modems.size(); i++) {
+        m_channels.emplace_back(new Channel(*this, i, modems[i], config, journal));
+        Channel* channel = m_channels.back().get();
+
+        if (channel->control && !m_control) {
+            m_control = channel;
+        }
+        if (channel->traffic) {
+            channel->poolIndex = m_pool.add(channel->channelId);
+            if (channel->poolIndex == ChannelPool::NONE) {
+                LOG_WARN("More than " + std::to_string(ChannelPool::MAX_CHANNELS) + " traffic channels - modem " +
+                         std::to_string(i) + " carries no voice");
+                channel->traffic = false;
+                continue;
+            }
+            m_traffic.push_back(channel);
+        }
+    }
+
+    // Every modem is traffic-only: the first one keeps the control channel
+    if (!m_control) {
+        m_control = m_channels.front().get();
+    }
+    if (m_traffic.empty()) {
+        LOG_WARN("No modem has a traffic role - voice will not be relayed");
+    }
+
+    // A single voice channel takes every network stream
+    if (m_traffic.size() == 1) {
+        m_networkChannel = m_traffic.front();
+    }
+
+    m_filter.compile(config);
 }
 
 void TrunkingController::start() {
@@ -20,18 +129,309 @@ void TrunkingController::start() {
 
     m_running = true;
 
-    // Set up callbacks
-    m_modem->setP25DataCallback([this](const std::vector<uint8_t>& data) {
-        handleModemData(data);
-    });
+    // Publish handlers - only consulted if the modems and network were not
+    // started with a fixed sink
+    for (auto& channel : m_channels) {
+        channel->modem->setP25Handler<Channel, &Channel::handleModemData>(channel.get());
+    }
+    m_network->setDataHandler<TrunkingController, &TrunkingController::handleNetworkData>(this);
 
-    m_network->setDataCallback([this](const std::vector<uint8_t>& data) {
-        handleNetworkData(data);
-    });
+    // Subscriptions ride along with the keepalive
+    m_subscriptions.start(Clock::nowMs());
+    m_network->setKeepaliveHandler<TrunkingController, &TrunkingController::refreshSubscriptions>(this);
+
+    if (m_config.trunking) {
+        m_controlChannel.start();
+    }
+
+    if (m_channels.size() > 1) {
+        LOG_INFO("Site has " + std::to_string(m_channels.size()) + " channels, " +
+                 std::to_string(m_traffic.size()) + " carrying voice");
+    }
+
+    // Restored calls and grants time out as if nothing happened
+    uint64_t now = Clock::nowMs();
+    {
+        std::lock_guard<std::mutex> lock(m_stateMutex);
+        m_grants.forEach([&](uint32_t talkgroup, const Grant&) {
+            armGrantTimerLocked(talkgroup, now);
+        });
+    }
+    if (m_control->traffic && m_control->arbiter.tick(now)) {
+        m_controlChannel.setVoiceActive(true);
+        watchControlVoice();
+    }
+
+    if (m_config.registration_timeout > 0) {
+        TimerWheel::getInstance().schedulePeriodic(m_registryTimer, REGISTRY_SWEEP_INTERVAL_MS, [this]() {
+            expireUnits();
+        });
+    }
 
     LOG_INFO("Trunking controller started");
 }
 
+void TrunkingController::suspend() {
+    if (!m_running) {
+        return;
+    }
+
+    LOG_INFO("Suspending trunking controller...");
+    m_running = false;
+
+    m_network->clearKeepaliveHandler();
+    m_network->clearDataHandler();
+    for (auto& channel : m_channels) {
+        channel->modem->clearP25Handler();
+    }
+    resetGrantTimers();
+    TimerWheel::getInstance().cancel(m_controlVoiceTimer);
+    TimerWheel::getInstance().cancel(m_registryTimer);
+    m_controlVoiceWatched = false;
+    m_controlChannel.stop();
+    m_concealer.onEnd();
+
+    // The new process opens fresh records from the next LDU1
+    for (auto& channel : m_channels) {
+        channel->calls.flush();
+    }
+}
+
+// Fixed-size parts of the handoff image
+struct SavedChannel {
+    CallArbiter::Snapshot arbiter;
+    uint32_t rfTalkgroup;
+    uint32_t poolTalkgroup;
+};
+
+struct SavedRouting {
+    uint32_t channelCount;
+    uint32_t networkTalkgroup;
+    int32_t networkChannel;     // index, -1 = none
+    uint32_t unroutedTalkgroup;
+    uint32_t droppedTalkgroup;
+    bool dropNetworkCall;
+};
+
+void TrunkingController::saveState(StateImage& image) {
+    SavedRouting routing = {};
+    routing.channelCount = static_cast<uint32_t>(m_channels.size());
+    routing.networkTalkgroup = m_networkTalkgroup.load();
+    Channel* networkChannel = m_networkChannel.load();
+    routing.networkChannel = networkChannel ? static_cast<int32_t>(networkChannel->index) : -1;
+    routing.unroutedTalkgroup = m_unroutedTalkgroup;
+    routing.droppedTalkgroup = m_droppedTalkgroup;
+    routing.dropNetworkCall = m_dropNetworkCall;
+    image.put(routing);
+
+    for (auto& channel : m_channels) {
+        SavedChannel saved = {};
+        saved.arbiter = channel->arbiter.snapshot();
+        saved.rfTalkgroup = channel->rfTalkgroup.load();
+        saved.poolTalkgroup = channel->poolIndex != ChannelPool::NONE ? m_pool.getTalkgroup(channel->poolIndex) : 0;
+        image.put(saved);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_stateMutex);
+        image.put(static_cast<uint32_t>(m_grants.size()));
+        m_grants.forEach([&image](uint32_t, const Grant& grant) {
+            image.put(grant);
+        });
+        image.put(static_cast<uint32_t>(m_units.size()));
+        m_units.forEach([&image](uint32_t, const UnitEntry& unit) {
+            image.put(unit);
+        });
+    }
+
+    m_subscriptions.saveState(image);
+}
+
+bool TrunkingController::restoreState(StateImage& image) {
+    SavedRouting routing;
+    if (!image.get(routing)) {
+        return false;
+    }
+
+    // Channels are matched by position - a different modem line-up would
+    // put calls on the wrong frequency
+    if (routing.channelCount != m_channels.size()) {
+        LOG_ERROR("Handed-off site has " + std::to_string(routing.channelCount) + " channels, this config " +
+                  std::to_string(m_channels.size()));
+        return false;
+    }
+
+    uint64_t now = Clock::nowMs();
+    for (auto& channel : m_channels) {
+        SavedChannel saved;
+        if (!image.get(saved)) {
+            return false;
+        }
+        channel->arbiter.restore(saved.arbiter);
+        channel->rfTalkgroup = saved.rfTalkgroup;
+        if (channel->poolIndex != ChannelPool::NONE && saved.poolTalkgroup != 0) {
+            m_pool.claim(channel->poolIndex, saved.poolTalkgroup, now);
+        }
+    }
+
+    m_networkTalkgroup = routing.networkTalkgroup;
+    if (routing.networkChannel >= 0 && static_cast<size_t>(routing.networkChannel) < m_channels.size()) {
+        m_networkChannel = m_channels[static_cast<size_t>(routing.networkChannel)].get();
+    }
+    m_unroutedTalkgroup = routing.unroutedTalkgroup;
+    m_droppedTalkgroup = routing.droppedTalkgroup;
+    m_dropNetworkCall = routing.dropNetworkCall;
+
+    uint32_t count = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_stateMutex);
+        if (!image.get(count)) {
+            return false;
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            Grant grant;
+            if (!image.get(grant)) {
+                return false;
+            }
+            m_grants.restore(grant);
+        }
+
+        if (!image.get(count)) {
+            return false;
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            UnitEntry unit;
+            if (!image.get(unit)) {
+                return false;
+            }
+            m_units.restore(unit);
+        }
+    }
+
+    if (!m_subscriptions.restoreState(image, 0)) {
+        return false;
+    }
+
+    LOG_INFO("Restored " + std::to_string(m_grants.size()) + " grants, " + std::to_string(m_units.size()) +
+             " units and " + std::to_string(m_subscriptions.getSubscriptionCount()) + " subscriptions");
+    return true;
+}
+
+// Moves a monotonic timestamp of an earlier process (or boot) onto our clock
+static uint64_t rebaseMs(uint64_t timeMs, int64_t shiftMs) {
+    if (timeMs == 0) {
+        return 0;
+    }
+    int64_t rebased = static_cast<int64_t>(timeMs) + shiftMs;
+    return rebased > 0 ? static_cast<uint64_t>(rebased) : 0;
+}
+
+void TrunkingController::saveSnapshot(StateImage& image) {
+    image.put(Clock::nowMs());
+    image.put(static_cast<uint32_t>(m_traffic.size()));
+    for (size_t i = 0; i < m_traffic.size(); i++) {
+        image.put(m_pool.getTalkgroup(i));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_stateMutex);
+        image.put(static_cast<uint32_t>(m_grants.size()));
+        m_grants.forEach([&image](uint32_t, const Grant& grant) {
+            image.put(grant);
+        });
+        image.put(static_cast<uint32_t>(m_units.size()));
+        m_units.forEach([&image](uint32_t, const UnitEntry& unit) {
+            image.put(unit);
+        });
+    }
+
+    m_subscriptions.saveState(image);
+}
+
+bool TrunkingController::restoreSnapshot(StateImage& image, uint64_t ageMs) {
+    uint64_t savedAtMs = 0;
+    uint32_t trafficCount = 0;
+    if (!image.get(savedAtMs) || !image.get(trafficCount)) {
+        return false;
+    }
+
+    // The timestamps are on the saving process's monotonic clock, which a
+    // reboot restarted - put them as far behind now as they were then
+    uint64_t now = Clock::nowMs();
+    int64_t shiftMs = static_cast<int64_t>(now) - static_cast<int64_t>(ageMs) - static_cast<int64_t>(savedAtMs);
+
+    std::vector<uint32_t> poolTalkgroups(trafficCount);
+    for (uint32_t& talkgroup : poolTalkgroups) {
+        if (!image.get(talkgroup)) {
+            return false;
+        }
+    }
+
+    // Grants name channels - with a different line-up they are dropped
+    bool sameChannels = trafficCount == m_traffic.size();
+    if (!sameChannels) {
+        LOG_WARN("Snapshot has " + std::to_string(trafficCount) + " traffic channels, this config " +
+                 std::to_string(m_traffic.size()) + " - grants not restored");
+    }
+
+    uint32_t count = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_stateMutex);
+        if (!image.get(count)) {
+            return false;
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            Grant grant;
+            if (!image.get(grant)) {
+                return false;
+            }
+            if (!sameChannels || grant.state == CallState::Released) {
+                continue;
+            }
+            grant.grantedAtMs = rebaseMs(grant.grantedAtMs, shiftMs);
+            grant.activeAtMs = rebaseMs(grant.activeAtMs, shiftMs);
+            grant.lastActivityMs = rebaseMs(grant.lastActivityMs, shiftMs);
+            grant.hangAtMs = rebaseMs(grant.hangAtMs, shiftMs);
+            m_grants.restore(grant);
+        }
+
+        if (!image.get(count)) {
+            return false;
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            UnitEntry unit;
+            if (!image.get(unit)) {
+                return false;
+            }
+            unit.registeredAtMs = rebaseMs(unit.registeredAtMs, shiftMs);
+            unit.lastSeenMs = rebaseMs(unit.lastSeenMs, shiftMs);
+            m_units.restore(unit);
+        }
+
+        // Only channels whose grant came back - expiry releases them
+        for (uint32_t& talkgroup : poolTalkgroups) {
+            if (!sameChannels || !m_grants.find(talkgroup)) {
+                talkgroup = 0;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < poolTalkgroups.size(); i++) {
+        if (poolTalkgroups[i] != 0) {
+            m_pool.claim(i, poolTalkgroups[i], now);
+        }
+    }
+
+    if (!m_subscriptions.restoreState(image, shiftMs) || !image.ok()) {
+        return false;
+    }
+
+    LOG_INFO("Warm restart from a " + std::to_string(ageMs / 1000) + " s old snapshot: " +
+             std::to_string(m_grants.size()) + " grants, " + std::to_string(m_units.size()) + " units, " +
+             std::to_string(m_subscriptions.getSubscriptionCount()) + " subscriptions");
+    return true;
+}
+
 void TrunkingController::stop() {
     if (!m_running) {
         return;
@@ -39,113 +439,797 @@ void TrunkingController::stop() {
 
     LOG_INFO("Stopping trunking controller...");
     m_running = false;
+
+    m_network->clearKeepaliveHandler();
+    m_network->clearDataHandler();
+    for (auto& channel : m_channels) {
+        channel->modem->clearP25Handler();
+    }
+    resetGrantTimers();
+    TimerWheel::getInstance().cancel(m_controlVoiceTimer);
+    TimerWheel::getInstance().cancel(m_registryTimer);
+    m_controlChannel.stop();
+    m_concealer.onEnd();
+    m_subscriptions.stop();
+    for (auto& channel : m_channels) {
+        channel->calls.flush();
+    }
+
+    uint64_t rfDropped = getArbiterDropped(CallDirection::RF);
+    uint64_t networkDropped = getArbiterDropped(CallDirection::Network);
+    if (rfDropped + networkDropped > 0) {
+        LOG_INFO("Arbiter dropped " + std::to_string(rfDropped) + " RF and " +
+                 std::to_string(networkDropped) + " network frames, " +
+                 std::to_string(getPreemptions()) + " preemptions");
+    }
+
+    if (m_pool.getRejected() > 0) {
+        LOG_INFO("Refused " + std::to_string(m_pool.getRejected()) + " calls with every traffic channel busy");
+    }
+
+    if (m_filter.getTotalDropped() > 0) {
+        std::string top;
+        for (const auto& entry : m_filter.getTopDropped(5)) {
+            top += (top.empty() ? " (TG " : ", TG ") + std::to_string(entry.first) + ": " + std::to_string(entry.second);
+        }
+        LOG_INFO("Filter dropped " + std::to_string(m_filter.getTotalDropped()) + " network frames" +
+                 (top.empty() ? "" : top + ")"));
+    }
+
+    VoiceConcealer::Stats concealed = m_concealer.getStats();
+    if (concealed.repeated + concealed.silenced > 0) {
+        LOG_INFO("Concealed " + std::to_string(concealed.repeated) + " lost network records with repeats and " +
+                 std::to_string(concealed.silenced) + " with silence, " + std::to_string(concealed.late) +
+                 " arrived too late");
+    }
+
+    if (m_unknownFrames > 0) {
+        LOG_WARN("Dropped " + std::to_string(m_unknownFrames.load()) + " frames of unknown type");
+    }
     LOG_INFO("Trunking controller stopped");
 }
 
-void TrunkingController::handleModemData(const std::vector<uint8_t>& data) {
-    if (data.empty()) {
+void TrunkingController::handleModemData(Channel& channel, const P25FrameView& frame) {
+    if (frame.empty() || !m_running.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    (this->*s_modemHandlers[frameClassIndex(classifyFrame(frame.frameType()))])(channel, frame);
+}
+
+void TrunkingController::handleNetworkData(const P25FrameView& frame) {
+    if (frame.empty() || !m_running.load(std::memory_order_relaxed)) {
         return;
     }
 
-    uint8_t frameType = P25Protocol::getFrameType(data);
+    (this->*s_networkHandlers[frameClassIndex(classifyFrame(frame.frameType()))])(frame);
+}
 
+void TrunkingController::forwardToNetwork(const P25FrameView& frame) {
     // Voice frames from RF → send to network
-    if (P25Protocol::isVoiceFrame(frameType)) {
-        handleVoiceFrame(data);
+    if (m_network->isAuthenticated()) {
+        FrameTrace::mark(TraceStage::Controller);
+        m_network->sendData(frame);
+    }
+}
 
-        // Forward to network
-        if (m_network->isAuthenticated()) {
-            m_network->sendData(data);
+void TrunkingController::endConcealment() {
+    if (m_config.conceal_loss && m_concealer.isActive()) {
+        m_concealer.onEnd();
+    }
+}
+
+int16_t TrunkingController::frameRssi(const Channel& channel) const {
+    int16_t dbm;
+    return channel.modem->getFrameRssi(dbm) ? dbm : CDR_RSSI_UNKNOWN;
+}
+
+void TrunkingController::onModemLdu1(Channel& channel, const P25FrameView& frame) {
+    if (!channel.arbiter.admit(CallDirection::RF, P25FrameClass::VoiceLdu1, frame, Clock::nowMs())) {
+        return;
+    }
+
+    // RF took the channel - stop filling in for the network stream
+    if (&channel == m_networkChannel.load()) {
+        endConcealment();
+    }
+
+    // LDU1 carries the link control - track call start
+    handleVoiceFrame(frame, CallDirection::RF, channel);
+    channel.calls.onVoice(CallDirection::RF, frame, frameRssi(channel));
+    forwardToNetwork(frame);
+}
+
+void TrunkingController::onModemLdu2(Channel& channel, const P25FrameView& frame) {
+    if (!channel.arbiter.admit(CallDirection::RF, P25FrameClass::VoiceLdu2, frame, Clock::nowMs())) {
+        return;
+    }
+
+    if (&channel == m_networkChannel.load()) {
+        endConcealment();
+    }
+    channel.calls.onVoice(CallDirection::RF, frame, frameRssi(channel));
+    forwardToNetwork(frame);
+}
+
+void TrunkingController::onModemEot(Channel& channel, const P25FrameView& frame) {
+    if (!channel.arbiter.admit(CallDirection::RF, P25FrameClass::Eot, frame, Clock::nowMs())) {
+        return;
+    }
+
+    channel.calls.onEnd(CallDirection::RF);
+
+    uint32_t tg = channel.rfTalkgroup.exchange(0);
+    if (tg != 0) {
+        LOG_INFOF("End of transmission on TG %u", tg);
+        handleEndOfCall(tg);
+    }
+
+    // Forward EOT to network
+    forwardToNetwork(frame);
+}
+
+void TrunkingController::onModemTsbk(Channel&, const P25FrameView& frame) {
+    processTSBK(frame, CallDirection::RF);
+}
+
+void TrunkingController::onModemIgnored(Channel&, const P25FrameView& frame) {
+    onIgnoredFrame(frame);
+}
+
+void TrunkingController::onModemUnknown(Channel&, const P25FrameView& frame) {
+    onUnknownFrame(frame);
+}
+
+bool TrunkingController::filterNetworkFrame(const P25FrameView& frame, P25FrameClass frameClass) {
+    // The first LDU1 carrying link control decides the call. Later LDU1s only
+    // repeat the same bit test, which also recovers from a lost EOT.
+    if (frameClass == P25FrameClass::VoiceLdu1 && frame.hasLinkControl()) {
+        uint32_t tg = frame.talkgroupId();
+        if (tg != 0) {
+            bool drop = !m_filter.allowTalkgroup(tg) || m_filter.isSourceBlocked(frame.sourceId());
+            if (drop && m_droppedTalkgroup != tg) {
+                LOG_DEBUG("Filtering network call on TG " + std::to_string(tg) + " SRC " + std::to_string(frame.sourceId()));
+            }
+            m_dropNetworkCall = drop;
+            m_droppedTalkgroup = drop ? tg : 0;
         }
     }
-    // TSBK frames
-    else if (frameType == FRAME_TSBK) {
-        processTSBK(data);
+
+    if (!m_dropNetworkCall) {
+        return false;
     }
-    // End of transmission
-    else if (frameType == FRAME_EOT) {
-        if (m_inCall) {
-            LOG_INFO("End of transmission on TG " + std::to_string(m_currentTalkgroup.load()));
-            m_inCall = false;
-            m_currentTalkgroup = 0;
+
+    m_filter.countDrop(m_droppedTalkgroup);
+    if (frameClass == P25FrameClass::Eot) {
+        m_dropNetworkCall = false;
+        m_droppedTalkgroup = 0;
+    }
+    return true;
+}
+
+TrunkingController::Channel* TrunkingController::routeNetworkVoice(const P25FrameView& frame, P25FrameClass frameClass,
+                                                                   bool& taken) {
+    taken = false;
+    if (!isMultiChannel()) {
+        return m_networkChannel.load(std::memory_order_relaxed);
+    }
+
+    // The stream carries no channel of its own - the talkgroup in its link
+    // control picks one, and LDU2s follow the last LDU1
+    if (frameClass != P25FrameClass::VoiceLdu1 || !frame.hasLinkControl() || frame.talkgroupId() == 0) {
+        return m_networkChannel.load(std::memory_order_relaxed);
+    }
+
+    uint32_t tg = frame.talkgroupId();
+    size_t index = m_pool.assign(tg, taken);
+    Channel* channel = nullptr;
+    if (index == ChannelPool::NONE) {
+        if (m_unroutedTalkgroup != tg) {
+            LOG_WARNF("No free traffic channel for network call on TG %u", tg);
         }
+        m_unroutedTalkgroup = tg;
+    } else {
+        channel = m_traffic[index];
+        m_unroutedTalkgroup = 0;
+    }
 
-        // Forward EOT to network
-        if (m_network->isAuthenticated()) {
-            m_network->sendData(data);
+    // Records already paced for the old channel must not continue on the new one
+    Channel* previous = m_networkChannel.exchange(channel);
+    if (previous != channel && previous) {
+        endConcealment();
+    }
+    return channel;
+}
+
+void TrunkingController::onNetworkVoice(const P25FrameView& frame) {
+    P25FrameClass frameClass = classifyFrame(frame.frameType());
+
+    if (m_filter.isActive() && filterNetworkFrame(frame, frameClass)) {
+        return;
+    }
+
+    bool taken = false;
+    Channel* channel = routeNetworkVoice(frame, frameClass, taken);
+    if (!channel) {
+        return;
+    }
+
+    // A losing stream never reaches the serial port. The channel it just
+    // took is only released with a grant, so give it back if none follows.
+    if (!channel->arbiter.admit(CallDirection::Network, frameClass, frame, Clock::nowMs())) {
+        if (taken) {
+            m_pool.release(frame.talkgroupId(), Clock::nowMs());
         }
+        return;
+    }
+
+    if (frameClass == P25FrameClass::VoiceLdu1 && !handleVoiceFrame(frame, CallDirection::Network, *channel) && taken) {
+        m_pool.release(frame.talkgroupId(), Clock::nowMs());
+    }
+    channel->calls.onVoice(CallDirection::Network, frame);
+
+    // Voice frames from network → send to modem (RF)
+    if (m_config.conceal_loss) {
+        m_concealer.onVoice(frame, channel->txDelayMs);
+    } else if (channel->modem->isOpen()) {
+        channel->modem->writeP25Data(frame);
     }
 }
 
-void TrunkingController::handleNetworkData(const std::vector<uint8_t>& data) {
-    if (data.empty()) {
+void TrunkingController::onNetworkEot(const P25FrameView& frame) {
+    if (m_filter.isActive() && filterNetworkFrame(frame, P25FrameClass::Eot)) {
         return;
     }
 
-    uint8_t frameType = P25Protocol::getFrameType(data);
+    Channel* channel = m_networkChannel.load(std::memory_order_relaxed);
+    if (!channel) {
+        return;
+    }
 
-    // Ignore auth frames (already handled by NetworkClient)
-    if (frameType == FRAME_AUTH_RESPONSE || frameType == FRAME_AUTH_REQUEST) {
+    if (!channel->arbiter.admit(CallDirection::Network, P25FrameClass::Eot, frame, Clock::nowMs())) {
         return;
     }
 
-    // Ignore poll frames
-    if (frameType == FRAME_POLL) {
+    channel->calls.onEnd(CallDirection::Network);
+    endConcealment();
+
+    uint32_t tg = m_networkTalkgroup.exchange(0);
+    if (tg != 0) {
+        handleEndOfCall(tg);
+    }
+
+    if (channel->modem->isOpen()) {
+        channel->modem->writeP25Data(frame);
+    }
+}
+
+void TrunkingController::onNetworkGrant(const P25FrameView& frame) {
+    uint32_t tg = 0;
+    uint32_t src = 0;
+    if (!P25Protocol::parseTalkgroupGrant(frame, tg, src)) {
+        LOG_DEBUG("Malformed talkgroup grant from network");
         return;
     }
 
-    // Voice frames from network → send to modem (RF)
-    if (P25Protocol::isVoiceFrame(frameType)) {
-        if (m_modem->isOpen()) {
-            m_modem->writeP25Data(data);
+    LOG_INFOF("Received talkgroup grant from network - TG: %u", tg);
+    if (isMultiChannel()) {
+        grantTrafficChannel(tg, src, false, CallDirection::Network);
+        return;
+    }
+    applyGrant(tg, src, 0, false, CallDirection::Network);
+
+    // Announce it on the control channel ahead of the broadcast fill
+    if (m_config.trunking) {
+        m_controlChannel.enqueueGrant(tg, src, m_config.control_channel, false);
+    }
+}
+
+void TrunkingController::onNetworkTsbk(const P25FrameView& frame) {
+    processTSBK(frame, CallDirection::Network);
+
+    // Relay TSBK over RF in the next free control channel slot (if trunking enabled)
+    if (m_config.trunking) {
+        m_controlChannel.enqueue(frame, TsbkPriority::Relay);
+    }
+}
+
+void TrunkingController::onIgnoredFrame(const P25FrameView&) {
+    // Auth and poll frames are handled by NetworkClient
+}
+
+void TrunkingController::onUnknownFrame(const P25FrameView& frame) {
+    m_unknownFrames++;
+    LOG_DEBUG("Unknown frame type " + std::to_string(frame.frameType()) + " (" + std::to_string(frame.size()) + " bytes)");
+}
+
+void TrunkingController::processTSBK(const P25FrameView& frame, CallDirection direction) {
+    if (!frame.hasTsbk()) {
+        return;
+    }
+
+    // Manufacturer-specific opcodes are not ours to interpret
+    if (frame.tsbkMfid() != 0x00) {
+        LOG_DEBUG("Ignoring TSBK with MFID " + std::to_string(frame.tsbkMfid()));
+        return;
+    }
+
+    uint64_t now = Clock::nowMs();
+
+    switch (frame.tsbkOpcode()) {
+        case TSBK_GRP_V_CH_GRANT: {
+            uint8_t options = static_cast<uint8_t>(frame.tsbkField(TSBK_ARG_SVC_OPTIONS, 1));
+            if (isMultiChannel() && direction == CallDirection::RF) {
+                // This site owns the channels - treat it as a request and pick one
+                grantTrafficChannel(
+                    frame.tsbkField(TSBK_ARG_GROUP, 2),
+                    frame.tsbkField(TSBK_ARG_UNIT, 3),
+                    (options & SVC_OPT_EMERGENCY) != 0,
+                    direction);
+                break;
+            }
+            applyGrant(
+                frame.tsbkField(TSBK_ARG_GROUP, 2),
+                frame.tsbkField(TSBK_ARG_UNIT, 3),
+                static_cast<uint16_t>(frame.tsbkField(TSBK_ARG_CHANNEL, 2)),
+                (options & SVC_OPT_EMERGENCY) != 0,
+                direction);
+            break;
+        }
+
+        case TSBK_GRP_V_CH_GRANT_UPDT: {
+            // Two channel/group pairs - refresh the grants, never create a source
+            for (size_t pair = 0; pair < 2; pair++) {
+                uint16_t channel = static_cast<uint16_t>(frame.tsbkField(pair * 4, 2));
+                uint32_t group = frame.tsbkField(pair * 4 + 2, 2);
+                if (group == 0) {
+                    continue;
+                }
+                uint32_t source = 0;
+                {
+                    std::lock_guard<std::mutex> lock(m_stateMutex);
+                    Grant* existing = m_grants.find(group);
+                    if (existing) {
+                        source = existing->source;
+                    }
+                }
+                applyGrant(group, source, channel, false, direction);
+            }
+            break;
+        }
+
+        case TSBK_GRP_AFF: {
+            uint32_t unit = frame.tsbkField(TSBK_ARG_UNIT, 3);
+            uint32_t group = frame.tsbkField(TSBK_ARG_GROUP, 2);
+            uint32_t previous = 0;
+            bool ok;
+            {
+                std::lock_guard<std::mutex> lock(m_stateMutex);
+                ok = m_units.affiliate(unit, group, now, &previous);
+            }
+            if (!ok) {
+                LOG_WARNF("Unit registry full - affiliation of %u dropped", unit);
+            } else if (previous != group) {
+                LOG_INFOF("Unit %u affiliated to TG %u", unit, group);
+            }
+
+            // A radio here affiliating means we want that talkgroup's traffic
+            if (ok && direction == CallDirection::RF) {
+                m_subscriptions.noteInterest(group, now);
+            }
+            break;
+        }
+
+        case TSBK_U_REG: {
+            uint32_t unit = frame.tsbkField(TSBK_ARG_UNIT, 3);
+            bool ok;
+            {
+                std::lock_guard<std::mutex> lock(m_stateMutex);
+                ok = m_units.registerUnit(unit, now);
+            }
+            if (!ok) {
+                LOG_WARNF("Unit registry full - registration of %u dropped", unit);
+            } else {
+                LOG_DEBUG("Unit " + std::to_string(unit) + " registered");
+            }
+            break;
+        }
+
+        // A radio here asking to leave, or another site's acknowledgement
+        case TSBK_U_DE_REG_REQ:
+        case TSBK_U_DE_REG_ACK: {
+            bool request = frame.tsbkOpcode() == TSBK_U_DE_REG_REQ;
+            if (request != (direction == CallDirection::RF)) {
+                LOG_DEBUG("Unhandled TSBK opcode " + std::to_string(frame.tsbkOpcode()));
+                break;
+            }
+            uint32_t unit = frame.tsbkField(TSBK_ARG_UNIT, 3);
+            std::lock_guard<std::mutex> lock(m_stateMutex);
+            if (m_units.deregisterUnit(unit)) {
+                LOG_DEBUG("Unit " + std::to_string(unit) + " deregistered");
+            }
+            break;
+        }
+
+        default:
+            LOG_DEBUG("Unhandled TSBK opcode " + std::to_string(frame.tsbkOpcode()));
+            break;
+    }
+}
+
+bool TrunkingController::handleVoiceFrame(const P25FrameView& frame, CallDirection direction, Channel& channel) {
+    // Voice only displaces the control channel when they share a modem
+    if (&channel == m_control && channel.traffic) {
+        m_controlChannel.setVoiceActive(true);
+        watchControlVoice();
+    }
+
+    // Extract talkgroup and source from voice frame
+    uint32_t tg = frame.talkgroupId();
+    uint32_t src = frame.sourceId();
+
+    if (tg == 0) {
+        return false;
+    }
+
+    uint64_t now = Clock::nowMs();
+    CallState from = CallState::Idle;
+    Grant snapshot;
+    {
+        std::lock_guard<std::mutex> lock(m_stateMutex);
+        Grant* grant = m_grants.find(tg);
+        if (grant) {
+            from = grant->state;
+        }
+
+        grant = m_grants.activate(tg, src, direction, now);
+        if (!grant) {
+            LOG_WARNF("Grant table full - call on TG %u not tracked", tg);
+            return false;
+        }
+        grant->emergency = frame.isEmergency();
+        if (isMultiChannel()) {
+            grant->channel = channel.channelId;
+        }
+        if (direction == CallDirection::RF) {
+            m_units.touch(src, now);
+        }
+        // Later frames only push the activity timeout out - the timer
+        // finds the new deadline when it fires
+        if (from != CallState::Active) {
+            armGrantTimerLocked(tg, now);
+        }
+        snapshot = *grant;
+    }
+
+    if (direction == CallDirection::RF) {
+        channel.rfTalkgroup = tg;
+
+        // Late entry or a unit that skipped the control channel
+        if (channel.traffic && isMultiChannel() && !m_pool.claim(channel.poolIndex, tg, now)) {
+            LOG_DEBUG("TG " + std::to_string(tg) + " keyed up on a channel held by another talkgroup");
+        }
+    } else {
+        m_networkTalkgroup = tg;
+    }
+
+    if (from != CallState::Active) {
+        logTransition(snapshot, from);
+        if (direction == CallDirection::RF) {
+            LOG_INFOF("Voice call started - TG: %u SRC: %u", tg, src);
+
+            // Someone keyed up here - make sure replies on this talkgroup reach us
+            m_subscriptions.noteInterest(tg, now);
+        }
+    }
+    return true;
+}
+
+void TrunkingController::handleEndOfCall(uint32_t talkgroup) {
+    Grant snapshot;
+    {
+        std::lock_guard<std::mutex> lock(m_stateMutex);
+        uint64_t now = Clock::nowMs();
+        Grant* grant = m_grants.hang(talkgroup, now);
+        if (!grant) {
+            return;
+        }
+        armGrantTimerLocked(talkgroup, now);
+        snapshot = *grant;
+    }
+
+    logTransition(snapshot, CallState::Active);
+}
+
+bool TrunkingController::applyGrant(uint32_t talkgroup, uint32_t source, uint16_t channel, bool emergency, CallDirection direction) {
+    if (talkgroup == 0) {
+        return false;
+    }
+
+    CallState from = CallState::Idle;
+    Grant snapshot;
+    {
+        std::lock_guard<std::mutex> lock(m_stateMutex);
+        Grant* grant = m_grants.find(talkgroup);
+        if (grant) {
+            from = grant->state;
+        }
+
+        uint64_t now = Clock::nowMs();
+        grant = m_grants.grant(talkgroup, source, channel, direction, now);
+        if (!grant) {
+            LOG_WARNF("Grant table full - grant for TG %u dropped", talkgroup);
+            return false;
         }
+        grant->emergency = emergency;
+        if (grant->state != from) {
+            armGrantTimerLocked(talkgroup, now);
+        }
+        snapshot = *grant;
+    }
+
+    if (snapshot.state != from) {
+        logTransition(snapshot, from);
+    }
+    return true;
+}
+
+void TrunkingController::grantTrafficChannel(uint32_t talkgroup, uint32_t source, bool emergency, CallDirection direction) {
+    if (talkgroup == 0) {
+        return;
     }
-    // Talkgroup grant notifications
-    else if (frameType == FRAME_TG_GRANT) {
-        LOG_INFO("Received talkgroup grant from network");
-        processTSBK(data);
+
+    size_t index = m_pool.assign(talkgroup);
+    if (index == ChannelPool::NONE) {
+        LOG_WARNF("All %zu traffic channels busy - grant for TG %u refused", m_pool.size(), talkgroup);
+        return;
     }
-    // TSBK frames
-    else if (frameType == FRAME_TSBK) {
-        processTSBK(data);
 
-        // Forward TSBK to modem for RF transmission (if trunking enabled)
-        if (m_config.trunking && m_modem->isOpen()) {
-            m_modem->writeP25Data(data);
+    uint16_t channel = m_pool.getChannelId(index);
+    if (!applyGrant(talkgroup, source, channel, emergency, direction)) {
+        m_pool.release(talkgroup, Clock::nowMs());
+        return;
+    }
+
+    // Announce it on the control channel ahead of the broadcast fill
+    if (m_config.trunking) {
+        m_controlChannel.enqueueGrant(talkgroup, source, channel, emergency);
+    }
+}
+
+void TrunkingController::armGrantTimerLocked(uint32_t talkgroup, uint64_t nowMs) {
+    const Grant* grant = m_grants.find(talkgroup);
+    if (!m_running || !grant) {
+        return;
+    }
+
+    bool created = false;
+    GrantTimer** slot = m_grantTimerOf.insert(talkgroup, &created);
+    if (!slot) {
+        return;
+    }
+    if (created) {
+        // One timer per table entry, so this only runs dry if the two disagree
+        if (m_freeGrantTimerCount == 0) {
+            m_grantTimerOf.erase(talkgroup);
+            LOG_WARNF("No grant timer free - TG %u will not time out", talkgroup);
+            return;
         }
+        *slot = m_freeGrantTimers[--m_freeGrantTimerCount];
+        (*slot)->talkgroup = talkgroup;
     }
-    // EOT from network
-    else if (frameType == FRAME_EOT) {
-        if (m_modem->isOpen()) {
-            m_modem->writeP25Data(data);
+
+    GrantTimer* grantTimer = *slot;
+    uint64_t deadlineMs = m_grants.getDeadlineMs(*grant);
+    uint64_t delayMs = deadlineMs > nowMs ? deadlineMs - nowMs : 0;
+    TimerWheel::getInstance().schedule(grantTimer->timer, static_cast<uint32_t>(delayMs),
+        [this, grantTimer]() { onGrantTimer(grantTimer); });
+}
+
+void TrunkingController::onGrantTimer(GrantTimer* grantTimer) {
+    uint64_t now = Clock::nowMs();
+
+    // Active can go to Hang and, with no hang time, straight on to Released
+    Grant changed[2];
+    CallState changedFrom[2];
+    size_t changedCount = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(m_stateMutex);
+        uint32_t talkgroup = grantTimer->talkgroup;
+        if (talkgroup == 0) {
+            return;
         }
+
+        uint64_t deadlineMs = m_grants.expire(talkgroup, now, [&](const Grant& grant, CallState from) {
+            if (changedCount < 2) {
+                changed[changedCount] = grant;
+                changedFrom[changedCount] = from;
+                changedCount++;
+            }
+        });
+
+        if (deadlineMs == UINT64_MAX) {
+            // The grant is gone - hand its timer back
+            m_grantTimerOf.erase(talkgroup);
+            grantTimer->talkgroup = 0;
+            m_freeGrantTimers[m_freeGrantTimerCount++] = grantTimer;
+        } else {
+            armGrantTimerLocked(talkgroup, now);
+        }
+    }
+
+    // Act and log outside the lock
+    for (size_t i = 0; i < changedCount; i++) {
+        onGrantExpired(changed[i], changedFrom[i], now);
+    }
+}
+
+void TrunkingController::onGrantExpired(const Grant& grant, CallState from, uint64_t nowMs) {
+    if (grant.state == CallState::Hang) {
+        // Timed out without an EOT - stop treating it as the current call
+        if (grant.direction == CallDirection::RF) {
+            for (auto& channel : m_channels) {
+                uint32_t expected = grant.talkgroup;
+                channel->rfTalkgroup.compare_exchange_strong(expected, 0);
+            }
+        } else {
+            uint32_t expected = grant.talkgroup;
+            m_networkTalkgroup.compare_exchange_strong(expected, 0);
+            endConcealment();
+        }
+        for (auto& channel : m_channels) {
+            channel->calls.onTimeout(grant.direction, grant.talkgroup);
+        }
+        LOG_WARNF("Call on TG %u timed out without EOT", grant.talkgroup);
+    } else if (grant.state == CallState::Released) {
+        // The talkgroup's hang time is over - its channel can carry another
+        m_pool.release(grant.talkgroup, nowMs);
     }
+    logTransition(grant, from);
 }
 
-void TrunkingController::processTSBK(const std::vector<uint8_t>& data) {
-    if (data.size() < 12) {
+void TrunkingController::resetGrantTimers() {
+    // Not under m_stateMutex - cancel waits for a running callback, which takes it
+    for (auto& grantTimer : m_grantTimers) {
+        TimerWheel::getInstance().cancel(grantTimer.timer);
+    }
+
+    std::lock_guard<std::mutex> lock(m_stateMutex);
+    m_grantTimerOf.clear();
+    for (size_t i = 0; i < GrantTable::MAX_GRANTS; i++) {
+        m_grantTimers[i].talkgroup = 0;
+        m_freeGrantTimers[i] = &m_grantTimers[i];
+    }
+    m_freeGrantTimerCount = GrantTable::MAX_GRANTS;
+}
+
+void TrunkingController::watchControlVoice() {
+    if (!m_running || m_controlVoiceWatched.exchange(true)) {
         return;
     }
 
-    // Simple TSBK processing (real implementation would decode full TSBK structure)
-    // For now, just log that we received it
-    LOG_DEBUG("Processing TSBK message");
+    uint64_t now = Clock::nowMs();
+    uint64_t idleAtMs = now;
+    m_control->arbiter.tick(now, &idleAtMs);
+    TimerWheel::getInstance().schedule(m_controlVoiceTimer, static_cast<uint32_t>(idleAtMs > now ? idleAtMs - now : 0),
+        [this]() { onControlVoiceTimer(); });
+}
 
-    // In a real system, this would:
-    // - Decode TSBK opcode
-    // - Handle different TSBK message types (Group Voice Grant, etc.)
-    // - Manage trunking state
-    // - Switch channels as needed
+void TrunkingController::onControlVoiceTimer() {
+    uint64_t now = Clock::nowMs();
+    uint64_t idleAtMs = now;
+    if (m_control->arbiter.tick(now, &idleAtMs)) {
+        // Frames kept coming - wait for the new release time
+        if (m_running) {
+            TimerWheel::getInstance().schedule(m_controlVoiceTimer,
+                static_cast<uint32_t>(idleAtMs > now ? idleAtMs - now : 0), [this]() { onControlVoiceTimer(); });
+        }
+        return;
+    }
+
+    m_controlVoiceWatched = false;
+    m_controlChannel.setVoiceActive(false);
+
+    // A call that keyed up in between saw the watch still set
+    if (m_control->arbiter.tick(Clock::nowMs())) {
+        m_controlChannel.setVoiceActive(true);
+        watchControlVoice();
+    }
 }
 
-void TrunkingController::handleVoiceFrame(const std::vector<uint8_t>& data) {
-    // Extract talkgroup and source from voice frame
-    uint32_t tg = P25Protocol::extractTalkgroupId(data);
-    uint32_t src = P25Protocol::extractSourceId(data);
+void TrunkingController::expireUnits() {
+    uint64_t timeoutMs = static_cast<uint64_t>(m_config.registration_timeout) * 1000;
+    size_t expired;
+    {
+        std::lock_guard<std::mutex> lock(m_stateMutex);
+        expired = m_units.expire(Clock::nowMs(), timeoutMs);
+    }
+
+    if (expired > 0) {
+        LOG_INFOF("Deregistered %zu units not heard from in %d s", expired, m_config.registration_timeout);
+    }
+}
+
+uint64_t TrunkingController::getArbiterDropped(CallDirection direction) const {
+    uint64_t dropped = 0;
+    for (const auto& channel : m_channels) {
+        dropped += channel->arbiter.getDropped(direction);
+    }
+    return dropped;
+}
+
+uint64_t TrunkingController::getPreemptions() const {
+    uint64_t preemptions = 0;
+    for (const auto& channel : m_channels) {
+        preemptions += channel->arbiter.getPreemptions();
+    }
+    return preemptions;
+}
+
+bool TrunkingController::getLiveCall(CallDirection direction, CallRecord& record) {
+    for (auto& channel : m_channels) {
+        if (channel->calls.snapshot(direction, record)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void TrunkingController::setCallEndCallback(CallTracker::EndCallback callback) {
+    for (auto& channel : m_channels) {
+        channel->calls.setEndCallback(callback);
+    }
+}
+
+size_t TrunkingController::getActiveGrantCount() {
+    std::lock_guard<std::mutex> lock(m_stateMutex);
+    return m_grants.size();
+}
+
+size_t TrunkingController::getRegisteredUnitCount() {
+    std::lock_guard<std::mutex> lock(m_stateMutex);
+    return m_units.size();
+}
+
+void TrunkingController::refreshSubscriptions() {
+    if (!m_subscriptions.isEnabled()) {
+        return;
+    }
+
+    uint64_t now = Clock::nowMs();
+    uint64_t idleMs = static_cast<uint64_t>(m_network->getConfig().talkgroup_idle_timeout) * 1000;
+
+    // Affiliated talkgroups, as of the last time one of their units was
+    // heard - a unit that went quiet stops keeping its talkgroup subscribed
+    OpenAddressMap<uint64_t, 1024> affiliated;
+    {
+        std::lock_guard<std::mutex> lock(m_stateMutex);
+        m_units.forEach([&](uint32_t, const UnitEntry& unit) {
+            if (unit.talkgroup == 0 || unit.lastSeenMs + idleMs <= now) {
+                return;
+            }
+            uint64_t* lastSeen = affiliated.insert(unit.talkgroup);
+            if (lastSeen && unit.lastSeenMs > *lastSeen) {
+                *lastSeen = unit.lastSeenMs;
+            }
+        });
+    }
+
+    affiliated.forEach([&](uint32_t tg, uint64_t& lastSeenMs) {
+        m_subscriptions.noteInterest(tg, lastSeenMs);
+    });
+
+    m_subscriptions.refresh(now);
+}
 
-    if (tg > 0 && !m_inCall) {
-        m_inCall = true;
-        m_currentTalkgroup = tg;
-        LOG_INFO("Voice call started - TG: " + std::to_string(tg) + " SRC: " + std::to_string(src));
+void TrunkingController::logTransition(const Grant& grant, CallState from) {
+    if (grant.state == CallState::Granted) {
+        LOG_INFOF("TG %u: %s -> %s (SRC %u, channel %u%s)", grant.talkgroup, callStateName(from),
+                  callStateName(grant.state), grant.source, static_cast<unsigned>(grant.channel),
+                  grant.emergency ? ", EMERGENCY" : "");
+    } else {
+        Logger::getInstance().logf(grant.state == CallState::Released ? LogLevel::INFO : LogLevel::DEBUG,
+                                   "TG %u: %s -> %s", grant.talkgroup, callStateName(from), callStateName(grant.state));
     }
 }
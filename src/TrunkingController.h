@@ -2,38 +2,229 @@
 
 #include "ModemSerial.h"
 #include "NetworkClient.h"
+#include "P25Protocol.h"
+#include "TrunkingState.h"
+#include "TalkgroupFilter.h"
+#include "SubscriptionManager.h"
+#include "CallArbiter.h"
+#include "ChannelPool.h"
+#include "TsbkScheduler.h"
+#include "CallTracker.h"
+#include "VoiceConcealer.h"
+#include "TimerWheel.h"
+#include "StateImage.h"
 #include "Config.h"
 #include <memory>
 #include <atomic>
+#include <mutex>
+#include <vector>
 
 class TrunkingController {
 public:
+    // One per modem. The control channel goes to the modem with role
+    // "control" (or "both" on a single-frequency hotspot); voice goes to
+    // "traffic"/"both" modems, one talkgroup per channel at a time.
     TrunkingController(
         const P25Config& config,
-        std::shared_ptr<ModemSerial> modem,
-        std::shared_ptr<NetworkClient> network
+        std::vector<std::shared_ptr<ModemSerial>> modems,
+        std::shared_ptr<NetworkClient> network,
+        CallJournal& journal
     );
     ~TrunkingController() = default;
 
     void start();
     void stop();
 
+    // Stop acting on frames and timers without releasing anything the
+    // reflector or the radios hold, so another process can carry on with
+    // the site. start() resumes.
+    void suspend();
+
+    // Calls, grants, units, subscriptions and channel assignments, for a
+    // handoff to a new process. Restore before start().
+    void saveState(StateImage& image);
+    bool restoreState(StateImage& image);
+
+    // What outlives the process for a warm restart: grants, units,
+    // subscriptions and the channels held for them - not calls in progress.
+    // ageMs is how long ago the image was saved. Restore before start().
+    void saveSnapshot(StateImage& image);
+    bool restoreSnapshot(StateImage& image, uint64_t ageMs);
+
+    // An RF channel of the site: its modem, and the arbitration and call
+    // records for the traffic on it
+    struct Channel {
+        Channel(TrunkingController& owner, size_t index, std::shared_ptr<ModemSerial> modem,
+                const P25Config& config, CallJournal& journal);
+
+        // Modem read thread entry point
+        void handleModemData(const P25FrameView& frame) { owner.handleModemData(*this, frame); }
+
+        TrunkingController& owner;
+        const size_t index;
+        std::shared_ptr<ModemSerial> modem;
+        uint16_t channelId;
+        bool control;         // carries the control channel
+        bool traffic;         // carries voice
+        size_t poolIndex;     // ChannelPool::NONE unless traffic
+        uint32_t txDelayMs;   // modem key-up before the first record it sends
+
+        CallArbiter arbiter;
+        CallTracker calls;
+
+        // Talkgroup of the RF call on this channel (0 = none)
+        std::atomic<uint32_t> rfTalkgroup;
+    };
+
+    // Frame entry points. start() publishes them as the modem and network
+    // handlers; frames arriving while stopped are dropped.
+    void handleModemData(Channel& channel, const P25FrameView& frame);
+    void handleNetworkData(const P25FrameView& frame);
+
+    // Fixed wiring for ModemSerial::open(sink) and NetworkClient::start(sink),
+    // which compiles the controller into the I/O loops
+    using ModemSink = StaticFrameHandler<Channel, &Channel::handleModemData>;
+    using NetworkSink = StaticFrameHandler<TrunkingController, &TrunkingController::handleNetworkData>;
+    ModemSink getModemSink(size_t index) { return ModemSink{m_channels[index].get()}; }
+    NetworkSink getNetworkSink() { return NetworkSink{this}; }
+
+    size_t getActiveGrantCount();
+    size_t getRegisteredUnitCount();
+    size_t getSubscriptionCount() { return m_subscriptions.getSubscriptionCount(); }
+
+    size_t getChannelCount() const { return m_channels.size(); }
+    size_t getBusyTrafficChannels() { return m_pool.getBusyCount(); }
+
+    const TalkgroupFilter& getFilter() const { return m_filter; }
+    TsbkScheduler& getControlChannel() { return m_controlChannel; }
+
+    // Arbitration counters summed over the channels
+    uint64_t getArbiterDropped(CallDirection direction) const;
+    uint64_t getPreemptions() const;
+
+    // Calls refused because every traffic channel was busy
+    uint64_t getChannelBusyCount() const { return m_pool.getRejected(); }
+
+    // Quality counters of a call currently passing in direction (the first
+    // channel that has one)
+    bool getLiveCall(CallDirection direction, CallRecord& record);
+
+    // Finished calls (status board). Set before start().
+    void setCallEndCallback(CallTracker::EndCallback callback);
+
+    // Frames whose type byte matched no known class
+    uint64_t getUnknownFrameCount() const { return m_unknownFrames.load(); }
+
 private:
-    // Callbacks
-    void handleModemData(const std::vector<uint8_t>& data);
-    void handleNetworkData(const std::vector<uint8_t>& data);
+    using ModemHandler = void (TrunkingController::*)(Channel&, const P25FrameView&);
+    using FrameHandler = void (TrunkingController::*)(const P25FrameView&);
+
+    // Timer of a tracked grant, armed at its next timeout. Grants move around
+    // inside their table, so the timers live apart from them and are handed
+    // to talkgroups under m_stateMutex.
+    struct GrantTimer {
+        uint32_t talkgroup;   // 0 = free
+        TimerWheel::Timer timer;
+    };
+
+    // Per-class handlers, indexed by P25FrameClass
+    static const ModemHandler s_modemHandlers[P25_FRAME_CLASS_COUNT];
+    static const FrameHandler s_networkHandlers[P25_FRAME_CLASS_COUNT];
+
+    // RF → network handlers
+    void forwardToNetwork(const P25FrameView& frame);
+    int16_t frameRssi(const Channel& channel) const;
+    void endConcealment();
+    void onModemLdu1(Channel& channel, const P25FrameView& frame);
+    void onModemLdu2(Channel& channel, const P25FrameView& frame);
+    void onModemEot(Channel& channel, const P25FrameView& frame);
+    void onModemTsbk(Channel& channel, const P25FrameView& frame);
+    void onModemIgnored(Channel& channel, const P25FrameView& frame);
+    void onModemUnknown(Channel& channel, const P25FrameView& frame);
+
+    // Network → RF handlers
+    bool filterNetworkFrame(const P25FrameView& frame, P25FrameClass frameClass);
+    // taken is set when the frame took a free traffic channel for its talkgroup
+    Channel* routeNetworkVoice(const P25FrameView& frame, P25FrameClass frameClass, bool& taken);
+    void onNetworkVoice(const P25FrameView& frame);
+    void onNetworkEot(const P25FrameView& frame);
+    void onNetworkGrant(const P25FrameView& frame);
+    void onNetworkTsbk(const P25FrameView& frame);
+
+    void onIgnoredFrame(const P25FrameView& frame);
+    void onUnknownFrame(const P25FrameView& frame);
 
     // Trunking logic
-    void processTSBK(const std::vector<uint8_t>& data);
-    void handleVoiceFrame(const std::vector<uint8_t>& data);
+    void processTSBK(const P25FrameView& frame, CallDirection direction);
+    // False if no grant tracks the call (no talkgroup, grant table full)
+    bool handleVoiceFrame(const P25FrameView& frame, CallDirection direction, Channel& channel);
+    void handleEndOfCall(uint32_t talkgroup);
+    bool applyGrant(uint32_t talkgroup, uint32_t source, uint16_t channel, bool emergency, CallDirection direction);
+    void grantTrafficChannel(uint32_t talkgroup, uint32_t source, bool emergency, CallDirection direction);
+    void logTransition(const Grant& grant, CallState from);
+    void refreshSubscriptions();
+    void expireUnits();
+
+    // Grant timeouts. Arming takes m_stateMutex; the wheel never calls back
+    // with its own lock held, so that order is safe.
+    void armGrantTimerLocked(uint32_t talkgroup, uint64_t nowMs);
+    void onGrantTimer(GrantTimer* grantTimer);
+    void onGrantExpired(const Grant& grant, CallState from, uint64_t nowMs);
+    void resetGrantTimers();     // cancels them all and hands them back
+
+    // Voice on a shared modem holds the control channel off until the
+    // channel's arbiter lets go of it
+    void watchControlVoice();
+    void onControlVoiceTimer();
+
+    // More than one traffic channel - talkgroups get channels from the pool
+    bool isMultiChannel() const { return m_pool.size() > 1; }
 
     const P25Config& m_config;
-    std::shared_ptr<ModemSerial> m_modem;
     std::shared_ptr<NetworkClient> m_network;
 
+    // Fixed after construction
+    std::vector<std::unique_ptr<Channel>> m_channels;
+    Channel* m_control;                  // carries the control channel
+    std::vector<Channel*> m_traffic;     // by pool index
+    ChannelPool m_pool;
+
     std::atomic<bool> m_running;
 
-    // Current call state
-    std::atomic<uint32_t> m_currentTalkgroup;
-    std::atomic<bool> m_inCall;
+    // The reflector sends one voice stream at a time: its talkgroup (0 =
+    // none) and the traffic channel it is being relayed on
+    std::atomic<uint32_t> m_networkTalkgroup;
+    std::atomic<Channel*> m_networkChannel;
+    uint32_t m_unroutedTalkgroup;        // no free channel, network thread only
+
+    // Ingress filter. The drop decision is latched on the first LDU1 of a
+    // network call and held until its EOT (network receive thread only).
+    TalkgroupFilter m_filter;
+    bool m_dropNetworkCall;
+    uint32_t m_droppedTalkgroup;
+
+    // Trunking state - shared by the modem and network threads
+    std::mutex m_stateMutex;
+    GrantTable m_grants;
+    UnitRegistry m_units;
+
+    // Talkgroups requested from the reflector
+    SubscriptionManager m_subscriptions;
+
+    // Control channel broadcasts and grants (trunking only)
+    TsbkScheduler m_controlChannel;
+
+    // Network voice on its way to the modem (conceal_loss)
+    VoiceConcealer m_concealer;
+
+    std::atomic<uint64_t> m_unknownFrames;
+
+    // Declared last so they are cancelled before the state they touch goes away
+    OpenAddressMap<GrantTimer*, 512> m_grantTimerOf;   // by talkgroup, under m_stateMutex
+    GrantTimer* m_freeGrantTimers[GrantTable::MAX_GRANTS];
+    size_t m_freeGrantTimerCount;
+    GrantTimer m_grantTimers[GrantTable::MAX_GRANTS];
+    std::atomic<bool> m_controlVoiceWatched;
+    TimerWheel::Timer m_controlVoiceTimer;
+    TimerWheel::Timer m_registryTimer;   // registration timeout sweep
 };
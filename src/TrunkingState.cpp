@@ -0,0 +1,183 @@
+#include "TrunkingState.h"
+
+const char* callStateName(CallState state) {
+    switch (state) {
+        case CallState::Idle:     return "idle";
+        case CallState::Granted:  return "granted";
+        case CallState::Active:   return "active";
+        case CallState::Hang:     return "hang";
+        case CallState::Released: return "released";
+        default: return "unknown";
+    }
+}
+
+Grant* GrantTable::grant(uint32_t talkgroup, uint32_t source, uint16_t channel, CallDirection direction, uint64_t nowMs) {
+    Grant* grant = m_grants.find(talkgroup);
+    if (!grant) {
+        if (m_grants.size() >= MAX_GRANTS) {
+            return nullptr;
+        }
+        grant = m_grants.insert(talkgroup);
+        if (!grant) {
+            return nullptr;
+        }
+        grant->talkgroup = talkgroup;
+        grant->state = CallState::Idle;
+    }
+
+    grant->source = source;
+    grant->channel = channel;
+    grant->direction = direction;
+
+    if (grant->state == CallState::Idle || grant->state == CallState::Released) {
+        grant->state = CallState::Granted;
+        grant->grantedAtMs = nowMs;
+    }
+    grant->lastActivityMs = nowMs;
+    return grant;
+}
+
+Grant* GrantTable::activate(uint32_t talkgroup, uint32_t source, CallDirection direction, uint64_t nowMs) {
+    Grant* grant = m_grants.find(talkgroup);
+    if (!grant) {
+        grant = this->grant(talkgroup, source, 0, direction, nowMs);
+        if (!grant) {
+            return nullptr;
+        }
+    }
+
+    if (grant->state != CallState::Active) {
+        grant->state = CallState::Active;
+        grant->activeAtMs = nowMs;
+    }
+    grant->source = source;
+    grant->direction = direction;
+    grant->lastActivityMs = nowMs;
+    return grant;
+}
+
+Grant* GrantTable::hang(uint32_t talkgroup, uint64_t nowMs) {
+    Grant* grant = m_grants.find(talkgroup);
+    if (!grant || grant->state != CallState::Active) {
+        return nullptr;
+    }
+
+    grant->state = CallState::Hang;
+    grant->hangAtMs = nowMs;
+    return grant;
+}
+
+bool GrantTable::release(uint32_t talkgroup) {
+    Grant* grant = m_grants.find(talkgroup);
+    if (!grant) {
+        return false;
+    }
+
+    grant->state = CallState::Released;
+    return m_grants.erase(talkgroup);
+}
+
+void GrantTable::setTimeouts(uint64_t grantTimeoutMs, uint64_t activityTimeoutMs, uint64_t hangTimeMs) {
+    m_grantTimeoutMs = grantTimeoutMs;
+    m_activityTimeoutMs = activityTimeoutMs;
+    m_hangTimeMs = hangTimeMs;
+}
+
+uint64_t GrantTable::getDeadlineMs(const Grant& grant) const {
+    switch (grant.state) {
+        case CallState::Granted:  return grant.grantedAtMs + m_grantTimeoutMs;
+        case CallState::Active:   return grant.lastActivityMs + m_activityTimeoutMs;
+        case CallState::Hang:     return grant.hangAtMs + m_hangTimeMs;
+        case CallState::Released: return 0;
+        default: return UINT64_MAX;
+    }
+}
+
+bool GrantTable::restore(const Grant& grant) {
+    if (m_grants.size() >= MAX_GRANTS && !m_grants.find(grant.talkgroup)) {
+        return false;
+    }
+
+    Grant* entry = m_grants.insert(grant.talkgroup);
+    if (!entry) {
+        return false;
+    }
+    *entry = grant;
+    return true;
+}
+
+bool UnitRegistry::registerUnit(uint32_t unitId, uint64_t nowMs) {
+    if (m_units.size() >= MAX_UNITS && !m_units.find(unitId)) {
+        return false;
+    }
+
+    bool created = false;
+    UnitEntry* unit = m_units.insert(unitId, &created);
+    if (!unit) {
+        return false;
+    }
+
+    if (created) {
+        unit->unitId = unitId;
+        unit->talkgroup = 0;
+    }
+    if (!unit->registered) {
+        unit->registered = true;
+        unit->registeredAtMs = nowMs;
+    }
+    unit->lastSeenMs = nowMs;
+    return true;
+}
+
+bool UnitRegistry::deregisterUnit(uint32_t unitId) {
+    return m_units.erase(unitId);
+}
+
+bool UnitRegistry::affiliate(uint32_t unitId, uint32_t talkgroup, uint64_t nowMs, uint32_t* previousTalkgroup) {
+    if (!registerUnit(unitId, nowMs)) {
+        return false;
+    }
+
+    UnitEntry* unit = m_units.find(unitId);
+    if (previousTalkgroup) {
+        *previousTalkgroup = unit->talkgroup;
+    }
+    unit->talkgroup = talkgroup;
+    return true;
+}
+
+void UnitRegistry::touch(uint32_t unitId, uint64_t nowMs) {
+    UnitEntry* unit = m_units.find(unitId);
+    if (unit) {
+        unit->lastSeenMs = nowMs;
+    }
+}
+
+size_t UnitRegistry::expire(uint64_t nowMs, uint64_t timeoutMs) {
+    uint32_t expired[MAX_UNITS];
+    size_t expiredCount = 0;
+
+    m_units.forEach([&](uint32_t unitId, const UnitEntry& unit) {
+        if (unit.lastSeenMs + timeoutMs <= nowMs && expiredCount < MAX_UNITS) {
+            expired[expiredCount++] = unitId;
+        }
+    });
+
+    for (size_t i = 0; i < expiredCount; i++) {
+        m_units.erase(expired[i]);
+    }
+    return expiredCount;
+}
+
+bool UnitRegistry::restore(const UnitEntry& unit) {
+    if (m_units.size() >= MAX_UNITS && !m_units.find(unit.unitId)) {
+        return false;
+    }
+
+    UnitEntry* entry = m_units.insert(unit.unitId);
+    if (!entry) {
+        return false;
+    }
+    *entry = unit;
+    return true;
+}
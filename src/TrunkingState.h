@@ -0,0 +1,157 @@
+#pragma once
+
+#include "OpenAddressMap.h"
+#include <cstdint>
+#include <cstddef>
+
+// Per-call state. A call only moves forward through these; Released entries
+// are removed from the table as soon as the timeout that released them runs.
+enum class CallState : uint8_t {
+    Idle = 0,
+    Granted,
+    Active,
+    Hang,
+    Released
+};
+
+const char* callStateName(CallState state);
+
+// Which side of the hotspot a call came from
+enum class CallDirection : uint8_t {
+    RF = 0,
+    Network
+};
+
+struct Grant {
+    uint32_t talkgroup;
+    uint32_t source;
+    uint16_t channel;
+    CallState state;
+    CallDirection direction;
+    bool emergency;
+    uint64_t grantedAtMs;
+    uint64_t activeAtMs;
+    uint64_t lastActivityMs;
+    uint64_t hangAtMs;
+};
+
+// Active grants keyed by talkgroup
+class GrantTable {
+public:
+    static const size_t MAX_GRANTS = 256;
+
+    GrantTable() = default;
+
+    // Idle/Released → Granted (a grant for an already-active call just refreshes it)
+    Grant* grant(uint32_t talkgroup, uint32_t source, uint16_t channel, CallDirection direction, uint64_t nowMs);
+
+    // Idle/Granted/Hang → Active. Voice without a preceding grant (conventional
+    // operation, late entry) creates an implicit grant on channel 0.
+    Grant* activate(uint32_t talkgroup, uint32_t source, CallDirection direction, uint64_t nowMs);
+
+    // Active → Hang
+    Grant* hang(uint32_t talkgroup, uint64_t nowMs);
+
+    // Any → Released
+    bool release(uint32_t talkgroup);
+
+    // Put back a grant taken from another process's table
+    bool restore(const Grant& grant);
+
+    // How long a grant may sit in each state without anything happening to it
+    void setTimeouts(uint64_t grantTimeoutMs, uint64_t activityTimeoutMs, uint64_t hangTimeMs);
+
+    // When the grant next times out if nothing happens to it, UINT64_MAX never
+    uint64_t getDeadlineMs(const Grant& grant) const;
+
+    // Applies the timeouts to one grant: Granted with no voice, Active with no
+    // frames and Hang past the hang time all move on. fn(grant, from) is called
+    // for every transition; a released grant is then dropped from the table.
+    // Returns the grant's next deadline, UINT64_MAX once it is gone.
+    template <typename Fn>
+    uint64_t expire(uint32_t talkgroup, uint64_t nowMs, Fn&& fn);
+
+    Grant* find(uint32_t talkgroup) { return m_grants.find(talkgroup); }
+    size_t size() const { return m_grants.size(); }
+
+    template <typename Fn>
+    void forEach(Fn&& fn) const { m_grants.forEach(fn); }
+
+private:
+    OpenAddressMap<Grant, 512> m_grants;
+    uint64_t m_grantTimeoutMs = 0;
+    uint64_t m_activityTimeoutMs = 0;
+    uint64_t m_hangTimeMs = 0;
+};
+
+struct UnitEntry {
+    uint32_t unitId;
+    uint32_t talkgroup;  // current affiliation, 0 = none
+    bool registered;
+    uint64_t registeredAtMs;
+    uint64_t lastSeenMs;
+};
+
+// Unit registration and group affiliation registry keyed by unit ID
+class UnitRegistry {
+public:
+    static const size_t MAX_UNITS = 4096;
+
+    UnitRegistry() = default;
+
+    bool registerUnit(uint32_t unitId, uint64_t nowMs);
+    bool deregisterUnit(uint32_t unitId);
+
+    // Affiliating implicitly registers the unit. Returns the previous
+    // affiliation through previousTalkgroup (0 if none).
+    bool affiliate(uint32_t unitId, uint32_t talkgroup, uint64_t nowMs, uint32_t* previousTalkgroup = nullptr);
+
+    // Refresh last-seen time for a unit heard on voice
+    void touch(uint32_t unitId, uint64_t nowMs);
+
+    // Drops units not heard from for timeoutMs, with their affiliations.
+    // Returns how many went.
+    size_t expire(uint64_t nowMs, uint64_t timeoutMs);
+
+    // Put back an entry taken from another process's registry
+    bool restore(const UnitEntry& unit);
+
+    const UnitEntry* find(uint32_t unitId) const { return m_units.find(unitId); }
+    size_t size() const { return m_units.size(); }
+
+    template <typename Fn>
+    void forEach(Fn&& fn) const { m_units.forEach(fn); }
+
+private:
+    OpenAddressMap<UnitEntry, 8192> m_units;
+};
+
+template <typename Fn>
+uint64_t GrantTable::expire(uint32_t talkgroup, uint64_t nowMs, Fn&& fn) {
+    Grant* grant = m_grants.find(talkgroup);
+    while (grant) {
+        uint64_t deadlineMs = getDeadlineMs(*grant);
+        if (deadlineMs > nowMs) {
+            return deadlineMs;
+        }
+
+        CallState from = grant->state;
+        if (grant->state == CallState::Active) {
+            // Lost the EOT - treat as end of transmission
+            grant->state = CallState::Hang;
+            grant->hangAtMs = nowMs;
+        } else {
+            grant->state = CallState::Released;
+        }
+
+        if (grant->state != from) {
+            fn(*grant, from);
+        }
+
+        if (grant->state == CallState::Released) {
+            m_grants.erase(talkgroup);
+            grant = nullptr;
+        }
+    }
+    return UINT64_MAX;
+}
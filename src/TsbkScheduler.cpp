@@ -0,0 +1,205 @@
+#include "TsbkScheduler.h"
+#include "P25Protocol.h"
+#include "Logger.h"
+#include "Clock.h"
+#include <cstring>
+
+static int64_t monotonicNs() {
+    return static_cast<int64_t>(Clock::get().monotonicNs());
+}
+
+TsbkScheduler::TsbkScheduler(const P25Config& config, Sink sink)
+    : m_config(config)
+    , m_sink(sink)
+    , m_slotNs(static_cast<int64_t>(config.tsbk_slot_us > 0 ? config.tsbk_slot_us : 25000) * 1000)
+    , m_broadcastIndex(0)
+    , m_sinceBroadcast(0)
+    , m_stats()
+    , m_startNs(0)
+    , m_slotsAccounted(0)
+    , m_voiceActive(false)
+    , m_running(false)
+{
+    buildBroadcasts();
+}
+
+TsbkScheduler::~TsbkScheduler() {
+    stop();
+}
+
+void TsbkScheduler::buildBroadcasts() {
+    Record record;
+
+    if (P25Protocol::writeRfssStatus(record.data(), record.size(), m_config)) {
+        m_broadcasts.push_back(record);
+    }
+    if (P25Protocol::writeNetworkStatus(record.data(), record.size(), m_config)) {
+        m_broadcasts.push_back(record);
+    }
+    for (const auto& identifier : m_config.identifiers) {
+        if (P25Protocol::writeIdentifierUpdate(record.data(), record.size(), identifier)) {
+            m_broadcasts.push_back(record);
+        }
+    }
+    for (const auto& adjacent : m_config.adjacent_sites) {
+        if (P25Protocol::writeAdjacentStatus(record.data(), record.size(), m_config, adjacent)) {
+            m_broadcasts.push_back(record);
+        }
+    }
+}
+
+void TsbkScheduler::start() {
+    if (m_running.exchange(true)) {
+        return;
+    }
+
+    m_startNs = monotonicNs();
+    m_slotsAccounted = 0;
+
+    LOG_INFO("Control channel: " + std::to_string(m_broadcasts.size()) + " broadcasts, one TSBK every " +
+             std::to_string(m_slotNs / 1000) + " us");
+
+    TimerWheel::getInstance().schedulePeriodic(m_timer, TimerWheel::TICK_MS, [this]() {
+        onTick();
+    });
+}
+
+void TsbkScheduler::stop() {
+    if (!m_running.exchange(false)) {
+        return;
+    }
+
+    TimerWheel::getInstance().cancel(m_timer);
+
+    Stats stats = getStats();
+    LOG_INFO("Control channel: " + std::to_string(stats.slots) + " slots, " +
+             std::to_string(stats.broadcasts) + " broadcasts, " +
+             std::to_string(stats.sent[static_cast<size_t>(TsbkPriority::Emergency)] +
+                            stats.sent[static_cast<size_t>(TsbkPriority::Grant)]) + " grants, " +
+             std::to_string(stats.sent[static_cast<size_t>(TsbkPriority::Relay)]) + " relayed, " +
+             std::to_string(stats.yielded) + " yielded to voice, " +
+             std::to_string(stats.missed) + " missed (fill " +
+             std::to_string(static_cast<int>(getFillRatio() * 100)) + "%, signaling " +
+             std::to_string(static_cast<int>(getSignalingLoad() * 100)) + "%)");
+}
+
+bool TsbkScheduler::enqueue(const P25FrameView& tsbk, TsbkPriority priority) {
+    if (tsbk.size() < TSBK_LENGTH) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Queue& queue = m_queues[static_cast<size_t>(priority)];
+    if (queue.count == QUEUE_DEPTH) {
+        m_stats.overflows++;
+        return false;
+    }
+
+    Record& record = queue.records[(queue.head + queue.count) % QUEUE_DEPTH];
+    memcpy(record.data(), tsbk.data(), TSBK_LENGTH);
+    queue.count++;
+    return true;
+}
+
+bool TsbkScheduler::enqueueGrant(uint32_t talkgroup, uint32_t source, uint16_t channel, bool emergency) {
+    uint8_t buffer[TSBK_LENGTH];
+    size_t length = P25Protocol::writeGroupVoiceGrant(buffer, sizeof(buffer),
+        emergency ? SVC_OPT_EMERGENCY : 0, channel, talkgroup, source);
+
+    return enqueue(P25FrameView(buffer, length), emergency ? TsbkPriority::Emergency : TsbkPriority::Grant);
+}
+
+bool TsbkScheduler::nextRecord(Record& record) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // Broadcasts are what keep idle radios on the site - never starve them
+    bool forceBroadcast = m_sinceBroadcast >= BROADCAST_MAX_GAP;
+
+    if (!forceBroadcast) {
+        for (size_t p = 0; p < static_cast<size_t>(TsbkPriority::Count); p++) {
+            Queue& queue = m_queues[p];
+            if (queue.count == 0) {
+                continue;
+            }
+            record = queue.records[queue.head];
+            queue.head = (queue.head + 1) % QUEUE_DEPTH;
+            queue.count--;
+            m_stats.sent[p]++;
+            m_sinceBroadcast++;
+            return true;
+        }
+    }
+
+    if (m_broadcasts.empty()) {
+        return false;
+    }
+
+    record = m_broadcasts[m_broadcastIndex];
+    m_broadcastIndex = (m_broadcastIndex + 1) % m_broadcasts.size();
+    m_stats.broadcasts++;
+    m_sinceBroadcast = 0;
+    return true;
+}
+
+void TsbkScheduler::onTick() {
+    // Slots owed since start, from the clock rather than the tick count
+    uint64_t due = static_cast<uint64_t>((monotonicNs() - m_startNs) / m_slotNs);
+    if (due <= m_slotsAccounted) {
+        return;
+    }
+
+    uint64_t owed = due - m_slotsAccounted;
+    m_slotsAccounted = due;
+
+    uint64_t skipped = 0;
+    if (owed > MAX_BURST) {
+        skipped = owed - MAX_BURST;
+        owed = MAX_BURST;
+    }
+
+    uint64_t yielded = 0;
+    uint64_t failed = 0;
+
+    if (m_voiceActive.load(std::memory_order_relaxed)) {
+        yielded = owed;
+    } else {
+        Record record;
+        for (uint64_t i = 0; i < owed; i++) {
+            if (!nextRecord(record) || !m_sink(P25FrameView(record.data(), record.size()))) {
+                failed++;
+            }
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.slots += owed + skipped;
+    m_stats.yielded += yielded;
+    m_stats.missed += skipped + failed;
+}
+
+TsbkScheduler::Stats TsbkScheduler::getStats() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+double TsbkScheduler::getFillRatio() {
+    Stats stats = getStats();
+    uint64_t available = stats.slots - stats.yielded;
+    if (available == 0) {
+        return 0.0;
+    }
+    return static_cast<double>(available - stats.missed) / available;
+}
+
+double TsbkScheduler::getSignalingLoad() {
+    Stats stats = getStats();
+    uint64_t queued = 0;
+    for (size_t p = 0; p < static_cast<size_t>(TsbkPriority::Count); p++) {
+        queued += stats.sent[p];
+    }
+    uint64_t transmitted = queued + stats.broadcasts;
+    if (transmitted == 0) {
+        return 0.0;
+    }
+    return static_cast<double>(queued) / transmitted;
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "Config.h"
+#include "P25Frame.h"
+#include "TimerWheel.h"
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <functional>
+
+// Queued TSBKs go out ahead of the broadcast rotation, highest first
+enum class TsbkPriority : uint8_t {
+    Emergency = 0,
+    Grant,
+    Relay,    // TSBKs from the network
+    Count
+};
+
+// Keeps the control channel filled at one TSBK per slot. Each slot carries
+// the highest-priority queued TSBK, or the next entry of the broadcast
+// rotation (RFSS/network/adjacent status, identifier updates) when nothing
+// is queued. Slots are counted against the monotonic clock from start(), so
+// the long-run rate is exact even though the wheel only wakes every tick.
+class TsbkScheduler {
+public:
+    using Sink = std::function<bool(const P25FrameView&)>;
+
+    static const size_t QUEUE_DEPTH = 32;
+
+    // A broadcast is forced at least this often, however busy the queues are
+    static const uint32_t BROADCAST_MAX_GAP = 8;
+
+    // Slots more than this far behind are written off rather than bursted
+    static const uint32_t MAX_BURST = 4;
+
+    struct Stats {
+        uint64_t slots;      // elapsed since start
+        uint64_t sent[static_cast<size_t>(TsbkPriority::Count)];
+        uint64_t broadcasts;
+        uint64_t yielded;    // slots given to voice
+        uint64_t missed;     // slots with nothing written (late or sink failure)
+        uint64_t overflows;  // TSBKs dropped on a full queue
+    };
+
+    TsbkScheduler(const P25Config& config, Sink sink);
+    ~TsbkScheduler();
+
+    void start();
+    void stop();
+
+    bool enqueue(const P25FrameView& tsbk, TsbkPriority priority);
+    bool enqueueGrant(uint32_t talkgroup, uint32_t source, uint16_t channel, bool emergency);
+
+    // Single-frequency hotspot: the control channel stands down during voice
+    void setVoiceActive(bool active) { m_voiceActive.store(active, std::memory_order_relaxed); }
+
+    size_t getBroadcastCount() const { return m_broadcasts.size(); }
+    Stats getStats();
+
+    // Fraction of slots actually transmitted, and of those, the fraction
+    // carrying queued traffic rather than broadcast fill
+    double getFillRatio();
+    double getSignalingLoad();
+
+private:
+    using Record = std::array<uint8_t, TSBK_LENGTH>;
+
+    struct Queue {
+        std::array<Record, QUEUE_DEPTH> records;
+        size_t head = 0;
+        size_t count = 0;
+    };
+
+    void buildBroadcasts();
+    void onTick();
+    bool nextRecord(Record& record);
+
+    const P25Config& m_config;
+    Sink m_sink;
+    int64_t m_slotNs;
+
+    std::vector<Record> m_broadcasts;
+    size_t m_broadcastIndex;
+
+    std::mutex m_mutex;
+    Queue m_queues[static_cast<size_t>(TsbkPriority::Count)];
+    uint32_t m_sinceBroadcast;
+    Stats m_stats;
+
+    // Wheel thread only
+    int64_t m_startNs;
+    uint64_t m_slotsAccounted;
+
+    std::atomic<bool> m_voiceActive;
+    std::atomic<bool> m_running;
+    TimerWheel::Timer m_timer;
+};
@@ -0,0 +1,223 @@
+#include "VoiceConcealer.h"
+#include "FrameTrace.h"
+#include "Clock.h"
+#include <cstring>
+
+// IMBE encoding of silence
+static const uint8_t IMBE_SILENCE[IMBE_FRAME_LENGTH] = {
+    0x04, 0x0C, 0xFD, 0x7B, 0xFB, 0x7D, 0xF2, 0x7B, 0x3D, 0x9E, 0x45
+};
+
+VoiceConcealer::VoiceConcealer(Sink sink, ConcealHook hook)
+    : m_sink(std::move(sink))
+    , m_hook(std::move(hook))
+    , m_txDelayMs(0)
+    , m_active(false)
+    , m_expected(0)
+    , m_playoutEndUs(0)
+    , m_run(0)
+    , m_talkgroup(0)
+    , m_source(0)
+    , m_lastImbe()
+    , m_haveImbe(false)
+    , m_stats()
+{
+}
+
+VoiceConcealer::~VoiceConcealer() {
+    TimerWheel::getInstance().cancel(m_timer);
+}
+
+void VoiceConcealer::onVoice(const P25FrameView& record, uint32_t txDelayMs) {
+    if (record.empty() || !P25Protocol::isVoiceFrame(record.frameType()) || record.size() > P25_MAX_FRAME_LENGTH) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    uint64_t nowUs = Clock::nowUs();
+    size_t position = positionOf(record.frameType());
+    m_txDelayMs = txDelayMs;
+
+    // A different talker without an EOT is a new stream - old fill is wrong for it
+    if (classifyFrame(record.frameType()) == P25FrameClass::VoiceLdu1 && record.hasLinkControl() &&
+        record.talkgroupId() != 0) {
+        if (m_active && (record.talkgroupId() != m_talkgroup || record.sourceId() != m_source)) {
+            resetLocked();
+        }
+        m_talkgroup = record.talkgroupId();
+        m_source = record.sourceId();
+    }
+
+    if (!m_active) {
+        m_active = true;
+        m_expected = position;
+    }
+
+    size_t distance = (position + POSITIONS - m_expected) % POSITIONS;
+    if (distance > POSITIONS / 2) {
+        // Behind the stream - its slot was concealed or it is a duplicate
+        m_stats.late++;
+        return;
+    }
+
+    // Missing positions are only filled if the modem would otherwise starve
+    // before this record reaches it. Fill written here is not this record -
+    // keep its trace stamps off it.
+    FrameTrace::Stamp stamp;
+    FrameTrace::take(stamp);
+    while (m_expected != position) {
+        if (!isStarvingLocked(nowUs) || m_run >= MAX_CONCEALED_RUN || !concealLocked(nowUs)) {
+            m_stats.skipped += (position + POSITIONS - m_expected) % POSITIONS;
+            m_expected = position;
+            break;
+        }
+    }
+
+    Record& slot = m_templates[position];
+    memcpy(slot.data, record.data(), record.size());
+    slot.length = record.size();
+
+    m_run = 0;
+    FrameTrace::resume(CallDirection::Network, stamp);
+    if (writeLocked(record, nowUs)) {
+        m_stats.written++;
+        if (record.size() > IMBE_FRAME_LENGTH) {
+            memcpy(m_lastImbe, record.data() + record.size() - IMBE_FRAME_LENGTH, IMBE_FRAME_LENGTH);
+            m_haveImbe = true;
+        }
+    }
+}
+
+void VoiceConcealer::onEnd() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        resetLocked();
+    }
+
+    // Outside the lock - a running callback needs it to finish
+    TimerWheel::getInstance().cancel(m_timer);
+}
+
+bool VoiceConcealer::isActive() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_active;
+}
+
+VoiceConcealer::Stats VoiceConcealer::getStats() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+bool VoiceConcealer::writeLocked(const P25FrameView& record, uint64_t nowUs) {
+    if (!m_sink(record)) {
+        return false;
+    }
+
+    // The modem keys up for its TX delay when it has nothing to send, then
+    // plays one record every 20 ms
+    uint64_t startUs = m_playoutEndUs > nowUs ? m_playoutEndUs : nowUs + m_txDelayMs * 1000ULL;
+    m_playoutEndUs = startUs + RECORD_MS * 1000ULL;
+    m_expected = (positionOf(record.frameType()) + 1) % POSITIONS;
+
+    armLocked(nowUs);
+    return true;
+}
+
+bool VoiceConcealer::concealLocked(uint64_t nowUs) {
+    bool repeat = m_haveImbe && m_run < MAX_REPEATS;
+
+    Record record;
+    if (!buildLocked(m_expected, repeat, record)) {
+        return false;
+    }
+
+    if (!writeLocked(P25FrameView(record.data, record.length), nowUs)) {
+        return false;
+    }
+
+    m_run++;
+    if (repeat) {
+        m_stats.repeated++;
+    } else {
+        m_stats.silenced++;
+    }
+    if (m_hook) {
+        m_hook();
+    }
+    return true;
+}
+
+bool VoiceConcealer::buildLocked(size_t position, bool repeat, Record& out) {
+    // Prefer the last record seen in this position, then one from the same
+    // LDU (same LC/ES fill), then anything from this stream
+    const Record* source = m_templates[position].length > 0 ? &m_templates[position] : nullptr;
+    size_t first = position - position % 9;
+    for (size_t candidate = first; candidate < first + 9 && !source; candidate++) {
+        if (m_templates[candidate].length > 0) {
+            source = &m_templates[candidate];
+        }
+    }
+    for (size_t candidate = 0; candidate < POSITIONS && !source; candidate++) {
+        if (m_templates[candidate].length > 0) {
+            source = &m_templates[candidate];
+        }
+    }
+    if (!source) {
+        return false;
+    }
+
+    memcpy(out.data, source->data, source->length);
+    out.length = source->length;
+    out.data[0] = static_cast<uint8_t>(FRAME_LDU1_0 + position);
+
+    if (out.length > IMBE_FRAME_LENGTH) {
+        memcpy(out.data + out.length - IMBE_FRAME_LENGTH, repeat ? m_lastImbe : IMBE_SILENCE, IMBE_FRAME_LENGTH);
+    }
+    return true;
+}
+
+bool VoiceConcealer::isStarvingLocked(uint64_t nowUs) const {
+    return m_playoutEndUs < nowUs + STARVATION_GUARD_MS * 1000ULL;
+}
+
+void VoiceConcealer::armLocked(uint64_t nowUs) {
+    uint64_t wakeUs = m_playoutEndUs - STARVATION_GUARD_MS * 1000ULL;
+    uint32_t delayMs = wakeUs > nowUs ? static_cast<uint32_t>((wakeUs - nowUs) / 1000) : 0;
+
+    TimerWheel::getInstance().schedule(m_timer, delayMs, [this]() {
+        onTimer();
+    });
+}
+
+void VoiceConcealer::onTimer() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_active) {
+        return;
+    }
+
+    uint64_t nowUs = Clock::nowUs();
+    if (!isStarvingLocked(nowUs)) {
+        // Fed since this was armed
+        armLocked(nowUs);
+        return;
+    }
+
+    // Past the limit the stream is left to drop; the next real record
+    // starts concealment over
+    if (m_run < MAX_CONCEALED_RUN) {
+        concealLocked(nowUs);
+    }
+}
+
+void VoiceConcealer::resetLocked() {
+    m_active = false;
+    m_expected = 0;
+    m_playoutEndUs = 0;
+    m_run = 0;
+    m_talkgroup = 0;
+    m_source = 0;
+    m_haveImbe = false;
+    for (Record& record : m_templates) {
+        record.length = 0;
+    }
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "P25Frame.h"
+#include "P25Protocol.h"
+#include "TimerWheel.h"
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+
+// Packet-loss concealment for network voice on its way to the modem.
+//
+// Follows the position of each record in the 18-record superframe and keeps
+// a playout clock - when the modem will have transmitted everything written
+// so far, starting one TX delay after the first record of a stream. Only
+// when that clock says the modem is about to run dry and the next record
+// still hasn't arrived is one synthesized: the last record seen in that
+// position (so LC/ES fill is right) carrying a repeat of the previous IMBE
+// frame, or silence once the repeats are used up. A real record arriving
+// for a position that was already concealed is dropped.
+class VoiceConcealer {
+public:
+    using Sink = std::function<bool(const P25FrameView&)>;
+    using ConcealHook = std::function<void()>;
+
+    static const uint32_t RECORD_MS = 20;
+
+    // Synthesize once less than this much audio is left in the modem (more
+    // than a wheel tick of slack)
+    static const uint32_t STARVATION_GUARD_MS = 30;
+
+    // Repeats of the last IMBE frame before switching to silence
+    static const uint32_t MAX_REPEATS = 3;
+
+    // Give up after one superframe of nothing - the carrier drops and the
+    // call times out as before
+    static const uint32_t MAX_CONCEALED_RUN = 18;
+
+    struct Stats {
+        uint64_t written;    // real records passed to the modem
+        uint64_t repeated;   // concealed with the previous IMBE frame
+        uint64_t silenced;   // concealed with a silence frame
+        uint64_t skipped;    // missing with the modem still fed - left out
+        uint64_t late;       // real records dropped, their slot already concealed
+    };
+
+    // hook runs once per synthesized record
+    VoiceConcealer(Sink sink, ConcealHook hook);
+    ~VoiceConcealer();
+
+    VoiceConcealer(const VoiceConcealer&) = delete;
+    VoiceConcealer& operator=(const VoiceConcealer&) = delete;
+
+    // Admitted network voice record (LDU1/LDU2). txDelayMs is the key-up time
+    // of the modem the sink writes it to.
+    void onVoice(const P25FrameView& record, uint32_t txDelayMs);
+
+    // Stream over (EOT, timeout, or the channel went to RF)
+    void onEnd();
+
+    bool isActive();
+    Stats getStats();
+
+private:
+    static const size_t POSITIONS = FRAME_LDU2_8 - FRAME_LDU1_0 + 1;
+
+    struct Record {
+        uint8_t data[P25_MAX_FRAME_LENGTH];
+        size_t length = 0;
+    };
+
+    static size_t positionOf(uint8_t type) { return type - FRAME_LDU1_0; }
+
+    bool writeLocked(const P25FrameView& record, uint64_t nowUs);
+    bool concealLocked(uint64_t nowUs);
+    bool buildLocked(size_t position, bool repeat, Record& out);
+    bool isStarvingLocked(uint64_t nowUs) const;
+    void armLocked(uint64_t nowUs);
+    void onTimer();
+    void resetLocked();
+
+
+    Sink m_sink;
+    ConcealHook m_hook;
+
+    std::mutex m_mutex;
+    uint32_t m_txDelayMs;    // of the modem carrying the stream
+    bool m_active;
+    size_t m_expected;       // position the next record should have
+    uint64_t m_playoutEndUs; // modem runs dry here
+    uint32_t m_run;          // consecutive records concealed
+    uint32_t m_talkgroup;
+    uint32_t m_source;
+
+    // Last real record per superframe position, for LC/ES fill
+    std::array<Record, POSITIONS> m_templates;
+
+    // IMBE frame of the last record written (real or repeated)
+    uint8_t m_lastImbe[IMBE_FRAME_LENGTH];
+    bool m_haveImbe;
+
+    Stats m_stats;
+
+    TimerWheel::Timer m_timer;
+};
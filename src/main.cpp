@@ -3,23 +3,109 @@
 #include "ModemSerial.h"
 #include "NetworkClient.h"
 #include "TrunkingController.h"
+#include "TimerWheel.h"
+#include "CallJournal.h"
+#include "StatusBoard.h"
+#include "Realtime.h"
+#include "FrameTrace.h"
+#include "FrameCapture.h"
+#include "Handoff.h"
+#include "StateSnapshot.h"
+#include "AllocTrace.h"
 #include <iostream>
 #include <signal.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
 #include <memory>
 #include <atomic>
-#include <thread>
-#include <chrono>
+#include <vector>
 
 // Global flag for signal handling
 std::atomic<bool> g_running(true);
 
+// Live status refresh for the web dashboard
+static const uint32_t STATUS_INTERVAL_MS = 500;
+
+// Allocation rate log line (P25_ALLOC_TRACE builds)
+static const uint32_t ALLOC_REPORT_INTERVAL_MS = 60000;
+
+// Main thread blocks on this until shutdown or a health check failure
+static int g_wakeFd = -1;
+
+static void wakeMain() {
+    uint64_t one = 1;
+    ssize_t ignored = write(g_wakeFd, &one, sizeof(one));
+    (void)ignored;
+}
+
 void signalHandler(int signal) {
     if (signal == SIGINT || signal == SIGTERM) {
-        std::cout << "\nReceived shutdown signal..." << std::endl;
+        // Only async-signal-safe calls here
+        static const char message[] = "\nReceived shutdown signal...\n";
+        ssize_t ignored = write(STDOUT_FILENO, message, sizeof(message) - 1);
+        (void)ignored;
         g_running = false;
+        wakeMain();
     }
 }
 
+// Tell systemd (Type=notify) where we are - nothing without NOTIFY_SOCKET
+static void notifySystemd(const std::string& state) {
+    const char* path = getenv("NOTIFY_SOCKET");
+    if (!path || (path[0] != '/' && path[0] != '@') || strlen(path) >= sizeof(sockaddr_un::sun_path)) {
+        return;
+    }
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, path, strlen(path));
+    socklen_t length = static_cast<socklen_t>(offsetof(struct sockaddr_un, sun_path) + strlen(path));
+    if (addr.sun_path[0] == '@') {
+        addr.sun_path[0] = '\0';  // abstract namespace
+    }
+
+    int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd >= 0) {
+        sendto(fd, state.data(), state.size(), MSG_NOSIGNAL, reinterpret_cast<struct sockaddr*>(&addr), length);
+        close(fd);
+    }
+}
+
+// --takeover carries on in a child and returns once that child runs the
+// site, so it works as a systemd ExecReload. Returns the pipe to report
+// success on; the parent only exits.
+static int detachTakeover() {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        return -1;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        return -1;
+    }
+
+    if (pid > 0) {
+        close(fds[1]);
+        char result = 0;
+        ssize_t n = read(fds[0], &result, 1);
+        _exit(n == 1 && result == 1 ? 0 : 1);
+    }
+
+    close(fds[0]);
+    setsid();
+    return fds[1];
+}
+
 LogLevel parseLogLevel(const std::string& level) {
     if (level == "DEBUG") return LogLevel::DEBUG;
     if (level == "INFO") return LogLevel::INFO;
@@ -35,19 +121,27 @@ int main(int argc, char* argv[]) {
     std::cout << "============================================================" << std::endl;
     std::cout << std::endl;
 
-    // Parse command line arguments
+    // Parse command line arguments: [--takeover] [config]
     std::string configFile = "/etc/p25-hotspot.yaml";
-    if (argc > 1) {
-        configFile = argv[1];
+    bool takeover = false;
+    for (int i = 1; i < argc; i++) {
+        if (std::string(argv[i]) == "--takeover") {
+            takeover = true;
+        } else {
+            configFile = argv[i];
+        }
     }
 
     std::cout << "Using config file: " << configFile << std::endl;
 
+    // Before any thread exists
+    int takeoverResult = takeover ? detachTakeover() : -1;
+
     // Load configuration
     Config config;
     if (!config.load(configFile)) {
         std::cerr << "Failed to load configuration from " << configFile << std::endl;
-        std::cerr << "Try: p25-hotspot /path/to/config.yaml" << std::endl;
+        std::cerr << "Try: p25-hotspot [--takeover] /path/to/config.yaml" << std::endl;
         return 1;
     }
 
@@ -78,78 +172,168 @@ int main(int argc, char* argv[]) {
     }
     LOG_INFO("✓ License validated successfully");
 
+    g_wakeFd = eventfd(0, EFD_CLOEXEC);
+    if (g_wakeFd < 0) {
+        LOG_ERROR("Failed to create eventfd");
+        return 1;
+    }
+
     // Register signal handlers
     signal(SIGINT, signalHandler);
     signal(SIGTERM, signalHandler);
 
+    // Realtime scheduling, before the I/O threads start - they apply their own policy
+    if (!Realtime::getInstance().configure(config.getRealtime())) {
+        LOG_WARN("Realtime mode only partly applied - timing may jitter under load");
+    }
+
+    FrameTrace::getInstance().setEnabled(config.getLogging().latency_trace);
+
+    // Call detail records - the hotspot runs without them if the file can't be opened
+    CallJournal journal;
+    if (!config.getLogging().cdr_file.empty() &&
+        !journal.open(config.getLogging().cdr_file, config.getLogging().cdr_records)) {
+        LOG_WARN("Call detail records disabled");
+    }
+
+    // Frame capture for offline replay - before any I/O thread starts
+    if (!config.getLogging().capture_file.empty() &&
+        !FrameCapture::getInstance().open(config.getLogging().capture_file,
+                                          static_cast<uint64_t>(config.getLogging().capture_mb) << 20)) {
+        LOG_WARN("Frame capture disabled");
+    }
+
+    // Live status for the web dashboard - optional as well
+    StatusBoard statusBoard;
+    if (!config.getLogging().status_file.empty() && !statusBoard.open(config.getLogging().status_file)) {
+        LOG_WARN("Live status disabled");
+    }
+
     // Create components
-    std::shared_ptr<ModemSerial> modem;
+    std::vector<std::shared_ptr<ModemSerial>> modems;
     std::shared_ptr<TrunkingController> controller;
 
     auto network = std::make_shared<NetworkClient>(
         config.getReflector()
     );
 
-    // Initialize modem if enabled
-    if (config.getModem().enabled) {
-        LOG_INFO("Initializing MMDVM modem...");
-        modem = std::make_shared<ModemSerial>(
-            config.getModem(),
-            config.getP25().nac
-        );
-
-        if (!modem->open()) {
-            LOG_ERROR("Failed to open modem - exiting");
-            return 1;
+    // Initialize modems if enabled - one read thread each, one shared reflector link
+    if (!config.getModems().empty()) {
+        LOG_INFO("Initializing MMDVM modem" + std::string(config.getModems().size() > 1 ? "s..." : "..."));
+        for (const ModemConfig& modemConfig : config.getModems()) {
+            modems.push_back(std::make_shared<ModemSerial>(
+                modemConfig,
+                config.getP25().nac,
+                modems.size()
+            ));
         }
 
         controller = std::make_shared<TrunkingController>(
             config.getP25(),
-            modem,
-            network
+            modems,
+            network,
+            journal
         );
+
+        if (statusBoard.isOpen()) {
+            controller->setCallEndCallback([&statusBoard](const CallRecord& record) {
+                statusBoard.addHeard(record);
+            });
+        }
     } else {
         LOG_WARN("Modem disabled - running in network-only mode");
         LOG_WARN("This is for testing purposes only!");
     }
 
-    // Start network
-    LOG_INFO("Connecting to reflector...");
-    if (!network->start()) {
-        LOG_ERROR("Failed to connect to reflector - exiting");
-        if (modem) modem->close();
-        return 1;
+    Handoff handoff(config.getHandoff(), modems, network, controller);
+
+    // Warm restart - the hotspot runs without snapshots if the file can't be opened
+    StateSnapshot snapshot;
+    if (controller && !config.getSnapshot().file.empty() && !snapshot.open(config.getSnapshot().file)) {
+        LOG_WARN("State snapshots disabled");
     }
 
-    // Wait for authentication
-    int authWait = 0;
-    while (!network->isAuthenticated() && authWait < 10) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(500));
-        authWait++;
+    if (takeover) {
+        // The links are already open, configured and authenticated
+        LOG_INFO("Taking over from the running process...");
+        if (!handoff.takeOver()) {
+            LOG_ERROR("Takeover failed - exiting");
+            return 1;
+        }
+
+        // systemd follows us instead of the process we took over from
+        notifySystemd("MAINPID=" + std::to_string(getpid()) + "\nREADY=1");
+        if (takeoverResult >= 0) {
+            char result = 1;
+            ssize_t ignored = write(takeoverResult, &result, 1);
+            (void)ignored;
+            close(takeoverResult);
+        }
+    } else {
+        // Grants, units and subscriptions from before the restart
+        StateImage image;
+        uint64_t ageMs = 0;
+        if (snapshot.load(image, static_cast<uint64_t>(config.getSnapshot().max_age) * 1000, ageMs) &&
+            !controller->restoreSnapshot(image, ageMs)) {
+            LOG_WARN("State snapshot unreadable - cold start");
+        }
+
+        // The wiring is fixed, so the controller is compiled into the read loops
+        for (size_t i = 0; i < modems.size(); i++) {
+            if (!modems[i]->open(controller->getModemSink(i))) {
+                LOG_ERROR("Failed to open modem " + modems[i]->describeTransport() + " - exiting");
+                for (auto& modem : modems) modem->close();
+                return 1;
+            }
+        }
+
+        // Start network
+        LOG_INFO("Connecting to reflector...");
+        bool networkStarted = controller ? network->start(controller->getNetworkSink()) : network->start();
+        if (!networkStarted) {
+            LOG_ERROR("Failed to connect to reflector - exiting");
+            for (auto& modem : modems) modem->close();
+            return 1;
+        }
+
+        // start() only returns true once the reflector accepted us
+
+        // Start trunking controller if modem enabled
+        if (controller) {
+            LOG_INFO("Starting trunking controller...");
+            controller->start();
+        }
     }
 
-    if (!network->isAuthenticated()) {
-        LOG_ERROR("Authentication timeout - exiting");
-        network->stop();
-        if (modem) modem->close();
-        return 1;
+    // The next upgrade takes over from us
+    if (!config.getHandoff().socket.empty() && !handoff.listen(wakeMain)) {
+        LOG_WARN("Zero-downtime upgrade disabled");
     }
 
-    // Start trunking controller if modem enabled
-    if (controller) {
-        LOG_INFO("Starting trunking controller...");
-        controller->start();
+    if (!takeover) {
+        notifySystemd("READY=1");
     }
 
+    auto startSnapshots = [&]() {
+        snapshot.start(config.getSnapshot().interval_ms, [&controller](StateImage& image) {
+            controller->saveSnapshot(image);
+        });
+    };
+    startSnapshots();
+
     LOG_INFO("============================================================");
     LOG_INFO("✓ P25 Hotspot Running");
     LOG_INFO("============================================================");
     LOG_INFO("Reflector: " + config.getReflector().address + ":" + std::to_string(config.getReflector().port));
     LOG_INFO("Radio ID: " + std::to_string(config.getReflector().radio_id) + " (" + config.getReflector().callsign + ")");
-    if (config.getModem().enabled) {
-        LOG_INFO("Modem: " + config.getModem().port);
-        LOG_INFO("RX Freq: " + std::to_string(config.getModem().rx_frequency / 1000000.0) + " MHz");
-        LOG_INFO("TX Freq: " + std::to_string(config.getModem().tx_frequency / 1000000.0) + " MHz");
+    if (!modems.empty()) {
+        for (const auto& modem : modems) {
+            const ModemConfig& modemConfig = modem->getConfig();
+            LOG_INFO("Modem: " + modem->describeTransport() +
+                     (modems.size() > 1 ? " (" + modemConfig.role + ", channel " + std::to_string(modemConfig.channel) + ")" : ""));
+            LOG_INFO("RX Freq: " + std::to_string(modemConfig.rx_frequency / 1000000.0) + " MHz");
+            LOG_INFO("TX Freq: " + std::to_string(modemConfig.tx_frequency / 1000000.0) + " MHz");
+        }
     } else {
         LOG_INFO("Modem: DISABLED (network-only mode)");
     }
@@ -159,32 +343,164 @@ int main(int argc, char* argv[]) {
     LOG_INFO("Press Ctrl+C to stop");
     LOG_INFO("");
 
-    // Main loop
+    // Health check on the timer wheel - wakes the main thread on failure
+    std::atomic<bool> modemLost(false);
+    std::atomic<bool> networkLost(false);
+    TimerWheel::Timer healthTimer;
+    TimerWheel::getInstance().schedulePeriodic(healthTimer, 1000, [&]() {
+        for (const auto& modem : modems) {
+            if (!modem->isOpen()) {
+                modemLost = true;
+                wakeMain();
+            }
+        }
+        if (!network->isConnected()) {
+            networkLost = true;
+            wakeMain();
+        }
+    });
+
+    TimerWheel::Timer allocTimer;
+    if (AllocTrace::ENABLED) {
+        AllocTrace::logRates();
+        TimerWheel::getInstance().schedulePeriodic(allocTimer, ALLOC_REPORT_INTERVAL_MS, []() {
+            AllocTrace::logRates();
+        });
+    }
+
+    TimerWheel::Timer statusTimer;
+    if (statusBoard.isOpen()) {
+        TimerWheel::getInstance().schedulePeriodic(statusTimer, STATUS_INTERVAL_MS, [&]() {
+            // Gather before taking the board lock - the call snapshots lock
+            // the tracker, which calls back into the board on call end
+            CallRecord calls[2];
+            bool live[2] = {false, false};
+            TsbkScheduler::Stats tsbk = {};
+            if (controller) {
+                live[0] = controller->getLiveCall(CallDirection::RF, calls[0]);
+                live[1] = controller->getLiveCall(CallDirection::Network, calls[1]);
+                if (config.getP25().trunking) {
+                    tsbk = controller->getControlChannel().getStats();
+                }
+            }
+
+            statusBoard.update([&](StatusBlock& status) {
+                status.modemOpen = !modems.empty();
+                for (const auto& modem : modems) {
+                    status.modemOpen = status.modemOpen && modem->isOpen();
+                }
+                status.networkConnected = network->isConnected();
+                status.networkAuthenticated = network->isAuthenticated();
+                status.trunking = config.getP25().trunking;
+                status.p25Space = modems.empty() ? 0 : modems.front()->getP25BufferSpace();
+
+                for (size_t i = 0; i < 2; i++) {
+                    status.calls[i] = calls[i];
+                    status.calls[i].sequence = live[i] ? 1 : 0;
+                }
+
+                if (controller) {
+                    status.grants = static_cast<uint32_t>(controller->getActiveGrantCount());
+                    status.units = static_cast<uint32_t>(controller->getRegisteredUnitCount());
+                    status.subscriptions = static_cast<uint32_t>(controller->getSubscriptionCount());
+                    status.rfDropped = controller->getArbiterDropped(CallDirection::RF);
+                    status.networkDropped = controller->getArbiterDropped(CallDirection::Network);
+                    status.preemptions = controller->getPreemptions();
+                    status.filterDropped = controller->getFilter().getTotalDropped();
+                    status.unknownFrames = controller->getUnknownFrameCount();
+                }
+
+                status.tsbkSent = 0;
+                for (uint64_t sent : tsbk.sent) {
+                    status.tsbkSent += sent;
+                }
+                status.tsbkSent += tsbk.broadcasts;
+                status.tsbkBroadcasts = tsbk.broadcasts;
+                status.tsbkMissed = tsbk.missed;
+
+                for (size_t direction = 0; direction < 2; direction++) {
+                    for (size_t stage = 0; stage < TRACE_STAGE_COUNT; stage++) {
+                        LatencyHistogram::Summary summary = FrameTrace::getInstance().getSummary(
+                            static_cast<CallDirection>(direction), static_cast<TraceStage>(stage));
+                        LatencyStatus& latency = status.latency[direction][stage];
+                        latency.count = summary.count;
+                        latency.p50Us = static_cast<uint32_t>(summary.p50Ns / 1000);
+                        latency.p99Us = static_cast<uint32_t>(summary.p99Ns / 1000);
+                        latency.p999Us = static_cast<uint32_t>(summary.p999Ns / 1000);
+                        latency.maxUs = static_cast<uint32_t>(summary.maxNs / 1000);
+                    }
+                }
+            });
+        });
+    }
+
+    // Main loop - sleeps until something needs the main thread
+    bool handedOver = false;
     while (g_running) {
-        std::this_thread::sleep_for(std::chrono::seconds(1));
+        uint64_t value;
+        if (read(g_wakeFd, &value, sizeof(value)) < 0 && errno != EINTR) {
+            LOG_ERROR("Main wait failed - exiting");
+            break;
+        }
 
-        // Check modem status
-        if (modem && !modem->isOpen()) {
+        // A new binary is taking over - exit without closing anything once
+        // it has. It writes the snapshots from then on.
+        if (handoff.isRequested()) {
+            snapshot.stop();
+            if (handoff.handOver()) {
+                handedOver = true;
+                break;
+            }
+            startSnapshots();
+        }
+
+        if (modemLost) {
             LOG_ERROR("Modem connection lost - exiting");
             break;
         }
 
-        // Check network status
-        if (!network->isConnected()) {
+        if (networkLost) {
             LOG_ERROR("Network connection lost - exiting");
             break;
         }
     }
 
+    TimerWheel::getInstance().cancel(healthTimer);
+    TimerWheel::getInstance().cancel(statusTimer);
+    TimerWheel::getInstance().cancel(allocTimer);
+    handoff.close();
+
     // Shutdown
     LOG_INFO("");
     LOG_INFO("============================================================");
-    LOG_INFO("Shutting down...");
+    LOG_INFO(handedOver ? "Handed over - exiting..." : "Shutting down...");
     LOG_INFO("============================================================");
 
+    // A clean restart comes back with the state as it is now
+    snapshot.stop();
+    if (!handedOver) {
+        snapshot.save();
+    }
+
+    // After a handoff the links are detached and the controller suspended,
+    // so none of these tell the modem or the reflector anything
     if (controller) controller->stop();
     network->stop();
-    if (modem) modem->close();
+    for (auto& modem : modems) modem->close();
+    if (handedOver) {
+        statusBoard.detach();
+    } else {
+        statusBoard.close();
+    }
+    Realtime::getInstance().logStats();
+    FrameTrace::getInstance().logSummary();
+
+    // Last - stopping components above still waits on wheel timeouts
+    TimerWheel::getInstance().shutdown();
+
+    // Every thread that captures is gone
+    FrameCapture::getInstance().close();
+    close(g_wakeFd);
 
     LOG_INFO("✓ P25 Hotspot stopped cleanly");
     LOG_INFO("73!");
@@ -0,0 +1,160 @@
+// p25-cdr - query the call detail record journal
+//
+// Usage: p25-cdr [--file <path>] [--tg <id>] [--src <id>] [--since <time>] [--limit <n>] [--csv]
+//
+// --since takes unix seconds or a relative age such as 90m, 12h or 7d.
+// Records are printed newest first. The journal is mapped read-only, so
+// this is safe to run while the hotspot is writing.
+
+#include "CallJournal.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <string>
+
+namespace {
+
+const char* DEFAULT_FILE = "/var/lib/p25-hotspot/calls.cdr";
+
+bool parseSince(const std::string& value, uint64_t& sinceUs) {
+    if (value.empty()) {
+        return false;
+    }
+
+    char* end = nullptr;
+    unsigned long long number = strtoull(value.c_str(), &end, 10);
+    uint64_t unit = 0;
+    switch (*end) {
+        case '\0': sinceUs = number * 1000000ULL; return true;
+        case 's': unit = 1; break;
+        case 'm': unit = 60; break;
+        case 'h': unit = 3600; break;
+        case 'd': unit = 86400; break;
+        default: return false;
+    }
+
+    uint64_t nowUs = static_cast<uint64_t>(time(nullptr)) * 1000000ULL;
+    uint64_t ageUs = number * unit * 1000000ULL;
+    sinceUs = ageUs < nowUs ? nowUs - ageUs : 0;
+    return true;
+}
+
+void formatTime(uint64_t us, char* buffer, size_t size) {
+    time_t seconds = static_cast<time_t>(us / 1000000);
+    struct tm local;
+    localtime_r(&seconds, &local);
+    strftime(buffer, size, "%Y-%m-%d %H:%M:%S", &local);
+}
+
+void printRecord(const CallRecord& record, bool csv) {
+    char start[32];
+    formatTime(record.startUs, start, sizeof(start));
+    double duration = record.endUs > record.startUs ? (record.endUs - record.startUs) / 1e6 : 0.0;
+    double loss = record.frames + record.lostFrames > 0
+        ? 100.0 * record.lostFrames / (record.frames + record.lostFrames) : 0.0;
+    const char* direction = record.direction == 0 ? "RF" : "NET";
+
+    std::string flags;
+    if (record.flags & CDR_FLAG_EMERGENCY) flags += "E";
+    if (record.flags & CDR_FLAG_ENCRYPTED) flags += "X";
+    if (record.flags & CDR_FLAG_NO_EOT) flags += "T";
+
+    char rssi[16];
+    if (record.rssi == CDR_RSSI_UNKNOWN) {
+        snprintf(rssi, sizeof(rssi), "-");
+    } else {
+        snprintf(rssi, sizeof(rssi), "%d", record.rssi);
+    }
+
+    if (csv) {
+        printf("%s,%s,%u,%u,%.1f,%u,%u,%.2f,%u,%u,%u,%.1f,%u,%u,%s,%d,%d,%s\n", start, direction, record.talkgroup,
+               record.source, duration, record.frames, record.lostFrames, loss, record.superframes,
+               record.badSuperframes, record.lateFrames, record.jitterUs / 1000.0, record.maxGapMs, record.concealedFrames, rssi,
+               record.rssiMin == CDR_RSSI_UNKNOWN ? 0 : record.rssiMin,
+               record.rssiMax == CDR_RSSI_UNKNOWN ? 0 : record.rssiMax, flags.c_str());
+    } else {
+        printf("%s  %-3s  TG %-7u  SRC %-8u  %7.1fs  %6u frames  %5.1f%% loss  %4u late  jitter %5.1f ms  RSSI %-4s  %s\n",
+               start, direction, record.talkgroup, record.source, duration, record.frames, loss, record.lateFrames,
+               record.jitterUs / 1000.0, rssi, flags.c_str());
+    }
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    std::string file = DEFAULT_FILE;
+    uint32_t talkgroup = 0;
+    uint32_t source = 0;
+    uint64_t sinceUs = 0;
+    uint64_t limit = 100;
+    bool csv = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--file" && i + 1 < argc) {
+            file = argv[++i];
+        } else if (arg == "--tg" && i + 1 < argc) {
+            talkgroup = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 0));
+        } else if (arg == "--src" && i + 1 < argc) {
+            source = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 0));
+        } else if (arg == "--since" && i + 1 < argc) {
+            if (!parseSince(argv[++i], sinceUs)) {
+                fprintf(stderr, "Invalid --since value: %s\n", argv[i]);
+                return 1;
+            }
+        } else if (arg == "--limit" && i + 1 < argc) {
+            limit = strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--csv") {
+            csv = true;
+        } else {
+            fprintf(stderr, "Usage: %s [--file <path>] [--tg <id>] [--src <id>] [--since <time>] [--limit <n>] [--csv]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    CallJournal journal;
+    if (!journal.openReadOnly(file)) {
+        fprintf(stderr, "Cannot open call journal %s\n", file.c_str());
+        return 1;
+    }
+
+    auto started = std::chrono::steady_clock::now();
+
+    uint64_t end = journal.getWriteIndex();
+    uint64_t first = end > journal.getCapacity() ? end - journal.getCapacity() : 0;
+    uint64_t scanned = 0;
+    uint64_t matched = 0;
+
+    if (csv) {
+        printf("start,direction,talkgroup,source,duration_s,frames,lost,loss_pct,superframes,bad_superframes,"
+               "late,jitter_ms,max_gap_ms,concealed,rssi,rssi_min,rssi_max,flags\n");
+    }
+
+    // Newest first. The writer may be overwriting any slot, so the filters
+    // only look at a copy read() has checked.
+    for (uint64_t index = end; index > first && (limit == 0 || matched < limit); index--) {
+        CallRecord record;
+        scanned++;
+        if (!journal.read(index - 1, record)) {
+            continue;
+        }
+
+        // Appended at call end, so end times only go back from here
+        if (record.endUs < sinceUs) {
+            break;
+        }
+
+        if ((talkgroup != 0 && record.talkgroup != talkgroup) || (source != 0 && record.source != source)) {
+            continue;
+        }
+
+        printRecord(record, csv);
+        matched++;
+    }
+
+    double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+    fprintf(stderr, "%llu of %llu records matched in %.1f ms\n", static_cast<unsigned long long>(matched),
+            static_cast<unsigned long long>(scanned), elapsedMs);
+    return 0;
+}
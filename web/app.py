@@ -11,12 +11,17 @@ import os
 import re
 from datetime import datetime
 from license import is_licensed, activate_license, get_mac_address, load_license
+from status import read_status, STATUS_FILE
 
 app = Flask(__name__)
 
 CONFIG_FILE = '/etc/p25-hotspot.yaml'
 SERVICE_NAME = 'p25-hotspot'
 
+# Where the daemon publishes live status. Looked up once; saving the config
+# (which restarts the daemon) looks it up again.
+_status_path = None
+
 def load_config():
     """Load current configuration."""
     try:
@@ -27,14 +32,24 @@ def load_config():
 
 def save_config(config):
     """Save configuration to file."""
+    global _status_path
     try:
         with open(CONFIG_FILE, 'w') as f:
             yaml.dump(config, f, default_flow_style=False, sort_keys=False)
+        _status_path = None
         return True
     except Exception as e:
         print(f"Error saving config: {e}")
         return False
 
+def status_path():
+    """Path of the daemon's status block, from the config on first use."""
+    global _status_path
+    if _status_path is None:
+        config = load_config() or {}
+        _status_path = (config.get('logging') or {}).get('status_file', STATUS_FILE)
+    return _status_path
+
 def get_service_status():
     """Get systemd service status."""
     try:
@@ -165,6 +180,20 @@ def api_status():
         } if config else {}
     })
 
+@app.route('/api/live')
+def api_live():
+    """API endpoint for live status, read from the daemon's shared memory."""
+    path = status_path()
+    if not path:
+        return jsonify({'available': False})
+
+    live = read_status(path)
+    if live is None:
+        return jsonify({'available': False})
+
+    live['available'] = True
+    return jsonify(live)
+
 @app.route('/api/logs')
 def api_logs():
     """API endpoint for logs."""
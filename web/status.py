@@ -0,0 +1,169 @@
+#!/usr/bin/env python3
+"""
+P25 Hotspot live status reader
+Maps the daemon's shared-memory status block (src/StatusBoard.h) and reads it
+without system calls or locks - the daemon publishes under a seqlock and this
+side retries until it gets a consistent copy.
+"""
+
+import mmap
+import os
+import struct
+import time
+
+STATUS_FILE = '/dev/shm/p25-hotspot-status'
+
+STATUS_MAGIC = b'P25STAT\x00'
+STATUS_VERSION = 3
+
+# TraceStage order in src/FrameTrace.h, per direction (RF → network, network → RF)
+LATENCY_DIRECTIONS = ('rf_to_network', 'network_to_rf')
+LATENCY_STAGES = ('receive', 'controller', 'queue', 'send', 'total')
+
+# Must match StatusBlock in src/StatusBoard.h
+HEADER = struct.Struct('<8sIIQQQIBBBBBBHIII')
+COUNTERS = struct.Struct('<9Q')
+CALL = struct.Struct('<QQQIIIIhBBIIHHhhHH')
+LATENCY = struct.Struct('<QIIII')
+LAST_HEARD = 20
+CALLS_OFFSET = HEADER.size + COUNTERS.size
+HEARD_OFFSET = CALLS_OFFSET + 2 * CALL.size
+LATENCY_OFFSET = HEARD_OFFSET + LAST_HEARD * CALL.size
+STATUS_SIZE = LATENCY_OFFSET + 2 * len(LATENCY_STAGES) * LATENCY.size
+
+SEQUENCE_OFFSET = 16
+READ_ATTEMPTS = 100
+
+# Updates arrive every 500 ms - anything this old means the daemon is gone
+STALE_AFTER_S = 3.0
+
+RSSI_UNKNOWN = -32768
+FLAG_EMERGENCY = 0x01
+FLAG_ENCRYPTED = 0x02
+FLAG_NO_EOT = 0x04
+
+COUNTER_NAMES = ('rf_dropped', 'network_dropped', 'preemptions', 'filter_dropped', 'unknown_frames',
+                 'tsbk_sent', 'tsbk_broadcasts', 'tsbk_missed', 'calls_heard')
+
+_mapping = None
+_mapped_path = None
+
+
+def _map(path):
+    """Map the status file once; the daemon reuses it across restarts."""
+    global _mapping, _mapped_path
+    if _mapping is not None and _mapped_path == path:
+        return _mapping
+
+    try:
+        fd = os.open(path, os.O_RDONLY)
+    except OSError:
+        return None
+    try:
+        if os.fstat(fd).st_size < STATUS_SIZE:
+            return None
+        _mapping = mmap.mmap(fd, STATUS_SIZE, mmap.MAP_SHARED, mmap.PROT_READ)
+        _mapped_path = path
+        return _mapping
+    finally:
+        os.close(fd)
+
+
+def _snapshot(mapping):
+    """Consistent copy of the block, or None if the writer kept it busy."""
+    for _ in range(READ_ATTEMPTS):
+        before = struct.unpack_from('<Q', mapping, SEQUENCE_OFFSET)[0]
+        if before & 1:
+            continue
+        data = mapping[:STATUS_SIZE]
+        if struct.unpack_from('<Q', mapping, SEQUENCE_OFFSET)[0] == before:
+            return data
+    return None
+
+
+def _call(data, offset, now_us=None):
+    (_, start_us, end_us, talkgroup, source, frames, lost, rssi, direction, flags,
+     late, jitter_us, max_gap_ms, concealed, rssi_min, rssi_max, superframes, bad_superframes) = CALL.unpack_from(data, offset)
+    end_us = now_us or end_us
+    expected = frames + lost
+    return {
+        'direction': 'RF' if direction == 0 else 'NET',
+        'talkgroup': talkgroup,
+        'source': source,
+        'start': start_us / 1e6,
+        'duration': max(0, end_us - start_us) / 1e6,
+        'frames': frames,
+        'loss_pct': round(100.0 * lost / expected, 1) if expected else 0.0,
+        'late': late,
+        'jitter_ms': round(jitter_us / 1000.0, 1),
+        'max_gap_ms': max_gap_ms,
+        'concealed': concealed,
+        'superframes': superframes,
+        'bad_superframes': bad_superframes,
+        'rssi': None if rssi == RSSI_UNKNOWN else rssi,
+        'rssi_min': None if rssi_min == RSSI_UNKNOWN else rssi_min,
+        'rssi_max': None if rssi_max == RSSI_UNKNOWN else rssi_max,
+        'emergency': bool(flags & FLAG_EMERGENCY),
+        'encrypted': bool(flags & FLAG_ENCRYPTED),
+        'timed_out': bool(flags & FLAG_NO_EOT),
+    }
+
+
+def _latency(data):
+    latency = {}
+    for d, direction in enumerate(LATENCY_DIRECTIONS):
+        stages = {}
+        for s, stage in enumerate(LATENCY_STAGES):
+            count, p50, p99, p999, maximum = LATENCY.unpack_from(
+                data, LATENCY_OFFSET + (d * len(LATENCY_STAGES) + s) * LATENCY.size)
+            stages[stage] = {'count': count, 'p50_us': p50, 'p99_us': p99, 'p999_us': p999, 'max_us': maximum}
+        latency[direction] = stages
+    return latency
+
+
+def read_status(path=STATUS_FILE):
+    """Live status as a dict, or None if the daemon has never published."""
+    mapping = _map(path)
+    if mapping is None:
+        return None
+
+    data = _snapshot(mapping)
+    if data is None:
+        return None
+
+    (magic, version, size, _, updated_us, started_us, pid, running, modem_open, network_connected,
+     network_authenticated, trunking, p25_space, heard_count, grants, units, subscriptions) = HEADER.unpack_from(data, 0)
+    if magic != STATUS_MAGIC or version != STATUS_VERSION or size != STATUS_SIZE:
+        return None
+
+    now = time.time()
+    age = now - updated_us / 1e6
+
+    calls = []
+    for index in range(2):
+        offset = CALLS_OFFSET + index * CALL.size
+        if struct.unpack_from('<Q', data, offset)[0] != 0:
+            calls.append(_call(data, offset, int(now * 1e6)))
+
+    heard = [_call(data, HEARD_OFFSET + index * CALL.size) for index in range(min(heard_count, LAST_HEARD))]
+
+    return {
+        'running': bool(running) and age < STALE_AFTER_S,
+        'age': round(age, 1),
+        'pid': pid,
+        'uptime': int(now - started_us / 1e6),
+        'link': {
+            'modem': bool(modem_open),
+            'network': bool(network_connected),
+            'authenticated': bool(network_authenticated),
+            'trunking': bool(trunking),
+            'p25_space': p25_space,
+        },
+        'grants': grants,
+        'units': units,
+        'subscriptions': subscriptions,
+        'counters': dict(zip(COUNTER_NAMES, COUNTERS.unpack_from(data, HEADER.size))),
+        'calls': calls,
+        'heard': heard,
+        'latency': _latency(data),
+    }